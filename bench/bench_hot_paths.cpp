@@ -0,0 +1,213 @@
+#include <QApplication>
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#define private public
+#include "tray.h"
+#undef private
+
+// Per-tick hot paths. Run the `bench` target for machine-readable results
+// in bench-results.xml, or pass Catch2 reporter options to nohang-tr-bench.
+
+namespace {
+std::unique_ptr<QApplication> app = [] {
+  qputenv("QT_QPA_PLATFORM", "offscreen");
+  int argc = 0;
+  char *argv[] = {(char *)"bench", nullptr};
+  return std::make_unique<QApplication>(argc, argv);
+}();
+
+const std::string kFixtures = NOHANG_BENCH_FIXTURES;
+
+std::string slurp(const std::string &path) {
+  std::ifstream in(path);
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+/// Returns the same reading every tick, like a system at steady state.
+struct FixedProbe : SystemProbe {
+  ProbeSample s;
+  explicit FixedProbe(const ProbeSample &sample) : s(sample) {}
+  std::optional<ProbeSample> sample() const override { return s; }
+};
+
+ProbeSample fixtureSample() {
+  SystemProbe probe(kFixtures + "/meminfo", kFixtures + "/pressure/memory");
+  auto s = probe.sample();
+  REQUIRE(s);
+  return *s;
+}
+
+/// Points XDG_CONFIG_HOME at a directory with or without a nohang.conf.
+class NohangConf {
+public:
+  /// @p repeat copies of a commented block of settings, like the long
+  /// nohang.conf shipped by distributions; 0 for no file at all.
+  explicit NohangConf(int repeat) : old_(qgetenv("XDG_CONFIG_HOME")) {
+    QDir().mkpath(dir_.filePath("nohang"));
+    if (repeat > 0) {
+      QFile f(dir_.filePath("nohang/nohang.conf"));
+      REQUIRE(f.open(QIODevice::WriteOnly | QIODevice::Text));
+      QTextStream ts(&f);
+      for (int i = 0; i < repeat; ++i) {
+        ts << "##################################################\n";
+        ts << "#   Thresholds below which memory is considered low.\n";
+        ts << "#   Units: %, M; percentages are of MemTotal.\n";
+        ts << "@LOW_MEMORY_WARNINGS  PLAIN\n";
+        ts << "\n";
+        ts << "warning_threshold_min_mem = 20 %   # of MemTotal\n";
+        ts << "soft_threshold_min_mem = 256 M\n";
+        ts << "hard_threshold_min_mem = 128 M\n";
+        ts << "warning_threshold_min_swap = 25 %\n";
+        ts << "soft_threshold_min_swap = 10 %\n";
+        ts << "hard_threshold_min_swap = 5 %\n";
+        ts << "warning_threshold_max_psi = 10\n";
+        ts << "soft_threshold_max_psi = 20\n";
+        ts << "hard_threshold_max_psi = 30\n";
+        ts << "psi_path = /proc/pressure/memory\n";
+        ts << "ignore_psi = False\n";
+        ts << "\n";
+      }
+    }
+    qputenv("XDG_CONFIG_HOME", dir_.path().toLocal8Bit());
+  }
+  ~NohangConf() {
+    if (old_.isEmpty())
+      qunsetenv("XDG_CONFIG_HOME");
+    else
+      qputenv("XDG_CONFIG_HOME", old_);
+  }
+
+private:
+  QTemporaryDir dir_;
+  QByteArray old_;
+};
+} // namespace
+
+TEST_CASE("meminfo parsing", "[parse]") {
+  const std::string text = slurp(kFixtures + "/meminfo");
+  BENCHMARK("parseMemAvailable") {
+    std::istringstream in(text);
+    return parseMemAvailable(in);
+  };
+  BENCHMARK("parseMemAvailable+MemTotal+MemFree+SwapFree+Cached") {
+    std::istringstream a(text), b(text), c(text), d(text), e(text);
+    return parseMemAvailable(a).value_or(0) + parseMemTotal(b).value_or(0) +
+           parseMemFree(c).value_or(0) + parseSwapFree(d).value_or(0) +
+           parseCached(e).value_or(0);
+  };
+  BENCHMARK("parseMeminfo") {
+    ProbeSample s;
+    parseMeminfo(text, s);
+    return s.meminfo_present;
+  };
+}
+
+TEST_CASE("PSI parsing", "[parse]") {
+  const std::string text = slurp(kFixtures + "/pressure/memory");
+  const std::string line = text.substr(0, text.find('\n'));
+  BENCHMARK("parsePsiMemoryLine") {
+    return SystemProbe::parsePsiMemoryLine(line);
+  };
+  BENCHMARK("parsePsi") {
+    std::optional<PsiValues> some, full;
+    SystemProbe::parsePsi(text, some, full);
+    return some;
+  };
+}
+
+TEST_CASE("vmstat parsing", "[parse]") {
+  const std::string text = slurp(kFixtures + "/vmstat");
+  BENCHMARK("parseVmstat") {
+    VmstatCounters c;
+    parseVmstat(text, c);
+    return c.pgscan;
+  };
+}
+
+TEST_CASE("SystemProbe::sample on fixture files", "[probe]") {
+  SystemProbe probe(kFixtures + "/meminfo", kFixtures + "/pressure/memory");
+  REQUIRE(probe.sample());
+  BENCHMARK("sample") { return probe.sample(); };
+}
+
+TEST_CASE("Tray::decide", "[decide]") {
+  AppConfig cfg;
+  const ProbeSample calm = fixtureSample();
+  ProbeSample pressured = calm;
+  pressured.mem_available_kib = cfg.mem.available_warn_kib - 1;
+  pressured.some.avg10 = cfg.psi.avg10_crit + 1;
+  BENCHMARK("decide calm") {
+    return Tray::decide(calm, cfg, Tray::State::Green, 0.0, 1.0);
+  };
+  BENCHMARK("decide pressured") {
+    return Tray::decide(pressured, cfg, Tray::State::Orange, 1.0, 1.0);
+  };
+
+  // Every meminfo key as a rule, none of them matching.
+  std::vector<std::string> text;
+  for (std::size_t i = 0; i < kMeminfoFieldCount; ++i)
+    text.push_back("yellow if meminfo." +
+                   std::string(meminfoKey(static_cast<MeminfoField>(i)).name) +
+                   " >= 1e18");
+  AppConfig many = cfg;
+  many.policy.rules =
+      Policy::compile(std::vector<std::string_view>(text.begin(), text.end()));
+  BENCHMARK("decide calm, one rule per meminfo key") {
+    return Tray::decide(calm, many, Tray::State::Green, 0.0, 1.0);
+  };
+}
+
+TEST_CASE("Tray::buildTooltip", "[tray]") {
+  AppConfig cfg;
+  const ProbeSample s = fixtureSample();
+  BENCHMARK("buildTooltip") {
+    return Tray::buildTooltip(s, cfg, Tray::State::Yellow);
+  };
+}
+
+TEST_CASE("Tray::refresh with a fake probe", "[tray]") {
+  NohangConf conf(0);
+  const ProbeSample s = fixtureSample();
+  Tray tray(nullptr, std::make_unique<FixedProbe>(s));
+  tray.refresh();
+  BENCHMARK("refresh unchanged sample") { tray.refresh(); };
+}
+
+TEST_CASE("AppConfig::load", "[config]") {
+  const QString example = NOHANG_BENCH_EXAMPLE_CONFIG;
+  SECTION("without nohang.conf") {
+    NohangConf conf(0);
+    BENCHMARK("load example") {
+      AppConfig cfg;
+      return cfg.load(example);
+    };
+  }
+  SECTION("with nohang.conf") {
+    NohangConf conf(1);
+    BENCHMARK("load example and nohang.conf") {
+      AppConfig cfg;
+      return cfg.load(example);
+    };
+  }
+  SECTION("with a large nohang.conf") {
+    // About 3400 lines, with percentages that need MemTotal on every key.
+    NohangConf conf(200);
+    BENCHMARK("load example and large nohang.conf") {
+      AppConfig cfg;
+      return cfg.load(example);
+    };
+  }
+}
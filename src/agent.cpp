@@ -0,0 +1,211 @@
+#include "agent.h"
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+/// Appends JSON members to an object, inserting the separators.
+class JsonObject {
+public:
+  explicit JsonObject(std::string &out) : out_(out) { out_ += '{'; }
+  ~JsonObject() { out_ += '}'; }
+
+  void key(const char *name) {
+    if (!first_)
+      out_ += ',';
+    first_ = false;
+    out_ += '"';
+    out_ += name;
+    out_ += "\":";
+  }
+  void number(const char *name, long long v) {
+    key(name);
+    out_ += std::to_string(v);
+  }
+  void number(const char *name, double v) {
+    key(name);
+    if (!std::isfinite(v)) {
+      out_ += "null";
+      return;
+    }
+    // Unlike printf, to_chars ignores the locale QCoreApplication sets.
+    char buf[64];
+    const auto r = std::to_chars(buf, buf + sizeof(buf), v,
+                                 std::chars_format::fixed, 2);
+    if (r.ec != std::errc()) {
+      out_ += "null";
+      return;
+    }
+    out_.append(buf, r.ptr);
+  }
+  void optional(const char *name, const std::optional<long> &v) {
+    if (v)
+      number(name, static_cast<long long>(*v));
+  }
+  void string(const char *name, std::string_view v) {
+    key(name);
+    quote(out_, v);
+  }
+
+  static void quote(std::string &out, std::string_view v) {
+    out += '"';
+    for (char c : v) {
+      switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+          out += buf;
+        } else {
+          out += c;
+        }
+      }
+    }
+    out += '"';
+  }
+
+private:
+  std::string &out_;
+  bool first_ = true;
+};
+
+void psi(JsonObject &obj, const char *name, const PsiValues &v,
+         std::string &out) {
+  obj.key(name);
+  JsonObject o(out);
+  o.number("avg10", v.avg10);
+  o.number("avg60", v.avg60);
+  o.number("avg300", v.avg300);
+  o.number("total", static_cast<long long>(v.total));
+}
+
+void resource(JsonObject &obj, const char *name, const PsiResourceValues &v,
+              std::string &out) {
+  if (!v.some && !v.full)
+    return;
+  obj.key(name);
+  JsonObject o(out);
+  if (v.some)
+    psi(o, "some", *v.some, out);
+  if (v.full)
+    psi(o, "full", *v.full, out);
+}
+
+/// Emits a JSON array of objects, one per item.
+template <typename T, typename Fill>
+void array(JsonObject &obj, const char *name, const std::vector<T> &items,
+           std::string &out, Fill fill) {
+  if (items.empty())
+    return;
+  obj.key(name);
+  out += '[';
+  for (std::size_t i = 0; i < items.size(); ++i) {
+    if (i > 0)
+      out += ',';
+    JsonObject o(out);
+    fill(o, items[i]);
+  }
+  out += ']';
+}
+} // namespace
+
+std::string AgentWriter::transitionLine(PressureState from, PressureState to,
+                                        std::int64_t timeMs) {
+  std::string out;
+  {
+    JsonObject o(out);
+    o.string("type", "transition");
+    o.number("time_ms", static_cast<long long>(timeMs));
+    o.string("from", pressureStateName(from));
+    o.string("to", pressureStateName(to));
+  }
+  return out;
+}
+
+std::string AgentWriter::sampleLine(const Sampler::Snapshot &snap,
+                                    std::int64_t timeMs) {
+  std::string out;
+  out.reserve(512);
+  {
+    JsonObject o(out);
+    o.string("type", "sample");
+    o.number("time_ms", static_cast<long long>(timeMs));
+    o.string("state", pressureStateName(snap.state));
+    o.number("interval_ms", static_cast<long long>(snap.interval_ms));
+    if (!snap.sample) {
+      o.string("error", "probe failed");
+    } else {
+      const ProbeSample &s = *snap.sample;
+      o.optional("mem_available_kib", s.mem_available_kib);
+      o.optional("mem_total_kib", s.mem_total_kib);
+      o.optional("mem_free_kib", s.mem_free_kib);
+      o.optional("swap_free_kib", s.swap_free_kib);
+      o.optional("cached_kib", s.cached_kib);
+      if (s.seconds_to_critical)
+        o.number("seconds_to_critical", *s.seconds_to_critical);
+      psi(o, "some", s.some, out);
+      psi(o, "full", s.full, out);
+      resource(o, "cpu", s.cpu, out);
+      resource(o, "io", s.io, out);
+      resource(o, "irq", s.irq, out);
+      if (s.vmstat) {
+        o.key("vmstat");
+        JsonObject v(out);
+        v.number("refault", s.vmstat->refault());
+        v.number("pswpin", s.vmstat->pswpin);
+        v.number("pswpout", s.vmstat->pswpout);
+        v.number("pgmajfault", s.vmstat->pgmajfault);
+        v.number("pgscan", s.vmstat->pgscan);
+        v.number("pgsteal", s.vmstat->pgsteal);
+        v.number("allocstall", s.vmstat->allocstall);
+      }
+      array(o, "cgroups", s.cgroups, out,
+            [&out](JsonObject &c, const CgroupSample &cg) {
+              c.string("path", cg.path);
+              c.number("current_kib", static_cast<long long>(cg.current_kib));
+              c.optional("max_kib", cg.max_kib);
+              c.optional("high_kib", cg.high_kib);
+              psi(c, "some", cg.some, out);
+            });
+      array(o, "processes", s.processes, out,
+            [](JsonObject &p, const ProcessSample &ps) {
+              p.number("pid", static_cast<long long>(ps.pid));
+              p.string("name", ps.name);
+              p.number("rss_kib", static_cast<long long>(ps.rss_kib));
+              p.optional("pss_kib", ps.pss_kib);
+              p.number("swap_kib", static_cast<long long>(ps.swap_kib));
+            });
+    }
+  }
+  return out;
+}
+
+void AgentWriter::write(const Sampler::Snapshot &snap) {
+  const std::int64_t timeMs =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          snap.time.time_since_epoch())
+          .count();
+  if (last_ && *last_ != snap.state) {
+    std::fputs(transitionLine(*last_, snap.state, timeMs).c_str(), out_);
+    std::fputc('\n', out_);
+  }
+  last_ = snap.state;
+  if (samples_) {
+    std::fputs(sampleLine(snap, timeMs).c_str(), out_);
+    std::fputc('\n', out_);
+  }
+  std::fflush(out_);
+}
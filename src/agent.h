@@ -0,0 +1,40 @@
+#pragma once
+#include "pressure_state.h"
+#include "sampler.h"
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+
+/**
+ * @brief Writes published snapshots as JSON lines for the headless agent.
+ *
+ * Every snapshot becomes one `"type":"sample"` object; a state change is
+ * announced first by a `"type":"transition"` object. Lines are flushed as
+ * they are written so a pipe reader sees them immediately.
+ */
+class AgentWriter {
+public:
+  /**
+   * @param out Stream to write to.
+   * @param samples Write sample lines; transitions are always written.
+   */
+  explicit AgentWriter(std::FILE *out, bool samples = true)
+      : out_(out), samples_(samples) {}
+
+  /** Write the lines for one snapshot, stamped with its capture time. */
+  void write(const Sampler::Snapshot &snap);
+
+  /** JSON object of a snapshot, without a trailing newline. */
+  static std::string sampleLine(const Sampler::Snapshot &snap,
+                                std::int64_t timeMs);
+
+  /** JSON object of a state change, without a trailing newline. */
+  static std::string transitionLine(PressureState from, PressureState to,
+                                    std::int64_t timeMs);
+
+private:
+  std::FILE *out_;
+  bool samples_;
+  std::optional<PressureState> last_;
+};
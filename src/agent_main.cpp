@@ -0,0 +1,89 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include "agent.h"
+#include "config.h"
+#include "sampler.h"
+
+// Headless variant of nohang-tr: same probe, decisions and configuration,
+// but without Widgets. Runs until SIGINT or SIGTERM, printing JSON lines;
+// SIGUSR1 dumps the phase latencies to stderr.
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    QCommandLineOption configOpt({"c", "config"}, "Path to configuration file", "path");
+    QCommandLineOption transitionsOpt({"t", "transitions-only"}, "Only print state transitions");
+    parser.addOption(configOpt);
+    parser.addOption(transitionsOpt);
+    parser.addHelpOption();
+    parser.process(app);
+
+    AppConfig cfg;
+    QString configPath = resolveConfigPath(parser.value(configOpt));
+    if (!configPath.isEmpty())
+        cfg.load(configPath);
+
+    // Signals are blocked before the sampler thread starts, so it inherits the
+    // mask, and read from a descriptor, so the wait below needs no event loop.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    if (sigprocmask(SIG_BLOCK, &signals, nullptr) < 0) {
+        std::perror("sigprocmask");
+        return 1;
+    }
+    int sigFd = signalfd(-1, &signals, SFD_CLOEXEC);
+    int wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (sigFd < 0 || wakeFd < 0) {
+        std::perror("signalfd/eventfd");
+        return 1;
+    }
+
+    Sampler sampler(std::make_unique<SystemProbe>(), cfg);
+    TickProfiler profiler;
+    sampler.setProfiler(&profiler);
+    sampler.enableTriggers();
+    AgentWriter writer(stdout, !parser.isSet(transitionsOpt));
+    sampler.start([wakeFd] {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] ssize_t n = write(wakeFd, &one, sizeof(one));
+    });
+
+    pollfd fds[2] = {{sigFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            std::perror("poll");
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            signalfd_siginfo info;
+            if (read(sigFd, &info, sizeof(info)) == sizeof(info) &&
+                info.ssi_signo == SIGUSR1) {
+                std::fputs(profiler.report().c_str(), stderr);
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            std::uint64_t count;
+            [[maybe_unused]] ssize_t n = read(wakeFd, &count, sizeof(count));
+            sampler.drainEach([&](const Sampler::Snapshot& snap) { writer.write(snap); });
+        }
+    }
+    sampler.stop();
+    close(wakeFd);
+    close(sigFd);
+    return 0;
+}
@@ -0,0 +1,259 @@
+#include "cgroup_monitor.h"
+#include "proc_read.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+struct CgroupMonitor::Group {
+    std::string path;
+    int pressureFd = -1;
+    int currentFd = -1;
+    int maxFd = -1;
+    int highFd = -1;
+    int statFd = -1;
+    std::vector<int> triggerFds;
+    bool fired = false;
+    ProcReader::Handle pressureSlot = 0;
+    ProcReader::Handle currentSlot = 0;
+    ProcReader::Handle maxSlot = 0;
+    ProcReader::Handle highSlot = 0;
+};
+
+namespace {
+
+/// Single-value cgroup files hold one short line.
+constexpr std::size_t kValueBufferSize = 64;
+/// Pressure files hold two lines of about 70 bytes.
+constexpr std::size_t kPressureBufferSize = 256;
+/// memory.stat is typically ~1.5 KiB.
+constexpr std::size_t kStatBufferSize = 8192;
+
+/// Parse a byte count from a single-value file; "max" and errors give nullopt.
+std::optional<long> parseKib(std::string_view text) {
+    long long bytes = 0;
+    if (text.empty() || std::from_chars(text.data(), text.data() + text.size(), bytes).ec != std::errc())
+        return std::nullopt;
+    return static_cast<long>(bytes / 1024);
+}
+
+/// Pick the anon and file byte counts out of memory.stat.
+void parseStat(std::string_view text, CgroupSample& out) {
+    while (!text.empty() && !(out.anon_kib && out.file_kib)) {
+        auto eol = text.find('\n');
+        std::string_view line = text.substr(0, eol);
+        auto sp = line.find(' ');
+        if (sp != std::string_view::npos) {
+            std::string_view key = line.substr(0, sp);
+            std::optional<long>* field = key == "anon" ? &out.anon_kib
+                                       : key == "file" ? &out.file_kib
+                                                       : nullptr;
+            long long bytes = 0;
+            if (field && std::from_chars(line.data() + sp + 1, line.data() + line.size(), bytes).ec == std::errc())
+                *field = static_cast<long>(bytes / 1024);
+        }
+        if (eol == std::string_view::npos) break;
+        text.remove_prefix(eol + 1);
+    }
+}
+
+/// Usage relative to the tightest of memory.high and memory.max, 0 if unlimited.
+double usageRatio(const CgroupSample& s) {
+    std::optional<long> limit = s.high_kib;
+    if (s.max_kib && (!limit || *s.max_kib < *limit)) limit = s.max_kib;
+    return limit && *limit > 0 ? static_cast<double>(s.current_kib) / *limit : 0.0;
+}
+
+bool worse(const CgroupSample& a, const CgroupSample& b) {
+    if (a.some.avg10 != b.some.avg10) return a.some.avg10 > b.some.avg10;
+    return usageRatio(a) > usageRatio(b);
+}
+
+void closeFd(int& fd) {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+} // namespace
+
+CgroupMonitor::CgroupMonitor(std::string root, int maxDepth)
+    : root_(std::move(root)), maxDepth_(maxDepth) {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+}
+
+CgroupMonitor::~CgroupMonitor() {
+    for (auto& g : groups_) close(*g);
+    closeFd(epollFd_);
+}
+
+void CgroupMonitor::close(Group& g) {
+    for (auto slot : {g.pressureSlot, g.currentSlot, g.maxSlot, g.highSlot})
+        reader_.remove(slot);
+    dropTriggers(g);
+    for (int* fd : {&g.pressureFd, &g.currentFd, &g.maxFd, &g.highFd, &g.statFd})
+        closeFd(*fd);
+}
+
+void CgroupMonitor::dropTriggers(Group& g) {
+    for (int& fd : g.triggerFds) {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+        closeFd(fd);
+    }
+    g.triggerFds.clear();
+}
+
+void CgroupMonitor::walk(const std::string& rel, int depth, std::vector<std::string>& found) const {
+    const std::string dir = rel.empty() ? root_ : root_ + '/' + rel;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+    while (dirent* e = readdir(d)) {
+        if (std::strcmp(e->d_name, ".") == 0 || std::strcmp(e->d_name, "..") == 0) continue;
+        bool isDir = e->d_type == DT_DIR;
+        if (e->d_type == DT_UNKNOWN) {
+            struct stat st {};
+            isDir = ::stat((dir + '/' + e->d_name).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (!isDir) continue;
+        std::string child = rel.empty() ? std::string(e->d_name) : rel + '/' + e->d_name;
+        if (depth < maxDepth_) walk(child, depth + 1, found);
+        found.push_back(std::move(child));
+    }
+    closedir(d);
+}
+
+std::unique_ptr<CgroupMonitor::Group> CgroupMonitor::open(const std::string& rel) {
+    const std::string dir = root_ + '/' + rel + '/';
+    auto g = std::make_unique<Group>();
+    g->path = rel;
+    // Without memory.current the memory controller is not enabled here.
+    g->currentFd = ::open((dir + "memory.current").c_str(), O_RDONLY | O_CLOEXEC);
+    if (g->currentFd < 0) return nullptr;
+    g->pressureFd = ::open((dir + "memory.pressure").c_str(), O_RDONLY | O_CLOEXEC);
+    g->maxFd = ::open((dir + "memory.max").c_str(), O_RDONLY | O_CLOEXEC);
+    g->highFd = ::open((dir + "memory.high").c_str(), O_RDONLY | O_CLOEXEC);
+    g->statFd = ::open((dir + "memory.stat").c_str(), O_RDONLY | O_CLOEXEC);
+    g->pressureSlot = reader_.add(g->pressureFd, kPressureBufferSize);
+    g->currentSlot = reader_.add(g->currentFd, kValueBufferSize);
+    g->maxSlot = reader_.add(g->maxFd, kValueBufferSize);
+    g->highSlot = reader_.add(g->highFd, kValueBufferSize);
+    return g;
+}
+
+std::size_t CgroupMonitor::rescan() {
+    std::vector<std::string> found;
+    walk({}, 1, found);
+    std::sort(found.begin(), found.end());
+
+    // groups_ stays sorted by path, so old and new sets merge in one pass.
+    std::vector<std::unique_ptr<Group>> next;
+    next.reserve(found.size());
+    auto it = groups_.begin();
+    for (const auto& rel : found) {
+        for (; it != groups_.end() && (*it)->path < rel; ++it) close(**it);
+        if (it != groups_.end() && (*it)->path == rel) {
+            next.push_back(std::move(*it++));
+            continue;
+        }
+        if (auto g = open(rel)) {
+            if (!triggers_.empty()) addTriggers(*g, triggers_);
+            next.push_back(std::move(g));
+        }
+    }
+    for (; it != groups_.end(); ++it) close(**it);
+    groups_ = std::move(next);
+    return groups_.size();
+}
+
+bool CgroupMonitor::addTriggers(Group& g, const std::vector<SystemProbe::Trigger>& triggers) {
+    const std::string path = root_ + '/' + g.path + "/memory.pressure";
+    std::vector<int> fds;
+    for (const auto& t : triggers) {
+        int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_APPEND | O_CLOEXEC);
+        if (fd >= 0) fds.push_back(fd);
+        std::string line = (t.type == SystemProbe::PsiType::Some ? "some " : "full ") +
+                           std::to_string(t.stall_us) + " " + std::to_string(t.window_us) + "\n";
+        epoll_event ev{};
+        ev.events = EPOLLPRI;
+        ev.data.ptr = &g;
+        if (fd < 0 || write(fd, line.c_str(), line.size()) < 0 ||
+            epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            for (int opened : fds) ::close(opened);
+            return false;
+        }
+    }
+    g.triggerFds.insert(g.triggerFds.end(), fds.begin(), fds.end());
+    return true;
+}
+
+bool CgroupMonitor::enableTriggers(const std::vector<SystemProbe::Trigger>& triggers) {
+    triggers_.insert(triggers_.end(), triggers.begin(), triggers.end());
+    bool ok = true;
+    for (auto& g : groups_) ok = addTriggers(*g, triggers) && ok;
+    return ok;
+}
+
+std::size_t CgroupMonitor::drainEvents() {
+    if (epollFd_ < 0) return 0;
+    epoll_event events[32];
+    std::size_t total = 0;
+    int n = 0;
+    while ((n = epoll_wait(epollFd_, events, 32, 0)) > 0) {
+        for (int i = 0; i < n; ++i) {
+            Group& g = *static_cast<Group*>(events[i].data.ptr);
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                // The cgroup was removed. Its triggers would report this on
+                // every wait until the next rescan() closes the group, so
+                // they leave the set now.
+                dropTriggers(g);
+                continue;
+            }
+            g.fired = true;
+            ++total;
+        }
+        if (n < 32) break;
+    }
+    return total;
+}
+
+void CgroupMonitor::sample(std::vector<CgroupSample>& out, std::size_t count) {
+    out.clear();
+    if (count == 0) return;
+    // Every small file of every cgroup is read in one batch.
+    reader_.readAll();
+    CgroupSample cur;
+    for (auto& g : groups_) {
+        auto current = parseKib(reader_.view(g->currentSlot));
+        if (!current) continue; // cgroup removed; the next rescan drops it
+        cur.current_kib = *current;
+        cur.max_kib = parseKib(reader_.view(g->maxSlot));
+        cur.high_kib = parseKib(reader_.view(g->highSlot));
+        cur.some = {};
+        cur.full = {};
+        cur.anon_kib.reset();
+        cur.file_kib.reset();
+        std::optional<PsiValues> some, full;
+        SystemProbe::parsePsi(reader_.view(g->pressureSlot), some, full);
+        if (some) cur.some = *some;
+        if (full) cur.full = *full;
+        cur.triggered = std::exchange(g->fired, false);
+        if (out.size() == count && !worse(cur, out.back())) continue;
+        // Keep out sorted worst first; only candidates copy their path.
+        cur.path = g->path;
+        if (out.size() == count) out.pop_back();
+        out.insert(std::upper_bound(out.begin(), out.end(), cur, worse), cur);
+    }
+    // memory.stat is the largest file, so only the reported cgroups read it.
+    char buf[kStatBufferSize];
+    for (auto& s : out) {
+        auto g = std::lower_bound(groups_.begin(), groups_.end(), s.path,
+                                  [](const auto& a, const std::string& p) { return a->path < p; });
+        if (g == groups_.end() || (*g)->statFd < 0) continue;
+        ssize_t n = readFromStart((*g)->statFd, buf, sizeof(buf));
+        if (n > 0) parseStat(std::string_view(buf, static_cast<std::size_t>(n)), s);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "system_probe.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Watches memory pressure of every cgroup in a cgroup v2 hierarchy.
+ *
+ * The hierarchy is walked once by rescan(); each cgroup with the memory
+ * controller keeps its memory.pressure, memory.current, memory.max,
+ * memory.high and memory.stat files open, so sampling hundreds of cgroups
+ * never re-opens a file. The small files of all cgroups are read in one
+ * ProcReader batch per sample. Triggers registered with enableTriggers() are
+ * collected in a single epoll set whose descriptor can be polled together
+ * with the system-wide triggers.
+ */
+class CgroupMonitor {
+public:
+    /**
+     * Construct a monitor for a cgroup v2 mount.
+     * @param root Mount point of the unified hierarchy.
+     * @param maxDepth Deepest level walked below @p root; the root cgroup
+     *        itself is skipped since /proc/pressure already covers it.
+     */
+    explicit CgroupMonitor(std::string root = "/sys/fs/cgroup", int maxDepth = 3);
+
+    /** Close every cgroup file, trigger and the epoll set. */
+    ~CgroupMonitor();
+
+    CgroupMonitor(const CgroupMonitor&) = delete;
+    CgroupMonitor& operator=(const CgroupMonitor&) = delete;
+
+    /**
+     * @brief Walk the hierarchy and sync the set of watched cgroups.
+     *
+     * Cgroups seen before keep their descriptors, new ones are opened and
+     * given the configured triggers, and vanished ones are closed.
+     * @return Number of cgroups watched afterwards.
+     */
+    std::size_t rescan();
+
+    /**
+     * @brief Register PSI triggers in every watched cgroup.
+     *
+     * Like SystemProbe::enableTriggers, each trigger gets its own descriptor.
+     * The triggers are remembered and also registered in cgroups found by
+     * later rescans.
+     * @param triggers Collection of trigger thresholds to register.
+     * @return True if every cgroup accepted every trigger.
+     */
+    bool enableTriggers(const std::vector<SystemProbe::Trigger>& triggers);
+
+    /**
+     * @brief Epoll descriptor that becomes readable when a trigger fires.
+     * @return Descriptor to poll for POLLIN, or -1 if epoll is unavailable.
+     */
+    int eventFd() const { return epollFd_; }
+
+    /**
+     * @brief Consume pending trigger events without blocking.
+     *
+     * Cgroups whose trigger fired are flagged in the next sample(). The
+     * triggers of a cgroup that was removed meanwhile are closed.
+     * @return Number of trigger events consumed.
+     */
+    std::size_t drainEvents();
+
+    /**
+     * @brief Read every watched cgroup and keep the worst ones.
+     *
+     * Cgroups are ranked by memory "some" avg10, then by usage relative to
+     * their limit; memory.stat is only read for the cgroups kept.
+     * @param out Receives at most @p count samples, worst first. Its
+     *        storage is reused between calls.
+     * @param count Number of cgroups to report.
+     */
+    void sample(std::vector<CgroupSample>& out, std::size_t count);
+
+    /** Number of cgroups currently watched. */
+    std::size_t size() const { return groups_.size(); }
+
+private:
+    struct Group;
+
+    void walk(const std::string& rel, int depth, std::vector<std::string>& found) const;
+    std::unique_ptr<Group> open(const std::string& rel);
+    bool addTriggers(Group& g, const std::vector<SystemProbe::Trigger>& triggers);
+    void close(Group& g);
+    void dropTriggers(Group& g);
+
+    std::string root_;
+    int maxDepth_;
+    int epollFd_ = -1;
+    std::vector<std::unique_ptr<Group>> groups_;
+    std::vector<SystemProbe::Trigger> triggers_;
+    ProcReader reader_;
+};
@@ -1,241 +1,391 @@
 #include "config.h"
+#include "config_lexer.h"
+#include "proc_read.h"
+#include "system_probe.h"
+#include <QByteArray>
 #include <QFile>
-#include <QTextStream>
-#include <QRegularExpression>
+#include <algorithm>
 #include <cstdlib>
 #include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <string_view>
 
 namespace {
 
-long readMemTotalKiB() {
-    const char* override = std::getenv("NOHANG_TR_MEMINFO");
-    QString path = (override && *override) ? QString::fromLocal8Bit(override)
-                                           : QStringLiteral("/proc/meminfo");
-    QFile f(path);
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
-        return 0;
-    QTextStream ts(&f);
-    while (!ts.atEnd()) {
-        const QString line = ts.readLine();
-        if (line.startsWith("MemTotal:")) {
-            auto parts = line.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
-            if (parts.size() >= 2)
-                return parts[1].toLong();
+using Psi = AppConfig::Psi;
+using Mem = decltype(AppConfig::mem);
+using Swap = decltype(AppConfig::swap);
+using Thrash = decltype(AppConfig::thrash);
+using Palette = decltype(AppConfig::palette);
+using Ui = decltype(AppConfig::ui);
+using Sample = decltype(AppConfig::sample);
+using Cgroup = decltype(AppConfig::cgroup);
+using Forecast = decltype(AppConfig::forecast);
+using History = decltype(AppConfig::history);
+using Metrics = decltype(AppConfig::metrics);
+using Process = decltype(AppConfig::process);
+
+/// State shared by the key handlers during one AppConfig::load().
+struct Loader {
+    AppConfig& cfg;
+    std::optional<long> memTotal;
+
+    /// MemTotal in KiB, read at most once per load; 0 when unavailable.
+    long memTotalKiB() {
+        if (!memTotal) {
+            const char* override = std::getenv("NOHANG_TR_MEMINFO");
+            const char* path = (override && *override) ? override : "/proc/meminfo";
+            char buf[8192];
+            ProbeSample s;
+            ssize_t n = readFile(path, buf, sizeof buf);
+            if (n > 0)
+                parseMeminfo(std::string_view(buf, static_cast<std::size_t>(n)), s);
+            memTotal = s.mem_total_kib.value_or(0);
         }
+        return *memTotal;
     }
-    return 0;
+};
+
+using Apply = void (*)(Loader&, const ConfigEntry&);
+
+struct KeyHandler {
+    std::string_view key;
+    Apply apply;
+};
+
+QString toQString(std::string_view s) {
+    return QString::fromUtf8(s.data(), static_cast<qsizetype>(s.size()));
 }
 
-long parseNohangMem(const QString& value) {
-    auto parts = value.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
-    if (parts.isEmpty())
-        return 0;
-    bool ok = false;
-    double num = parts[0].toDouble(&ok);
-    if (!ok)
+/// The AppConfig member reached through a chain of member pointers.
+template <auto... Member>
+auto& field(AppConfig& cfg) {
+    return (cfg .* ... .* Member);
+}
+
+template <auto... Member>
+void setDouble(Loader& l, const ConfigEntry& e) {
+    if (auto v = e.toDouble())
+        field<Member...>(l.cfg) = *v;
+}
+
+template <auto... Member>
+void setLong(Loader& l, const ConfigEntry& e) {
+    if (auto v = e.toLong())
+        field<Member...>(l.cfg) = *v;
+}
+
+template <int Min, auto... Member>
+void setIntAtLeast(Loader& l, const ConfigEntry& e) {
+    if (auto v = e.toInt(); v && *v >= Min)
+        field<Member...>(l.cfg) = *v;
+}
+
+template <auto... Member>
+void setInt(Loader& l, const ConfigEntry& e) {
+    setIntAtLeast<std::numeric_limits<int>::min(), Member...>(l, e);
+}
+
+template <auto... Member>
+void setBool(Loader& l, const ConfigEntry& e) {
+    field<Member...>(l.cfg) = e.text == "true";
+}
+
+template <auto... Member>
+void setString(Loader& l, const ConfigEntry& e) {
+    field<Member...>(l.cfg) = toQString(e.text);
+}
+
+/// A trigger written as "stall window" or [stall, window], in microseconds.
+template <auto... Member>
+void setTrigger(Loader& l, const ConfigEntry& e) {
+    std::string_view stall;
+    std::string_view window;
+    if (e.kind == ConfigEntry::Kind::Array) {
+        if (e.items.size() != 2)
+            return;
+        stall = e.items[0];
+        window = e.items[1];
+    } else {
+        const auto space = e.text.find_first_of(" \t");
+        if (space == std::string_view::npos)
+            return;
+        stall = e.text.substr(0, space);
+        window = e.text.substr(e.text.find_first_not_of(" \t", space));
+    }
+    auto s = ConfigEntry::parseLong(stall);
+    auto w = ConfigEntry::parseLong(window);
+    if (s && w)
+        field<Member...>(l.cfg) = Psi::Trigger{*s, *w};
+}
+
+/// Keys of nohang-tr.toml by full dotted path, sorted for binary search.
+constexpr KeyHandler kTomlKeys[] = {
+    {"cgroup.enabled", setBool<&AppConfig::cgroup, &Cgroup::enabled>},
+    {"cgroup.max_depth", setInt<&AppConfig::cgroup, &Cgroup::max_depth>},
+    {"cgroup.rescan_ticks", setInt<&AppConfig::cgroup, &Cgroup::rescan_ticks>},
+    {"cgroup.root", setString<&AppConfig::cgroup, &Cgroup::root>},
+    {"cgroup.top_n", setInt<&AppConfig::cgroup, &Cgroup::top_n>},
+    {"cgroup.trigger.full", setTrigger<&AppConfig::cgroup, &Cgroup::trigger, &Psi::Triggers::full>},
+    {"cgroup.trigger.some", setTrigger<&AppConfig::cgroup, &Cgroup::trigger, &Psi::Triggers::some>},
+    {"forecast.horizon_exit_sec", setDouble<&AppConfig::forecast, &Forecast::horizon_exit_sec>},
+    {"forecast.horizon_sec", setDouble<&AppConfig::forecast, &Forecast::horizon_sec>},
+    {"forecast.window_sec", setDouble<&AppConfig::forecast, &Forecast::window_sec>},
+    {"history.archive", setBool<&AppConfig::history, &History::archive>},
+    {"history.archive_path", setString<&AppConfig::history, &History::archive_path>},
+    {"history.capacity", setIntAtLeast<1, &AppConfig::history, &History::capacity>},
+    {"history.enabled", setBool<&AppConfig::history, &History::enabled>},
+    {"history.path", setString<&AppConfig::history, &History::path>},
+    {"mem.available_crit_exit_kib", setLong<&AppConfig::mem, &Mem::available_crit_exit_kib>},
+    {"mem.available_crit_kib", setLong<&AppConfig::mem, &Mem::available_crit_kib>},
+    {"mem.available_warn_exit_kib", setLong<&AppConfig::mem, &Mem::available_warn_exit_kib>},
+    {"mem.available_warn_kib", setLong<&AppConfig::mem, &Mem::available_warn_kib>},
+    {"metrics.listen", setString<&AppConfig::metrics, &Metrics::listen>},
+    {"policy.rules",
+     [](Loader& l, const ConfigEntry& e) {
+         if (e.kind != ConfigEntry::Kind::Array)
+             return;
+         std::vector<std::string> errors;
+         l.cfg.policy.rules = Policy::compile(e.items, &errors);
+         for (const std::string& err : errors)
+             std::cerr << "nohang-tr: ignoring policy rule " << err << '\n';
+     }},
+    {"process.budget_ms", setInt<&AppConfig::process, &Process::budget_ms>},
+    {"process.enabled", setBool<&AppConfig::process, &Process::enabled>},
+    {"process.sort",
+     [](Loader& l, const ConfigEntry& e) {
+         if (e.text == "rss" || e.text == "pss" || e.text == "swap")
+             l.cfg.process.sort = toQString(e.text);
+     }},
+    {"process.top_n", setInt<&AppConfig::process, &Process::top_n>},
+    {"process.workers", setInt<&AppConfig::process, &Process::workers>},
+    {"psi.avg10_crit", setDouble<&AppConfig::psi, &Psi::avg10_crit>},
+    {"psi.avg10_crit_exit", setDouble<&AppConfig::psi, &Psi::avg10_crit_exit>},
+    {"psi.avg10_deriv_warn", setDouble<&AppConfig::psi, &Psi::avg10_deriv_warn>},
+    {"psi.avg10_warn", setDouble<&AppConfig::psi, &Psi::avg10_warn>},
+    {"psi.avg10_warn_exit", setDouble<&AppConfig::psi, &Psi::avg10_warn_exit>},
+    {"psi.cpu.avg10_crit", setDouble<&AppConfig::psi, &Psi::cpu, &Psi::Resource::avg10_crit>},
+    {"psi.cpu.avg10_crit_exit", setDouble<&AppConfig::psi, &Psi::cpu, &Psi::Resource::avg10_crit_exit>},
+    {"psi.cpu.avg10_warn", setDouble<&AppConfig::psi, &Psi::cpu, &Psi::Resource::avg10_warn>},
+    {"psi.cpu.avg10_warn_exit", setDouble<&AppConfig::psi, &Psi::cpu, &Psi::Resource::avg10_warn_exit>},
+    {"psi.cpu.trigger.full", setTrigger<&AppConfig::psi, &Psi::cpu, &Psi::Resource::trigger, &Psi::Triggers::full>},
+    {"psi.cpu.trigger.some", setTrigger<&AppConfig::psi, &Psi::cpu, &Psi::Resource::trigger, &Psi::Triggers::some>},
+    {"psi.io.avg10_crit", setDouble<&AppConfig::psi, &Psi::io, &Psi::Resource::avg10_crit>},
+    {"psi.io.avg10_crit_exit", setDouble<&AppConfig::psi, &Psi::io, &Psi::Resource::avg10_crit_exit>},
+    {"psi.io.avg10_warn", setDouble<&AppConfig::psi, &Psi::io, &Psi::Resource::avg10_warn>},
+    {"psi.io.avg10_warn_exit", setDouble<&AppConfig::psi, &Psi::io, &Psi::Resource::avg10_warn_exit>},
+    {"psi.io.trigger.full", setTrigger<&AppConfig::psi, &Psi::io, &Psi::Resource::trigger, &Psi::Triggers::full>},
+    {"psi.io.trigger.some", setTrigger<&AppConfig::psi, &Psi::io, &Psi::Resource::trigger, &Psi::Triggers::some>},
+    {"psi.irq.avg10_crit", setDouble<&AppConfig::psi, &Psi::irq, &Psi::Resource::avg10_crit>},
+    {"psi.irq.avg10_crit_exit", setDouble<&AppConfig::psi, &Psi::irq, &Psi::Resource::avg10_crit_exit>},
+    {"psi.irq.avg10_warn", setDouble<&AppConfig::psi, &Psi::irq, &Psi::Resource::avg10_warn>},
+    {"psi.irq.avg10_warn_exit", setDouble<&AppConfig::psi, &Psi::irq, &Psi::Resource::avg10_warn_exit>},
+    {"psi.irq.trigger.full", setTrigger<&AppConfig::psi, &Psi::irq, &Psi::Resource::trigger, &Psi::Triggers::full>},
+    {"psi.irq.trigger.some", setTrigger<&AppConfig::psi, &Psi::irq, &Psi::Resource::trigger, &Psi::Triggers::some>},
+    {"psi.trigger.full", setTrigger<&AppConfig::psi, &Psi::trigger, &Psi::Triggers::full>},
+    {"psi.trigger.some", setTrigger<&AppConfig::psi, &Psi::trigger, &Psi::Triggers::some>},
+    {"sample.calm_ticks", setInt<&AppConfig::sample, &Sample::calm_ticks>},
+    {"sample.interval_ms", setInt<&AppConfig::sample_interval_ms>},
+    {"sample.max_interval_ms", setInt<&AppConfig::sample, &Sample::max_interval_ms>},
+    {"sample.min_interval_ms", setInt<&AppConfig::sample, &Sample::min_interval_ms>},
+    {"sample.ramp", setDouble<&AppConfig::sample, &Sample::ramp>},
+    {"swap.free_crit_exit_kib", setLong<&AppConfig::swap, &Swap::free_crit_exit_kib>},
+    {"swap.free_crit_kib", setLong<&AppConfig::swap, &Swap::free_crit_kib>},
+    {"swap.free_warn_exit_kib", setLong<&AppConfig::swap, &Swap::free_warn_exit_kib>},
+    {"swap.free_warn_kib", setLong<&AppConfig::swap, &Swap::free_warn_kib>},
+    {"thrash.allocstall_exit_per_sec", setDouble<&AppConfig::thrash, &Thrash::allocstall_exit_per_sec>},
+    {"thrash.allocstall_per_sec", setDouble<&AppConfig::thrash, &Thrash::allocstall_per_sec>},
+    {"thrash.refault_exit_per_sec", setDouble<&AppConfig::thrash, &Thrash::refault_exit_per_sec>},
+    {"thrash.refault_per_sec", setDouble<&AppConfig::thrash, &Thrash::refault_per_sec>},
+    {"thrash.swapin_exit_per_sec", setDouble<&AppConfig::thrash, &Thrash::swapin_exit_per_sec>},
+    {"thrash.swapin_per_sec", setDouble<&AppConfig::thrash, &Thrash::swapin_per_sec>},
+    {"ui.icon",
+     [](Loader& l, const ConfigEntry& e) {
+         if (e.text == "shield" || e.text == "sparkline")
+             l.cfg.ui.icon = toQString(e.text);
+     }},
+    {"ui.meminfo_fields",
+     [](Loader& l, const ConfigEntry& e) {
+         l.cfg.ui.meminfo_fields.clear();
+         for (std::string_view name : e.items) {
+             if (auto f = findMeminfoField(name))
+                 l.cfg.ui.meminfo_fields.push_back(*f);
+         }
+     }},
+    {"ui.palette.black", setString<&AppConfig::palette, &Palette::black>},
+    {"ui.palette.green", setString<&AppConfig::palette, &Palette::green>},
+    {"ui.palette.orange", setString<&AppConfig::palette, &Palette::orange>},
+    {"ui.palette.red", setString<&AppConfig::palette, &Palette::red>},
+    {"ui.palette.yellow", setString<&AppConfig::palette, &Palette::yellow>},
+    {"ui.sparkline_samples", setIntAtLeast<1, &AppConfig::ui, &Ui::sparkline_samples>},
+    {"ui.tooltip_min_interval_ms", setIntAtLeast<0, &AppConfig::ui, &Ui::tooltip_min_interval_ms>},
+    {"ui.tooltip_template",
+     [](Loader& l, const ConfigEntry& e) {
+         l.cfg.ui.tooltip_template = TooltipTemplate::compile(toQString(e.text));
+     }},
+};
+
+/**
+ * Parse a nohang memory threshold such as "512 M" or "10 %".
+ *
+ * A percentage is taken of MemTotal; any other unit, or none, means MiB.
+ * @return Threshold in KiB, or 0 when it cannot be parsed.
+ */
+long parseNohangMem(Loader& l, std::string_view value) {
+    const auto unitAt = value.find_first_of(" \t%");
+    auto num = ConfigEntry::parseDouble(value.substr(0, unitAt));
+    if (!num)
         return 0;
-    QString unit = parts.size() > 1 ? parts[1].toLower() : "m";
-    if (unit.startsWith('%')) {
-        long total = readMemTotalKiB();
+    std::string_view unit;
+    if (unitAt != std::string_view::npos)
+        unit = value.substr(value.find_first_not_of(" \t", unitAt));
+    if (!unit.empty() && unit.front() == '%') {
+        long total = l.memTotalKiB();
         if (total <= 0)
             return 0;
-        return static_cast<long>(num / 100.0 * total);
+        return static_cast<long>(*num / 100.0 * total);
     }
-    // default unit megabytes
-    return static_cast<long>(num * 1024);
+    return static_cast<long>(*num * 1024);
 }
 
-bool loadNohangConfig(AppConfig& cfg) {
-    QString path;
-    const char* xdg = std::getenv("XDG_CONFIG_HOME");
-    if (xdg && *xdg) {
-        path = QString::fromLocal8Bit(xdg) + "/nohang/nohang.conf";
-    } else {
-        const char* home = std::getenv("HOME");
-        if (home && *home)
-            path = QString::fromLocal8Bit(home) + "/.config/nohang/nohang.conf";
+/// nohang's warning/soft PSI percentage: entry and an exit 20% below it.
+template <auto Entry, auto Exit>
+void setNohangPsi(Loader& l, const ConfigEntry& e) {
+    if (auto v = e.toDouble()) {
+        l.cfg.psi.*Entry = *v / 100.0;
+        l.cfg.psi.*Exit = l.cfg.psi.*Entry * 0.8;
     }
-    if (path.isEmpty() || !QFile::exists(path))
-        path = "/etc/nohang/nohang.conf";
+}
 
+/// nohang's warning/soft memory threshold: entry and an exit 20% above it.
+template <auto Section, auto Entry, auto Exit>
+void setNohangMem(Loader& l, const ConfigEntry& e) {
+    long v = parseNohangMem(l, e.text);
+    if (v > 0) {
+        l.cfg.*Section.*Entry = v;
+        l.cfg.*Section.*Exit = v * 6 / 5;
+    }
+}
+
+/// nohang's hard memory threshold, used as the exit of the soft one.
+template <auto Section, auto Exit>
+void setNohangMemExit(Loader& l, const ConfigEntry& e) {
+    long v = parseNohangMem(l, e.text);
+    if (v > 0)
+        l.cfg.*Section.*Exit = v;
+}
+
+/// Keys of nohang.conf, sorted for binary search.
+constexpr KeyHandler kNohangKeys[] = {
+    {"hard_threshold_max_psi",
+     [](Loader& l, const ConfigEntry& e) {
+         if (auto v = e.toDouble())
+             l.cfg.psi.avg10_crit_exit = *v / 100.0;
+     }},
+    {"hard_threshold_min_mem", setNohangMemExit<&AppConfig::mem, &Mem::available_crit_exit_kib>},
+    {"hard_threshold_min_swap", setNohangMemExit<&AppConfig::swap, &Swap::free_crit_exit_kib>},
+    {"soft_threshold_max_psi", setNohangPsi<&Psi::avg10_crit, &Psi::avg10_crit_exit>},
+    {"soft_threshold_min_mem",
+     setNohangMem<&AppConfig::mem, &Mem::available_crit_kib, &Mem::available_crit_exit_kib>},
+    {"soft_threshold_min_swap",
+     setNohangMem<&AppConfig::swap, &Swap::free_crit_kib, &Swap::free_crit_exit_kib>},
+    {"warning_threshold_max_psi", setNohangPsi<&Psi::avg10_warn, &Psi::avg10_warn_exit>},
+    {"warning_threshold_min_mem",
+     setNohangMem<&AppConfig::mem, &Mem::available_warn_kib, &Mem::available_warn_exit_kib>},
+    {"warning_threshold_min_swap",
+     setNohangMem<&AppConfig::swap, &Swap::free_warn_kib, &Swap::free_warn_exit_kib>},
+};
+
+template <std::size_t N>
+constexpr bool isSorted(const KeyHandler (&table)[N]) {
+    for (std::size_t i = 1; i < N; ++i) {
+        if (!(table[i - 1].key < table[i].key))
+            return false;
+    }
+    return true;
+}
+static_assert(isSorted(kTomlKeys), "kTomlKeys must stay sorted by key");
+static_assert(isSorted(kNohangKeys), "kNohangKeys must stay sorted by key");
+
+template <std::size_t N>
+Apply findHandler(const KeyHandler (&table)[N], std::string_view key) {
+    auto it = std::lower_bound(std::begin(table), std::end(table), key,
+                               [](const KeyHandler& h, std::string_view k) { return h.key < k; });
+    return it != std::end(table) && it->key == key ? it->apply : nullptr;
+}
+
+/// Read a whole file; false if it cannot be opened.
+bool readAll(const QString& path, QByteArray& out) {
     QFile f(path);
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+    if (!f.open(QIODevice::ReadOnly))
         return false;
+    out = f.readAll();
+    return true;
+}
 
-    QTextStream ts(&f);
-    while (!ts.atEnd()) {
-        QString line = ts.readLine().trimmed();
-        if (line.isEmpty() || line.startsWith('#') || line.startsWith('@'))
-            continue;
-        int eq = line.indexOf('=');
-        if (eq == -1)
-            continue;
-        QString key = line.left(eq).trimmed();
-        QString value = line.mid(eq + 1).trimmed();
-        int comment = value.indexOf('#');
-        if (comment != -1)
-            value = value.left(comment).trimmed();
-
-        bool ok = false;
-        if (key == "warning_threshold_max_psi") {
-            double v = value.toDouble(&ok);
-            if (ok) {
-                cfg.psi.avg10_warn = v / 100.0;
-                cfg.psi.avg10_warn_exit = cfg.psi.avg10_warn * 0.8;
-            }
-        } else if (key == "soft_threshold_max_psi") {
-            double v = value.toDouble(&ok);
-            if (ok) {
-                cfg.psi.avg10_crit = v / 100.0;
-                cfg.psi.avg10_crit_exit = cfg.psi.avg10_crit * 0.8;
-            }
-        } else if (key == "hard_threshold_max_psi") {
-            double v = value.toDouble(&ok);
-            if (ok)
-                cfg.psi.avg10_crit_exit = v / 100.0;
-        } else if (key == "warning_threshold_min_mem") {
-            long v = parseNohangMem(value);
-            if (v > 0) {
-                cfg.mem.available_warn_kib = v;
-                cfg.mem.available_warn_exit_kib = v * 6 / 5;
-            }
-        } else if (key == "soft_threshold_min_mem") {
-            long v = parseNohangMem(value);
-            if (v > 0) {
-                cfg.mem.available_crit_kib = v;
-                cfg.mem.available_crit_exit_kib = v * 6 / 5;
-            }
-        } else if (key == "hard_threshold_min_mem") {
-            long v = parseNohangMem(value);
-            if (v > 0)
-                cfg.mem.available_crit_exit_kib = v;
-        } else if (key == "warning_threshold_min_swap") {
-            long v = parseNohangMem(value);
-            if (v > 0) {
-                cfg.swap.free_warn_kib = v;
-                cfg.swap.free_warn_exit_kib = v * 6 / 5;
-            }
-        } else if (key == "soft_threshold_min_swap") {
-            long v = parseNohangMem(value);
-            if (v > 0) {
-                cfg.swap.free_crit_kib = v;
-                cfg.swap.free_crit_exit_kib = v * 6 / 5;
-            }
-        } else if (key == "hard_threshold_min_swap") {
-            long v = parseNohangMem(value);
-            if (v > 0)
-                cfg.swap.free_crit_exit_kib = v;
-        }
-    }
-    cfg.source = AppConfig::Source::Nohang;
+std::string_view view(const QByteArray& bytes) {
+    return {bytes.constData(), static_cast<std::size_t>(bytes.size())};
+}
+
+bool loadNohangConfig(Loader& l) {
+    QByteArray text;
+    if (!readAll(nohangConfigPath(), text))
+        return false;
+    parseNohangConf(view(text), [&](const ConfigEntry& e) {
+        if (Apply apply = findHandler(kNohangKeys, e.key))
+            apply(l, e);
+    });
+    l.cfg.source = AppConfig::Source::Nohang;
     return true;
 }
 
+/// Exit thresholds of cpu, io and irq pressure left unset: 20% below entry.
+void defaultResourceExits(Psi& psi) {
+    for (Psi::Resource* r : {&psi.cpu, &psi.io, &psi.irq}) {
+        if (r->avg10_warn_exit <= 0)
+            r->avg10_warn_exit = r->avg10_warn * 0.8;
+        if (r->avg10_crit_exit <= 0)
+            r->avg10_crit_exit = r->avg10_crit * 0.8;
+    }
+}
+
 } // namespace
 
 bool AppConfig::load(const QString& path) {
-    bool fileLoaded = false;
-    QFile f(path);
-    if (f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        fileLoaded = true;
-        QTextStream ts(&f);
-        QString section;
-        while (!ts.atEnd()) {
-            QString line = ts.readLine().trimmed();
-            if (line.isEmpty() || line.startsWith('#'))
-                continue;
-            if (line.startsWith('[') && line.endsWith(']')) {
-                section = line.mid(1, line.size() - 2);
-                continue;
-            }
-            int eq = line.indexOf('=');
-            if (eq == -1)
-                continue;
-            QString key = line.left(eq).trimmed();
-            QString value = line.mid(eq + 1).trimmed();
-            int comment = value.indexOf('#');
-            if (comment != -1)
-                value = value.left(comment).trimmed();
-            if (value.startsWith('"') && value.endsWith('"') && value.size() >= 2)
-                value = value.mid(1, value.size() - 2);
-
-            bool ok = false;
-            if (section == "psi") {
-                double v = value.toDouble(&ok);
-                if (ok) {
-                    if (key == "avg10_warn")
-                        psi.avg10_warn = v;
-                    else if (key == "avg10_warn_exit")
-                        psi.avg10_warn_exit = v;
-                    else if (key == "avg10_crit")
-                        psi.avg10_crit = v;
-                    else if (key == "avg10_crit_exit")
-                        psi.avg10_crit_exit = v;
-                    else if (key == "avg10_deriv_warn")
-                        psi.avg10_deriv_warn = v;
-                }
-            } else if (section == "psi.trigger") {
-                auto parts = value.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
-                if (parts.size() == 2) {
-                    long stall = parts[0].toLong(&ok);
-                    bool ok2 = false;
-                    long window = parts[1].toLong(&ok2);
-                    if (ok && ok2) {
-                        Psi::Trigger trig{stall, window};
-                        if (key == "some")
-                            psi.trigger.some = trig;
-                        else if (key == "full")
-                            psi.trigger.full = trig;
-                    }
-                }
-            } else if (section == "mem") {
-                long v = value.toLong(&ok);
-                if (ok) {
-                    if (key == "available_warn_kib")
-                        mem.available_warn_kib = v;
-                    else if (key == "available_warn_exit_kib")
-                        mem.available_warn_exit_kib = v;
-                    else if (key == "available_crit_kib")
-                        mem.available_crit_kib = v;
-                    else if (key == "available_crit_exit_kib")
-                        mem.available_crit_exit_kib = v;
-                }
-            } else if (section == "swap") {
-                long v = value.toLong(&ok);
-                if (ok) {
-                    if (key == "free_warn_kib")
-                        swap.free_warn_kib = v;
-                    else if (key == "free_warn_exit_kib")
-                        swap.free_warn_exit_kib = v;
-                    else if (key == "free_crit_kib")
-                        swap.free_crit_kib = v;
-                    else if (key == "free_crit_exit_kib")
-                        swap.free_crit_exit_kib = v;
-                }
-            } else if (section == "ui.palette") {
-                if (key == "green")
-                    palette.green = value;
-                else if (key == "yellow")
-                    palette.yellow = value;
-                else if (key == "orange")
-                    palette.orange = value;
-                else if (key == "red")
-                    palette.red = value;
-                else if (key == "black")
-                    palette.black = value;
-            } else if (section == "sample") {
-                int v = value.toInt(&ok);
-                if (ok && key == "interval_ms")
-                    sample_interval_ms = v;
-            }
-        }
+    Loader loader{*this, std::nullopt};
+    QByteArray text;
+    bool fileLoaded = readAll(path, text);
+    toml_loaded = fileLoaded;
+    if (fileLoaded) {
+        parseToml(view(text), [&](const ConfigEntry& e) {
+            if (Apply apply = findHandler(kTomlKeys, e.key))
+                apply(loader, e);
+        });
+        defaultResourceExits(psi);
     }
-    bool nohangLoaded = loadNohangConfig(*this);
+    bool nohangLoaded = loadNohangConfig(loader);
     if (nohangLoaded)
         source = Source::Nohang;
     return fileLoaded || nohangLoaded;
 }
 
+QString nohangConfigPath() {
+    QString path;
+    const char* xdg = std::getenv("XDG_CONFIG_HOME");
+    if (xdg && *xdg) {
+        path = QString::fromLocal8Bit(xdg) + "/nohang/nohang.conf";
+    } else {
+        const char* home = std::getenv("HOME");
+        if (home && *home)
+            path = QString::fromLocal8Bit(home) + "/.config/nohang/nohang.conf";
+    }
+    if (path.isEmpty() || !QFile::exists(path))
+        path = "/etc/nohang/nohang.conf";
+    return path;
+}
+
 QString resolveConfigPath(const QString& cliPath) {
     if (!cliPath.isEmpty())
         return cliPath;
@@ -1,6 +1,10 @@
 #pragma once
+#include "meminfo_fields.h"
+#include "policy.h"
+#include "tooltip_template.h"
 #include <QString>
 #include <optional>
+#include <vector>
 
 struct AppConfig {
   /**
@@ -12,20 +16,40 @@ struct AppConfig {
   };
 
   Source source = Source::Default;
+  bool toml_loaded = false; ///< Whether load() could read its TOML file.
   struct Psi {
     struct Trigger {
       long stall_us = 0;
       long window_us = 0;
     };
+    struct Triggers {
+      std::optional<Trigger> some;
+      std::optional<Trigger> full;
+    };
+    /**
+     * Thresholds for cpu, io or irq pressure.
+     *
+     * Compared against "some" avg10, or "full" avg10 where the kernel only
+     * reports that line (irq). Warn raises Yellow, crit raises Orange. All
+     * are 0, i.e. off, unless configured, since a busy CPU or disk is no
+     * memory shortage; an exit left at 0 becomes 80% of its entry.
+     */
+    struct Resource {
+      double avg10_warn = 0.0;
+      double avg10_warn_exit = 0.0;
+      double avg10_crit = 0.0;
+      double avg10_crit_exit = 0.0;
+      Triggers trigger;
+    };
     double avg10_warn = 0.5;
     double avg10_warn_exit = 0.4; // 20% below warn
     double avg10_crit = 1.0;
     double avg10_crit_exit = 0.8;  // 20% below crit
     double avg10_deriv_warn = 0.1; ///< avg10 rise/sec triggering yellow
-    struct {
-      std::optional<Trigger> some;
-      std::optional<Trigger> full;
-    } trigger;
+    Triggers trigger;
+    Resource cpu;
+    Resource io;
+    Resource irq;
   } psi;
 
   struct {
@@ -43,6 +67,17 @@ struct AppConfig {
     long free_crit_exit_kib = 256 * 1024 * 6 / 5; // 20% above crit
   } swap;
 
+  // Thrashing seen in /proc/vmstat rates; any rate reaching its threshold
+  // raises Orange. Rates are in pages (or stalls) per second.
+  struct {
+    double refault_per_sec = 10000;        ///< Refaults, anon and file.
+    double refault_exit_per_sec = 8000;    // 20% below entry
+    double swapin_per_sec = 5000;          ///< Pages swapped in.
+    double swapin_exit_per_sec = 4000;     // 20% below entry
+    double allocstall_per_sec = 100;       ///< Direct reclaim stalls.
+    double allocstall_exit_per_sec = 80;   // 20% below entry
+  } thrash;
+
   struct {
     // Icon theme names or file paths for tray colors.
     QString green = "shield-green";
@@ -52,7 +87,73 @@ struct AppConfig {
     QString black = "shield-black";
   } palette;
 
+  struct {
+    /// Extra meminfo keys listed in the tooltip, e.g. AnonPages, Shmem.
+    std::vector<MeminfoField> meminfo_fields;
+    /// Shortest time between two tooltip updates sent to the shell.
+    int tooltip_min_interval_ms = 1000;
+    /// Tooltip layout; empty for the built-in one.
+    TooltipTemplate tooltip_template;
+    QString icon = "shield";    ///< "shield" or "sparkline".
+    int sparkline_samples = 32; ///< Samples shown by the sparkline.
+  } ui;
+
   int sample_interval_ms = 2000;
+
+  // Trends of MemAvailable, SwapFree and PSI extrapolated to their critical
+  // thresholds; a forecast within the horizon raises Yellow.
+  struct {
+    double horizon_sec = 60;      ///< Warn this long before critical; 0 disables.
+    double horizon_exit_sec = 72; // 20% above horizon
+    double window_sec = 30;       ///< Time constant of the weighted regression.
+  } forecast;
+
+  // Rules deciding the pressure state; see Policy for the syntax.
+  struct {
+    Policy rules; ///< Empty for the built-in set, Policy::defaults().
+  } policy;
+
+  // Adaptive sampling bounds around sample_interval_ms.
+  struct {
+    int min_interval_ms = 100;    ///< Interval used while pressure is present.
+    int max_interval_ms = 10000;  ///< Longest interval while idle.
+    double ramp = 1.5;            ///< Growth/shrink factor per step.
+    int calm_ticks = 5;           ///< Calm samples before stretching.
+  } sample;
+
+  // Per-cgroup memory pressure in the cgroup v2 hierarchy.
+  struct {
+    bool enabled = false;            ///< Walk the hierarchy at all.
+    QString root = "/sys/fs/cgroup"; ///< Mount point of cgroup v2.
+    int max_depth = 3;               ///< Levels walked below the root.
+    int top_n = 3;                   ///< Worst cgroups shown.
+    int rescan_ticks = 30;           ///< Samples between hierarchy walks.
+    Psi::Triggers trigger;           ///< Triggers set in every cgroup.
+  } cgroup;
+
+  // Sample history kept in a memory-mapped file across restarts.
+  struct {
+    bool enabled = false; ///< Record samples at all.
+    QString path;         ///< Empty for $XDG_STATE_HOME/nohang-tr/history.bin.
+    int capacity = 32768; ///< Records kept before the oldest are overwritten.
+    bool archive = false; ///< Also keep every sample in a compressed TimeSeries; needs enabled.
+    QString archive_path; ///< Empty for $XDG_STATE_HOME/nohang-tr/archive.bin.
+  } history;
+
+  // Prometheus metrics endpoint.
+  struct {
+    QString listen; ///< "host:port" or "unix:/path"; empty to disable.
+  } metrics;
+
+  // Largest processes, scanned while the state is Orange or Red.
+  struct {
+    bool enabled = false;   ///< Scan processes at all.
+    int top_n = 5;          ///< Processes shown.
+    int workers = 2;        ///< Threads reading /proc in parallel.
+    int budget_ms = 20;     ///< Time one sample may spend scanning.
+    QString sort = "pss";   ///< "rss", "pss" or "swap".
+  } process;
+
   /**
    * Load configuration values from a TOML file.
    *
@@ -72,3 +173,11 @@ struct AppConfig {
  * `$HOME/.config/nohang-tr/nohang-tr.toml`.
  */
 QString resolveConfigPath(const QString &cliPath = {});
+
+/**
+ * Path of the nohang configuration read by AppConfig::load.
+ *
+ * `$XDG_CONFIG_HOME/nohang/nohang.conf` (or `$HOME/.config/nohang/nohang.conf`)
+ * when it exists, otherwise `/etc/nohang/nohang.conf`.
+ */
+QString nohangConfigPath();
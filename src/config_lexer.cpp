@@ -0,0 +1,430 @@
+#include "config_lexer.h"
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+
+namespace {
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+bool isBareKeyChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && isSpace(s.front()))
+    s.remove_prefix(1);
+  while (!s.empty() && isSpace(s.back()))
+    s.remove_suffix(1);
+  return s;
+}
+
+/// Drop a leading '+' and the '_' digit separators so from_chars accepts s.
+/// Returns an empty view when the number does not fit @p buf.
+std::string_view normalizeNumber(std::string_view s, char (&buf)[64]) {
+  if (!s.empty() && s.front() == '+')
+    s.remove_prefix(1);
+  if (s.find('_') == std::string_view::npos)
+    return s;
+  std::size_t n = 0;
+  for (char c : s) {
+    if (c == '_')
+      continue;
+    if (n == sizeof buf)
+      return {};
+    buf[n++] = c;
+  }
+  return {buf, n};
+}
+
+void appendUtf8(std::string &out, std::uint32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xC0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xE0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+class TomlLexer {
+public:
+  TomlLexer(std::string_view text, const ConfigEntryHandler &onEntry)
+      : p_(text.data()), end_(text.data() + text.size()), onEntry_(onEntry) {}
+
+  std::size_t run() {
+    std::size_t skipped = 0;
+    for (;;) {
+      skipBlank(false);
+      if (p_ == end_)
+        break;
+      decoded_.clear();
+      bool ok = *p_ == '[' ? header() : keyValue();
+      if (ok)
+        ok = endOfLine();
+      if (!ok) {
+        ++skipped;
+        skipLine();
+      }
+    }
+    return skipped;
+  }
+
+private:
+  bool consume(char c) {
+    if (p_ == end_ || *p_ != c)
+      return false;
+    ++p_;
+    return true;
+  }
+
+  void skipSpaces() {
+    while (p_ < end_ && isSpace(*p_))
+      ++p_;
+  }
+
+  /// Skip spaces and comments, and newlines too unless @p stopAtNewline.
+  void skipBlank(bool stopAtNewline) {
+    while (p_ < end_) {
+      if (isSpace(*p_)) {
+        ++p_;
+      } else if (*p_ == '#') {
+        while (p_ < end_ && *p_ != '\n')
+          ++p_;
+      } else if (*p_ == '\n' && !stopAtNewline) {
+        ++line_;
+        ++p_;
+      } else {
+        break;
+      }
+    }
+  }
+
+  void skipLine() {
+    while (p_ < end_ && *p_ != '\n')
+      ++p_;
+  }
+
+  bool endOfLine() {
+    skipBlank(true);
+    return p_ == end_ || *p_ == '\n';
+  }
+
+  bool header() {
+    ++p_;
+    const bool arrayTable = consume('[');
+    table_.clear();
+    if (!key(table_) || !consume(']') || (arrayTable && !consume(']'))) {
+      table_.clear();
+      return false;
+    }
+    return true;
+  }
+
+  bool keyValue() {
+    path_ = table_;
+    if (!key(path_) || !consume('='))
+      return false;
+    skipSpaces();
+    return value(false);
+  }
+
+  /// Append a possibly dotted key to @p out, joined to it with a dot.
+  bool key(std::string &out) {
+    do {
+      skipSpaces();
+      if (p_ == end_)
+        return false;
+      if (!out.empty())
+        out += '.';
+      if (*p_ == '"' || *p_ == '\'') {
+        std::string_view part;
+        if (!string(part))
+          return false;
+        out.append(part);
+      } else {
+        const char *begin = p_;
+        while (p_ < end_ && isBareKeyChar(*p_))
+          ++p_;
+        if (p_ == begin)
+          return false;
+        out.append(begin, p_);
+      }
+      skipSpaces();
+    } while (consume('.'));
+    return true;
+  }
+
+  bool value(bool nested) {
+    if (p_ == end_)
+      return false;
+    entry_.line = line_;
+    if (*p_ == '[')
+      return array();
+    if (*p_ == '{')
+      return inlineTable();
+    std::string_view text;
+    ConfigEntry::Kind kind;
+    if (!scalar(nested, text, kind))
+      return false;
+    emit(kind, text);
+    return true;
+  }
+
+  /// A string, or bare text up to the end of the line, a comment or, when
+  /// @p nested in an array or inline table, the next delimiter.
+  bool scalar(bool nested, std::string_view &out, ConfigEntry::Kind &kind) {
+    if (*p_ == '"' || *p_ == '\'') {
+      kind = ConfigEntry::Kind::String;
+      return string(out);
+    }
+    const char *begin = p_;
+    while (p_ < end_ && *p_ != '\n' && *p_ != '#' &&
+           !(nested && (*p_ == ',' || *p_ == ']' || *p_ == '}')))
+      ++p_;
+    kind = ConfigEntry::Kind::Bare;
+    out = trim({begin, static_cast<std::size_t>(p_ - begin)});
+    return !out.empty();
+  }
+
+  bool array() {
+    ++p_;
+    entry_.items.clear();
+    for (;;) {
+      skipBlank(false);
+      if (consume(']'))
+        break;
+      if (p_ == end_ || *p_ == '[' || *p_ == '{')
+        return false;
+      std::string_view item;
+      ConfigEntry::Kind kind;
+      if (!scalar(true, item, kind))
+        return false;
+      entry_.items.push_back(item);
+      skipBlank(false);
+      if (consume(']'))
+        break;
+      if (!consume(','))
+        return false;
+    }
+    emit(ConfigEntry::Kind::Array, {});
+    return true;
+  }
+
+  bool inlineTable() {
+    ++p_;
+    const std::size_t prefix = path_.size();
+    skipBlank(false);
+    if (consume('}'))
+      return true;
+    for (;;) {
+      skipBlank(false);
+      path_.resize(prefix);
+      if (!key(path_) || !consume('='))
+        return false;
+      skipSpaces();
+      if (!value(true))
+        return false;
+      skipBlank(false);
+      if (consume('}'))
+        break;
+      if (!consume(','))
+        return false;
+    }
+    path_.resize(prefix);
+    return true;
+  }
+
+  bool string(std::string_view &out) {
+    const char quote = *p_;
+    if (end_ - p_ >= 3 && p_[1] == quote && p_[2] == quote)
+      return multilineString(quote, out);
+    const char *begin = ++p_;
+    bool escaped = false;
+    while (p_ < end_ && *p_ != quote && *p_ != '\n') {
+      if (quote == '"' && *p_ == '\\' && p_ + 1 < end_ && p_[1] != '\n') {
+        escaped = true;
+        ++p_;
+      }
+      ++p_;
+    }
+    if (p_ == end_ || *p_ != quote)
+      return false;
+    std::string_view raw(begin, p_ - begin);
+    ++p_;
+    out = escaped ? unescape(raw) : raw;
+    return true;
+  }
+
+  bool multilineString(char quote, std::string_view &out) {
+    p_ += 3;
+    // A newline right after the opening delimiter is not part of the string.
+    if (p_ < end_ && *p_ == '\r' && p_ + 1 < end_ && p_[1] == '\n')
+      ++p_;
+    if (p_ < end_ && *p_ == '\n') {
+      ++line_;
+      ++p_;
+    }
+    const char *begin = p_;
+    bool escaped = false;
+    for (;;) {
+      if (p_ == end_)
+        return false;
+      if (*p_ == quote && end_ - p_ >= 3 && p_[1] == quote && p_[2] == quote)
+        break;
+      if (quote == '"' && *p_ == '\\' && p_ + 1 < end_) {
+        escaped = true;
+        ++p_;
+      }
+      if (*p_ == '\n')
+        ++line_;
+      ++p_;
+    }
+    std::string_view raw(begin, p_ - begin);
+    p_ += 3;
+    out = escaped ? unescape(raw) : raw;
+    return true;
+  }
+
+  /// Resolve the escapes of a basic string; unknown ones are kept as written.
+  std::string_view unescape(std::string_view raw) {
+    std::string &s = decoded_.emplace_back();
+    s.reserve(raw.size());
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+      const char c = raw[i];
+      if (c != '\\' || i + 1 == raw.size()) {
+        s += c;
+        continue;
+      }
+      const char e = raw[++i];
+      switch (e) {
+      case 'b': s += '\b'; break;
+      case 't': s += '\t'; break;
+      case 'n': s += '\n'; break;
+      case 'f': s += '\f'; break;
+      case 'r': s += '\r'; break;
+      case '"': s += '"'; break;
+      case '\\': s += '\\'; break;
+      case 'u':
+      case 'U': {
+        const std::size_t digits = e == 'u' ? 4 : 8;
+        std::uint32_t cp = 0;
+        auto hex = raw.substr(i + 1, digits);
+        auto [ptr, ec] = std::from_chars(hex.data(), hex.data() + hex.size(), cp, 16);
+        if (hex.size() == digits && ec == std::errc() &&
+            ptr == hex.data() + hex.size() && cp <= 0x10FFFF) {
+          appendUtf8(s, cp);
+          i += digits;
+        } else {
+          s += '\\';
+          s += e;
+        }
+        break;
+      }
+      default: {
+        // Line-ending backslash in a multi-line string: drop the newline
+        // and the whitespace that follows it.
+        std::size_t j = i;
+        while (j < raw.size() && isSpace(raw[j]))
+          ++j;
+        if (j < raw.size() && raw[j] == '\n') {
+          while (j < raw.size() && (isSpace(raw[j]) || raw[j] == '\n'))
+            ++j;
+          i = j - 1;
+        } else {
+          s += '\\';
+          s += e;
+        }
+      }
+      }
+    }
+    return s;
+  }
+
+  void emit(ConfigEntry::Kind kind, std::string_view text) {
+    entry_.key = path_;
+    entry_.kind = kind;
+    entry_.text = text;
+    if (kind != ConfigEntry::Kind::Array)
+      entry_.items.clear();
+    onEntry_(entry_);
+  }
+
+  const char *p_;
+  const char *end_;
+  int line_ = 1;
+  const ConfigEntryHandler &onEntry_;
+  std::string table_;
+  std::string path_;
+  ConfigEntry entry_;
+  /// Strings with escapes of the current statement; a deque keeps the
+  /// views stable while it grows.
+  std::deque<std::string> decoded_;
+};
+} // namespace
+
+std::optional<int> ConfigEntry::toInt() const {
+  auto v = toLong();
+  if (!v || *v < INT_MIN || *v > INT_MAX)
+    return std::nullopt;
+  return static_cast<int>(*v);
+}
+
+std::optional<double> ConfigEntry::parseDouble(std::string_view s) {
+  char buf[64];
+  s = normalizeNumber(s, buf);
+  double v = 0;
+  auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+  if (s.empty() || ec != std::errc() || ptr != s.data() + s.size())
+    return std::nullopt;
+  return v;
+}
+
+std::optional<long> ConfigEntry::parseLong(std::string_view s) {
+  char buf[64];
+  s = normalizeNumber(s, buf);
+  long v = 0;
+  auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+  if (s.empty() || ec != std::errc() || ptr != s.data() + s.size())
+    return std::nullopt;
+  return v;
+}
+
+std::size_t parseToml(std::string_view text, const ConfigEntryHandler &onEntry) {
+  return TomlLexer(text, onEntry).run();
+}
+
+void parseNohangConf(std::string_view text, const ConfigEntryHandler &onEntry) {
+  ConfigEntry entry;
+  const char *p = text.data();
+  const char *end = p + text.size();
+  while (p < end) {
+    ++entry.line;
+    const char *eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    if (!eol)
+      eol = end;
+    std::string_view line = trim({p, static_cast<std::size_t>(eol - p)});
+    p = eol + 1;
+    if (line.empty() || line.front() == '#' || line.front() == '@')
+      continue;
+    const auto eq = line.find('=');
+    if (eq == std::string_view::npos)
+      continue;
+    std::string_view value = line.substr(eq + 1);
+    value = trim(value.substr(0, value.find('#')));
+    entry.key = trim(line.substr(0, eq));
+    entry.text = value;
+    onEntry(entry);
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief One key and value produced by the configuration lexers.
+ *
+ * Views point into the text being parsed, or into scratch storage for
+ * strings with escapes, and are only valid during the callback.
+ */
+struct ConfigEntry {
+  enum class Kind {
+    Bare,   ///< Unquoted scalar such as 42, true or "10 100" without quotes.
+    String, ///< Quoted string with escapes resolved.
+    Array   ///< Array of scalars, in items.
+  };
+
+  /// Full dotted path, e.g. "psi.trigger.some" for `some` under [psi.trigger].
+  std::string_view key;
+  Kind kind = Kind::Bare;
+  /// Scalar text; empty for arrays.
+  std::string_view text;
+  /// Array elements as bare text or resolved strings.
+  std::vector<std::string_view> items;
+  /// 1-based line the value starts on.
+  int line = 0;
+
+  /// Number in text, allowing a leading '+' and '_' between digits.
+  std::optional<double> toDouble() const { return parseDouble(text); }
+  std::optional<long> toLong() const { return parseLong(text); }
+  std::optional<int> toInt() const;
+
+  static std::optional<double> parseDouble(std::string_view s);
+  static std::optional<long> parseLong(std::string_view s);
+};
+
+using ConfigEntryHandler = std::function<void(const ConfigEntry &)>;
+
+/**
+ * Parse TOML in a single pass, calling @p onEntry for every key.
+ *
+ * Supports comments, [table] headers, bare, quoted and dotted keys, basic
+ * and literal strings (also multi-line), arrays of scalars over several
+ * lines, and inline tables, whose keys are reported with the full path as
+ * if written under their own header. Unquoted values that are not valid
+ * TOML, such as `some = 10 100`, are passed on as bare text up to the end
+ * of the line or comment. Malformed lines are skipped.
+ * @return Number of malformed lines skipped.
+ */
+std::size_t parseToml(std::string_view text, const ConfigEntryHandler &onEntry);
+
+/**
+ * Parse nohang.conf `key = value` lines, calling @p onEntry for each.
+ *
+ * Lines starting with '#' or '@' are skipped and '#' starts a comment.
+ * Values are always Bare.
+ */
+void parseNohangConf(std::string_view text, const ConfigEntryHandler &onEntry);
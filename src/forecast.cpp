@@ -0,0 +1,109 @@
+#include "forecast.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+/// Samples must spread at least this far in time (weighted standard
+/// deviation) before a slope is trusted; bursts of trigger wakeups
+/// microseconds apart would otherwise yield absurd rates.
+constexpr double kMinSpreadSec = 0.5;
+constexpr int kMinSamples = 3;
+
+/// Seconds until a falling series reaches @p crit, if it is falling.
+std::optional<double> untilBelow(const TrendRegression &r, double y,
+                                 double crit) {
+  auto slope = r.slope();
+  if (!slope || *slope >= 0.0)
+    return std::nullopt;
+  return (y - crit) / -*slope;
+}
+
+/// Seconds until a rising series reaches @p crit, if it is rising.
+std::optional<double> untilAbove(const TrendRegression &r, double y,
+                                 double crit) {
+  auto slope = r.slope();
+  if (!slope || *slope <= 0.0)
+    return std::nullopt;
+  return (crit - y) / *slope;
+}
+} // namespace
+
+void TrendRegression::update(double y, double dtSec, double tauSec) {
+  if (n_ > 0) {
+    // Move the origin to the new sample, then age the old ones.
+    tt_ += dtSec * (dtSec * w_ - 2.0 * t_);
+    ty_ -= dtSec * y_;
+    t_ -= dtSec * w_;
+    const double decay = tauSec > 0.0 ? std::exp(-dtSec / tauSec) : 0.0;
+    w_ *= decay;
+    t_ *= decay;
+    y_ *= decay;
+    tt_ *= decay;
+    ty_ *= decay;
+  }
+  // The new sample sits at t = 0, so it adds nothing to t_, tt_ or ty_.
+  w_ += 1.0;
+  y_ += y;
+  ++n_;
+}
+
+std::optional<double> TrendRegression::slope() const {
+  if (n_ < kMinSamples)
+    return std::nullopt;
+  const double det = w_ * tt_ - t_ * t_;
+  if (det <= kMinSpreadSec * kMinSpreadSec * w_ * w_)
+    return std::nullopt;
+  return (w_ * ty_ - t_ * y_) / det;
+}
+
+std::optional<double> ExhaustionForecast::update(const ProbeSample &s,
+                                                 const AppConfig &cfg,
+                                                 double elapsedSec) {
+  const double tau = cfg.forecast.window_sec;
+  const double dt = std::max(elapsedSec, 0.0);
+  std::optional<double> soonest;
+  bool critical = false;
+  auto consider = [&](std::optional<double> eta) {
+    if (eta && (!soonest || *eta < *soonest))
+      soonest = eta;
+  };
+
+  if (s.mem_available_kib) {
+    const double y = static_cast<double>(*s.mem_available_kib);
+    mem_.update(y, dt, tau);
+    if (y <= cfg.mem.available_crit_kib)
+      critical = true;
+    else
+      consider(untilBelow(mem_, y, cfg.mem.available_crit_kib));
+  } else {
+    mem_.reset();
+  }
+
+  const auto swapTotal = s.meminfoValue(MeminfoField::SwapTotal);
+  if (s.swap_free_kib && swapTotal && *swapTotal > 0) {
+    const double y = static_cast<double>(*s.swap_free_kib);
+    swap_.update(y, dt, tau);
+    if (y <= cfg.swap.free_crit_kib)
+      critical = true;
+    else
+      consider(untilBelow(swap_, y, cfg.swap.free_crit_kib));
+  } else {
+    swap_.reset();
+  }
+
+  psi_.update(s.some.avg10, dt, tau);
+  if (s.some.avg10 >= cfg.psi.avg10_crit)
+    critical = true;
+  else
+    consider(untilAbove(psi_, s.some.avg10, cfg.psi.avg10_crit));
+
+  if (critical || !soonest || *soonest > kMaxSec)
+    return std::nullopt;
+  return soonest;
+}
+
+void ExhaustionForecast::reset() {
+  mem_.reset();
+  swap_.reset();
+  psi_.reset();
+}
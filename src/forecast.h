@@ -0,0 +1,75 @@
+#pragma once
+#include "config.h"
+#include "system_probe.h"
+#include <optional>
+
+/**
+ * @brief Exponentially weighted linear regression of one series over time.
+ *
+ * Only five decayed sums are kept, so update() is O(1) with fixed memory.
+ * A sample @p tau seconds old weighs 1/e of a new one. Times are measured
+ * back from the newest sample, which keeps the sums well conditioned no
+ * matter how long the series runs.
+ */
+class TrendRegression {
+public:
+  /**
+   * @brief Add a sample.
+   * @param y Value of the sample.
+   * @param dtSec Seconds since the previous sample.
+   * @param tauSec Time constant of the weights.
+   */
+  void update(double y, double dtSec, double tauSec);
+
+  /// Forget every sample.
+  void reset() { *this = TrendRegression(); }
+
+  /// Fitted change per second, once samples span some time.
+  std::optional<double> slope() const;
+
+  /// Samples added since the last reset().
+  int samples() const { return n_; }
+
+private:
+  double w_ = 0.0;  ///< Sum of weights.
+  double t_ = 0.0;  ///< Weighted sum of times.
+  double y_ = 0.0;  ///< Weighted sum of values.
+  double tt_ = 0.0; ///< Weighted sum of squared times.
+  double ty_ = 0.0; ///< Weighted sum of time times value.
+  int n_ = 0;
+};
+
+/**
+ * @brief Forecasts how long until memory, swap or PSI turns critical.
+ *
+ * MemAvailable and SwapFree are extrapolated down to `available_crit_kib`
+ * and `free_crit_kib`, PSI some avg10 up to `avg10_crit`. Swap is ignored
+ * on systems without any. The trends come from a TrendRegression per
+ * series with `[forecast] window_sec` as time constant, so a steady ramp
+ * is caught after a few samples while single spikes barely move it.
+ */
+class ExhaustionForecast {
+public:
+  /// Forecasts further out than this are dropped as meaningless.
+  static constexpr double kMaxSec = 3600.0;
+
+  /**
+   * @brief Feed a sample and forecast from the updated trends.
+   * @param s Latest probe sample.
+   * @param cfg Thresholds and regression window.
+   * @param elapsedSec Seconds since the previous sample.
+   * @return Seconds until the first series is forecast to reach its
+   *         critical threshold, or std::nullopt when none is heading there
+   *         within kMaxSec or one is critical already.
+   */
+  std::optional<double> update(const ProbeSample &s, const AppConfig &cfg,
+                               double elapsedSec);
+
+  /// Forget every trend, e.g. after a gap in sampling.
+  void reset();
+
+private:
+  TrendRegression mem_;
+  TrendRegression swap_;
+  TrendRegression psi_;
+};
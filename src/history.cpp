@@ -0,0 +1,191 @@
+#include "history.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// File header, followed by the records.
+struct History::Header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t record_size;
+  std::uint64_t capacity;
+  /// Records ever appended; the newest sits at (count - 1) % capacity.
+  std::uint64_t count;
+};
+
+namespace {
+constexpr char kMagic[8] = {'N', 'H', 'T', 'R', 'H', 'I', 'S', 'T'};
+constexpr std::uint32_t kVersion = 1;
+/// Keeps the records aligned for their doubles.
+constexpr std::size_t kHeaderSize = 64;
+
+constexpr double kMissing = std::numeric_limits<double>::quiet_NaN();
+
+double avg10OrNaN(const PsiResourceValues &v) {
+  auto avg = v.avg10();
+  return avg ? *avg : kMissing;
+}
+} // namespace
+
+HistoryRecord HistoryRecord::from(const ProbeSample &s, PressureState state,
+                                  std::chrono::system_clock::time_point time) {
+  HistoryRecord r;
+  r.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  time.time_since_epoch())
+                  .count();
+  r.state = static_cast<std::uint8_t>(state);
+  const std::pair<const std::optional<long> &, std::int64_t &> fields[] = {
+      {s.mem_available_kib, r.mem_available_kib},
+      {s.mem_total_kib, r.mem_total_kib},
+      {s.mem_free_kib, r.mem_free_kib},
+      {s.swap_free_kib, r.swap_free_kib},
+      {s.cached_kib, r.cached_kib}};
+  std::uint32_t bit = MemAvailable;
+  for (const auto &[value, out] : fields) {
+    if (value) {
+      out = *value;
+      r.present |= bit;
+    }
+    bit <<= 1;
+  }
+  r.some = s.some;
+  r.full = s.full;
+  r.cpu_avg10 = avg10OrNaN(s.cpu);
+  r.io_avg10 = avg10OrNaN(s.io);
+  r.irq_avg10 = avg10OrNaN(s.irq);
+  if (s.vmstat) {
+    r.present |= Vmstat;
+    r.refault_per_sec = s.vmstat->refault();
+    r.swapin_per_sec = s.vmstat->pswpin;
+  }
+  return r;
+}
+
+ProbeSample HistoryRecord::sample() const {
+  ProbeSample s;
+  const std::pair<std::optional<long> &, std::int64_t> fields[] = {
+      {s.mem_available_kib, mem_available_kib},
+      {s.mem_total_kib, mem_total_kib},
+      {s.mem_free_kib, mem_free_kib},
+      {s.swap_free_kib, swap_free_kib},
+      {s.cached_kib, cached_kib}};
+  std::uint32_t bit = MemAvailable;
+  for (const auto &[out, value] : fields) {
+    if (present & bit)
+      out = static_cast<long>(value);
+    bit <<= 1;
+  }
+  s.some = some;
+  s.full = full;
+  const std::pair<PsiResourceValues &, double> resources[] = {
+      {s.cpu, cpu_avg10}, {s.io, io_avg10}, {s.irq, irq_avg10}};
+  for (const auto &[out, avg10] : resources) {
+    if (!std::isnan(avg10))
+      out.some = PsiValues{avg10, 0.0, 0.0, 0};
+  }
+  if (present & Vmstat) {
+    s.vmstat = VmstatRates{};
+    s.vmstat->refault_file = refault_per_sec;
+    s.vmstat->pswpin = swapin_per_sec;
+  }
+  return s;
+}
+
+History::History(std::string path, std::size_t capacity)
+    : path_(std::move(path)), capacity_(capacity) {
+  static_assert(sizeof(Header) <= kHeaderSize, "header outgrew its slot");
+  if (capacity_ == 0)
+    return;
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(path_).parent_path(), ec);
+  int fd = open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return;
+  mapSize_ = kHeaderSize + capacity_ * sizeof(HistoryRecord);
+  struct stat st {};
+  const bool sized = fstat(fd, &st) == 0 &&
+                     static_cast<std::size_t>(st.st_size) == mapSize_;
+  // Blocks are reserved up front: storing into a hole of a sparse file
+  // raises SIGBUS once the filesystem is full, i.e. mid pressure event.
+  if ((!sized && ftruncate(fd, static_cast<off_t>(mapSize_)) < 0) ||
+      posix_fallocate(fd, 0, static_cast<off_t>(mapSize_)) != 0) {
+    close(fd);
+    return;
+  }
+  void *map =
+      mmap(nullptr, mapSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return;
+  header_ = static_cast<Header *>(map);
+  records_ = reinterpret_cast<HistoryRecord *>(static_cast<char *>(map) +
+                                               kHeaderSize);
+  if (!sized || std::memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header_->version != kVersion ||
+      header_->record_size != sizeof(HistoryRecord) ||
+      header_->capacity != capacity_) {
+    std::memcpy(header_->magic, kMagic, sizeof(kMagic));
+    header_->version = kVersion;
+    header_->record_size = sizeof(HistoryRecord);
+    header_->capacity = capacity_;
+    header_->count = 0;
+  }
+}
+
+History::~History() {
+  if (header_)
+    munmap(header_, mapSize_);
+}
+
+void History::append(const HistoryRecord &rec) {
+  if (!header_)
+    return;
+  const std::uint64_t count = header_->count;
+  std::memcpy(&records_[count % capacity_], &rec, sizeof(rec));
+  // Publish after the record so a reader of the file never sees it half
+  // written.
+  __atomic_store_n(&header_->count, count + 1, __ATOMIC_RELEASE);
+}
+
+std::size_t History::size() const {
+  if (!header_)
+    return 0;
+  const std::uint64_t count = __atomic_load_n(&header_->count, __ATOMIC_ACQUIRE);
+  return static_cast<std::size_t>(std::min<std::uint64_t>(count, capacity_));
+}
+
+std::optional<HistoryRecord> History::at(std::size_t i) const {
+  if (!header_)
+    return std::nullopt;
+  const std::uint64_t count = __atomic_load_n(&header_->count, __ATOMIC_ACQUIRE);
+  const std::uint64_t held = std::min<std::uint64_t>(count, capacity_);
+  if (i >= held)
+    return std::nullopt;
+  return records_[(count - held + i) % capacity_];
+}
+
+std::optional<HistoryRecord> History::last() const {
+  const std::size_t n = size();
+  if (n == 0)
+    return std::nullopt;
+  return at(n - 1);
+}
+
+std::string History::defaultPath() {
+  std::filesystem::path base;
+  const char *xdg = std::getenv("XDG_STATE_HOME");
+  if (xdg && *xdg) {
+    base = xdg;
+  } else {
+    const char *home = std::getenv("HOME");
+    base = std::filesystem::path(home && *home ? home : ".") / ".local" / "state";
+  }
+  return (base / "nohang-tr" / "history.bin").string();
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include "pressure_state.h"
+#include "system_probe.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+/**
+ * @brief Fixed-size, trivially copyable form of a sample in the history.
+ *
+ * Optional values are marked in @ref present; PSI averages of resources the
+ * kernel does not report are NaN.
+ */
+struct HistoryRecord {
+  /// Bits of @ref present.
+  enum Field : std::uint32_t {
+    MemAvailable = 1u << 0,
+    MemTotal = 1u << 1,
+    MemFree = 1u << 2,
+    SwapFree = 1u << 3,
+    Cached = 1u << 4,
+    Vmstat = 1u << 5,
+  };
+
+  std::int64_t time_ms = 0;  ///< Wall clock time, ms since the epoch.
+  std::uint8_t state = 0;    ///< PressureState after this sample.
+  std::uint32_t present = 0; ///< Field bits of the values below.
+  std::int64_t mem_available_kib = 0;
+  std::int64_t mem_total_kib = 0;
+  std::int64_t mem_free_kib = 0;
+  std::int64_t swap_free_kib = 0;
+  std::int64_t cached_kib = 0;
+  PsiValues some;
+  PsiValues full;
+  double cpu_avg10 = 0.0;
+  double io_avg10 = 0.0;
+  double irq_avg10 = 0.0;
+  double refault_per_sec = 0.0;
+  double swapin_per_sec = 0.0;
+
+  /// Build a record from a sample and the state decided for it.
+  static HistoryRecord from(const ProbeSample &s, PressureState state,
+                            std::chrono::system_clock::time_point time);
+
+  /// Restore the sample fields the record holds.
+  ProbeSample sample() const;
+
+  /// Recorded state.
+  PressureState pressureState() const {
+    return static_cast<PressureState>(state);
+  }
+
+  /// Recorded wall clock time.
+  std::chrono::system_clock::time_point time() const {
+    return std::chrono::system_clock::time_point(
+        std::chrono::milliseconds(time_ms));
+  }
+};
+static_assert(std::is_trivially_copyable_v<HistoryRecord>,
+              "records are copied into the mapped file as raw bytes");
+
+/**
+ * @brief Ring of HistoryRecords in a memory-mapped file.
+ *
+ * The file outlives the process, so the pressure leading up to a crash or an
+ * OOM kill can be inspected afterwards and sampling resumes with the last
+ * state on restart. Appending is a memcpy into the shared mapping; the kernel
+ * writes dirty pages back on its own, no system call is made.
+ */
+class History {
+public:
+  /// Records kept by default: hours at the default interval.
+  static constexpr std::size_t kDefaultCapacity = 32768;
+
+  /**
+   * @brief Open or create the history file.
+   *
+   * An existing file is reused when its layout and capacity match, and
+   * started afresh otherwise. The file's blocks are reserved, and history
+   * stays off if they cannot be. Check isOpen() for failures.
+   * @param path File to map.
+   * @param capacity Number of records kept.
+   */
+  explicit History(std::string path, std::size_t capacity = kDefaultCapacity);
+
+  /** Unmaps the file. */
+  ~History();
+
+  History(const History &) = delete;
+  History &operator=(const History &) = delete;
+
+  /** Whether the file is mapped. */
+  bool isOpen() const { return header_ != nullptr; }
+
+  /** Append a record, overwriting the oldest once the ring is full. */
+  void append(const HistoryRecord &rec);
+
+  /** Number of records held, at most the capacity. */
+  std::size_t size() const;
+
+  /** Maximum number of records held. */
+  std::size_t capacity() const { return capacity_; }
+
+  /**
+   * @brief Record by age.
+   * @param i 0 for the oldest record held, size() - 1 for the newest.
+   * @return std::nullopt if @p i is out of range or the file is not open.
+   */
+  std::optional<HistoryRecord> at(std::size_t i) const;
+
+  /** Newest record, if any. */
+  std::optional<HistoryRecord> last() const;
+
+  /** Path of the mapped file. */
+  const std::string &path() const { return path_; }
+
+  /**
+   * @brief Default file location.
+   * @return `$XDG_STATE_HOME/nohang-tr/history.bin`, falling back to
+   *         `$HOME/.local/state/nohang-tr/history.bin`.
+   */
+  static std::string defaultPath();
+
+private:
+  struct Header;
+
+  std::string path_;
+  std::size_t capacity_;
+  std::size_t mapSize_ = 0;
+  Header *header_ = nullptr;
+  HistoryRecord *records_ = nullptr;
+};
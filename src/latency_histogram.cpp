@@ -0,0 +1,75 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+std::string formatNs(std::uint64_t ns) {
+  char buf[32];
+  if (ns < 1000)
+    std::snprintf(buf, sizeof(buf), "%llu ns", static_cast<unsigned long long>(ns));
+  else if (ns < 1000000)
+    std::snprintf(buf, sizeof(buf), "%.1f µs", ns / 1e3);
+  else if (ns < 1000000000)
+    std::snprintf(buf, sizeof(buf), "%.1f ms", ns / 1e6);
+  else
+    std::snprintf(buf, sizeof(buf), "%.2f s", ns / 1e9);
+  return buf;
+}
+} // namespace
+
+std::uint64_t LatencyHistogram::percentile(double percent) const {
+  const std::uint64_t total = count();
+  if (total == 0)
+    return 0;
+  const auto target = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(std::ceil(percent / 100.0 * total)));
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    seen += counts_[i].load(std::memory_order_relaxed);
+    if (seen >= target)
+      return std::min(bucketUpper(i), max());
+  }
+  return max();
+}
+
+const char *TickProfiler::name(Phase phase) {
+  switch (phase) {
+  case Phase::ProbeRead:
+    return "probe read";
+  case Phase::Parse:
+    return "parse";
+  case Phase::Decide:
+    return "decide";
+  case Phase::Tooltip:
+    return "tooltip";
+  case Phase::SetIcon:
+    return "setIcon";
+  case Phase::SetToolTip:
+    return "setToolTip";
+  case Phase::Count:
+    break;
+  }
+  return "?";
+}
+
+std::string TickProfiler::summary(Phase phase) const {
+  const LatencyHistogram &h = histogram(phase);
+  std::string line = name(phase);
+  if (h.count() == 0)
+    return line + ": no samples";
+  line += ": p50 " + formatNs(h.percentile(50));
+  line += ", p99 " + formatNs(h.percentile(99));
+  line += ", max " + formatNs(h.max());
+  line += " (" + std::to_string(h.count()) + ")";
+  return line;
+}
+
+std::string TickProfiler::report() const {
+  std::string out;
+  for (std::size_t i = 0; i < kPhases; ++i) {
+    out += summary(static_cast<Phase>(i));
+    out += '\n';
+  }
+  return out;
+}
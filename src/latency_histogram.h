@@ -0,0 +1,120 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+/**
+ * @brief Log-linear latency histogram in the style of HdrHistogram.
+ *
+ * Every power of two is split into 16 linear buckets, so any recorded value
+ * is reported within about 6%. The buckets are a fixed array of atomics:
+ * record() never allocates or locks and may run on one thread while
+ * another reads percentiles.
+ */
+class LatencyHistogram {
+public:
+  /// Linear buckets per power of two.
+  static constexpr unsigned kSubBuckets = 16;
+  static constexpr unsigned kSubBucketBits = 4;
+  static constexpr std::size_t kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  /** Add one value in nanoseconds. */
+  void record(std::uint64_t ns) {
+    counts_[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t max = max_.load(std::memory_order_relaxed);
+    while (ns > max &&
+           !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  /** Values recorded. */
+  std::uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+  /** Largest value recorded, exactly. */
+  std::uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Value below which @p percent of the recorded values fall.
+   * @return Upper bound of the bucket holding that value, capped at max();
+   *         0 when nothing was recorded.
+   */
+  std::uint64_t percentile(double percent) const;
+
+  /** Bucket holding @p ns. */
+  static std::size_t bucket(std::uint64_t ns) {
+    if (ns < kSubBuckets)
+      return static_cast<std::size_t>(ns);
+    const unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(ns));
+    const unsigned shift = msb - kSubBucketBits;
+    return (shift + 1) * kSubBuckets + ((ns >> shift) & (kSubBuckets - 1));
+  }
+
+  /** Largest value falling into bucket @p i. */
+  static std::uint64_t bucketUpper(std::size_t i) {
+    if (i < kSubBuckets)
+      return i;
+    const unsigned shift = static_cast<unsigned>(i / kSubBuckets) - 1;
+    const std::uint64_t lower = (kSubBuckets + i % kSubBuckets) << shift;
+    return lower + ((std::uint64_t{1} << shift) - 1);
+  }
+
+private:
+  std::array<std::atomic<std::uint64_t>, kBuckets> counts_{};
+  std::atomic<std::uint64_t> count_{0};
+  std::atomic<std::uint64_t> max_{0};
+};
+
+/**
+ * @brief Latency histograms for each phase of a sampling tick.
+ *
+ * Phases are timed with CLOCK_MONOTONIC. Probe read, parse and decide run on
+ * the sampling thread; the tooltip and icon phases on the GUI thread. Each
+ * phase has its own histogram, so every histogram has a single writer.
+ */
+class TickProfiler {
+public:
+  enum class Phase {
+    ProbeRead,  ///< Reading the /proc sources.
+    Parse,      ///< Parsing what was read.
+    Decide,     ///< Deciding the state.
+    Tooltip,    ///< Building the tooltip text.
+    SetIcon,    ///< QSystemTrayIcon::setIcon.
+    SetToolTip, ///< QSystemTrayIcon::setToolTip.
+    Count
+  };
+  static constexpr std::size_t kPhases = static_cast<std::size_t>(Phase::Count);
+
+  /** CLOCK_MONOTONIC in nanoseconds. */
+  static std::uint64_t now() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000u +
+           static_cast<std::uint64_t>(ts.tv_nsec);
+  }
+
+  /** Record the time since @p startNs against @p phase. */
+  void finish(Phase phase, std::uint64_t startNs) {
+    phases_[static_cast<std::size_t>(phase)].record(now() - startNs);
+  }
+
+  /** Histogram of a phase. */
+  const LatencyHistogram &histogram(Phase phase) const {
+    return phases_[static_cast<std::size_t>(phase)];
+  }
+
+  /** Display name of a phase. */
+  static const char *name(Phase phase);
+
+  /** "name: p50 …, p99 …, max … (n)" for one phase. */
+  std::string summary(Phase phase) const;
+
+  /** One summary line per phase. */
+  std::string report() const;
+
+private:
+  std::array<LatencyHistogram, kPhases> phases_;
+};
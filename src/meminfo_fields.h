@@ -0,0 +1,104 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+/**
+ * @brief Keys known in /proc/meminfo, in the order the kernel prints them.
+ *
+ * Values index the dense array ProbeSample::meminfo. Keys a kernel does not
+ * print are simply absent from a sample.
+ */
+enum class MeminfoField : std::uint8_t {
+    MemTotal, MemFree, MemAvailable, Buffers, Cached, SwapCached,
+    Active, Inactive, ActiveAnon, InactiveAnon, ActiveFile, InactiveFile,
+    Unevictable, Mlocked, SwapTotal, SwapFree, Zswap, Zswapped, Dirty,
+    Writeback, AnonPages, Mapped, Shmem, KReclaimable, Slab, SReclaimable,
+    SUnreclaim, KernelStack, ShadowCallStack, PageTables, SecPageTables,
+    NfsUnstable, Bounce, WritebackTmp, CommitLimit, CommittedAs,
+    VmallocTotal, VmallocUsed, VmallocChunk, Percpu, HardwareCorrupted,
+    AnonHugePages, ShmemHugePages, ShmemPmdMapped, FileHugePages,
+    FilePmdMapped, CmaTotal, CmaFree, Unaccepted, Balloon, HugePagesTotal,
+    HugePagesFree, HugePagesRsvd, HugePagesSurp, Hugepagesize, Hugetlb,
+    DirectMap4k, DirectMap2M, DirectMap1G,
+    Count
+};
+
+/// Number of known meminfo keys.
+inline constexpr std::size_t kMeminfoFieldCount = static_cast<std::size_t>(MeminfoField::Count);
+
+/** Name and unit of a meminfo key. */
+struct MeminfoKey {
+    std::string_view name; ///< Key as printed before the colon.
+    bool kib;              ///< Value is in kB; HugePages_* are page counts.
+};
+
+/// Keys indexed by MeminfoField.
+inline constexpr std::array<MeminfoKey, kMeminfoFieldCount> kMeminfoKeys{{
+    {"MemTotal", true}, {"MemFree", true}, {"MemAvailable", true},
+    {"Buffers", true}, {"Cached", true}, {"SwapCached", true},
+    {"Active", true}, {"Inactive", true}, {"Active(anon)", true},
+    {"Inactive(anon)", true}, {"Active(file)", true}, {"Inactive(file)", true},
+    {"Unevictable", true}, {"Mlocked", true}, {"SwapTotal", true},
+    {"SwapFree", true}, {"Zswap", true}, {"Zswapped", true}, {"Dirty", true},
+    {"Writeback", true}, {"AnonPages", true}, {"Mapped", true}, {"Shmem", true},
+    {"KReclaimable", true}, {"Slab", true}, {"SReclaimable", true},
+    {"SUnreclaim", true}, {"KernelStack", true}, {"ShadowCallStack", true},
+    {"PageTables", true}, {"SecPageTables", true}, {"NFS_Unstable", true},
+    {"Bounce", true}, {"WritebackTmp", true}, {"CommitLimit", true},
+    {"Committed_AS", true}, {"VmallocTotal", true}, {"VmallocUsed", true},
+    {"VmallocChunk", true}, {"Percpu", true}, {"HardwareCorrupted", true},
+    {"AnonHugePages", true}, {"ShmemHugePages", true}, {"ShmemPmdMapped", true},
+    {"FileHugePages", true}, {"FilePmdMapped", true}, {"CmaTotal", true},
+    {"CmaFree", true}, {"Unaccepted", true}, {"Balloon", true},
+    {"HugePages_Total", false}, {"HugePages_Free", false},
+    {"HugePages_Rsvd", false}, {"HugePages_Surp", false},
+    {"Hugepagesize", true}, {"Hugetlb", true}, {"DirectMap4k", true},
+    {"DirectMap2M", true}, {"DirectMap1G", true},
+}};
+
+/// Key entry of @p field.
+constexpr const MeminfoKey& meminfoKey(MeminfoField field) {
+    return kMeminfoKeys[static_cast<std::size_t>(field)];
+}
+
+namespace detail {
+/// Fields ordered by name, built at compile time for binary search.
+constexpr std::array<MeminfoField, kMeminfoFieldCount> sortedMeminfoFields() {
+    std::array<MeminfoField, kMeminfoFieldCount> out{};
+    for (std::size_t i = 0; i < kMeminfoFieldCount; ++i) {
+        std::size_t j = i;
+        for (; j > 0 && kMeminfoKeys[i].name < meminfoKey(out[j - 1]).name; --j)
+            out[j] = out[j - 1];
+        out[j] = static_cast<MeminfoField>(i);
+    }
+    return out;
+}
+inline constexpr auto kSortedMeminfoFields = sortedMeminfoFields();
+} // namespace detail
+
+/**
+ * Look up a meminfo key by name.
+ * @param name Key as printed before the colon.
+ * @return Matching field or std::nullopt for keys this build does not know.
+ */
+constexpr std::optional<MeminfoField> findMeminfoField(std::string_view name) {
+    std::size_t lo = 0;
+    std::size_t hi = kMeminfoFieldCount;
+    while (lo < hi) {
+        const std::size_t mid = (lo + hi) / 2;
+        const MeminfoField f = detail::kSortedMeminfoFields[mid];
+        const int cmp = name.compare(meminfoKey(f).name);
+        if (cmp == 0) return f;
+        if (cmp < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return std::nullopt;
+}
+
+static_assert(findMeminfoField("MemAvailable") == MeminfoField::MemAvailable);
+static_assert(findMeminfoField("HugePages_Surp") == MeminfoField::HugePagesSurp);
+static_assert(findMeminfoField("DirectMap1G") == MeminfoField::DirectMap1G);
+static_assert(!findMeminfoField("MemAvail"));
@@ -0,0 +1,462 @@
+#include "metrics_exporter.h"
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+constexpr char kContentType[] = "text/plain; version=0.0.4; charset=utf-8";
+constexpr std::size_t kMaxRequest = 4096;
+
+void appendf(std::string &out, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void appendf(std::string &out, const char *fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  const int n = std::vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (n > 0)
+    out.append(buf, std::min<std::size_t>(static_cast<std::size_t>(n),
+                                          sizeof(buf) - 1));
+}
+
+/// Append a sample value and end the line. to_chars ignores the locale
+/// QCoreApplication sets, which would otherwise turn 1.5 into "1,5".
+void appendValue(std::string &out, double v) {
+  if (std::isnan(v)) {
+    out += "NaN";
+  } else if (std::isinf(v)) {
+    out += v > 0 ? "+Inf" : "-Inf";
+  } else {
+    char buf[32];
+    const auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, r.ptr);
+  }
+  out += '\n';
+}
+
+void header(std::string &out, const char *name, const char *type,
+            const char *help) {
+  appendf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void sampleValue(std::string &out, const char *name, const char *labels,
+                 double v) {
+  appendf(out, "%s%s ", name, labels);
+  appendValue(out, v);
+}
+
+void psiLines(std::string &out, const char *resource, const char *kind,
+              const PsiValues &v) {
+  const std::pair<const char *, double> windows[] = {
+      {"10", v.avg10}, {"60", v.avg60}, {"300", v.avg300}};
+  for (const auto &[window, avg] : windows) {
+    appendf(out,
+            "nohang_tr_pressure_percent{resource=\"%s\",kind=\"%s\","
+            "window=\"%ss\"} ",
+            resource, kind, window);
+    appendValue(out, avg);
+  }
+}
+
+void psiTotal(std::string &out, const char *resource, const char *kind,
+              const PsiValues &v) {
+  appendf(out,
+          "nohang_tr_pressure_stall_seconds_total{resource=\"%s\","
+          "kind=\"%s\"} ",
+          resource, kind);
+  appendValue(out, v.total / 1e6);
+}
+
+bool writeAll(int fd, const char *data, std::size_t size) {
+  while (size > 0) {
+    const ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    size -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+} // namespace
+
+std::optional<MetricsExporter::Endpoint>
+MetricsExporter::parseEndpoint(std::string_view spec) {
+  Endpoint ep;
+  constexpr std::string_view kUnix = "unix:";
+  if (spec.substr(0, kUnix.size()) == kUnix) {
+    ep.unixPath = std::string(spec.substr(kUnix.size()));
+    if (ep.unixPath.empty() ||
+        ep.unixPath.size() >= sizeof(sockaddr_un::sun_path))
+      return std::nullopt;
+    return ep;
+  }
+  const auto colon = spec.rfind(':');
+  if (colon == std::string_view::npos || colon + 1 == spec.size())
+    return std::nullopt;
+  std::string_view host = spec.substr(0, colon);
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+    host = host.substr(1, host.size() - 2);
+  else if (host.find(':') != std::string_view::npos)
+    return std::nullopt; // bare IPv6 needs brackets
+  if (host.empty())
+    return std::nullopt;
+  const std::string_view port = spec.substr(colon + 1);
+  for (char c : port) {
+    if (c < '0' || c > '9')
+      return std::nullopt;
+  }
+  ep.host = std::string(host);
+  ep.port = std::string(port);
+  return ep;
+}
+
+MetricsExporter::MetricsExporter(const AppConfig &cfg) {
+  setThresholds(cfg);
+  // Until the first sample only the configuration is known.
+  front_ = thresholds_;
+}
+
+void MetricsExporter::setThresholds(const AppConfig &cfg) {
+  std::string &t = thresholds_;
+  t.clear();
+  header(t, "nohang_tr_memory_threshold_bytes", "gauge",
+         "Configured memory thresholds.");
+  const struct {
+    const char *field;
+    const char *level;
+    long kib;
+  } memory[] = {
+      {"MemAvailable", "warn", cfg.mem.available_warn_kib},
+      {"MemAvailable", "warn_exit", cfg.mem.available_warn_exit_kib},
+      {"MemAvailable", "crit", cfg.mem.available_crit_kib},
+      {"MemAvailable", "crit_exit", cfg.mem.available_crit_exit_kib},
+      {"SwapFree", "warn", cfg.swap.free_warn_kib},
+      {"SwapFree", "warn_exit", cfg.swap.free_warn_exit_kib},
+      {"SwapFree", "crit", cfg.swap.free_crit_kib},
+      {"SwapFree", "crit_exit", cfg.swap.free_crit_exit_kib}};
+  for (const auto &m : memory)
+    appendf(t,
+            "nohang_tr_memory_threshold_bytes{field=\"%s\",level=\"%s\"} "
+            "%lld\n",
+            m.field, m.level, static_cast<long long>(m.kib) * 1024);
+
+  header(t, "nohang_tr_pressure_threshold_percent", "gauge",
+         "Configured PSI avg10 thresholds.");
+  const struct {
+    const char *resource;
+    double warn, warnExit, crit, critExit;
+  } psi[] = {{"memory", cfg.psi.avg10_warn, cfg.psi.avg10_warn_exit,
+              cfg.psi.avg10_crit, cfg.psi.avg10_crit_exit},
+             {"cpu", cfg.psi.cpu.avg10_warn, cfg.psi.cpu.avg10_warn_exit,
+              cfg.psi.cpu.avg10_crit, cfg.psi.cpu.avg10_crit_exit},
+             {"io", cfg.psi.io.avg10_warn, cfg.psi.io.avg10_warn_exit,
+              cfg.psi.io.avg10_crit, cfg.psi.io.avg10_crit_exit},
+             {"irq", cfg.psi.irq.avg10_warn, cfg.psi.irq.avg10_warn_exit,
+              cfg.psi.irq.avg10_crit, cfg.psi.irq.avg10_crit_exit}};
+  for (const auto &p : psi) {
+    const std::pair<const char *, double> levels[] = {{"warn", p.warn},
+                                                      {"warn_exit", p.warnExit},
+                                                      {"crit", p.crit},
+                                                      {"crit_exit", p.critExit}};
+    for (const auto &[level, v] : levels) {
+      appendf(t,
+              "nohang_tr_pressure_threshold_percent{resource=\"%s\","
+              "level=\"%s\"} ",
+              p.resource, level);
+      appendValue(t, v);
+    }
+  }
+
+  header(t, "nohang_tr_vmstat_threshold_per_second", "gauge",
+         "Configured thrashing thresholds.");
+  const std::pair<const char *, double> thrash[] = {
+      {"refault", cfg.thrash.refault_per_sec},
+      {"pswpin", cfg.thrash.swapin_per_sec},
+      {"allocstall", cfg.thrash.allocstall_per_sec}};
+  for (const auto &[counter, v] : thrash) {
+    appendf(t, "nohang_tr_vmstat_threshold_per_second{counter=\"%s\"} ",
+            counter);
+    appendValue(t, v);
+  }
+}
+
+MetricsExporter::~MetricsExporter() {
+  if (thread_.joinable()) {
+    const std::uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = write(stopFd_, &one, sizeof(one));
+    thread_.join();
+  }
+  if (stopFd_ >= 0)
+    close(stopFd_);
+  if (listenFd_ >= 0)
+    close(listenFd_);
+  if (!unixPath_.empty())
+    unlink(unixPath_.c_str());
+}
+
+bool MetricsExporter::listen(std::string_view spec) {
+  if (listenFd_ >= 0)
+    return false;
+  const auto ep = parseEndpoint(spec);
+  if (!ep)
+    return false;
+  int fd = -1;
+  if (!ep->unixPath.empty()) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, ep->unixPath.c_str(), ep->unixPath.size());
+    // A stale socket from an earlier run would make bind fail, but a
+    // mistyped path must not cost some other file.
+    struct stat st {};
+    if (lstat(ep->unixPath.c_str(), &st) == 0) {
+      if (!S_ISSOCK(st.st_mode))
+        return false;
+      unlink(ep->unixPath.c_str());
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 ||
+        bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+      if (fd >= 0)
+        close(fd);
+      return false;
+    }
+    unixPath_ = ep->unixPath;
+  } else {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    addrinfo *res = nullptr;
+    if (getaddrinfo(ep->host.c_str(), ep->port.c_str(), &hints, &res) != 0)
+      return false;
+    for (addrinfo *ai = res; ai; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                  ai->ai_protocol);
+      if (fd < 0)
+        continue;
+      const int on = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        break;
+      close(fd);
+      fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0)
+      return false;
+    sockaddr_storage bound{};
+    socklen_t len = sizeof(bound);
+    if (getsockname(fd, reinterpret_cast<sockaddr *>(&bound), &len) == 0)
+      port_ = ntohs(bound.ss_family == AF_INET6
+                        ? reinterpret_cast<sockaddr_in6 *>(&bound)->sin6_port
+                        : reinterpret_cast<sockaddr_in *>(&bound)->sin_port);
+  }
+  stopFd_ = eventfd(0, EFD_CLOEXEC);
+  if (::listen(fd, 16) < 0 || stopFd_ < 0) {
+    close(fd);
+    if (!unixPath_.empty())
+      unlink(unixPath_.c_str());
+    unixPath_.clear();
+    port_ = 0;
+    return false;
+  }
+  listenFd_ = fd;
+  thread_ = std::thread([this] { serve(); });
+  return true;
+}
+
+void MetricsExporter::update(const std::optional<ProbeSample> &sample,
+                             PressureState state,
+                             std::chrono::nanoseconds duration, int intervalMs,
+                             std::uint64_t dropped) {
+  if (state_ && *state_ != state)
+    ++transitions_[static_cast<std::size_t>(*state_)]
+                  [static_cast<std::size_t>(state)];
+  state_ = state;
+  ++samples_;
+  durationSum_ += std::chrono::duration<double>(duration).count();
+
+  std::string &out = back_;
+  out.clear();
+  header(out, "nohang_tr_state", "gauge",
+         "Pressure state: 0 green, 1 yellow, 2 orange, 3 red.");
+  sampleValue(out, "nohang_tr_state", "", static_cast<int>(state));
+  header(out, "nohang_tr_probe_success", "gauge",
+         "Whether the latest sample could be read.");
+  sampleValue(out, "nohang_tr_probe_success", "", sample ? 1 : 0);
+
+  if (sample) {
+    const ProbeSample &s = *sample;
+    header(out, "nohang_tr_memory_bytes", "gauge", "Readings of /proc/meminfo.");
+    const std::pair<const char *, const std::optional<long> &> memory[] = {
+        {"MemAvailable", s.mem_available_kib},
+        {"MemTotal", s.mem_total_kib},
+        {"MemFree", s.mem_free_kib},
+        {"SwapFree", s.swap_free_kib},
+        {"Cached", s.cached_kib}};
+    for (const auto &[field, kib] : memory) {
+      if (kib)
+        appendf(out, "nohang_tr_memory_bytes{field=\"%s\"} %lld\n", field,
+                static_cast<long long>(*kib) * 1024);
+    }
+
+    header(out, "nohang_tr_pressure_percent", "gauge",
+           "PSI stall averages over 10, 60 and 300 seconds.");
+    psiLines(out, "memory", "some", s.some);
+    psiLines(out, "memory", "full", s.full);
+    const std::pair<const char *, const PsiResourceValues &> resources[] = {
+        {"cpu", s.cpu}, {"io", s.io}, {"irq", s.irq}};
+    for (const auto &[name, values] : resources) {
+      if (values.some)
+        psiLines(out, name, "some", *values.some);
+      if (values.full)
+        psiLines(out, name, "full", *values.full);
+    }
+    header(out, "nohang_tr_pressure_stall_seconds_total", "counter",
+           "Total PSI stall time.");
+    psiTotal(out, "memory", "some", s.some);
+    psiTotal(out, "memory", "full", s.full);
+    for (const auto &[name, values] : resources) {
+      if (values.some)
+        psiTotal(out, name, "some", *values.some);
+      if (values.full)
+        psiTotal(out, name, "full", *values.full);
+    }
+
+    if (s.vmstat) {
+      header(out, "nohang_tr_vmstat_per_second", "gauge",
+             "Reclaim and swap rates from /proc/vmstat.");
+      const VmstatRates &r = *s.vmstat;
+      const std::pair<const char *, double> rates[] = {
+          {"refault", r.refault()},     {"pswpin", r.pswpin},
+          {"pswpout", r.pswpout},       {"pgmajfault", r.pgmajfault},
+          {"pgscan", r.pgscan},         {"pgsteal", r.pgsteal},
+          {"allocstall", r.allocstall}};
+      for (const auto &[counter, v] : rates) {
+        appendf(out, "nohang_tr_vmstat_per_second{counter=\"%s\"} ", counter);
+        appendValue(out, v);
+      }
+    }
+  }
+
+  header(out, "nohang_tr_state_transitions_total", "counter",
+         "State changes by origin and destination.");
+  for (std::size_t from = 0; from < kStates; ++from) {
+    for (std::size_t to = 0; to < kStates; ++to) {
+      if (from == to)
+        continue;
+      appendf(out,
+              "nohang_tr_state_transitions_total{from=\"%s\",to=\"%s\"} "
+              "%llu\n",
+              pressureStateName(static_cast<PressureState>(from)),
+              pressureStateName(static_cast<PressureState>(to)),
+              static_cast<unsigned long long>(transitions_[from][to]));
+    }
+  }
+  header(out, "nohang_tr_sample_duration_seconds", "summary",
+         "Time taken to sample and decide.");
+  sampleValue(out, "nohang_tr_sample_duration_seconds_sum", "", durationSum_);
+  sampleValue(out, "nohang_tr_sample_duration_seconds_count", "",
+              static_cast<double>(samples_));
+  header(out, "nohang_tr_sample_interval_seconds", "gauge",
+         "Delay before the next sample.");
+  sampleValue(out, "nohang_tr_sample_interval_seconds", "", intervalMs / 1000.0);
+  header(out, "nohang_tr_snapshots_dropped_total", "counter",
+         "Samples the display fell too far behind to show.");
+  sampleValue(out, "nohang_tr_snapshots_dropped_total", "",
+              static_cast<double>(dropped));
+  out += thresholds_;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  front_.swap(back_);
+}
+
+std::string MetricsExporter::text() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return front_;
+}
+
+void MetricsExporter::serve() {
+  pollfd fds[2] = {{listenFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+  for (;;) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    if (fds[1].revents & POLLIN)
+      return;
+    if (fds[0].revents & POLLIN) {
+      int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd >= 0) {
+        respond(fd);
+        close(fd);
+      }
+    }
+  }
+}
+
+void MetricsExporter::respond(int fd) {
+  // Scrapes are served one at a time; a stalled client only holds its own
+  // connection for the timeout.
+  const timeval timeout{1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  char request[kMaxRequest];
+  std::size_t used = 0;
+  while (used < sizeof(request)) {
+    const ssize_t n = recv(fd, request + used, sizeof(request) - used, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    used += static_cast<std::size_t>(n);
+    if (std::string_view(request, used).find("\r\n\r\n") !=
+        std::string_view::npos)
+      break;
+  }
+  const std::string_view req(request, used);
+  const std::string_view line = req.substr(0, req.find("\r\n"));
+  const bool head = line.rfind("HEAD ", 0) == 0;
+  const bool get = line.rfind("GET ", 0) == 0;
+  std::string_view target;
+  if (get || head) {
+    target = line.substr(get ? 4 : 5);
+    target = target.substr(0, target.find(' '));
+  }
+
+  std::string &response = response_;
+  response.clear();
+  if (target == "/metrics") {
+    std::lock_guard<std::mutex> lock(mutex_);
+    appendf(response,
+            "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+            "Connection: close\r\n\r\n",
+            kContentType, front_.size());
+    if (get)
+      response += front_;
+  } else {
+    constexpr char kNotFound[] = "Not found; try /metrics\n";
+    appendf(response,
+            "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n"
+            "Content-Length: %zu\r\nConnection: close\r\n\r\n%s",
+            sizeof(kNotFound) - 1, get ? kNotFound : "");
+  }
+  writeAll(fd, response.data(), response.size());
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "config.h"
+#include "pressure_state.h"
+#include "system_probe.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * @brief Serves the latest sample as Prometheus metrics over HTTP.
+ *
+ * update() renders the metrics text once per sample into a reused buffer;
+ * scrapes are answered from that cached text on a dedicated thread, so a
+ * scrape never reads /proc. Listens on a TCP address or a Unix socket and
+ * answers `GET /metrics` with one response per connection.
+ */
+class MetricsExporter {
+public:
+  /** Where to listen. */
+  struct Endpoint {
+    std::string host;     ///< TCP host, empty for a Unix socket.
+    std::string port;     ///< TCP port; "0" picks a free one.
+    std::string unixPath; ///< Unix socket path, empty for TCP.
+  };
+
+  /**
+   * @brief Parse "host:port", "[v6addr]:port" or "unix:/path".
+   * @return The endpoint, or std::nullopt if malformed.
+   */
+  static std::optional<Endpoint> parseEndpoint(std::string_view spec);
+
+  /**
+   * @param cfg Thresholds exported alongside the readings.
+   */
+  explicit MetricsExporter(const AppConfig &cfg);
+
+  /** Stops serving and removes a Unix socket. */
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter &) = delete;
+  MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+  /**
+   * @brief Bind to @p spec and start serving.
+   *
+   * A socket left at a Unix path by an earlier run is replaced; any other
+   * file there is left alone and the call fails.
+   * @return False if the endpoint is malformed or cannot be bound.
+   */
+  bool listen(std::string_view spec);
+
+  /**
+   * @brief Replace the exported thresholds, e.g. after a reload.
+   *
+   * Takes effect with the next update(), on whose thread it must be called.
+   */
+  void setThresholds(const AppConfig &cfg);
+
+  /** Bound TCP port, or 0 when not listening on TCP. */
+  int port() const { return port_; }
+
+  /**
+   * @brief Publish a sampling result.
+   * @param sample Reading, empty if the probe failed.
+   * @param state Decided state; changes are counted as transitions.
+   * @param duration Time taken to sample and decide.
+   * @param intervalMs Delay before the next sample.
+   * @param dropped Snapshots the consumer has dropped so far.
+   */
+  void update(const std::optional<ProbeSample> &sample, PressureState state,
+              std::chrono::nanoseconds duration, int intervalMs,
+              std::uint64_t dropped);
+
+  /** Current metrics text, as a scrape would receive it. */
+  std::string text() const;
+
+private:
+  static constexpr std::size_t kStates = 4;
+
+  void serve();
+  void respond(int fd);
+
+  std::string thresholds_; ///< Rendered by setThresholds(), not per sample.
+  std::optional<PressureState> state_;
+  std::array<std::array<std::uint64_t, kStates>, kStates> transitions_{};
+  std::uint64_t samples_ = 0;
+  double durationSum_ = 0.0;
+
+  std::string back_; ///< Rendered by update(), swapped into front_.
+  mutable std::mutex mutex_;
+  std::string front_;
+  std::string response_; ///< Reused by the serving thread.
+
+  int listenFd_ = -1;
+  int stopFd_ = -1;
+  int port_ = 0;
+  std::string unixPath_;
+  std::thread thread_;
+};
@@ -0,0 +1,317 @@
+#include "policy.h"
+#include "config.h"
+#include "config_lexer.h"
+#include "pressure_state.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <iterator>
+#include <limits>
+
+namespace {
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+double orNaN(const std::optional<long> &v) {
+  return v ? static_cast<double>(*v) : kNaN;
+}
+double orNaN(const std::optional<double> &v) { return v ? *v : kNaN; }
+
+template <double VmstatRates::*Rate>
+double vmstatRate(const PolicyInput &in) {
+  return in.sample.vmstat ? (*in.sample.vmstat).*Rate : kNaN;
+}
+
+struct Metric {
+  std::string_view name;
+  double (*read)(const PolicyInput &);
+};
+constexpr Metric kMetrics[] = {
+    {"mem.available_kib",
+     [](const PolicyInput &in) { return orNaN(in.sample.mem_available_kib); }},
+    {"mem.total_kib",
+     [](const PolicyInput &in) { return orNaN(in.sample.mem_total_kib); }},
+    {"mem.free_kib",
+     [](const PolicyInput &in) { return orNaN(in.sample.mem_free_kib); }},
+    {"mem.cached_kib",
+     [](const PolicyInput &in) { return orNaN(in.sample.cached_kib); }},
+    {"swap.free_kib",
+     [](const PolicyInput &in) { return orNaN(in.sample.swap_free_kib); }},
+    {"psi.some.avg10", [](const PolicyInput &in) { return in.sample.some.avg10; }},
+    {"psi.some.avg60", [](const PolicyInput &in) { return in.sample.some.avg60; }},
+    {"psi.some.avg300",
+     [](const PolicyInput &in) { return in.sample.some.avg300; }},
+    {"psi.full.avg10", [](const PolicyInput &in) { return in.sample.full.avg10; }},
+    {"psi.full.avg60", [](const PolicyInput &in) { return in.sample.full.avg60; }},
+    {"psi.full.avg300",
+     [](const PolicyInput &in) { return in.sample.full.avg300; }},
+    {"psi.some.avg10_rate", someAvg10Rate},
+    {"psi.cpu.avg10", [](const PolicyInput &in) { return orNaN(in.sample.cpu.avg10()); }},
+    {"psi.io.avg10", [](const PolicyInput &in) { return orNaN(in.sample.io.avg10()); }},
+    {"psi.irq.avg10", [](const PolicyInput &in) { return orNaN(in.sample.irq.avg10()); }},
+    {"vmstat.refault",
+     [](const PolicyInput &in) {
+       return in.sample.vmstat ? in.sample.vmstat->refault() : kNaN;
+     }},
+    {"vmstat.pswpin", vmstatRate<&VmstatRates::pswpin>},
+    {"vmstat.pswpout", vmstatRate<&VmstatRates::pswpout>},
+    {"vmstat.pgmajfault", vmstatRate<&VmstatRates::pgmajfault>},
+    {"vmstat.pgscan", vmstatRate<&VmstatRates::pgscan>},
+    {"vmstat.pgsteal", vmstatRate<&VmstatRates::pgsteal>},
+    {"vmstat.allocstall", vmstatRate<&VmstatRates::allocstall>},
+    {"forecast.seconds_to_critical",
+     [](const PolicyInput &in) {
+       // A leftover forecast must not fire while forecasting is off.
+       return in.cfg.forecast.horizon_sec > 0.0
+                  ? orNaN(in.sample.seconds_to_critical)
+                  : kNaN;
+     }},
+};
+constexpr std::size_t kNamedMetrics = std::size(kMetrics);
+/// Named metrics first, then one per MeminfoField as meminfo.<Key>.
+constexpr std::size_t kMetricCount = kNamedMetrics + kMeminfoFieldCount;
+static_assert(kMetricCount <= 256, "metric indices are 8 bits");
+
+double readMetric(std::size_t i, const PolicyInput &in) {
+  if (i < kNamedMetrics)
+    return kMetrics[i].read(in);
+  return orNaN(
+      in.sample.meminfoValue(static_cast<MeminfoField>(i - kNamedMetrics)));
+}
+
+std::optional<std::uint8_t> findMetric(std::string_view name) {
+  for (std::size_t i = 0; i < kNamedMetrics; ++i)
+    if (kMetrics[i].name == name)
+      return static_cast<std::uint8_t>(i);
+  constexpr std::string_view kMeminfo = "meminfo.";
+  if (name.substr(0, kMeminfo.size()) == kMeminfo) {
+    if (auto f = findMeminfoField(name.substr(kMeminfo.size())))
+      return static_cast<std::uint8_t>(kNamedMetrics +
+                                       static_cast<std::size_t>(*f));
+  }
+  return std::nullopt;
+}
+
+/// Numeric config keys usable as thresholds, named as in nohang-tr.toml.
+struct Param {
+  std::string_view name;
+  double (*read)(const AppConfig &);
+};
+#define NOHANG_PARAM(key, expr)                                                \
+  {key, [](const AppConfig &c) { return static_cast<double>(c.expr); }}
+/// A threshold that is off while 0, which no reading can match.
+#define NOHANG_OPTIONAL_PARAM(key, expr)                                       \
+  {key, [](const AppConfig &c) { return c.expr > 0 ? c.expr : kNaN; }}
+constexpr Param kParams[] = {
+    NOHANG_PARAM("psi.avg10_warn", psi.avg10_warn),
+    NOHANG_PARAM("psi.avg10_warn_exit", psi.avg10_warn_exit),
+    NOHANG_PARAM("psi.avg10_crit", psi.avg10_crit),
+    NOHANG_PARAM("psi.avg10_crit_exit", psi.avg10_crit_exit),
+    NOHANG_PARAM("psi.avg10_deriv_warn", psi.avg10_deriv_warn),
+    NOHANG_OPTIONAL_PARAM("psi.cpu.avg10_warn", psi.cpu.avg10_warn),
+    NOHANG_OPTIONAL_PARAM("psi.cpu.avg10_warn_exit", psi.cpu.avg10_warn_exit),
+    NOHANG_OPTIONAL_PARAM("psi.cpu.avg10_crit", psi.cpu.avg10_crit),
+    NOHANG_OPTIONAL_PARAM("psi.cpu.avg10_crit_exit", psi.cpu.avg10_crit_exit),
+    NOHANG_OPTIONAL_PARAM("psi.io.avg10_warn", psi.io.avg10_warn),
+    NOHANG_OPTIONAL_PARAM("psi.io.avg10_warn_exit", psi.io.avg10_warn_exit),
+    NOHANG_OPTIONAL_PARAM("psi.io.avg10_crit", psi.io.avg10_crit),
+    NOHANG_OPTIONAL_PARAM("psi.io.avg10_crit_exit", psi.io.avg10_crit_exit),
+    NOHANG_OPTIONAL_PARAM("psi.irq.avg10_warn", psi.irq.avg10_warn),
+    NOHANG_OPTIONAL_PARAM("psi.irq.avg10_warn_exit", psi.irq.avg10_warn_exit),
+    NOHANG_OPTIONAL_PARAM("psi.irq.avg10_crit", psi.irq.avg10_crit),
+    NOHANG_OPTIONAL_PARAM("psi.irq.avg10_crit_exit", psi.irq.avg10_crit_exit),
+    NOHANG_PARAM("mem.available_warn_kib", mem.available_warn_kib),
+    NOHANG_PARAM("mem.available_warn_exit_kib", mem.available_warn_exit_kib),
+    NOHANG_PARAM("mem.available_crit_kib", mem.available_crit_kib),
+    NOHANG_PARAM("mem.available_crit_exit_kib", mem.available_crit_exit_kib),
+    NOHANG_PARAM("swap.free_warn_kib", swap.free_warn_kib),
+    NOHANG_PARAM("swap.free_warn_exit_kib", swap.free_warn_exit_kib),
+    NOHANG_PARAM("swap.free_crit_kib", swap.free_crit_kib),
+    NOHANG_PARAM("swap.free_crit_exit_kib", swap.free_crit_exit_kib),
+    NOHANG_PARAM("thrash.refault_per_sec", thrash.refault_per_sec),
+    NOHANG_PARAM("thrash.refault_exit_per_sec", thrash.refault_exit_per_sec),
+    NOHANG_PARAM("thrash.swapin_per_sec", thrash.swapin_per_sec),
+    NOHANG_PARAM("thrash.swapin_exit_per_sec", thrash.swapin_exit_per_sec),
+    NOHANG_PARAM("thrash.allocstall_per_sec", thrash.allocstall_per_sec),
+    NOHANG_PARAM("thrash.allocstall_exit_per_sec", thrash.allocstall_exit_per_sec),
+    NOHANG_PARAM("forecast.horizon_sec", forecast.horizon_sec),
+    NOHANG_PARAM("forecast.horizon_exit_sec", forecast.horizon_exit_sec),
+};
+#undef NOHANG_PARAM
+#undef NOHANG_OPTIONAL_PARAM
+constexpr std::size_t kParamCount = std::size(kParams);
+
+std::optional<std::int16_t> findParam(std::string_view name) {
+  for (std::size_t i = 0; i < kParamCount; ++i)
+    if (kParams[i].name == name)
+      return static_cast<std::int16_t>(i);
+  return std::nullopt;
+}
+
+/// The cascade the tray has always used, highest state first.
+const std::vector<std::string_view> kDefaultRules = {
+    "red if mem.available_kib <= mem.available_crit_kib exit mem.available_crit_exit_kib",
+    "red if swap.free_kib <= swap.free_crit_kib exit swap.free_crit_exit_kib",
+    "red if psi.some.avg10 >= psi.avg10_crit exit psi.avg10_crit_exit",
+    "orange if mem.available_kib <= mem.available_warn_kib exit mem.available_warn_exit_kib",
+    "orange if swap.free_kib <= swap.free_warn_kib exit swap.free_warn_exit_kib",
+    "orange if psi.cpu.avg10 >= psi.cpu.avg10_crit exit psi.cpu.avg10_crit_exit",
+    "orange if psi.io.avg10 >= psi.io.avg10_crit exit psi.io.avg10_crit_exit",
+    "orange if psi.irq.avg10 >= psi.irq.avg10_crit exit psi.irq.avg10_crit_exit",
+    "orange if vmstat.refault >= thrash.refault_per_sec exit thrash.refault_exit_per_sec",
+    "orange if vmstat.pswpin >= thrash.swapin_per_sec exit thrash.swapin_exit_per_sec",
+    "orange if vmstat.allocstall >= thrash.allocstall_per_sec exit thrash.allocstall_exit_per_sec",
+    "yellow if mem.available_kib <= mem.available_warn_exit_kib",
+    "yellow if swap.free_kib <= swap.free_warn_exit_kib",
+    "yellow if forecast.seconds_to_critical <= forecast.horizon_sec exit forecast.horizon_exit_sec",
+    "yellow if psi.some.avg10_rate >= psi.avg10_deriv_warn",
+    "yellow if psi.some.avg10 >= psi.avg10_warn exit psi.avg10_warn_exit",
+    "yellow if psi.cpu.avg10 >= psi.cpu.avg10_warn exit psi.cpu.avg10_warn_exit",
+    "yellow if psi.io.avg10 >= psi.io.avg10_warn exit psi.io.avg10_warn_exit",
+    "yellow if psi.irq.avg10 >= psi.irq.avg10_warn exit psi.irq.avg10_warn_exit",
+};
+
+/// Split at runs of whitespace; returns false if there are more than N words.
+template <std::size_t N>
+bool words(std::string_view s, std::array<std::string_view, N> &out,
+           std::size_t &count) {
+  count = 0;
+  std::size_t i = 0;
+  while (i < s.size()) {
+    while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i])))
+      ++i;
+    if (i == s.size())
+      break;
+    const std::size_t begin = i;
+    while (i < s.size() && !std::isspace(static_cast<unsigned char>(s[i])))
+      ++i;
+    if (count == N)
+      return false;
+    out[count++] = s.substr(begin, i - begin);
+  }
+  return true;
+}
+
+bool equalsLower(std::string_view word, std::string_view lower) {
+  return word.size() == lower.size() &&
+         std::equal(word.begin(), word.end(), lower.begin(), [](char a, char b) {
+           return std::tolower(static_cast<unsigned char>(a)) == b;
+         });
+}
+} // namespace
+
+double someAvg10Rate(const PolicyInput &in) {
+  if (!in.prevSomeAvg10)
+    return kNaN;
+  constexpr double kPsiUpdateSec = 2.0;
+  const double dt =
+      in.elapsedSec > 0.0
+          ? std::max(in.elapsedSec, kPsiUpdateSec)
+          : static_cast<double>(in.cfg.sample_interval_ms) / 1000.0;
+  return (in.sample.some.avg10 - *in.prevSomeAvg10) / dt;
+}
+
+Policy Policy::compile(const std::vector<std::string_view> &rules,
+                       std::vector<std::string> *errors) {
+  Policy policy;
+  std::array<bool, kMetricCount> metricUsed{};
+  std::array<bool, kParamCount> paramUsed{};
+  auto fail = [&](std::string_view rule, const char *reason) {
+    if (errors)
+      errors->push_back(std::string(rule) + ": " + reason);
+  };
+  auto threshold = [&](std::string_view word) -> std::optional<Threshold> {
+    if (auto v = ConfigEntry::parseDouble(word))
+      return Threshold{*v, -1};
+    if (auto p = findParam(word))
+      return Threshold{0.0, *p};
+    return std::nullopt;
+  };
+
+  for (std::string_view text : rules) {
+    std::array<std::string_view, 7> w;
+    std::size_t n = 0;
+    if (!words(text, w, n) || (n != 5 && n != 7) || !equalsLower(w[1], "if") ||
+        (n == 7 && !equalsLower(w[5], "exit"))) {
+      fail(text, "expected '<state> if <metric> <op> <threshold> [exit <threshold>]'");
+      continue;
+    }
+    Rule r{};
+    if (equalsLower(w[0], "yellow"))
+      r.state = PressureState::Yellow;
+    else if (equalsLower(w[0], "orange"))
+      r.state = PressureState::Orange;
+    else if (equalsLower(w[0], "red"))
+      r.state = PressureState::Red;
+    else {
+      fail(text, "state must be yellow, orange or red");
+      continue;
+    }
+    auto metric = findMetric(w[2]);
+    if (!metric) {
+      fail(text, "unknown metric");
+      continue;
+    }
+    r.metric = *metric;
+    if (w[3] == ">=" || w[3] == ">") {
+      r.sign = 1.0;
+    } else if (w[3] == "<=" || w[3] == "<") {
+      r.sign = -1.0;
+    } else {
+      fail(text, "operator must be >=, >, <= or <");
+      continue;
+    }
+    r.strict = w[3].size() == 1;
+    auto enter = threshold(w[4]);
+    auto exit = n == 7 ? threshold(w[6]) : enter;
+    if (!enter || !exit) {
+      fail(text, "threshold must be a number or a config key");
+      continue;
+    }
+    r.enter = *enter;
+    r.exit = *exit;
+    metricUsed[r.metric] = true;
+    for (const Threshold &t : {r.enter, r.exit})
+      if (t.param >= 0)
+        paramUsed[static_cast<std::size_t>(t.param)] = true;
+    policy.rules_.push_back(r);
+  }
+
+  std::stable_sort(policy.rules_.begin(), policy.rules_.end(),
+                   [](const Rule &a, const Rule &b) { return a.state > b.state; });
+  for (std::size_t i = 0; i < kMetricCount; ++i)
+    if (metricUsed[i])
+      policy.metrics_.push_back(static_cast<std::uint8_t>(i));
+  for (std::size_t i = 0; i < kParamCount; ++i)
+    if (paramUsed[i])
+      policy.params_.push_back(static_cast<std::uint8_t>(i));
+  return policy;
+}
+
+const std::vector<std::string_view> &Policy::defaultRules() {
+  return kDefaultRules;
+}
+
+const Policy &Policy::defaults() {
+  static const Policy policy = compile(kDefaultRules);
+  return policy;
+}
+
+PressureState Policy::evaluate(const PolicyInput &in,
+                               PressureState prev) const {
+  std::array<double, kMetricCount> metrics;
+  for (std::uint8_t i : metrics_)
+    metrics[i] = readMetric(i, in);
+  std::array<double, kParamCount> params;
+  for (std::uint8_t i : params_)
+    params[i] = kParams[i].read(in.cfg);
+
+  for (const Rule &r : rules_) {
+    // The exit threshold holds a state once entered.
+    const Threshold &t = prev >= r.state ? r.exit : r.enter;
+    const double limit = r.sign * (t.param < 0 ? t.value : params[t.param]);
+    const double v = r.sign * metrics[r.metric];
+    if ((v > limit) | (!r.strict & (v == limit)))
+      return r.state;
+  }
+  return PressureState::Green;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct AppConfig;
+struct ProbeSample;
+enum class PressureState;
+
+/// Everything a policy rule may look at for one decision.
+struct PolicyInput {
+  const ProbeSample &sample;
+  const AppConfig &cfg;
+  /// PSI some avg10 of the previous sample, for psi.some.avg10_rate.
+  std::optional<double> prevSomeAvg10;
+  /// Seconds since the previous sample; the sample interval when not positive.
+  double elapsedSec = 0.0;
+};
+
+/**
+ * @brief Change of PSI some avg10 per second, i.e. psi.some.avg10_rate.
+ *
+ * The kernel recomputes PSI averages every 2 s, so shorter gaps (e.g. a
+ * trigger wakeup right after a tick) are measured as 2 s.
+ * @return NaN without a previous value.
+ */
+double someAvg10Rate(const PolicyInput &in);
+
+/**
+ * @brief Rules mapping readings to a pressure state, compiled once.
+ *
+ * Each rule reads
+ *
+ *     <yellow|orange|red> if <metric> <op> <threshold> [exit <threshold>]
+ *
+ * with op one of >=, >, <= or <, e.g. "red if psi.some.avg10 >= 1.0 exit
+ * 0.8". Metrics are sample readings such as mem.available_kib,
+ * swap.free_kib, psi.some.avg10, psi.some.avg10_rate, psi.io.avg10,
+ * vmstat.refault, forecast.seconds_to_critical or meminfo.<Key> for any
+ * /proc/meminfo key. A threshold is a number or the name of a numeric
+ * config key such as mem.available_crit_kib, read at every decision so
+ * edits to AppConfig apply at once. While the previous state is at or
+ * above a rule's state, the exit threshold applies instead, which gives
+ * each rule its own hysteresis; without exit it is the entry threshold.
+ *
+ * compile() resolves every name to an index, so evaluate() only fills the
+ * metrics and config values the rules use into fixed arrays on the stack
+ * and walks a flat vector of comparisons, highest state first. Missing
+ * readings are NaN and never match. Nothing is allocated per decision.
+ */
+class Policy {
+public:
+  /**
+   * @brief Compile rules, one per element.
+   * @param errors Receives "rule: reason" for each rule that was skipped.
+   */
+  static Policy compile(const std::vector<std::string_view> &rules,
+                        std::vector<std::string> *errors = nullptr);
+
+  /// The built-in rules, equivalent to the thresholds of AppConfig.
+  static const Policy &defaults();
+
+  /// Source of the built-in rules, one rule per element.
+  static const std::vector<std::string_view> &defaultRules();
+
+  bool empty() const { return rules_.empty(); }
+  std::size_t size() const { return rules_.size(); }
+
+  /// State of the first rule that matches, Green if none does.
+  PressureState evaluate(const PolicyInput &in, PressureState prev) const;
+
+private:
+  struct Threshold {
+    double value = 0.0;     ///< Constant, when param is negative.
+    std::int16_t param = -1; ///< Config key index.
+  };
+  struct Rule {
+    PressureState state;
+    std::uint8_t metric;
+    bool strict;  ///< > or < rather than >= or <=.
+    double sign;  ///< -1 turns <= and < into >= and >.
+    Threshold enter;
+    Threshold exit;
+  };
+
+  std::vector<Rule> rules_;
+  std::vector<std::uint8_t> metrics_; ///< Distinct metrics the rules read.
+  std::vector<std::uint8_t> params_;  ///< Distinct config keys they read.
+};
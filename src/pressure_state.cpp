@@ -0,0 +1,25 @@
+#include "pressure_state.h"
+#include "policy.h"
+
+const char *pressureStateName(PressureState state) {
+  switch (state) {
+  case PressureState::Green:
+    return "green";
+  case PressureState::Yellow:
+    return "yellow";
+  case PressureState::Orange:
+    return "orange";
+  case PressureState::Red:
+    return "red";
+  }
+  return "unknown";
+}
+
+PressureState decidePressure(const ProbeSample &s, const AppConfig &cfg,
+                             PressureState prev,
+                             std::optional<double> prevSomeAvg10,
+                             double elapsedSec) {
+  const Policy &policy =
+      cfg.policy.rules.empty() ? Policy::defaults() : cfg.policy.rules;
+  return policy.evaluate({s, cfg, prevSomeAvg10, elapsedSec}, prev);
+}
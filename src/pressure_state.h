@@ -0,0 +1,35 @@
+#pragma once
+#include "config.h"
+#include "system_probe.h"
+#include <optional>
+
+/**
+ * @brief Color-coded memory pressure states.
+ */
+enum class PressureState {
+  Green,  ///< Normal memory pressure.
+  Yellow, ///< Mild pressure.
+  Orange, ///< High pressure.
+  Red     ///< Critical pressure.
+};
+
+/// Lower-case name of a state, as used in machine-readable output.
+const char *pressureStateName(PressureState state);
+
+/**
+ * @brief Decide next state based on a sample and previous state.
+ *
+ * Evaluates `[policy] rules`, or Policy::defaults() when none are set. By
+ * default thrashing in the /proc/vmstat rates raises Orange even while
+ * memory and PSI still look fine, since refault storms precede PSI stalls,
+ * and a seconds_to_critical forecast within `[forecast] horizon_sec` raises
+ * Yellow. Each threshold applies hysteresis: once a state has been entered,
+ * its exit threshold must be crossed before the state is left again.
+ * @param prevSomeAvg10 Previous PSI some avg10 value to compute rate.
+ * @param elapsedSec Seconds since the previous sample; the configured
+ *        sample interval is assumed when not positive.
+ */
+PressureState decidePressure(const ProbeSample &s, const AppConfig &cfg,
+                             PressureState prev,
+                             std::optional<double> prevSomeAvg10 = std::nullopt,
+                             double elapsedSec = 0.0);
@@ -0,0 +1,268 @@
+#include "proc_read.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+/// Drop a trailing partial line left by a read that filled the buffer.
+std::size_t dropPartialLine(const char* buf, std::size_t len, std::size_t cap) {
+    if (len == cap) {
+        while (len > 0 && buf[len - 1] != '\n') --len;
+    }
+    return len;
+}
+
+ssize_t readLoop(int fd, char* buf, std::size_t cap) {
+    std::size_t len = 0;
+    ssize_t n = 0;
+    while (len < cap && (n = read(fd, buf + len, cap - len)) > 0)
+        len += static_cast<std::size_t>(n);
+    if (n < 0) return -1;
+    return static_cast<ssize_t>(dropPartialLine(buf, len, cap));
+}
+
+/// Submission queue depth; larger batches are split.
+constexpr unsigned kRingEntries = 64;
+
+} // namespace
+
+ssize_t readFromStart(int fd, char* buf, std::size_t cap) {
+    if (lseek(fd, 0, SEEK_SET) < 0) return -2;
+    return readLoop(fd, buf, cap);
+}
+
+ssize_t readFile(const char* path, char* buf, std::size_t cap) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = readLoop(fd, buf, cap);
+    close(fd);
+    return n;
+}
+
+/// Minimal io_uring driven through the raw system calls.
+struct ProcReader::Ring {
+    int fd = -1;
+    unsigned entries = 0;
+    void* sq = MAP_FAILED;
+    std::size_t sqSize = 0;
+    void* cq = MAP_FAILED;
+    std::size_t cqSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t sqesSize = 0;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cq != MAP_FAILED && cq != sq) munmap(cq, cqSize);
+        if (sq != MAP_FAILED) munmap(sq, sqSize);
+        if (fd >= 0) close(fd);
+    }
+
+    static std::unique_ptr<Ring> create() {
+        auto r = std::make_unique<Ring>();
+        io_uring_params p{};
+        r->fd = static_cast<int>(syscall(__NR_io_uring_setup, kRingEntries, &p));
+        if (r->fd < 0) return nullptr;
+        r->entries = p.sq_entries;
+        r->sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        r->cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) r->sqSize = r->cqSize = std::max(r->sqSize, r->cqSize);
+        r->sq = mmap(nullptr, r->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+        if (r->sq == MAP_FAILED) return nullptr;
+        r->cq = single ? r->sq
+                       : mmap(nullptr, r->cqSize, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq == MAP_FAILED) return nullptr;
+        r->sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+        r->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, r->sqesSize, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, r->fd,
+                                                  IORING_OFF_SQES));
+        if (r->sqes == MAP_FAILED) return nullptr;
+        if (!r->supportsRead()) return nullptr;
+        auto* sq = static_cast<char*>(r->sq);
+        auto* cq = static_cast<char*>(r->cq);
+        r->sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        r->sqMask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        r->sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        r->cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        r->cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        r->cqMask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        r->cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return r;
+    }
+
+    /// Whether the kernel implements IORING_OP_READ (5.6 and later).
+    bool supportsRead() const {
+        constexpr unsigned kOps = 64;
+        alignas(io_uring_probe) char storage[sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op)]{};
+        auto* probe = reinterpret_cast<io_uring_probe*>(storage);
+        // Kernels without the probe also lack the opcode.
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, kOps) < 0)
+            return false;
+        return probe->last_op >= IORING_OP_READ &&
+               (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    int enter(unsigned submit, unsigned wait) const {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, wait,
+                                        wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+    }
+};
+
+ProcReader::ProcReader(Backend preferred) {
+    if (preferred == Backend::IoUring) ring_ = Ring::create();
+}
+
+ProcReader::~ProcReader() = default;
+
+void ProcReader::check(Slot& s) const {
+    s.seekable = s.fd >= 0 && lseek(s.fd, 0, SEEK_CUR) >= 0;
+    s.result = s.fd < 0 ? -EBADF : s.seekable ? 0 : -errno;
+}
+
+void ProcReader::finish(Slot& s, ssize_t n) const {
+    s.result = n < 0 ? n : static_cast<ssize_t>(
+                               dropPartialLine(s.buf.get(), static_cast<std::size_t>(n), s.cap));
+}
+
+ProcReader::Handle ProcReader::add(int fd, std::size_t capacity) {
+    Handle h;
+    if (!free_.empty()) {
+        h = free_.back();
+        free_.pop_back();
+    } else {
+        h = slots_.size();
+        slots_.emplace_back();
+    }
+    Slot& s = slots_[h];
+    s.fd = fd;
+    s.used = true;
+    if (s.cap != capacity) {
+        s.buf = std::make_unique<char[]>(capacity);
+        s.cap = capacity;
+    }
+    check(s);
+    return h;
+}
+
+void ProcReader::reset(Handle h, int fd) {
+    slots_[h].fd = fd;
+    check(slots_[h]);
+}
+
+void ProcReader::remove(Handle h) {
+    Slot& s = slots_[h];
+    s.used = false;
+    s.fd = -1;
+    s.result = -EBADF;
+    free_.push_back(h);
+}
+
+std::size_t ProcReader::readAll() {
+    batch_.clear();
+    for (Handle h = 0; h < slots_.size(); ++h) {
+        if (slots_[h].used && slots_[h].seekable) batch_.push_back(h);
+    }
+    if (batch_.empty()) return 0;
+    if (ring_ && readRing()) return batch_.size();
+    for (Handle h : batch_) {
+        Slot& s = slots_[h];
+        ssize_t n = pread(s.fd, s.buf.get(), s.cap, 0);
+        ++syscalls_;
+        finish(s, n < 0 ? -errno : n);
+    }
+    return batch_.size();
+}
+
+bool ProcReader::readRing() {
+    Ring& r = *ring_;
+    for (std::size_t done = 0; done < batch_.size();) {
+        const unsigned n = static_cast<unsigned>(std::min<std::size_t>(r.entries, batch_.size() - done));
+        unsigned tail = *r.sqTail;
+        const unsigned mask = *r.sqMask;
+        for (unsigned i = 0; i < n; ++i, ++tail) {
+            const Handle h = batch_[done + i];
+            Slot& s = slots_[h];
+            const unsigned idx = tail & mask;
+            io_uring_sqe& sqe = r.sqes[idx];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = s.fd;
+            sqe.addr = reinterpret_cast<std::uintptr_t>(s.buf.get());
+            sqe.len = static_cast<unsigned>(s.cap);
+            sqe.off = 0;
+            sqe.user_data = h;
+            r.sqArray[idx] = idx;
+        }
+        __atomic_store_n(r.sqTail, tail, __ATOMIC_RELEASE);
+
+        // Submit and wait for the whole chunk in one call. A read that fails
+        // is retried with pread() for that file alone.
+        unsigned submitted = 0;
+        unsigned reaped = 0;
+        bool unsupported = false;
+        auto reap = [&] {
+            unsigned head = *r.cqHead;
+            const unsigned cqTail = __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE);
+            for (; head != cqTail; ++head, ++reaped) {
+                const io_uring_cqe& cqe = r.cqes[head & *r.cqMask];
+                Slot& s = slots_[static_cast<Handle>(cqe.user_data)];
+                ssize_t res = cqe.res;
+                if (res < 0) {
+                    if (res == -EOPNOTSUPP || res == -ENOSYS) unsupported = true;
+                    res = pread(s.fd, s.buf.get(), s.cap, 0);
+                    ++syscalls_;
+                    if (res < 0) res = -errno;
+                }
+                finish(s, res);
+            }
+            __atomic_store_n(r.cqHead, head, __ATOMIC_RELEASE);
+        };
+        while (reaped < n) {
+            int ret = r.enter(n - submitted, n - reaped);
+            ++syscalls_;
+            if (ret < 0) {
+                if (errno == EINTR) continue;
+                if ((errno == EAGAIN || errno == EBUSY) && reaped < submitted) {
+                    // Out of resources: completions free them up.
+                    reap();
+                    continue;
+                }
+                // The ring itself is unusable. Submitted reads still write
+                // into the slot buffers, so wait for them before dropping
+                // it; unsubmitted entries die with it.
+                reap();
+                while (reaped < submitted) {
+                    const int waited = r.enter(0, submitted - reaped);
+                    ++syscalls_;
+                    if (waited < 0 && errno != EINTR) break;
+                    reap();
+                }
+                ring_.reset();
+                return false;
+            }
+            submitted += static_cast<unsigned>(ret);
+            reap();
+        }
+        if (unsupported) {
+            // Every request of the chunk has completed, so the ring can go.
+            ring_.reset();
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * Read a whole /proc or /sys file from offset 0 into a caller-owned buffer.
+ *
+ * Pseudo files regenerate their contents on every read from the start, so
+ * a descriptor can stay open across samples. When the buffer fills up, a
+ * trailing partial line is dropped so parsers never see a cut-off number.
+ * @param fd Open descriptor.
+ * @param buf Destination buffer.
+ * @param cap Capacity of @p buf in bytes.
+ * @return Number of bytes read, -1 on read error or -2 if seeking failed.
+ */
+ssize_t readFromStart(int fd, char* buf, std::size_t cap);
+
+/**
+ * Open, read and close a file in one go.
+ *
+ * Used for per-process files, which are too many to keep open.
+ * @param path File to read.
+ * @param buf Destination buffer.
+ * @param cap Capacity of @p buf in bytes.
+ * @return Number of bytes read or a negative value on failure.
+ */
+ssize_t readFile(const char* path, char* buf, std::size_t cap);
+
+/**
+ * @brief Reads a set of /proc and /sys files in one batch per sample.
+ *
+ * Each registered descriptor gets a buffer allocated once at registration.
+ * readAll() refreshes all of them from offset 0: with io_uring a whole batch
+ * costs a single io_uring_enter(), and otherwise each file costs one pread()
+ * instead of an lseek() plus a read loop. Results are string_views into the
+ * buffers, valid until the next readAll().
+ */
+class ProcReader {
+public:
+    /// Identifies a registered descriptor.
+    using Handle = std::size_t;
+
+    /// How reads are issued.
+    enum class Backend { Pread, IoUring };
+
+    /**
+     * Construct a reader.
+     * @param preferred IoUring falls back to Pread when the kernel refuses it.
+     */
+    explicit ProcReader(Backend preferred = Backend::IoUring);
+
+    /** Release the io_uring instance; registered descriptors are not closed. */
+    ~ProcReader();
+
+    ProcReader(const ProcReader&) = delete;
+    ProcReader& operator=(const ProcReader&) = delete;
+
+    /**
+     * @brief Register a descriptor with a buffer of @p capacity bytes.
+     *
+     * The descriptor stays owned by the caller. Descriptors that cannot seek
+     * (pipes) fail every read with -ESPIPE, as /proc files always seek.
+     * @param fd Descriptor to read, or -1 to reserve a slot for later.
+     * @param capacity Largest number of bytes kept per read.
+     * @return Handle for result(), view(), reset() and remove().
+     */
+    Handle add(int fd, std::size_t capacity);
+
+    /** Point a registered slot at another descriptor, keeping its buffer. */
+    void reset(Handle h, int fd);
+
+    /** Unregister a slot; its handle may be reused by a later add(). */
+    void remove(Handle h);
+
+    /**
+     * @brief Read every registered descriptor from offset 0.
+     * @return Number of descriptors read.
+     */
+    std::size_t readAll();
+
+    /**
+     * @brief Outcome of the last readAll() for a slot.
+     * @return Bytes kept, or a negated errno value (-EBADF without a descriptor).
+     */
+    ssize_t result(Handle h) const { return slots_[h].result; }
+
+    /** Contents from the last readAll(), empty on failure. */
+    std::string_view view(Handle h) const {
+        const Slot& s = slots_[h];
+        return s.result > 0 ? std::string_view(s.buf.get(), static_cast<std::size_t>(s.result))
+                            : std::string_view{};
+    }
+
+    /** Backend in use after any fallback. */
+    Backend backend() const { return ring_ ? Backend::IoUring : Backend::Pread; }
+
+    /** System calls issued by readAll() so far. */
+    std::uint64_t syscalls() const { return syscalls_; }
+
+private:
+    struct Slot {
+        int fd = -1;
+        bool used = false;
+        bool seekable = false;
+        std::size_t cap = 0;
+        std::unique_ptr<char[]> buf;
+        ssize_t result = -EBADF;
+    };
+    struct Ring;
+
+    void check(Slot& s) const;
+    void finish(Slot& s, ssize_t n) const;
+    bool readRing();
+
+    std::unique_ptr<Ring> ring_;
+    std::vector<Slot> slots_;
+    std::vector<Handle> free_;
+    std::vector<Handle> batch_;
+    std::uint64_t syscalls_ = 0;
+};
@@ -0,0 +1,253 @@
+#include "process_scanner.h"
+#include "proc_read.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <dirent.h>
+#include <unistd.h>
+
+namespace {
+
+/// status is the largest file read, typically ~1.5 KiB.
+constexpr std::size_t kProcBufferSize = 4096;
+
+template <typename T>
+bool parseField(std::string_view text, T& out) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+    return std::from_chars(text.data(), text.data() + text.size(), out).ec == std::errc();
+}
+
+long rankValue(const ProcessSample& s, ProcessScanner::SortKey key) {
+    switch (key) {
+    case ProcessScanner::SortKey::Rss: return s.rss_kib;
+    case ProcessScanner::SortKey::Swap: return s.swap_kib;
+    case ProcessScanner::SortKey::Pss: break;
+    }
+    return s.pss_kib.value_or(s.rss_kib);
+}
+
+} // namespace
+
+ProcessScanner::ProcessScanner(std::string procRoot, unsigned workers,
+                               std::chrono::microseconds budget)
+    : procRoot_(std::move(procRoot)), workers_(std::max(workers, 1u)), budget_(budget),
+      pageKib_(std::max(sysconf(_SC_PAGESIZE) / 1024, 1L)) {
+    helpers_.reserve(workers_ - 1);
+    for (unsigned i = 1; i < workers_; ++i)
+        helpers_.emplace_back([this] { helperLoop(); });
+}
+
+ProcessScanner::~ProcessScanner() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : helpers_) t.join();
+}
+
+void ProcessScanner::helperLoop() {
+    std::uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_) return;
+        seen = generation_;
+        lock.unlock();
+        work();
+        lock.lock();
+        if (--busy_ == 0) idle_.notify_one();
+    }
+}
+
+void ProcessScanner::work() {
+    do {
+        std::size_t i = next_.fetch_add(1, std::memory_order_relaxed);
+        if (i >= entries_.size()) break;
+        refresh(entries_[i]);
+        refreshed_.fetch_add(1, std::memory_order_relaxed);
+    } while (std::chrono::steady_clock::now() < deadline_);
+}
+
+bool ProcessScanner::parseStat(std::string_view text, std::string& name,
+                               unsigned long long& startTime, long& rssPages) {
+    // The command name may itself contain spaces and parentheses.
+    auto open = text.find('(');
+    auto close = text.rfind(')');
+    if (open == std::string_view::npos || close == std::string_view::npos || close < open)
+        return false;
+    name.assign(text.data() + open + 1, close - open - 1);
+    // Fields after the name start with the state, field 3 in proc(5).
+    text.remove_prefix(close + 1);
+    int field = 2;
+    bool haveStart = false;
+    while (!text.empty()) {
+        while (!text.empty() && text.front() == ' ') text.remove_prefix(1);
+        auto end = text.find(' ');
+        std::string_view tok = text.substr(0, end);
+        ++field;
+        if (field == 22) haveStart = parseField(tok, startTime);
+        else if (field == 24) return haveStart && parseField(tok, rssPages);
+        if (end == std::string_view::npos) break;
+        text.remove_prefix(end);
+    }
+    return false;
+}
+
+void ProcessScanner::parseMemoryLines(std::string_view text, ProcessSample& out) {
+    while (!text.empty()) {
+        auto eol = text.find('\n');
+        std::string_view line = text.substr(0, eol);
+        auto colon = line.find(':');
+        if (colon != std::string_view::npos) {
+            std::string_view key = line.substr(0, colon);
+            std::string_view value = line.substr(colon + 1);
+            long kib = 0;
+            if (key == "Rss" || key == "VmRSS") {
+                if (parseField(value, kib)) out.rss_kib = kib;
+            } else if (key == "Pss") {
+                if (parseField(value, kib)) out.pss_kib = kib;
+            } else if (key == "Swap" || key == "VmSwap") {
+                if (parseField(value, kib)) out.swap_kib = kib;
+            }
+        }
+        if (eol == std::string_view::npos) break;
+        text.remove_prefix(eol + 1);
+    }
+}
+
+void ProcessScanner::relist() {
+    std::vector<int> pids;
+    pids.reserve(entries_.size());
+    if (DIR* d = opendir(procRoot_.c_str())) {
+        while (dirent* e = readdir(d)) {
+            int pid = 0;
+            const char* end = e->d_name + std::char_traits<char>::length(e->d_name);
+            auto [ptr, ec] = std::from_chars(e->d_name, end, pid);
+            if (ec == std::errc() && ptr == end && pid > 0) pids.push_back(pid);
+        }
+        closedir(d);
+    }
+    std::sort(pids.begin(), pids.end());
+
+    // Both lists are sorted by pid, so cached entries carry over in one pass.
+    std::vector<Entry> next;
+    next.reserve(pids.size());
+    auto it = entries_.begin();
+    for (int pid : pids) {
+        while (it != entries_.end() && it->pid < pid) ++it;
+        if (it != entries_.end() && it->pid == pid) {
+            next.push_back(std::move(*it++));
+        } else {
+            next.emplace_back();
+            next.back().pid = pid;
+        }
+    }
+    entries_ = std::move(next);
+}
+
+void ProcessScanner::refresh(Entry& e) const {
+    char path[256];
+    char buf[kProcBufferSize];
+    auto read = [&](const char* file) {
+        std::snprintf(path, sizeof(path), "%s/%d/%s", procRoot_.c_str(), e.pid, file);
+        ssize_t n = readFile(path, buf, sizeof(buf));
+        return n > 0 ? std::string_view(buf, static_cast<std::size_t>(n)) : std::string_view{};
+    };
+
+    unsigned long long startTime = 0;
+    long rssPages = 0;
+    std::string name;
+    auto stat = read("stat");
+    if (stat.empty() || !parseStat(stat, name, startTime, rssPages)) {
+        e.valid = false; // exited; dropped on the next relist
+        return;
+    }
+    if (e.valid && e.startTime == startTime && e.rssPages == rssPages) return;
+
+    ProcessSample s;
+    s.pid = e.pid;
+    s.name = std::move(name);
+    if (auto rollup = read("smaps_rollup"); !rollup.empty()) {
+        parseMemoryLines(rollup, s);
+    } else if (auto status = read("status"); !status.empty()) {
+        parseMemoryLines(status, s);
+    } else if (auto statm = read("statm"); !statm.empty()) {
+        long resident = 0;
+        auto sp = statm.find(' ');
+        if (sp != std::string_view::npos && parseField(statm.substr(sp + 1), resident))
+            s.rss_kib = resident * pageKib_;
+    } else {
+        s.rss_kib = rssPages * pageKib_;
+    }
+    e.sample = std::move(s);
+    e.startTime = startTime;
+    e.rssPages = rssPages;
+    e.valid = true;
+}
+
+bool ProcessScanner::stillRunning(Entry& e) const {
+    char path[256];
+    char buf[kProcBufferSize];
+    std::snprintf(path, sizeof(path), "%s/%d/stat", procRoot_.c_str(), e.pid);
+    ssize_t n = readFile(path, buf, sizeof(buf));
+    std::string name;
+    unsigned long long startTime = 0;
+    long rssPages = 0;
+    // A different start time means the pid was reused by a new process.
+    e.valid = n > 0 &&
+              parseStat(std::string_view(buf, static_cast<std::size_t>(n)), name, startTime,
+                        rssPages) &&
+              startTime == e.startTime;
+    return e.valid;
+}
+
+std::size_t ProcessScanner::scan(std::vector<ProcessSample>& out, std::size_t count,
+                                 SortKey key) {
+    deadline_ = std::chrono::steady_clock::now() + budget_;
+    if (cursor_ >= entries_.size()) {
+        relist();
+        cursor_ = 0;
+    }
+
+    // Workers claim entries from a shared index; each entry is touched by
+    // exactly one of them, so the cache needs no locking. The mutex orders
+    // the setup above before the helpers start and their writes before
+    // the ranking below.
+    next_.store(cursor_, std::memory_order_relaxed);
+    refreshed_.store(0, std::memory_order_relaxed);
+    if (!helpers_.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+        busy_ = static_cast<unsigned>(helpers_.size());
+    }
+    wake_.notify_all();
+    work();
+    if (!helpers_.empty()) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return busy_ == 0; });
+    }
+    cursor_ = std::min(next_.load(), entries_.size());
+
+    ranked_.clear();
+    for (auto& e : entries_)
+        if (e.valid) ranked_.push_back(&e);
+    // Entries the cursor has not reached for a while may belong to processes
+    // that exited since, such as the one the OOM killer just took, so the
+    // reported ones are confirmed first.
+    std::size_t n = 0;
+    for (;;) {
+        n = std::min(count, ranked_.size());
+        std::partial_sort(ranked_.begin(), ranked_.begin() + n, ranked_.end(),
+                          [key](const Entry* a, const Entry* b) {
+                              return rankValue(a->sample, key) > rankValue(b->sample, key);
+                          });
+        auto gone = std::remove_if(ranked_.begin(), ranked_.begin() + n,
+                                   [this](Entry* e) { return !stillRunning(*e); });
+        if (gone == ranked_.begin() + n) break;
+        ranked_.erase(gone, ranked_.begin() + n);
+    }
+    out.resize(n);
+    for (std::size_t i = 0; i < n; ++i) out[i] = ranked_[i]->sample;
+    return refreshed_.load();
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "system_probe.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Finds the processes using the most memory.
+ *
+ * Per-process numbers come from /proc/<pid>/smaps_rollup, falling back to
+ * status and then statm when it is not readable (other users' processes).
+ * Results are cached per pid and only re-read when the start time or the
+ * resident page count in /proc/<pid>/stat changed, which is far cheaper to
+ * read than smaps_rollup. Each scan() works through the process list on
+ * several threads until its time budget runs out and picks up where it
+ * stopped on the next call, so a single call never walks every process.
+ * The helper threads are started once and wait between scans, since scans
+ * run every tick exactly while memory is short.
+ */
+class ProcessScanner {
+public:
+    /// Measure used to rank processes.
+    enum class SortKey { Rss, Pss, Swap };
+
+    /**
+     * Construct a scanner.
+     * @param procRoot Mount point of procfs.
+     * @param workers Threads reading processes in parallel, at least one.
+     * @param budget Time one scan() may spend refreshing processes.
+     */
+    explicit ProcessScanner(std::string procRoot = "/proc", unsigned workers = 2,
+                            std::chrono::microseconds budget = std::chrono::milliseconds(20));
+    ~ProcessScanner();
+
+    ProcessScanner(const ProcessScanner&) = delete;
+    ProcessScanner& operator=(const ProcessScanner&) = delete;
+
+    /**
+     * @brief Refresh a budgeted slice of processes and report the largest.
+     *
+     * Every worker refreshes at least one process, so repeated calls always
+     * make progress. Processes not reached yet keep their cached values;
+     * those about to be reported are first checked to still be running.
+     * @param out Receives at most @p count processes, largest first. Its
+     *        storage is reused between calls.
+     * @param count Number of processes to report.
+     * @param key Measure to rank by; Pss falls back to RSS where unknown.
+     * @return Number of processes refreshed by this call.
+     */
+    std::size_t scan(std::vector<ProcessSample>& out, std::size_t count,
+                     SortKey key = SortKey::Pss);
+
+    /** Number of processes in the cache. */
+    std::size_t size() const { return entries_.size(); }
+
+    /**
+     * @brief Parse the fields of /proc/<pid>/stat used for caching.
+     * @param text File contents.
+     * @param name Receives the command name.
+     * @param startTime Receives the start time in clock ticks.
+     * @param rssPages Receives the resident set size in pages.
+     * @return False if the contents are malformed.
+     */
+    static bool parseStat(std::string_view text, std::string& name,
+                          unsigned long long& startTime, long& rssPages);
+
+    /**
+     * @brief Parse "Key: value kB" lines of smaps_rollup or status.
+     *
+     * Reads Rss/Pss/Swap as well as VmRSS/VmSwap; absent keys leave the
+     * sample untouched.
+     */
+    static void parseMemoryLines(std::string_view text, ProcessSample& out);
+
+private:
+    struct Entry {
+        int pid = 0;
+        bool valid = false;            ///< Sample holds data of a live process.
+        unsigned long long startTime = 0;
+        long rssPages = -1;
+        ProcessSample sample;
+    };
+
+    void relist();
+    void refresh(Entry& e) const;
+    /// Re-read the stat file of a cached entry; clears valid if it exited.
+    bool stillRunning(Entry& e) const;
+    /// Refresh entries claimed from next_ until the deadline or the end.
+    void work();
+    /// Body of each helper thread: run work() once per scan().
+    void helperLoop();
+
+    std::string procRoot_;
+    unsigned workers_;
+    std::chrono::microseconds budget_;
+    long pageKib_;
+    std::vector<Entry> entries_; ///< Sorted by pid.
+    std::size_t cursor_ = 0;     ///< Next entry to refresh.
+    std::vector<Entry*> ranked_;
+
+    // The scan in progress, shared with the helpers.
+    std::chrono::steady_clock::time_point deadline_;
+    std::atomic<std::size_t> next_{0};
+    std::atomic<std::size_t> refreshed_{0};
+
+    std::mutex mutex_;
+    std::condition_variable wake_;   ///< A scan started, or stop_ was set.
+    std::condition_variable idle_;   ///< The last helper finished its part.
+    std::uint64_t generation_ = 0;   ///< Scans started so far.
+    unsigned busy_ = 0;              ///< Helpers still working on this scan.
+    bool stop_ = false;
+    std::vector<std::thread> helpers_; ///< workers_ - 1 threads.
+};
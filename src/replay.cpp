@@ -0,0 +1,227 @@
+#include "replay.h"
+#include "forecast.h"
+#include "system_probe.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <utility>
+
+namespace {
+/// Section names of the text format and the frame members they fill.
+const std::pair<const char *, std::string TraceFrame::*> kSections[] = {
+    {"meminfo", &TraceFrame::meminfo}, {"memory", &TraceFrame::memory},
+    {"cpu", &TraceFrame::cpu},         {"io", &TraceFrame::io},
+    {"irq", &TraceFrame::irq},         {"vmstat", &TraceFrame::vmstat}};
+
+bool parseTime(const std::string &text, std::int64_t &out) {
+  std::istringstream in(text);
+  return static_cast<bool>(in >> out) && (in >> std::ws).eof();
+}
+
+void writeFile(const std::filesystem::path &path, const std::string &text) {
+  // Truncating in place keeps the inode the probe holds open.
+  std::ofstream out(path, std::ios::trunc);
+  out << text;
+}
+} // namespace
+
+std::optional<Trace> Trace::parse(std::istream &in, std::string *error) {
+  Trace trace;
+  std::string *section = nullptr;
+  std::string line;
+  std::size_t lineNo = 0;
+  auto fail = [&](const char *what) -> std::optional<Trace> {
+    if (error)
+      *error = "line " + std::to_string(lineNo) + ": " + what;
+    return std::nullopt;
+  };
+  while (std::getline(in, line)) {
+    ++lineNo;
+    if (line.rfind("@ ", 0) == 0) {
+      TraceFrame frame;
+      if (!parseTime(line.substr(2), frame.time_ms))
+        return fail("bad frame time");
+      if (!trace.frames.empty() && frame.time_ms < trace.frames.back().time_ms)
+        return fail("frames out of order");
+      trace.frames.push_back(std::move(frame));
+      section = nullptr;
+    } else if (line.rfind("! ", 0) == 0) {
+      std::istringstream ls(line.substr(2));
+      TraceEvent event;
+      if (!(ls >> event.time_ms))
+        return fail("bad event time");
+      std::getline(ls >> std::ws, event.label);
+      trace.events.push_back(std::move(event));
+      section = nullptr;
+    } else if (line.rfind("== ", 0) == 0) {
+      if (trace.frames.empty())
+        return fail("section before the first frame");
+      const std::string name = line.substr(3);
+      section = nullptr;
+      for (const auto &[sectionName, member] : kSections) {
+        if (name == sectionName)
+          section = &(trace.frames.back().*member);
+      }
+      if (!section)
+        return fail("unknown section");
+    } else if (section) {
+      *section += line;
+      *section += '\n';
+    } else if (!line.empty() && line[0] != '#') {
+      return fail("text outside a section");
+    }
+  }
+  std::sort(trace.events.begin(), trace.events.end(),
+            [](const TraceEvent &a, const TraceEvent &b) {
+              return a.time_ms < b.time_ms;
+            });
+  return trace;
+}
+
+void Trace::writeFrame(std::ostream &out, const TraceFrame &frame) {
+  out << "@ " << frame.time_ms << '\n';
+  for (const auto &[name, member] : kSections) {
+    const std::string &text = frame.*member;
+    if (text.empty())
+      continue;
+    out << "== " << name << '\n' << text;
+    if (text.back() != '\n')
+      out << '\n';
+  }
+}
+
+Replayer::Replayer(const AppConfig &cfg, std::string workDir, Options options)
+    : cfg_(cfg), workDir_(std::move(workDir)), options_(options) {}
+
+ReplayReport Replayer::run(const Trace &trace) const {
+  namespace fs = std::filesystem;
+  ReplayReport report;
+  const fs::path dir(workDir_);
+  const fs::path pressure = dir / "pressure";
+  fs::create_directories(pressure);
+  const fs::path meminfo = dir / "meminfo";
+  // Every file the trace records must exist before the probe opens them.
+  const std::pair<std::string TraceFrame::*, fs::path> files[] = {
+      {&TraceFrame::meminfo, meminfo},
+      {&TraceFrame::memory, pressure / "memory"},
+      {&TraceFrame::cpu, pressure / "cpu"},
+      {&TraceFrame::io, pressure / "io"},
+      {&TraceFrame::irq, pressure / "irq"}};
+  for (const auto &[member, path] : files) {
+    fs::remove(path);
+    const bool recorded = std::any_of(
+        trace.frames.begin(), trace.frames.end(),
+        [member = member](const TraceFrame &f) { return !(f.*member).empty(); });
+    if (recorded)
+      writeFile(path, {});
+  }
+  fs::remove(dir / "vmstat");
+  const SystemProbe probe(meminfo.string(), (pressure / "memory").string());
+
+  PressureState state = PressureState::Green;
+  std::optional<double> prevSomeAvg10;
+  ExhaustionForecast forecast;
+  std::optional<std::int64_t> prevMs;
+  std::optional<VmstatCounters> prevVmstat;
+  std::int64_t prevVmstatMs = 0;
+  // When each state was last left, for flap counting.
+  std::array<std::optional<std::int64_t>, 4> leftAt{};
+  // Entries into the detect level or above, for detection latency.
+  std::vector<std::pair<std::int64_t, std::optional<std::int64_t>>> episodes;
+
+  for (const TraceFrame &frame : trace.frames) {
+    for (const auto &[member, path] : files) {
+      if (!(frame.*member).empty())
+        writeFile(path, frame.*member);
+    }
+    auto sample = probe.sample();
+    const double elapsedSec = prevMs ? (frame.time_ms - *prevMs) / 1000.0 : 0.0;
+    if (prevMs)
+      report.seconds_in_state[static_cast<std::size_t>(state)] += elapsedSec;
+    prevMs = frame.time_ms;
+    ++report.frames;
+    if (!sample) {
+      ++report.failed_frames;
+      forecast.reset();
+      continue;
+    }
+    if (!frame.vmstat.empty()) {
+      VmstatCounters counters;
+      parseVmstat(frame.vmstat, counters);
+      if (prevVmstat && frame.time_ms > prevVmstatMs)
+        sample->vmstat = vmstatRates(*prevVmstat, counters,
+                                     (frame.time_ms - prevVmstatMs) / 1000.0);
+      prevVmstat = counters;
+      prevVmstatMs = frame.time_ms;
+    }
+
+    if (cfg_.forecast.horizon_sec > 0.0)
+      sample->seconds_to_critical = forecast.update(*sample, cfg_, elapsedSec);
+    const PressureState next =
+        decidePressure(*sample, cfg_, state, prevSomeAvg10, elapsedSec);
+    prevSomeAvg10 = sample->some.avg10;
+    if (next == state)
+      continue;
+    report.transitions.push_back({frame.time_ms, state, next});
+    const auto &returnedFrom = leftAt[static_cast<std::size_t>(next)];
+    if (returnedFrom &&
+        frame.time_ms - *returnedFrom <= options_.flap_window_sec * 1000.0)
+      ++report.flaps;
+    leftAt[static_cast<std::size_t>(state)] = frame.time_ms;
+    if (next >= options_.detect && state < options_.detect)
+      episodes.push_back({frame.time_ms, std::nullopt});
+    else if (next < options_.detect && state >= options_.detect)
+      episodes.back().second = frame.time_ms;
+    state = next;
+  }
+
+  for (const TraceEvent &event : trace.events) {
+    ReplayReport::Detection d{event, std::nullopt};
+    for (const auto &[entered, left] : episodes) {
+      if (left && *left <= event.time_ms)
+        continue;
+      // First episode still running at the event or starting after it.
+      d.latency_sec = (entered - event.time_ms) / 1000.0;
+      break;
+    }
+    report.detections.push_back(std::move(d));
+  }
+  return report;
+}
+
+std::string ReplayReport::format(std::int64_t startMs) const {
+  std::string out;
+  char buf[160];
+  auto line = [&](const char *fmt, auto... args) {
+    std::snprintf(buf, sizeof(buf), fmt, args...);
+    out += buf;
+  };
+  line("frames: %zu (%zu unreadable)\n", frames, failed_frames);
+  line("transitions: %zu, flaps: %zu\n", transitions.size(), flaps);
+  for (const auto &t : transitions)
+    line("  +%.1fs %s -> %s\n", (t.time_ms - startMs) / 1000.0,
+         pressureStateName(t.from), pressureStateName(t.to));
+  out += "time in state:\n";
+  double total = 0.0;
+  for (double s : seconds_in_state)
+    total += s;
+  for (std::size_t i = 0; i < seconds_in_state.size(); ++i)
+    line("  %-6s %10.1fs %5.1f%%\n",
+         pressureStateName(static_cast<PressureState>(i)), seconds_in_state[i],
+         total > 0.0 ? 100.0 * seconds_in_state[i] / total : 0.0);
+  if (!detections.empty())
+    out += "events:\n";
+  for (const auto &d : detections) {
+    line("  +%.1fs ", (d.event.time_ms - startMs) / 1000.0);
+    out += d.event.label.empty() ? "(unlabelled)" : d.event.label;
+    if (d.latency_sec)
+      line(": detected %+.1fs\n", *d.latency_sec);
+    else
+      out += ": missed\n";
+  }
+  return out;
+}
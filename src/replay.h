@@ -0,0 +1,112 @@
+#pragma once
+#include "config.h"
+#include "pressure_state.h"
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One recorded snapshot of the /proc sources.
+ *
+ * Sources left empty were not recorded and keep their previous contents.
+ */
+struct TraceFrame {
+  std::int64_t time_ms = 0; ///< When the snapshot was taken.
+  std::string meminfo;      ///< /proc/meminfo.
+  std::string memory;       ///< /proc/pressure/memory.
+  std::string cpu;          ///< /proc/pressure/cpu.
+  std::string io;           ///< /proc/pressure/io.
+  std::string irq;          ///< /proc/pressure/irq.
+  std::string vmstat;       ///< /proc/vmstat.
+};
+
+/** A moment marked in a trace, such as an OOM kill or a frozen desktop. */
+struct TraceEvent {
+  std::int64_t time_ms = 0;
+  std::string label;
+};
+
+/**
+ * @brief Recorded snapshots and marked events.
+ *
+ * Text format: a frame starts with `@ <time_ms>`, followed by sections
+ * `== meminfo`, `== memory`, `== cpu`, `== io`, `== irq` or `== vmstat`, each
+ * holding the file contents verbatim. `! <time_ms> <label>` marks an event;
+ * lines starting with `#` outside a section are comments.
+ */
+struct Trace {
+  std::vector<TraceFrame> frames;
+  std::vector<TraceEvent> events;
+
+  /**
+   * @brief Parse a trace.
+   * @param error Receives a message with the line number on failure.
+   * @return The trace, or std::nullopt if malformed.
+   */
+  static std::optional<Trace> parse(std::istream &in,
+                                    std::string *error = nullptr);
+
+  /** Write one frame in the text format. */
+  static void writeFrame(std::ostream &out, const TraceFrame &frame);
+};
+
+/** Outcome of replaying a trace. */
+struct ReplayReport {
+  struct Transition {
+    std::int64_t time_ms;
+    PressureState from;
+    PressureState to;
+  };
+  struct Detection {
+    TraceEvent event;
+    /// Seconds from the event to reaching the detect level; negative when
+    /// the level was already reached beforehand, empty if never reached.
+    std::optional<double> latency_sec;
+  };
+
+  std::size_t frames = 0;        ///< Frames decided.
+  std::size_t failed_frames = 0; ///< Frames the probe could not read.
+  std::vector<Transition> transitions;
+  std::array<double, 4> seconds_in_state{}; ///< Indexed by PressureState.
+  std::size_t flaps = 0; ///< Returns to a state left within the flap window.
+  std::vector<Detection> detections;
+
+  /** Human-readable summary. */
+  std::string format(std::int64_t startMs) const;
+};
+
+/**
+ * @brief Runs recorded /proc snapshots through SystemProbe and decidePressure.
+ *
+ * Each frame is written into fake /proc files in a work directory and read
+ * back through a SystemProbe, exactly as in the probe's tests. Time comes from
+ * the frame timestamps rather than a clock, so a week of samples replays as
+ * fast as the files can be rewritten. vmstat rates are computed from the
+ * recorded counters over the recorded time, since the probe would measure
+ * them against the real clock.
+ */
+class Replayer {
+public:
+  /** Report tuning. */
+  struct Options {
+    double flap_window_sec = 30.0; ///< Reverting sooner counts as a flap.
+    PressureState detect = PressureState::Orange; ///< Level events expect.
+  };
+
+  /**
+   * @param cfg Thresholds to evaluate.
+   * @param workDir Existing directory for the fake /proc files.
+   */
+  Replayer(const AppConfig &cfg, std::string workDir, Options options);
+
+  /** Replay @p trace from a Green start. */
+  ReplayReport run(const Trace &trace) const;
+
+private:
+  AppConfig cfg_;
+  std::string workDir_;
+  Options options_;
+};
@@ -0,0 +1,129 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include "config.h"
+#include "replay.h"
+
+namespace {
+std::string slurp(const char* path) {
+    std::ifstream in(path);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// Append live /proc snapshots to a trace until count frames are written.
+int record(const std::string& path, int intervalMs, long count) {
+    std::ofstream out(path, std::ios::app);
+    if (!out) {
+        std::cerr << "cannot write " << path << "\n";
+        return 1;
+    }
+    out << "# nohang-tr trace\n";
+    for (long i = 0; count <= 0 || i < count; ++i) {
+        TraceFrame frame;
+        frame.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+        frame.meminfo = slurp("/proc/meminfo");
+        frame.memory = slurp("/proc/pressure/memory");
+        frame.cpu = slurp("/proc/pressure/cpu");
+        frame.io = slurp("/proc/pressure/io");
+        frame.irq = slurp("/proc/pressure/irq");
+        frame.vmstat = slurp("/proc/vmstat");
+        Trace::writeFrame(out, frame);
+        out.flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+    return 0;
+}
+
+std::optional<PressureState> parseState(const QString& name) {
+    for (auto s : {PressureState::Green, PressureState::Yellow, PressureState::Orange,
+                   PressureState::Red}) {
+        if (name == pressureStateName(s))
+            return s;
+    }
+    return std::nullopt;
+}
+} // namespace
+
+// Replays a recorded trace through the decision logic with the thresholds of
+// a configuration file, or records a trace from the live system.
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replay recorded /proc snapshots through nohang-tr's decisions.");
+    QCommandLineOption configOpt({"c", "config"}, "Path to configuration file", "path");
+    QCommandLineOption flapOpt("flap-window", "Seconds within which a return to a state counts as a flap", "sec", "30");
+    QCommandLineOption detectOpt("detect", "State marked events are expected to reach", "state", "orange");
+    QCommandLineOption recordOpt("record", "Record live snapshots into a trace instead", "trace");
+    QCommandLineOption intervalOpt("interval-ms", "Recording interval", "ms", "1000");
+    QCommandLineOption countOpt("count", "Frames to record, 0 for no limit", "n", "0");
+    for (const auto* opt : {&configOpt, &flapOpt, &detectOpt, &recordOpt, &intervalOpt, &countOpt})
+        parser.addOption(*opt);
+    parser.addPositionalArgument("trace", "Trace to replay");
+    parser.addHelpOption();
+    parser.process(app);
+
+    if (parser.isSet(recordOpt))
+        return record(parser.value(recordOpt).toStdString(),
+                      std::max(parser.value(intervalOpt).toInt(), 1),
+                      parser.value(countOpt).toLong());
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 1)
+        parser.showHelp(1);
+    std::ifstream in(args.front().toStdString());
+    if (!in) {
+        std::cerr << "cannot read " << args.front().toStdString() << "\n";
+        return 1;
+    }
+    std::string error;
+    auto trace = Trace::parse(in, &error);
+    if (!trace) {
+        std::cerr << args.front().toStdString() << ": " << error << "\n";
+        return 1;
+    }
+
+    AppConfig cfg;
+    QString configPath = resolveConfigPath(parser.value(configOpt));
+    if (!configPath.isEmpty())
+        cfg.load(configPath);
+    Replayer::Options options;
+    options.flap_window_sec = parser.value(flapOpt).toDouble();
+    auto detect = parseState(parser.value(detectOpt));
+    if (!detect) {
+        std::cerr << "unknown state " << parser.value(detectOpt).toStdString() << "\n";
+        return 1;
+    }
+    options.detect = *detect;
+
+    // Fake /proc files go to memory-backed storage where available.
+    std::filesystem::path base = std::filesystem::exists("/dev/shm")
+                                     ? std::filesystem::path("/dev/shm")
+                                     : std::filesystem::temp_directory_path();
+    std::string workDir = (base / "nohang-tr-replay-XXXXXX").string();
+    if (!mkdtemp(workDir.data())) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    const auto started = std::chrono::steady_clock::now();
+    const ReplayReport report = Replayer(cfg, workDir, options).run(*trace);
+    const double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::filesystem::remove_all(workDir);
+
+    const std::int64_t start = trace->frames.empty() ? 0 : trace->frames.front().time_ms;
+    std::cout << report.format(start);
+    std::cout << "replayed in " << took << "s\n";
+    return 0;
+}
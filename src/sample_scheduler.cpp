@@ -0,0 +1,47 @@
+#include "sample_scheduler.h"
+#include <algorithm>
+
+namespace {
+// Ignore avg10 jitter from rounding in /proc/pressure output.
+constexpr double kSlopeNoise = 0.005;
+} // namespace
+
+SampleScheduler::SampleScheduler(const AppConfig &cfg)
+    : cfg_(cfg), interval_(cfg.sample_interval_ms) {}
+
+bool SampleScheduler::farFromThresholds(const ProbeSample &s,
+                                        const AppConfig &cfg) {
+  if (s.mem_available_kib &&
+      *s.mem_available_kib < 2 * cfg.mem.available_warn_exit_kib)
+    return false;
+  if (s.swap_free_kib && *s.swap_free_kib < 2 * cfg.swap.free_warn_exit_kib)
+    return false;
+  return s.some.avg10 <= cfg.psi.avg10_warn_exit / 2.0;
+}
+
+int SampleScheduler::next(const ProbeSample &s, bool elevated,
+                          double psiSlope) {
+  const int lo = std::max(1, cfg_.sample.min_interval_ms);
+  const int hi = std::max(lo, cfg_.sample.max_interval_ms);
+  const int base = std::clamp(cfg_.sample_interval_ms, lo, hi);
+  const double ramp = std::max(1.0, cfg_.sample.ramp);
+
+  if (elevated) {
+    calmTicks_ = 0;
+    interval_ = lo;
+  } else if (psiSlope > kSlopeNoise) {
+    calmTicks_ = 0;
+    interval_ = std::max(lo, static_cast<int>(interval_ / ramp));
+  } else if (farFromThresholds(s, cfg_)) {
+    if (++calmTicks_ >= cfg_.sample.calm_ticks)
+      interval_ = std::min(hi, static_cast<int>(interval_ * ramp + 0.5));
+  } else {
+    calmTicks_ = 0;
+    // Green but close to a threshold: settle back on the base interval.
+    interval_ = interval_ < base
+                    ? std::min(base, static_cast<int>(interval_ * ramp + 0.5))
+                    : base;
+  }
+  interval_ = std::clamp(interval_, lo, hi);
+  return interval_;
+}
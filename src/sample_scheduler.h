@@ -0,0 +1,49 @@
+#pragma once
+#include "config.h"
+#include "system_probe.h"
+
+/**
+ * @brief Chooses the delay until the next sample.
+ *
+ * The interval stretches towards `max_interval_ms` while readings stay calm
+ * and far from their thresholds, and drops to `min_interval_ms` as soon as
+ * pressure shows up so the tray gets fine resolution when memory runs low.
+ */
+class SampleScheduler {
+public:
+  /** Start at the configured base interval. */
+  explicit SampleScheduler(const AppConfig &cfg);
+
+  /**
+   * @brief Compute the next interval from the latest reading.
+   * @param s Most recent probe sample.
+   * @param elevated True when the decided state is above Green.
+   * @param psiSlope Rate of change of PSI some avg10 per second.
+   * @return Delay until the next sample in milliseconds.
+   */
+  int next(const ProbeSample &s, bool elevated, double psiSlope);
+
+  /**
+   * @brief Adopt new bounds and thresholds.
+   *
+   * The current interval is kept; the next call to next() brings it within
+   * the new bounds.
+   */
+  void reconfigure(const AppConfig &cfg) { cfg_ = cfg; }
+
+  /** Current interval in milliseconds. */
+  int interval() const { return interval_; }
+
+  /**
+   * @brief Whether every reading sits well clear of its thresholds.
+   *
+   * "Well clear" means at least twice the exit margin for memory and swap
+   * and at most half the exit level for PSI some avg10.
+   */
+  static bool farFromThresholds(const ProbeSample &s, const AppConfig &cfg);
+
+private:
+  AppConfig cfg_;
+  int interval_;
+  int calmTicks_ = 0;
+};
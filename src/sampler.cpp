@@ -0,0 +1,328 @@
+#include "sampler.h"
+#include "policy.h"
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <limits>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+ProcessScanner::SortKey sortKey(const QString &name) {
+  if (name == "rss")
+    return ProcessScanner::SortKey::Rss;
+  if (name == "swap")
+    return ProcessScanner::SortKey::Swap;
+  return ProcessScanner::SortKey::Pss;
+}
+
+bool sameTrigger(const std::optional<AppConfig::Psi::Trigger> &a,
+                 const std::optional<AppConfig::Psi::Trigger> &b) {
+  if (a.has_value() != b.has_value())
+    return false;
+  return !a || (a->stall_us == b->stall_us && a->window_us == b->window_us);
+}
+
+bool sameTriggers(const AppConfig::Psi &a, const AppConfig::Psi &b) {
+  const std::pair<const AppConfig::Psi::Triggers &,
+                  const AppConfig::Psi::Triggers &>
+      pairs[] = {{a.trigger, b.trigger},
+                 {a.cpu.trigger, b.cpu.trigger},
+                 {a.io.trigger, b.io.trigger},
+                 {a.irq.trigger, b.irq.trigger}};
+  for (const auto &[x, y] : pairs)
+    if (!sameTrigger(x.some, y.some) || !sameTrigger(x.full, y.full))
+      return false;
+  return true;
+}
+} // namespace
+
+Sampler::Sampler(std::unique_ptr<SystemProbe> probe, const AppConfig &cfg)
+    : probe_(std::move(probe)), cfg_(cfg), scheduler_(cfg),
+      interval_(scheduler_.interval()) {
+  if (cfg_.cgroup.enabled) {
+    cgroups_ = std::make_unique<CgroupMonitor>(cfg_.cgroup.root.toStdString(),
+                                               cfg_.cgroup.max_depth);
+    cgroups_->rescan();
+    auto cgroupTriggers = triggers(cfg_.cgroup.trigger);
+    if (!cgroupTriggers.empty())
+      cgroups_->enableTriggers(cgroupTriggers);
+  }
+  if (cfg_.history.enabled) {
+    history_ = std::make_unique<History>(
+        cfg_.history.path.isEmpty() ? History::defaultPath()
+                                    : cfg_.history.path.toStdString(),
+        static_cast<std::size_t>(cfg_.history.capacity));
+    if (!history_->isOpen())
+      history_.reset();
+    else if (auto last = history_->last())
+      restore(*last);
+  }
+  // Chunks are written hourly; the History ring holds the unflushed tail
+  // and hands it over after a crash, so the archive needs it.
+  if (cfg_.history.archive && !history_) {
+    std::cerr << "Archive unavailable: it needs the history ring "
+                 "([history] enabled = true)\n";
+  } else if (cfg_.history.archive) {
+    const std::string path = cfg_.history.archive_path.isEmpty()
+                                 ? TimeSeries::defaultPath()
+                                 : cfg_.history.archive_path.toStdString();
+    archive_ = std::make_unique<TimeSeries>(path);
+    if (!archive_->isOpen()) {
+      std::cerr << "Archive unavailable: cannot open " << path
+                << " as a nohang-tr archive\n";
+      archive_.reset();
+    } else {
+      catchUpArchive();
+    }
+  }
+  if (!cfg_.metrics.listen.isEmpty()) {
+    metrics_ = std::make_unique<MetricsExporter>(cfg_);
+    const std::string listen = cfg_.metrics.listen.toStdString();
+    if (!metrics_->listen(listen)) {
+      std::cerr << "Metrics unavailable: cannot listen on " << listen << "\n";
+      metrics_.reset();
+    }
+  }
+  if (cfg_.process.enabled) {
+    processes_ = std::make_unique<ProcessScanner>(
+        "/proc", static_cast<unsigned>(std::max(cfg_.process.workers, 1)),
+        std::chrono::milliseconds(cfg_.process.budget_ms));
+    processSort_ = sortKey(cfg_.process.sort);
+  }
+}
+
+Sampler::~Sampler() { stop(); }
+
+void Sampler::restore(const HistoryRecord &rec) {
+  const auto age = std::chrono::system_clock::now() - rec.time();
+  if (age < std::chrono::seconds(0) || age > kRestoreMaxAge)
+    return;
+  // Resume hysteresis and the PSI derivative as if the restart had been one
+  // long sampling gap.
+  state_ = rec.pressureState();
+  prevSomeAvg10_ = rec.some.avg10;
+  lastSample_ = std::chrono::steady_clock::now() -
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(age);
+}
+
+void Sampler::catchUpArchive() {
+  // Records newer than the last written chunk were pending when the
+  // previous run ended without its destructor, e.g. killed by the OOM
+  // killer.
+  const auto &chunks = archive_->chunks();
+  const std::int64_t archived = chunks.empty()
+                                    ? std::numeric_limits<std::int64_t>::min()
+                                    : chunks.back().max_ms;
+  for (std::size_t i = 0, n = history_->size(); i < n; ++i) {
+    const auto rec = history_->at(i);
+    if (rec && rec->time_ms > archived)
+      archive_->append(*rec);
+  }
+}
+
+void Sampler::setProfiler(TickProfiler *profiler) {
+  profiler_ = profiler;
+  probe_->setProfiler(profiler);
+}
+
+void Sampler::reconfigure(const AppConfig &cfg) {
+  std::atomic_store(&pendingCfg_, std::make_shared<const AppConfig>(cfg));
+}
+
+void Sampler::apply(const AppConfig &cfg) {
+  const bool retrigger = triggersEnabled_ && !sameTriggers(cfg_.psi, cfg.psi);
+  cfg_ = cfg;
+  scheduler_.reconfigure(cfg_);
+  processSort_ = sortKey(cfg_.process.sort);
+  if (metrics_)
+    metrics_->setThresholds(cfg_);
+  if (retrigger) {
+    probe_->disableTriggers();
+    enableTriggers();
+    triggersChanged_ = true;
+  }
+}
+
+void Sampler::enableTriggers() {
+  triggersEnabled_ = true;
+  using Resource = SystemProbe::PsiResource;
+  const std::pair<Resource, const AppConfig::Psi::Triggers &> configured[] = {
+      {Resource::Memory, cfg_.psi.trigger},
+      {Resource::Cpu, cfg_.psi.cpu.trigger},
+      {Resource::Io, cfg_.psi.io.trigger},
+      {Resource::Irq, cfg_.psi.irq.trigger}};
+  for (const auto &[resource, cfgTriggers] : configured) {
+    auto list = triggers(cfgTriggers);
+    if (!list.empty())
+      probe_->enableTriggers(resource, list);
+  }
+}
+
+std::vector<SystemProbe::Trigger>
+Sampler::triggers(const AppConfig::Psi::Triggers &cfg) {
+  std::vector<SystemProbe::Trigger> out;
+  if (cfg.some)
+    out.push_back(
+        {SystemProbe::PsiType::Some, cfg.some->stall_us, cfg.some->window_us});
+  if (cfg.full)
+    out.push_back(
+        {SystemProbe::PsiType::Full, cfg.full->stall_us, cfg.full->window_us});
+  return out;
+}
+
+void Sampler::start(std::function<void()> onPublish) {
+  if (running())
+    return;
+  if (wakeFd_ < 0)
+    wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  onPublish_ = std::move(onPublish);
+  stop_.store(false);
+  thread_ = std::thread(&Sampler::run, this);
+}
+
+void Sampler::stop() {
+  if (running()) {
+    stop_.store(true);
+    const std::uint64_t one = 1;
+    if (write(wakeFd_, &one, sizeof(one)) < 0) {
+      // The thread still notices stop_ after its current sleep.
+    }
+    thread_.join();
+  }
+  onPublish_ = nullptr;
+  if (wakeFd_ >= 0) {
+    close(wakeFd_);
+    wakeFd_ = -1;
+  }
+}
+
+void Sampler::run() {
+  std::vector<pollfd> fds;
+  auto watch = [&] {
+    fds.clear();
+    fds.push_back({wakeFd_, POLLIN, 0});
+    for (int fd : probe_->triggerFds())
+      fds.push_back({fd, POLLPRI, 0});
+    // Cgroups found by later rescans join the epoll set, not this array.
+    if (cgroups_ && cgroups_->eventFd() >= 0)
+      fds.push_back({cgroups_->eventFd(), POLLIN, 0});
+  };
+  watch();
+  while (!stop_.load()) {
+    if (poll(fds.data(), fds.size(), interval()) < 0 && errno != EINTR)
+      std::this_thread::sleep_for(std::chrono::milliseconds(interval()));
+    if (stop_.load())
+      break;
+    tick();
+    if (triggersChanged_) {
+      triggersChanged_ = false;
+      watch();
+    }
+  }
+}
+
+void Sampler::tick() {
+  if (auto next = std::atomic_exchange(&pendingCfg_,
+                                       std::shared_ptr<const AppConfig>()))
+    apply(*next);
+  const auto now = std::chrono::steady_clock::now();
+  Snapshot snap;
+  snap.time = std::chrono::system_clock::now();
+  snap.sample = probe_->sample();
+  if (snap.sample && cgroups_) {
+    cgroups_->drainEvents();
+    if (++ticksSinceRescan_ >= cfg_.cgroup.rescan_ticks) {
+      ticksSinceRescan_ = 0;
+      cgroups_->rescan();
+    }
+    cgroups_->sample(snap.sample->cgroups,
+                     static_cast<std::size_t>(std::max(cfg_.cgroup.top_n, 0)));
+  }
+  if (snap.sample) {
+    const double elapsedSec =
+        lastSample_ ? std::chrono::duration<double>(now - *lastSample_).count()
+                    : 0.0;
+    lastSample_ = now;
+    const std::uint64_t decideStart = profiler_ ? TickProfiler::now() : 0;
+    if (cfg_.forecast.horizon_sec > 0.0)
+      snap.sample->seconds_to_critical =
+          forecast_.update(*snap.sample, cfg_, elapsedSec);
+    const ProbeSample &s = *snap.sample;
+    state_ = decidePressure(s, cfg_, state_, prevSomeAvg10_, elapsedSec);
+    if (profiler_)
+      profiler_->finish(TickProfiler::Phase::Decide, decideStart);
+    // Same rate the rules see, so a trigger wakeup shortly after a tick
+    // does not inflate it.
+    const double slope =
+        prevSomeAvg10_
+            ? someAvg10Rate({s, cfg_, prevSomeAvg10_, elapsedSec})
+            : 0.0;
+    interval_.store(scheduler_.next(s, state_ != PressureState::Green, slope),
+                    std::memory_order_relaxed);
+    prevSomeAvg10_ = s.some.avg10;
+    if (history_ || archive_) {
+      const auto rec = HistoryRecord::from(s, state_, snap.time);
+      if (history_)
+        history_->append(rec);
+      if (archive_)
+        archive_->append(rec);
+    }
+    if (processes_ && state_ >= PressureState::Orange)
+      processes_->scan(snap.sample->processes,
+                       static_cast<std::size_t>(std::max(cfg_.process.top_n, 0)),
+                       processSort_);
+  } else {
+    forecast_.reset();
+  }
+  snap.state = state_;
+  snap.interval_ms = interval();
+  if (metrics_)
+    metrics_->update(snap.sample, state_, std::chrono::steady_clock::now() - now,
+                     snap.interval_ms, dropped());
+  publish(snap);
+}
+
+void Sampler::publish(const Snapshot &snap) {
+  if (hasOverflow_.load(std::memory_order_acquire) || !ring_.push(snap)) {
+    std::lock_guard<std::mutex> lock(overflowMutex_);
+    // A pending overflow goes first, so the ring stays in order.
+    if (hasOverflow_.load(std::memory_order_relaxed) && ring_.push(overflow_))
+      hasOverflow_.store(false, std::memory_order_relaxed);
+    if (hasOverflow_.load(std::memory_order_relaxed)) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      overflow_ = snap;
+    } else if (!ring_.push(snap)) {
+      overflow_ = snap;
+      hasOverflow_.store(true, std::memory_order_release);
+    }
+  }
+  // Coalesce wakeups: one notification until the consumer drains.
+  if (onPublish_ && !notifyPending_.exchange(true, std::memory_order_acq_rel))
+    onPublish_();
+}
+
+std::size_t Sampler::drain(Snapshot &latest) {
+  // Re-arm before popping so a snapshot pushed meanwhile still notifies.
+  notifyPending_.store(false, std::memory_order_release);
+  std::size_t n = 0;
+  while (ring_.pop(latest))
+    ++n;
+  if (takeOverflow(latest))
+    ++n;
+  return n;
+}
+
+bool Sampler::takeOverflow(Snapshot &out) {
+  if (!hasOverflow_.load(std::memory_order_acquire))
+    return false;
+  std::lock_guard<std::mutex> lock(overflowMutex_);
+  if (!hasOverflow_.load(std::memory_order_relaxed))
+    return false;
+  std::swap(out, overflow_);
+  hasOverflow_.store(false, std::memory_order_relaxed);
+  return true;
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include "cgroup_monitor.h"
+#include "config.h"
+#include "forecast.h"
+#include "history.h"
+#include "metrics_exporter.h"
+#include "pressure_state.h"
+#include "process_scanner.h"
+#include "sample_scheduler.h"
+#include "spsc_ring.h"
+#include "system_probe.h"
+#include "timeseries.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Samples memory pressure on a dedicated thread.
+ *
+ * Sampler owns the SystemProbe, decides the pressure state and publishes
+ * every result into a lock-free ring, so sampling keeps its cadence no
+ * matter how slowly the consumer (the GUI thread) drains it. A consumer a
+ * full ring behind loses the snapshots after the ring, but still receives
+ * the newest one. Between
+ * samples the thread sleeps for the adaptive interval and wakes early when
+ * a PSI trigger fires. When enabled in the configuration, the cgroup v2
+ * hierarchy is monitored too and its worst cgroups ride along with each
+ * sample, as do the largest processes while the state is Orange or Red.
+ * With history enabled, every sample is also appended to a memory-mapped
+ * History, from which the state and PSI baseline are restored on start,
+ * and optionally archived in a compressed TimeSeries for the long term;
+ * records a killed run never wrote out are handed over on the next start.
+ * A configured metrics endpoint is fed every result as it is decided.
+ * A new configuration can be swapped in while sampling runs.
+ */
+class Sampler {
+public:
+  /** One published sampling result. */
+  struct Snapshot {
+    std::optional<ProbeSample> sample; ///< Reading, empty if the probe failed.
+    PressureState state = PressureState::Green; ///< Decided state.
+    int interval_ms = 0; ///< Delay before the following sample.
+    /// Wall-clock time the sample was taken, on the sampling thread.
+    std::chrono::system_clock::time_point time;
+  };
+
+  /**
+   * @brief Construct a stopped sampler.
+   * @param probe Probe to sample; owned by the sampler.
+   * @param cfg Thresholds used for decisions and scheduling.
+   */
+  Sampler(std::unique_ptr<SystemProbe> probe, const AppConfig &cfg);
+
+  /** Stops the sampling thread if it is running. */
+  ~Sampler();
+
+  Sampler(const Sampler &) = delete;
+  Sampler &operator=(const Sampler &) = delete;
+
+  /**
+   * @brief Start the sampling thread.
+   * @param onPublish Invoked on the sampling thread when a snapshot is
+   *        published while the consumer has no wakeup pending.
+   */
+  void start(std::function<void()> onPublish = {});
+
+  /** Stop and join the sampling thread. */
+  void stop();
+
+  /** Whether the sampling thread is running. */
+  bool running() const { return thread_.joinable(); }
+
+  /**
+   * @brief Take one sample, decide its state and publish it.
+   *
+   * Runs on the calling thread; only call it while the sampling thread is
+   * stopped, since the ring allows a single producer.
+   */
+  void tick();
+
+  /**
+   * @brief Consume every pending snapshot, keeping the newest.
+   * @param latest Receives the most recent snapshot when any were pending.
+   * @return Number of snapshots consumed.
+   */
+  std::size_t drain(Snapshot &latest);
+
+  /**
+   * @brief Consume every pending snapshot in order.
+   * @param each Invoked with each snapshot, oldest first.
+   * @return Number of snapshots consumed.
+   */
+  template <typename Fn> std::size_t drainEach(Fn &&each) {
+    notifyPending_.store(false, std::memory_order_release);
+    std::size_t n = 0;
+    Snapshot snap;
+    while (ring_.pop(snap)) {
+      each(snap);
+      ++n;
+    }
+    if (takeOverflow(snap)) {
+      each(snap);
+      ++n;
+    }
+    return n;
+  }
+
+  /**
+   * @brief Convert configured triggers into probe trigger specifications.
+   * @param cfg Configured "some" and "full" triggers.
+   * @return Triggers to register, empty if none are configured.
+   */
+  static std::vector<SystemProbe::Trigger>
+  triggers(const AppConfig::Psi::Triggers &cfg);
+
+  /**
+   * @brief Register the configured PSI triggers of every resource.
+   *
+   * The sampling thread then polls their descriptors alongside its timeout.
+   * Only call it while the thread is stopped.
+   */
+  void enableTriggers();
+
+  /**
+   * @brief Swap in a new configuration.
+   *
+   * Safe to call from any thread. The sampling thread adopts it at the start
+   * of its next tick, so neither the sampling timeline nor the hysteresis
+   * state is disturbed. Thresholds, including the exported ones, sampling
+   * bounds, list sizes, the process sort key and PSI triggers take effect;
+   * triggers enabled through enableTriggers() are re-registered only if they
+   * changed. Subsystems set up at construction (cgroup monitoring, history,
+   * archive, metrics endpoint, process scanning) keep their settings until
+   * restart.
+   */
+  void reconfigure(const AppConfig &cfg);
+
+  /** Configuration in use; only read it while the thread is stopped. */
+  const AppConfig &config() const { return cfg_; }
+
+  /**
+   * @brief Time the probe and decide phases of each tick.
+   * @param profiler Receives the timings and must outlive the sampler;
+   *        nullptr stops timing. Only call it while the thread is stopped.
+   */
+  void setProfiler(TickProfiler *profiler);
+
+  /** Probe being sampled; only touch it while the thread is stopped. */
+  SystemProbe &probe() { return *probe_; }
+
+  /** Sample history, or nullptr when disabled or not mappable. */
+  const History *history() const { return history_.get(); }
+
+  /** Long-term archive, or nullptr if disabled; query it while stopped. */
+  const TimeSeries *archive() const { return archive_.get(); }
+
+  /** Metrics exporter, or nullptr when disabled or not listening. */
+  const MetricsExporter *metrics() const { return metrics_.get(); }
+
+  /** Interval until the next sample in milliseconds. */
+  int interval() const { return interval_.load(std::memory_order_relaxed); }
+
+  /**
+   * Snapshots dropped because the consumer fell a full ring behind. The
+   * newest snapshot is never dropped; those between the ring and it are.
+   */
+  std::uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  /// Records older than this no longer describe the current pressure.
+  static constexpr std::chrono::minutes kRestoreMaxAge{5};
+
+  void restore(const HistoryRecord &rec);
+  /// Append the History records missing from the archive.
+  void catchUpArchive();
+  void apply(const AppConfig &cfg);
+  void run();
+  void publish(const Snapshot &snap);
+  /// Move the snapshot that did not fit in ring_ to @p out, if any.
+  bool takeOverflow(Snapshot &out);
+
+  std::unique_ptr<SystemProbe> probe_;
+  TickProfiler *profiler_ = nullptr;
+  std::unique_ptr<CgroupMonitor> cgroups_;
+  int ticksSinceRescan_ = 0;
+  std::unique_ptr<History> history_;
+  std::unique_ptr<TimeSeries> archive_;
+  std::unique_ptr<MetricsExporter> metrics_;
+  std::unique_ptr<ProcessScanner> processes_;
+  ProcessScanner::SortKey processSort_ = ProcessScanner::SortKey::Pss;
+  AppConfig cfg_;
+  /// Set by reconfigure(), taken by tick(); use the std::atomic_* functions.
+  std::shared_ptr<const AppConfig> pendingCfg_;
+  bool triggersEnabled_ = false;
+  bool triggersChanged_ = false; ///< run() must poll the new descriptors.
+  SampleScheduler scheduler_;
+  PressureState state_ = PressureState::Green;
+  std::optional<double> prevSomeAvg10_;
+  ExhaustionForecast forecast_;
+  std::optional<std::chrono::steady_clock::time_point> lastSample_;
+
+  SpscRing<Snapshot, 64> ring_;
+  // Newest snapshot while ring_ is full, so a stalled consumer still catches
+  // up to the present. Only touched once the consumer is a ring behind.
+  std::mutex overflowMutex_;
+  Snapshot overflow_;
+  std::atomic<bool> hasOverflow_{false};
+  std::function<void()> onPublish_;
+  std::atomic<bool> notifyPending_{false};
+  std::atomic<int> interval_;
+  std::atomic<std::uint64_t> dropped_{0};
+
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  int wakeFd_ = -1;
+};
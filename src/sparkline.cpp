@@ -0,0 +1,73 @@
+#include "sparkline.h"
+#include <QColor>
+#include <QPainter>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+/// Keeps the icon visible while the graph is empty.
+const QColor kBackground(0, 0, 0, 96);
+
+/// Same colors as the shield icons.
+QColor tint(PressureState state) {
+  switch (state) {
+  case PressureState::Green:
+    return QColor(0x2e, 0xcc, 0x71);
+  case PressureState::Yellow:
+    return QColor(0xf1, 0xc4, 0x0f);
+  case PressureState::Orange:
+    return QColor(0xe6, 0x7e, 0x22);
+  case PressureState::Red:
+    return QColor(0xe7, 0x4c, 0x3c);
+  }
+  return QColor(0x80, 0x80, 0x80);
+}
+} // namespace
+
+Sparkline::Sparkline(int columns, int height)
+    : pixmap_(std::max(columns, 1), std::max(height, 1)),
+      run_(pixmap_.width()) {
+  pixmap_.fill(kBackground);
+  icon_ = QIcon(pixmap_);
+}
+
+Sparkline::Column Sparkline::column(const ProbeSample &s, PressureState state,
+                                    const AppConfig &cfg) const {
+  const int height = pixmap_.height();
+  Column c;
+  c.state = state;
+  if (s.mem_available_kib && s.mem_total_kib && *s.mem_total_kib > 0) {
+    const double used = 1.0 - static_cast<double>(*s.mem_available_kib) /
+                                  static_cast<double>(*s.mem_total_kib);
+    c.mem = static_cast<int>(std::lround(std::clamp(used, 0.0, 1.0) * height));
+  }
+  const double psi =
+      cfg.psi.avg10_crit > 0 ? s.some.avg10 / (2 * cfg.psi.avg10_crit) : 0.0;
+  c.psi = static_cast<int>(
+      std::lround(std::clamp(psi, 0.0, 1.0) * (height - 1)));
+  return c;
+}
+
+bool Sparkline::push(const Column &c) {
+  const int width = pixmap_.width();
+  const int height = pixmap_.height();
+  if (c == last_ && run_ >= width)
+    return false;
+  run_ = c == last_ ? run_ + 1 : 1;
+  last_ = c;
+
+  pixmap_.scroll(-1, 0, pixmap_.rect());
+  QPainter p(&pixmap_);
+  p.setCompositionMode(QPainter::CompositionMode_Source);
+  const int x = width - 1;
+  p.fillRect(x, 0, 1, height, kBackground);
+  if (c.state) {
+    if (c.mem > 0)
+      p.fillRect(x, height - c.mem, 1, c.mem, tint(*c.state));
+    if (c.psi >= 0)
+      p.fillRect(x, height - 1 - c.psi, 1, 1, Qt::white);
+  }
+  p.end();
+  icon_ = QIcon(pixmap_);
+  return true;
+}
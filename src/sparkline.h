@@ -0,0 +1,65 @@
+#pragma once
+#include <QIcon>
+#include <QPixmap>
+#include "config.h"
+#include "pressure_state.h"
+#include "system_probe.h"
+#include <optional>
+
+/**
+ * @brief Scrolling history graph of memory use and PSI for the tray icon.
+ *
+ * Each sample becomes one pixel column: a bar of the memory in use, tinted
+ * by the state, with a white mark at the PSI some avg10 level. The graph is
+ * kept in a cached pixmap that scrolls left by one column per sample, so
+ * only the new column is painted. Pushing a column that would leave the
+ * image unchanged, i.e. onto a graph already filled with that same column,
+ * is skipped altogether.
+ */
+class Sparkline {
+public:
+  /// One column of the graph, in pixels from the bottom.
+  struct Column {
+    int mem = 0;  ///< Height of the memory-in-use bar.
+    int psi = -1; ///< Row of the PSI mark, -1 for none.
+    std::optional<PressureState> state; ///< Tint; empty without a sample.
+
+    bool operator==(const Column &o) const {
+      return mem == o.mem && psi == o.psi && state == o.state;
+    }
+    bool operator!=(const Column &o) const { return !(*this == o); }
+  };
+
+  /**
+   * @param columns Samples shown, one pixel column each.
+   * @param height Pixel height of the graph.
+   */
+  explicit Sparkline(int columns, int height = 32);
+
+  /**
+   * @brief Map a sample to a column.
+   *
+   * Memory in use is MemTotal minus MemAvailable. PSI is scaled so that
+   * twice [psi] avg10_crit reaches the top, putting the critical level at
+   * half height.
+   */
+  Column column(const ProbeSample &s, PressureState state,
+                const AppConfig &cfg) const;
+
+  /**
+   * @brief Scroll by one column and paint @p c at the right edge.
+   * @return false if the image did not change.
+   */
+  bool push(const Column &c);
+
+  /// The graph as an icon; a new one after every push() returning true.
+  const QIcon &icon() const { return icon_; }
+
+  int columns() const { return pixmap_.width(); }
+
+private:
+  QPixmap pixmap_;
+  QIcon icon_;
+  Column last_;
+  int run_; ///< Trailing columns equal to last_.
+};
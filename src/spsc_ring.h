@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Bounded single-producer/single-consumer ring buffer.
+ *
+ * push() may only be called from one thread and pop() from one other
+ * thread. Neither side takes a lock or blocks; a full ring rejects the
+ * push so a stalled consumer never slows the producer down.
+ *
+ * @tparam T Slot type; slots are reused, so copies into them can keep
+ *         their allocated capacity.
+ * @tparam N Capacity, must be a power of two.
+ */
+template <typename T, std::size_t N> class SpscRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0,
+                "SpscRing capacity must be a power of two");
+
+public:
+  /**
+   * @brief Append a value.
+   * @return False when the ring is full and the value was dropped.
+   */
+  bool push(const T &value) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == N)
+      return false;
+    slots_[head & (N - 1)] = value;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Remove the oldest value.
+   * @return False when the ring is empty and @p out was left untouched.
+   */
+  bool pop(T &out) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+      return false;
+    out = slots_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Whether no values are waiting; exact only on the consumer thread. */
+  bool empty() const {
+    return tail_.load(std::memory_order_acquire) ==
+           head_.load(std::memory_order_acquire);
+  }
+
+  /** Number of slots. */
+  static constexpr std::size_t capacity() { return N; }
+
+private:
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  std::array<T, N> slots_{};
+};
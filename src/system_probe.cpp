@@ -1,5 +1,8 @@
 #include "system_probe.h"
-#include <sstream>
+#include "proc_read.h"
+#include <charconv>
+#include <filesystem>
+#include <iterator>
 #include <string>
 #include <vector>
 #include <poll.h>
@@ -9,206 +12,324 @@
 #include <cstring>
 #include <cerrno>
 
-static double parseDouble(const std::string& line, const char* key) {
-    auto pos = line.find(key);
-    if (pos == std::string::npos) return 0.0;
-    pos += std::string(key).size();
-    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) ++pos;
-    std::stringstream ss(line.substr(pos));
-    double v = 0.0;
-    ss >> v;
-    return v;
+namespace {
+
+const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    return p;
 }
 
-static long parseLong(const std::string& line, const char* key) {
-    auto pos = line.find(key);
-    if (pos == std::string::npos) return 0;
-    pos += std::string(key).size();
-    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) ++pos;
-    std::stringstream ss(line.substr(pos));
-    long v = 0;
-    ss >> v;
-    return v;
+template <typename T>
+bool parseNumber(const char* p, const char* end, T& out) {
+    p = skipBlanks(p, end);
+    return std::from_chars(p, end, out).ec == std::errc();
 }
 
-std::optional<long> parseMemAvailable(std::istream& in) {
-    std::string k, unit;
-    long v = 0;
-    while (in >> k >> v >> unit) {
-        if (k == "MemAvailable:") return v;
+/// Whether @p key starts with @p prefix and names one of @p suffixes.
+bool isReclaimCounter(std::string_view key, std::string_view prefix) {
+    if (key.substr(0, prefix.size()) != prefix) return false;
+    key.remove_prefix(prefix.size());
+    // pgscan_anon/file and friends repeat these totals split by LRU type.
+    return key == "kswapd" || key == "direct" || key == "khugepaged" || key == "proactive";
+}
+
+std::optional<long> parseMeminfoKey(std::istream& in, std::optional<long> ProbeSample::*field) {
+    std::string content{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    ProbeSample s;
+    parseMeminfo(content, s);
+    return s.*field;
+}
+
+} // namespace
+
+void parseMeminfo(std::string_view text, ProbeSample& out) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        const char* colon = static_cast<const char*>(std::memchr(p, ':', eol - p));
+        if (colon) {
+            auto field = findMeminfoField(std::string_view(p, colon - p));
+            long v = 0;
+            if (field && parseNumber(colon + 1, eol, v)) {
+                const auto i = static_cast<std::size_t>(*field);
+                out.meminfo[i] = v;
+                out.meminfo_present |= std::uint64_t{1} << i;
+            }
+        }
+        p = eol + 1;
+    }
+    const std::pair<MeminfoField, std::optional<long> ProbeSample::*> named[] = {
+        {MeminfoField::MemAvailable, &ProbeSample::mem_available_kib},
+        {MeminfoField::MemTotal, &ProbeSample::mem_total_kib},
+        {MeminfoField::MemFree, &ProbeSample::mem_free_kib},
+        {MeminfoField::SwapFree, &ProbeSample::swap_free_kib},
+        {MeminfoField::Cached, &ProbeSample::cached_kib}};
+    for (const auto& [field, member] : named) {
+        if (auto v = out.meminfoValue(field)) out.*member = v;
     }
-    return std::nullopt;
 }
 
-std::optional<long> parseMemTotal(std::istream& in) {
-    std::string k, unit;
-    long v = 0;
-    while (in >> k >> v >> unit) {
-        if (k == "MemTotal:") return v;
+void parseVmstat(std::string_view text, VmstatCounters& out) {
+    out = {};
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        const char* sp = static_cast<const char*>(std::memchr(p, ' ', eol - p));
+        unsigned long long v = 0;
+        if (sp && parseNumber(sp + 1, eol, v)) {
+            std::string_view key(p, sp - p);
+            if (key == "workingset_refault_anon") out.refault_anon = v;
+            else if (key == "workingset_refault_file" || key == "workingset_refault") out.refault_file = v;
+            else if (key == "pswpin") out.pswpin = v;
+            else if (key == "pswpout") out.pswpout = v;
+            else if (key == "pgmajfault") out.pgmajfault = v;
+            else if (isReclaimCounter(key, "pgscan_")) out.pgscan += v;
+            else if (isReclaimCounter(key, "pgsteal_")) out.pgsteal += v;
+            else if (key.substr(0, 11) == "allocstall_") out.allocstall += v;
+        }
+        p = eol + 1;
     }
-    return std::nullopt;
+}
+
+VmstatRates vmstatRates(const VmstatCounters& prev, const VmstatCounters& cur, double seconds) {
+    auto rate = [seconds](unsigned long long a, unsigned long long b) {
+        return b >= a ? static_cast<double>(b - a) / seconds : 0.0;
+    };
+    VmstatRates r;
+    r.refault_anon = rate(prev.refault_anon, cur.refault_anon);
+    r.refault_file = rate(prev.refault_file, cur.refault_file);
+    r.pswpin = rate(prev.pswpin, cur.pswpin);
+    r.pswpout = rate(prev.pswpout, cur.pswpout);
+    r.pgmajfault = rate(prev.pgmajfault, cur.pgmajfault);
+    r.pgscan = rate(prev.pgscan, cur.pgscan);
+    r.pgsteal = rate(prev.pgsteal, cur.pgsteal);
+    r.allocstall = rate(prev.allocstall, cur.allocstall);
+    return r;
+}
+
+std::optional<long> parseMemAvailable(std::istream& in) {
+    return parseMeminfoKey(in, &ProbeSample::mem_available_kib);
+}
+
+std::optional<long> parseMemTotal(std::istream& in) {
+    return parseMeminfoKey(in, &ProbeSample::mem_total_kib);
 }
 
 std::optional<long> parseSwapFree(std::istream& in) {
-    std::string k, unit;
-    long v = 0;
-    while (in >> k >> v >> unit) {
-        if (k == "SwapFree:") return v;
-    }
-    return std::nullopt;
+    return parseMeminfoKey(in, &ProbeSample::swap_free_kib);
 }
 
 std::optional<long> parseMemFree(std::istream& in) {
-    std::string k, unit;
-    long v = 0;
-    while (in >> k >> v >> unit) {
-        if (k == "MemFree:") return v;
-    }
-    return std::nullopt;
+    return parseMeminfoKey(in, &ProbeSample::mem_free_kib);
 }
 
 std::optional<long> parseCached(std::istream& in) {
-    std::string k, unit;
-    long v = 0;
-    while (in >> k >> v >> unit) {
-        if (k == "Cached:") return v;
-    }
-    return std::nullopt;
+    return parseMeminfoKey(in, &ProbeSample::cached_kib);
 }
 
 SystemProbe::SystemProbe(std::string meminfoPath, std::string psiPath)
     : meminfoPath_(std::move(meminfoPath)), psiPath_(std::move(psiPath)) {
+    const auto dir = std::filesystem::path(psiPath_).parent_path();
+    cpuPath_ = (dir / "cpu").string();
+    ioPath_ = (dir / "io").string();
+    irqPath_ = (dir / "irq").string();
+    vmstatPath_ = (std::filesystem::path(meminfoPath_).parent_path() / "vmstat").string();
     meminfoFd_ = open(meminfoPath_.c_str(), O_RDONLY | O_CLOEXEC);
     psiFd_ = open(psiPath_.c_str(), O_RDONLY | O_CLOEXEC);
+    cpuFd_ = open(cpuPath_.c_str(), O_RDONLY | O_CLOEXEC);
+    ioFd_ = open(ioPath_.c_str(), O_RDONLY | O_CLOEXEC);
+    irqFd_ = open(irqPath_.c_str(), O_RDONLY | O_CLOEXEC);
+    vmstatFd_ = open(vmstatPath_.c_str(), O_RDONLY | O_CLOEXEC);
+    meminfoSlot_ = reader_.add(meminfoFd_, kReadBufferSize);
+    psiSlot_ = reader_.add(psiFd_, kPsiBufferSize);
+    cpuSlot_ = reader_.add(cpuFd_, kPsiBufferSize);
+    ioSlot_ = reader_.add(ioFd_, kPsiBufferSize);
+    irqSlot_ = reader_.add(irqFd_, kPsiBufferSize);
+    vmstatSlot_ = reader_.add(vmstatFd_, kVmstatBufferSize);
 }
 
 SystemProbe::~SystemProbe() {
-    if (triggerFd_ >= 0) close(triggerFd_);
-    if (meminfoFd_ >= 0) close(meminfoFd_);
-    if (psiFd_ >= 0) close(psiFd_);
+    for (int fd : triggerFds_) close(fd);
+    for (int fd : {meminfoFd_, psiFd_, cpuFd_, ioFd_, irqFd_, vmstatFd_}) {
+        if (fd >= 0) close(fd);
+    }
 }
 
-std::optional<std::string> SystemProbe::readMeminfo() const {
-    if (meminfoFd_ < 0) {
-        meminfoFd_ = open(meminfoPath_.c_str(), O_RDONLY | O_CLOEXEC);
-        if (meminfoFd_ < 0) return std::nullopt;
+const std::string& SystemProbe::pressurePath(PsiResource resource) const {
+    switch (resource) {
+    case PsiResource::Cpu: return cpuPath_;
+    case PsiResource::Io: return ioPath_;
+    case PsiResource::Irq: return irqPath_;
+    case PsiResource::Memory: break;
     }
-    if (lseek(meminfoFd_, 0, SEEK_SET) < 0) return std::nullopt;
-    std::string content;
-    char buf[4096];
-    ssize_t n;
-    while ((n = read(meminfoFd_, buf, sizeof(buf))) > 0) {
-        content.append(buf, n);
-    }
-    if (n < 0) return std::nullopt;
-    return content;
+    return psiPath_;
+}
+
+bool SystemProbe::reopen(int& fd, const std::string& path, ProcReader::Handle slot) const {
+    if (fd >= 0) return true;
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    reader_.reset(slot, fd);
+    return true;
 }
 
-std::optional<std::pair<SystemProbe::PsiType, PsiValues>> SystemProbe::parsePsiMemoryLine(const std::string& line) {
+std::optional<std::pair<SystemProbe::PsiType, PsiValues>> SystemProbe::parsePsiMemoryLine(std::string_view line) {
     PsiType type;
-    if (line.rfind("some", 0) == 0) {
+    if (line.substr(0, 4) == "some") {
         type = PsiType::Some;
-    } else if (line.rfind("full", 0) == 0) {
+    } else if (line.substr(0, 4) == "full") {
         type = PsiType::Full;
     } else {
         return std::nullopt;
     }
     PsiValues v;
-    v.avg10 = parseDouble(line, "avg10=");
-    v.avg60 = parseDouble(line, "avg60=");
-    v.avg300 = parseDouble(line, "avg300=");
-    v.total = parseLong(line, "total=");
+    const char* p = line.data() + 4;
+    const char* end = line.data() + line.size();
+    while (p < end) {
+        p = skipBlanks(p, end);
+        const char* tok = p;
+        while (p < end && *p != ' ' && *p != '\t') ++p;
+        std::string_view field(tok, p - tok);
+        auto eq = field.find('=');
+        if (eq == std::string_view::npos) continue;
+        std::string_view key = field.substr(0, eq);
+        const char* val = tok + eq + 1;
+        if (key == "avg10") parseNumber(val, p, v.avg10);
+        else if (key == "avg60") parseNumber(val, p, v.avg60);
+        else if (key == "avg300") parseNumber(val, p, v.avg300);
+        else if (key == "total") parseNumber(val, p, v.total);
+    }
     return std::make_pair(type, v);
 }
 
-std::optional<std::pair<PsiValues, PsiValues>> SystemProbe::readPsiMemory() const {
-    if (psiFd_ < 0) {
-        psiFd_ = open(psiPath_.c_str(), O_RDONLY | O_CLOEXEC);
-        if (psiFd_ < 0) {
-            std::cerr << "PSI unavailable: cannot open " << psiPath_ << ": "
-                      << std::strerror(errno) << "\n";
-            return std::nullopt;
+void SystemProbe::parsePsi(std::string_view text, std::optional<PsiValues>& some,
+                           std::optional<PsiValues>& full) {
+    while (!text.empty()) {
+        auto eol = text.find('\n');
+        auto parsed = parsePsiMemoryLine(text.substr(0, eol));
+        if (parsed) {
+            if (parsed->first == PsiType::Some) some = parsed->second;
+            else full = parsed->second;
         }
+        if (eol == std::string_view::npos) break;
+        text.remove_prefix(eol + 1);
     }
-    if (lseek(psiFd_, 0, SEEK_SET) < 0) {
+}
+
+std::optional<std::pair<PsiValues, PsiValues>> SystemProbe::readPsiMemory() const {
+    ssize_t n = reader_.result(psiSlot_);
+    if (n == -ESPIPE) {
         std::cerr << "PSI unavailable: seek failed for " << psiPath_ << ": "
-                  << std::strerror(errno) << "\n";
+                  << std::strerror(ESPIPE) << "\n";
         return std::nullopt;
     }
-    std::string content;
-    char buf[4096];
-    ssize_t n;
-    while ((n = read(psiFd_, buf, sizeof(buf))) > 0) {
-        content.append(buf, n);
-    }
     if (n < 0) {
         std::cerr << "PSI unavailable: read error from " << psiPath_ << ": "
-                  << std::strerror(errno) << "\n";
+                  << std::strerror(static_cast<int>(-n)) << "\n";
         return std::nullopt;
     }
-    std::istringstream f(content);
-    std::string line;
     std::optional<PsiValues> some, full;
-    while (std::getline(f, line)) {
-        auto parsed = parsePsiMemoryLine(line);
-        if (!parsed) continue;
-        if (parsed->first == PsiType::Some) some = parsed->second;
-        else if (parsed->first == PsiType::Full) full = parsed->second;
-    }
+    parsePsi(reader_.view(psiSlot_), some, full);
     if (some && full) return std::make_pair(*some, *full);
     std::cerr << "PSI unavailable: incomplete data in " << psiPath_ << "\n";
     return std::nullopt;
 }
 
+void SystemProbe::readPsiResource(ProcReader::Handle slot, PsiResourceValues& out) const {
+    if (reader_.result(slot) < 0) return;
+    parsePsi(reader_.view(slot), out.some, out.full);
+}
+
+void SystemProbe::readVmstat(ProbeSample& out) const {
+    if (reader_.result(vmstatSlot_) < 0) return;
+    VmstatCounters cur;
+    parseVmstat(reader_.view(vmstatSlot_), cur);
+    const auto now = std::chrono::steady_clock::now();
+    if (!vmstatBase_) {
+        vmstatBase_ = cur;
+        vmstatBaseTime_ = now;
+        return;
+    }
+    // Rates over very short windows are mostly noise; keep the last ones
+    // until enough time has passed since the baseline.
+    const double elapsed = std::chrono::duration<double>(now - vmstatBaseTime_).count();
+    if (elapsed >= kVmstatMinWindowSec) {
+        vmstatRates_ = vmstatRates(*vmstatBase_, cur, elapsed);
+        vmstatBase_ = cur;
+        vmstatBaseTime_ = now;
+    }
+    out.vmstat = vmstatRates_;
+}
+
 bool SystemProbe::enableTriggers(const std::string& path, const std::vector<Trigger>& triggers) {
-    int fd = open(path.c_str(), O_RDWR | O_NONBLOCK);
-    if (fd < 0) return false;
+    std::vector<int> fds;
     for (const auto& t : triggers) {
+        // O_APPEND keeps triggers written to a plain file (as in tests) apart.
+        int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_APPEND | O_CLOEXEC);
+        if (fd >= 0) fds.push_back(fd);
         std::string line = (t.type == PsiType::Some ? "some " : "full ") +
                            std::to_string(t.stall_us) + " " + std::to_string(t.window_us) + "\n";
-        if (write(fd, line.c_str(), line.size()) < 0) {
-            close(fd);
+        if (fd < 0 || write(fd, line.c_str(), line.size()) < 0) {
+            for (int opened : fds) close(opened);
             return false;
         }
     }
-    triggerFd_ = fd;
+    triggerFds_.insert(triggerFds_.end(), fds.begin(), fds.end());
     return true;
 }
 
+void SystemProbe::disableTriggers() {
+    for (int fd : triggerFds_) close(fd);
+    triggerFds_.clear();
+}
+
 bool SystemProbe::enableTriggers(const std::vector<Trigger>& triggers) {
     return enableTriggers(psiPath_, triggers);
 }
 
+bool SystemProbe::enableTriggers(PsiResource resource, const std::vector<Trigger>& triggers) {
+    return enableTriggers(pressurePath(resource), triggers);
+}
+
 std::optional<ProbeSample> SystemProbe::sample() const {
-    if (triggerFd_ >= 0) {
-        struct pollfd pfd { triggerFd_, POLLPRI, 0 };
+    for (int fd : triggerFds_) {
+        struct pollfd pfd { fd, POLLPRI, 0 };
         if (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLPRI)) {
             char buf[128];
-            lseek(triggerFd_, 0, SEEK_SET);
-            while (read(triggerFd_, buf, sizeof(buf)) > 0) {
+            lseek(fd, 0, SEEK_SET);
+            while (read(fd, buf, sizeof(buf)) > 0) {
             }
         }
     }
-    ProbeSample s;
-    if (auto mem = readMeminfo()) {
-        std::istringstream ss(*mem);
-        s.mem_available_kib = parseMemAvailable(ss);
-        ss.clear();
-        ss.seekg(0);
-        s.mem_total_kib = parseMemTotal(ss);
-        ss.clear();
-        ss.seekg(0);
-        s.mem_free_kib = parseMemFree(ss);
-        ss.clear();
-        ss.seekg(0);
-        s.swap_free_kib = parseSwapFree(ss);
-        ss.clear();
-        ss.seekg(0);
-        s.cached_kib = parseCached(ss);
+    const std::uint64_t readStart = profiler_ ? TickProfiler::now() : 0;
+    reopen(meminfoFd_, meminfoPath_, meminfoSlot_);
+    if (!reopen(psiFd_, psiPath_, psiSlot_)) {
+        std::cerr << "PSI unavailable: cannot open " << psiPath_ << ": "
+                  << std::strerror(errno) << "\n";
+        return std::nullopt;
+    }
+    // One batch for meminfo, vmstat and every pressure file.
+    reader_.readAll();
+    std::uint64_t parseStart = 0;
+    if (profiler_) {
+        profiler_->finish(TickProfiler::Phase::ProbeRead, readStart);
+        parseStart = TickProfiler::now();
     }
+    ProbeSample s;
+    if (reader_.result(meminfoSlot_) >= 0)
+        parseMeminfo(reader_.view(meminfoSlot_), s);
     auto psi = readPsiMemory();
     if (!psi) return std::nullopt;
     s.some = psi->first;
     s.full = psi->second;
+    readPsiResource(cpuSlot_, s.cpu);
+    readPsiResource(ioSlot_, s.io);
+    readPsiResource(irqSlot_, s.irq);
+    readVmstat(s);
+    if (profiler_) profiler_->finish(TickProfiler::Phase::Parse, parseStart);
     return s;
 }
@@ -1,7 +1,15 @@
 #pragma once
+#include "latency_histogram.h"
+#include "meminfo_fields.h"
+#include "proc_read.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
 #include <istream>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -50,10 +58,104 @@ struct PsiValues {
     long total = 0;
 };
 
+/**
+ * @brief PSI readings of a resource whose lines may be partly absent.
+ *
+ * Depending on kernel version, /proc/pressure/cpu may lack the "full" line
+ * and /proc/pressure/irq only has one.
+ */
+struct PsiResourceValues {
+    std::optional<PsiValues> some; ///< "some" values if reported.
+    std::optional<PsiValues> full; ///< "full" values if reported.
+
+    /// avg10 of "some", falling back to "full" when only that is reported.
+    std::optional<double> avg10() const {
+        if (some) return some->avg10;
+        if (full) return full->avg10;
+        return std::nullopt;
+    }
+};
+
+/**
+ * @brief Cumulative /proc/vmstat counters used for thrash detection.
+ */
+struct VmstatCounters {
+    unsigned long long refault_anon = 0; ///< workingset_refault_anon.
+    unsigned long long refault_file = 0; ///< workingset_refault_file, or workingset_refault on old kernels.
+    unsigned long long pswpin = 0;       ///< Pages swapped in.
+    unsigned long long pswpout = 0;      ///< Pages swapped out.
+    unsigned long long pgmajfault = 0;   ///< Major page faults.
+    unsigned long long pgscan = 0;       ///< Pages scanned by kswapd, direct and khugepaged reclaim.
+    unsigned long long pgsteal = 0;      ///< Pages reclaimed by the same.
+    unsigned long long allocstall = 0;   ///< Direct reclaim stalls over all zones.
+};
+
+/**
+ * @brief Per-second rates of the VmstatCounters.
+ */
+struct VmstatRates {
+    double refault_anon = 0.0;
+    double refault_file = 0.0;
+    double pswpin = 0.0;
+    double pswpout = 0.0;
+    double pgmajfault = 0.0;
+    double pgscan = 0.0;
+    double pgsteal = 0.0;
+    double allocstall = 0.0;
+
+    /// Refaulted pages per second, anon and file together.
+    double refault() const { return refault_anon + refault_file; }
+};
+
+/**
+ * Parse the thrash-related counters of /proc/vmstat in a single pass.
+ * @param text Contents formatted as in /proc/vmstat.
+ * @param out Counters receiving the parsed values.
+ */
+void parseVmstat(std::string_view text, VmstatCounters& out);
+
+/**
+ * Compute per-second rates between two counter snapshots.
+ *
+ * Counters that went backwards (e.g. after a checkpoint restore) give 0.
+ * @param prev Earlier counters.
+ * @param cur Later counters.
+ * @param seconds Time between the two snapshots; must be positive.
+ */
+VmstatRates vmstatRates(const VmstatCounters& prev, const VmstatCounters& cur, double seconds);
+
+/**
+ * @brief Memory readings of a single cgroup.
+ */
+struct CgroupSample {
+    std::string path;             ///< Path relative to the cgroup root.
+    long current_kib = 0;         ///< memory.current in KiB.
+    std::optional<long> max_kib;  ///< memory.max in KiB, empty if unlimited.
+    std::optional<long> high_kib; ///< memory.high in KiB, empty if unlimited.
+    std::optional<long> anon_kib; ///< Anonymous memory from memory.stat.
+    std::optional<long> file_kib; ///< Page cache from memory.stat.
+    PsiValues some;               ///< PSI "some" memory values.
+    PsiValues full;               ///< PSI "full" memory values.
+    bool triggered = false;       ///< A trigger fired since the last sample.
+};
+
+/**
+ * @brief Memory usage of a single process.
+ */
+struct ProcessSample {
+    int pid = 0;                 ///< Process id.
+    std::string name;            ///< Command name from /proc/<pid>/stat.
+    long rss_kib = 0;            ///< Resident set size in KiB.
+    std::optional<long> pss_kib; ///< Proportional set size, if smaps_rollup was readable.
+    long swap_kib = 0;           ///< Swapped out memory in KiB.
+};
+
 /**
  * @brief Snapshot of memory availability and PSI readings.
  */
 struct ProbeSample {
+    static_assert(kMeminfoFieldCount <= 64, "meminfo_present holds one bit per field");
+
     std::optional<long> mem_available_kib; ///< MemAvailable in KiB if readable.
     std::optional<long> mem_total_kib;     ///< MemTotal in KiB if readable.
     std::optional<long> mem_free_kib;      ///< MemFree in KiB if readable.
@@ -61,8 +163,36 @@ struct ProbeSample {
     std::optional<long> cached_kib;        ///< Cached in KiB if readable.
     PsiValues some;                       ///< PSI "some" memory values.
     PsiValues full;                       ///< PSI "full" memory values.
+    PsiResourceValues cpu;                ///< PSI cpu values if readable.
+    PsiResourceValues io;                 ///< PSI io values if readable.
+    PsiResourceValues irq;                ///< PSI irq values if readable.
+    std::vector<CgroupSample> cgroups;    ///< Worst cgroups, if monitored.
+    std::vector<ProcessSample> processes; ///< Largest processes, if scanned.
+    std::optional<VmstatRates> vmstat;    ///< Reclaim and swap rates, if /proc/vmstat is readable.
+    std::array<long, kMeminfoFieldCount> meminfo{}; ///< Every meminfo value, by MeminfoField.
+    std::uint64_t meminfo_present = 0;    ///< Bit per MeminfoField found in meminfo.
+    std::optional<double> seconds_to_critical; ///< Forecast by ExhaustionForecast, if trending there.
+
+    /// Value of a meminfo field, or std::nullopt if the kernel did not report it.
+    std::optional<long> meminfoValue(MeminfoField field) const {
+        const auto i = static_cast<std::size_t>(field);
+        if (!(meminfo_present >> i & 1)) return std::nullopt;
+        return meminfo[i];
+    }
 };
 
+/**
+ * Parse every meminfo field in a single pass.
+ *
+ * Works directly on the buffer without allocating. Known keys are looked up
+ * in the compile-time kMeminfoKeys table and stored in ProbeSample::meminfo;
+ * the five named fields are filled from it. Keys that are absent leave the
+ * corresponding ProbeSample fields untouched.
+ * @param text Contents formatted as in /proc/meminfo.
+ * @param out Sample receiving the parsed values.
+ */
+void parseMeminfo(std::string_view text, ProbeSample& out);
+
 /**
  * @brief Reads memory statistics from the system.
  */
@@ -71,6 +201,9 @@ public:
     /// PSI memory line type indicator.
     enum class PsiType { Some, Full };
 
+    /// Resources reporting pressure stall information.
+    enum class PsiResource { Memory, Cpu, Io, Irq };
+
     /** PSI trigger specification. */
     struct Trigger {
         PsiType type;      ///< Trigger type (some/full).
@@ -80,6 +213,10 @@ public:
 
     /**
      * Construct a probe reading from provided paths.
+     *
+     * The cpu, io and irq pressure files are expected next to @p psiPath,
+     * as they are in /proc/pressure, and vmstat next to @p meminfoPath. They
+     * are opened once here; sources the kernel does not provide are skipped.
      * @param meminfoPath Path to meminfo-like file.
      * @param psiPath Path to psi memory file.
      */
@@ -91,6 +228,9 @@ public:
 
     /**
      * @brief Enable PSI triggers at the specified path.
+     *
+     * The kernel accepts one trigger per open file, so each trigger gets its
+     * own descriptor. Triggers add to those registered earlier.
      * @param path File path to register triggers (typically /proc/pressure/memory).
      * @param triggers Collection of trigger thresholds to register.
      * @return True on success, false otherwise.
@@ -104,6 +244,31 @@ public:
      */
     bool enableTriggers(const std::vector<Trigger>& triggers);
 
+    /**
+     * @brief Enable PSI triggers on the pressure file of a resource.
+     * @param resource Resource whose pressure file receives the triggers.
+     * @param triggers Collection of trigger thresholds to register.
+     * @return True on success, false otherwise.
+     */
+    bool enableTriggers(PsiResource resource, const std::vector<Trigger>& triggers);
+
+    /** Close every registered PSI trigger. */
+    void disableTriggers();
+
+    /**
+     * @brief File descriptors of the registered PSI triggers.
+     *
+     * Each descriptor signals POLLPRI when its trigger fires, so callers can
+     * wait on them instead of waiting for the next tick.
+     */
+    const std::vector<int>& triggerFds() const { return triggerFds_; }
+
+    /**
+     * @brief Time the read and parse phases of sample().
+     * @param profiler Receives the timings; nullptr stops timing.
+     */
+    void setProfiler(TickProfiler* profiler) { profiler_ = profiler; }
+
     /**
      * @brief Obtain a single sample of current memory statistics.
      * @return ProbeSample with current readings or std::nullopt on failure.
@@ -115,15 +280,55 @@ public:
      * @param line Line to parse.
      * @return Pair of PSI type and values or std::nullopt on failure.
      */
-    static std::optional<std::pair<PsiType, PsiValues>> parsePsiMemoryLine(const std::string& line);
+    static std::optional<std::pair<PsiType, PsiValues>> parsePsiMemoryLine(std::string_view line);
+
+    /**
+     * @brief Parse the contents of a PSI file in a single pass.
+     * @param text File contents holding "some" and/or "full" lines.
+     * @param some Receives the "some" values when present.
+     * @param full Receives the "full" values when present.
+     */
+    static void parsePsi(std::string_view text, std::optional<PsiValues>& some,
+                         std::optional<PsiValues>& full);
 
 private:
-    std::optional<std::string> readMeminfo() const;
+    /// Upper bound for a single /proc read; meminfo is typically ~1.5 KiB.
+    static constexpr std::size_t kReadBufferSize = 8192;
+    /// Pressure files hold two lines of about 70 bytes.
+    static constexpr std::size_t kPsiBufferSize = 256;
+    /// vmstat has ~180 lines on current kernels.
+    static constexpr std::size_t kVmstatBufferSize = 16384;
+    /// Shortest window for vmstat rates; trigger wakeups can come much sooner.
+    static constexpr double kVmstatMinWindowSec = 0.5;
+
+    bool reopen(int& fd, const std::string& path, ProcReader::Handle slot) const;
     std::optional<std::pair<PsiValues, PsiValues>> readPsiMemory() const;
+    void readPsiResource(ProcReader::Handle slot, PsiResourceValues& out) const;
+    void readVmstat(ProbeSample& out) const;
+    const std::string& pressurePath(PsiResource resource) const;
 
     std::string meminfoPath_;
     std::string psiPath_;
+    std::string cpuPath_;
+    std::string ioPath_;
+    std::string irqPath_;
+    std::string vmstatPath_;
     mutable int meminfoFd_ = -1;
     mutable int psiFd_ = -1;
-    mutable int triggerFd_ = -1;
+    int cpuFd_ = -1;
+    int ioFd_ = -1;
+    int irqFd_ = -1;
+    int vmstatFd_ = -1;
+    std::vector<int> triggerFds_;
+    mutable ProcReader reader_;
+    ProcReader::Handle meminfoSlot_;
+    ProcReader::Handle psiSlot_;
+    ProcReader::Handle cpuSlot_;
+    ProcReader::Handle ioSlot_;
+    ProcReader::Handle irqSlot_;
+    ProcReader::Handle vmstatSlot_;
+    mutable std::optional<VmstatCounters> vmstatBase_;
+    mutable std::chrono::steady_clock::time_point vmstatBaseTime_;
+    mutable std::optional<VmstatRates> vmstatRates_;
+    TickProfiler* profiler_ = nullptr;
 };
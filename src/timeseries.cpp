@@ -0,0 +1,690 @@
+#include "timeseries.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+namespace {
+constexpr char kFileMagic[8] = {'N', 'H', 'T', 'R', 'T', 'S', 'E', 'R'};
+constexpr std::uint32_t kFileVersion = 1;
+constexpr std::uint32_t kChunkMagic = 0x4b4e4843; // "CHNK"
+
+/// Start of the file.
+struct FileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t reserved;
+};
+
+/// Start of every chunk, followed by body_size bytes of columns.
+struct ChunkHeader {
+  std::uint32_t magic;
+  std::uint32_t count;
+  std::int64_t min_ms;
+  std::int64_t max_ms;
+  std::uint32_t body_size;
+  std::uint32_t checksum; ///< FNV-1a of the body.
+};
+
+/// Integer and floating-point columns, in the order they are stored.
+constexpr std::size_t kIntColumns = 8;
+constexpr std::size_t kFloatColumns = 11;
+
+template <typename Record, typename IntFn, typename FloatFn>
+void visitColumns(Record &r, IntFn onInt, FloatFn onFloat) {
+  onInt(r.time_ms);
+  onInt(r.mem_available_kib);
+  onInt(r.mem_total_kib);
+  onInt(r.mem_free_kib);
+  onInt(r.swap_free_kib);
+  onInt(r.cached_kib);
+  onInt(r.some.total);
+  onInt(r.full.total);
+  onFloat(r.some.avg10);
+  onFloat(r.some.avg60);
+  onFloat(r.some.avg300);
+  onFloat(r.full.avg10);
+  onFloat(r.full.avg60);
+  onFloat(r.full.avg300);
+  onFloat(r.cpu_avg10);
+  onFloat(r.io_avg10);
+  onFloat(r.irq_avg10);
+  onFloat(r.refault_per_sec);
+  onFloat(r.swapin_per_sec);
+}
+
+std::uint32_t fnv1a(std::string_view data) {
+  std::uint32_t h = 2166136261u;
+  for (char c : data) {
+    h ^= static_cast<std::uint8_t>(c);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+std::uint64_t zigzag(std::int64_t v) {
+  return (static_cast<std::uint64_t>(v) << 1) ^
+         static_cast<std::uint64_t>(v >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t v) {
+  return static_cast<std::int64_t>((v >> 1) ^ (~(v & 1) + 1));
+}
+
+/// Wrapping difference, so extreme values cannot overflow.
+std::int64_t minus(std::int64_t a, std::int64_t b) {
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(a) -
+                                   static_cast<std::uint64_t>(b));
+}
+
+std::int64_t plus(std::int64_t a, std::int64_t b) {
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(a) +
+                                   static_cast<std::uint64_t>(b));
+}
+
+class BitWriter {
+public:
+  void put(std::uint64_t value, int bits) {
+    while (bits > 0) {
+      if (used_ == 8) {
+        bytes_.push_back('\0');
+        used_ = 0;
+      }
+      const int take = std::min(bits, 8 - used_);
+      const auto part = static_cast<unsigned>(value >> (bits - take)) &
+                        ((1u << take) - 1);
+      bytes_.back() = static_cast<char>(
+          static_cast<std::uint8_t>(bytes_.back()) |
+          (part << (8 - used_ - take)));
+      used_ += take;
+      bits -= take;
+    }
+  }
+  const std::string &bytes() const { return bytes_; }
+
+private:
+  std::string bytes_;
+  int used_ = 8; ///< Bits used in the last byte.
+};
+
+class BitReader {
+public:
+  explicit BitReader(std::string_view bytes) : bytes_(bytes) {}
+  bool get(int bits, std::uint64_t &value) {
+    if (pos_ + static_cast<std::size_t>(bits) > bytes_.size() * 8)
+      return false;
+    value = 0;
+    while (bits > 0) {
+      const auto byte = static_cast<std::uint8_t>(bytes_[pos_ / 8]);
+      const int offset = static_cast<int>(pos_ % 8);
+      const int take = std::min(bits, 8 - offset);
+      value = (value << take) |
+              ((byte >> (8 - offset - take)) & ((1u << take) - 1));
+      pos_ += static_cast<std::size_t>(take);
+      bits -= take;
+    }
+    return true;
+  }
+
+private:
+  std::string_view bytes_;
+  std::size_t pos_ = 0; ///< Next bit.
+};
+
+/// Delta-of-delta codes: a unary prefix selects the width of the zigzagged
+/// value; a zero costs a single bit.
+struct DodBucket {
+  int prefixBits;
+  std::uint64_t prefix;
+  int bits;
+};
+constexpr DodBucket kDodBuckets[] = {
+    {2, 0b10, 7}, {3, 0b110, 12}, {4, 0b1110, 20}, {5, 0b11110, 32}};
+constexpr DodBucket kDodWide = {5, 0b11111, 64};
+
+class IntEncoder {
+public:
+  void put(std::int64_t v) {
+    if (n_++ == 0) {
+      out_.put(static_cast<std::uint64_t>(v), 64);
+    } else {
+      const std::int64_t delta = minus(v, prev_);
+      putDod(minus(delta, prevDelta_));
+      prevDelta_ = delta;
+    }
+    prev_ = v;
+  }
+  const std::string &bytes() const { return out_.bytes(); }
+
+private:
+  void putDod(std::int64_t dod) {
+    if (dod == 0) {
+      out_.put(0, 1);
+      return;
+    }
+    const std::uint64_t z = zigzag(dod);
+    for (const auto &b : kDodBuckets) {
+      if (z < (std::uint64_t{1} << b.bits)) {
+        out_.put(b.prefix, b.prefixBits);
+        out_.put(z, b.bits);
+        return;
+      }
+    }
+    out_.put(kDodWide.prefix, kDodWide.prefixBits);
+    out_.put(z, kDodWide.bits);
+  }
+
+  BitWriter out_;
+  std::size_t n_ = 0;
+  std::int64_t prev_ = 0;
+  std::int64_t prevDelta_ = 0;
+};
+
+class IntDecoder {
+public:
+  explicit IntDecoder(std::string_view bytes) : in_(bytes) {}
+  bool next(std::int64_t &v) {
+    std::uint64_t raw = 0;
+    if (n_++ == 0) {
+      if (!in_.get(64, raw))
+        return false;
+      prev_ = static_cast<std::int64_t>(raw);
+      v = prev_;
+      return true;
+    }
+    std::int64_t dod = 0;
+    if (!getDod(dod))
+      return false;
+    prevDelta_ = plus(prevDelta_, dod);
+    prev_ = plus(prev_, prevDelta_);
+    v = prev_;
+    return true;
+  }
+
+private:
+  bool getDod(std::int64_t &dod) {
+    std::uint64_t bit = 0;
+    if (!in_.get(1, bit))
+      return false;
+    if (bit == 0) {
+      dod = 0;
+      return true;
+    }
+    // Count further one bits of the prefix to find the bucket.
+    int ones = 1;
+    const int maxOnes = kDodWide.prefixBits;
+    while (ones < maxOnes) {
+      if (!in_.get(1, bit))
+        return false;
+      if (bit == 0)
+        break;
+      ++ones;
+    }
+    const int bits =
+        ones == maxOnes ? kDodWide.bits : kDodBuckets[ones - 1].bits;
+    std::uint64_t z = 0;
+    if (!in_.get(bits, z))
+      return false;
+    dod = unzigzag(z);
+    return true;
+  }
+
+  BitReader in_;
+  std::size_t n_ = 0;
+  std::int64_t prev_ = 0;
+  std::int64_t prevDelta_ = 0;
+};
+
+/// Gorilla XOR encoding: an unchanged value costs one bit; otherwise only
+/// the bits between the leading and trailing zeros of the XOR are stored,
+/// reusing the previous window when they fit.
+class FloatEncoder {
+public:
+  void put(double v) {
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &v, sizeof(bits));
+    if (n_++ == 0) {
+      out_.put(bits, 64);
+      prev_ = bits;
+      return;
+    }
+    const std::uint64_t x = bits ^ prev_;
+    prev_ = bits;
+    if (x == 0) {
+      out_.put(0, 1);
+      return;
+    }
+    out_.put(1, 1);
+    const int lz = std::min(__builtin_clzll(x), 31);
+    const int tz = __builtin_ctzll(x);
+    if (leading_ >= 0 && lz >= leading_ && tz >= trailing_) {
+      out_.put(0, 1);
+      out_.put(x >> trailing_, 64 - leading_ - trailing_);
+      return;
+    }
+    const int len = 64 - lz - tz;
+    out_.put(1, 1);
+    out_.put(static_cast<std::uint64_t>(lz), 5);
+    out_.put(static_cast<std::uint64_t>(len - 1), 6);
+    out_.put(x >> tz, len);
+    leading_ = lz;
+    trailing_ = tz;
+  }
+  const std::string &bytes() const { return out_.bytes(); }
+
+private:
+  BitWriter out_;
+  std::size_t n_ = 0;
+  std::uint64_t prev_ = 0;
+  int leading_ = -1;
+  int trailing_ = 0;
+};
+
+class FloatDecoder {
+public:
+  explicit FloatDecoder(std::string_view bytes) : in_(bytes) {}
+  bool next(double &v) {
+    if (n_++ == 0) {
+      if (!in_.get(64, prev_))
+        return false;
+    } else {
+      std::uint64_t bit = 0;
+      if (!in_.get(1, bit))
+        return false;
+      if (bit != 0 && !readXor())
+        return false;
+    }
+    std::memcpy(&v, &prev_, sizeof(v));
+    return true;
+  }
+
+private:
+  bool readXor() {
+    std::uint64_t control = 0;
+    if (!in_.get(1, control))
+      return false;
+    if (control != 0) {
+      std::uint64_t lz = 0;
+      std::uint64_t len = 0;
+      if (!in_.get(5, lz) || !in_.get(6, len))
+        return false;
+      leading_ = static_cast<int>(lz);
+      trailing_ = 64 - leading_ - static_cast<int>(len + 1);
+      if (trailing_ < 0)
+        return false;
+    } else if (leading_ < 0) {
+      return false;
+    }
+    std::uint64_t x = 0;
+    if (!in_.get(64 - leading_ - trailing_, x))
+      return false;
+    prev_ ^= x << trailing_;
+    return true;
+  }
+
+  BitReader in_;
+  std::size_t n_ = 0;
+  std::uint64_t prev_ = 0;
+  int leading_ = -1;
+  int trailing_ = 0;
+};
+
+void putVarint(std::string &out, std::uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+bool getVarint(std::string_view in, std::size_t &pos, std::uint64_t &v) {
+  v = 0;
+  for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+    const auto byte = static_cast<std::uint8_t>(in[pos++]);
+    v |= std::uint64_t{byte & 0x7fu} << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+/// Run-length encoding as (value, run length) varint pairs.
+class RunEncoder {
+public:
+  void put(std::uint32_t v) {
+    if (run_ > 0 && v == value_) {
+      ++run_;
+      return;
+    }
+    flushRun();
+    value_ = v;
+    run_ = 1;
+  }
+  const std::string &bytes() {
+    flushRun();
+    return out_;
+  }
+
+private:
+  void flushRun() {
+    if (run_ == 0)
+      return;
+    putVarint(out_, value_);
+    putVarint(out_, run_);
+    run_ = 0;
+  }
+
+  std::string out_;
+  std::uint32_t value_ = 0;
+  std::uint64_t run_ = 0;
+};
+
+class RunDecoder {
+public:
+  explicit RunDecoder(std::string_view bytes) : in_(bytes) {}
+  bool next(std::uint32_t &v) {
+    if (run_ == 0) {
+      std::uint64_t value = 0;
+      if (!getVarint(in_, pos_, value) || !getVarint(in_, pos_, run_) ||
+          run_ == 0)
+        return false;
+      value_ = static_cast<std::uint32_t>(value);
+    }
+    --run_;
+    v = value_;
+    return true;
+  }
+
+private:
+  std::string_view in_;
+  std::size_t pos_ = 0;
+  std::uint32_t value_ = 0;
+  std::uint64_t run_ = 0;
+};
+
+void putU32(std::string &out, std::uint32_t v) {
+  out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+bool writeAll(int fd, const char *data, std::size_t size) {
+  while (size > 0) {
+    const ssize_t n = write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    size -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+bool readAt(int fd, void *buf, std::size_t size, std::uint64_t offset) {
+  auto *p = static_cast<char *>(buf);
+  while (size > 0) {
+    const ssize_t n = pread(fd, p, size, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= static_cast<std::size_t>(n);
+    offset += static_cast<std::uint64_t>(n);
+  }
+  return true;
+}
+} // namespace
+
+struct ChunkEncoder::Columns {
+  RunEncoder state;
+  RunEncoder present;
+  IntEncoder ints[kIntColumns];
+  FloatEncoder floats[kFloatColumns];
+};
+
+ChunkEncoder::ChunkEncoder() : columns_(std::make_unique<Columns>()) {}
+
+ChunkEncoder::~ChunkEncoder() = default;
+
+void ChunkEncoder::append(const HistoryRecord &rec) {
+  if (count_ == 0)
+    minMs_ = maxMs_ = rec.time_ms;
+  minMs_ = std::min(minMs_, rec.time_ms);
+  maxMs_ = std::max(maxMs_, rec.time_ms);
+  ++count_;
+  columns_->state.put(rec.state);
+  columns_->present.put(rec.present);
+  std::size_t i = 0;
+  std::size_t j = 0;
+  visitColumns(
+      rec,
+      [&](const auto &v) {
+        columns_->ints[i++].put(static_cast<std::int64_t>(v));
+      },
+      [&](double v) { columns_->floats[j++].put(v); });
+}
+
+std::string ChunkEncoder::finish() {
+  std::string body;
+  auto column = [&body](const std::string &bytes) {
+    putU32(body, static_cast<std::uint32_t>(bytes.size()));
+    body += bytes;
+  };
+  column(columns_->state.bytes());
+  column(columns_->present.bytes());
+  for (const auto &c : columns_->ints)
+    column(c.bytes());
+  for (const auto &c : columns_->floats)
+    column(c.bytes());
+
+  ChunkHeader header{};
+  header.magic = kChunkMagic;
+  header.count = static_cast<std::uint32_t>(count_);
+  header.min_ms = minMs_;
+  header.max_ms = maxMs_;
+  header.body_size = static_cast<std::uint32_t>(body.size());
+  header.checksum = fnv1a(body);
+  std::string chunk(reinterpret_cast<const char *>(&header), sizeof(header));
+  chunk += body;
+
+  columns_ = std::make_unique<Columns>();
+  count_ = 0;
+  return chunk;
+}
+
+bool decodeChunk(std::string_view chunk, std::vector<HistoryRecord> &out) {
+  ChunkHeader header{};
+  if (chunk.size() < sizeof(header))
+    return false;
+  std::memcpy(&header, chunk.data(), sizeof(header));
+  std::string_view body = chunk.substr(sizeof(header));
+  if (header.magic != kChunkMagic || header.body_size != body.size() ||
+      header.checksum != fnv1a(body))
+    return false;
+
+  std::string_view columns[2 + kIntColumns + kFloatColumns];
+  std::size_t pos = 0;
+  for (auto &c : columns) {
+    std::uint32_t size = 0;
+    if (body.size() - pos < sizeof(size))
+      return false;
+    std::memcpy(&size, body.data() + pos, sizeof(size));
+    pos += sizeof(size);
+    if (body.size() - pos < size)
+      return false;
+    c = body.substr(pos, size);
+    pos += size;
+  }
+
+  RunDecoder state(columns[0]);
+  RunDecoder present(columns[1]);
+  std::vector<IntDecoder> ints(columns + 2, columns + 2 + kIntColumns);
+  std::vector<FloatDecoder> floats(columns + 2 + kIntColumns, std::end(columns));
+  const std::size_t base = out.size();
+  out.resize(base + header.count);
+  bool ok = true;
+  for (std::size_t n = 0; n < header.count && ok; ++n) {
+    HistoryRecord &r = out[base + n];
+    std::uint32_t v = 0;
+    ok = state.next(v);
+    r.state = static_cast<std::uint8_t>(v);
+    ok = ok && present.next(r.present);
+    std::size_t i = 0;
+    std::size_t j = 0;
+    visitColumns(
+        r,
+        [&](auto &field) {
+          std::int64_t value = 0;
+          ok = ok && ints[i++].next(value);
+          field = static_cast<std::remove_reference_t<decltype(field)>>(value);
+        },
+        [&](double &field) { ok = ok && floats[j++].next(field); });
+  }
+  if (!ok)
+    out.resize(base);
+  return ok;
+}
+
+TimeSeries::TimeSeries(std::string path, std::size_t chunkRecords)
+    : path_(std::move(path)), chunkRecords_(std::max<std::size_t>(chunkRecords, 1)) {
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(path_).parent_path(), ec);
+  fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  if (fd_ >= 0)
+    loadIndex();
+  pending_.reserve(chunkRecords_);
+}
+
+TimeSeries::~TimeSeries() {
+  flush();
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+void TimeSeries::loadIndex() {
+  struct stat st {};
+  const std::uint64_t size =
+      fstat(fd_, &st) == 0 ? static_cast<std::uint64_t>(st.st_size) : 0;
+  FileHeader file{};
+  if (size > 0) {
+    const bool valid = size >= sizeof(file) && readAt(fd_, &file, sizeof(file), 0) &&
+                       std::memcmp(file.magic, kFileMagic, sizeof(kFileMagic)) == 0 &&
+                       file.version == kFileVersion;
+    if (!valid) {
+      // Unlike the History ring, an archive is the only copy of its
+      // samples, and a mistyped path may name some other file.
+      close(fd_);
+      fd_ = -1;
+      return;
+    }
+  } else {
+    std::memcpy(file.magic, kFileMagic, sizeof(kFileMagic));
+    file.version = kFileVersion;
+    file.reserved = 0;
+    if (!writeAll(fd_, reinterpret_cast<const char *>(&file), sizeof(file))) {
+      close(fd_);
+      fd_ = -1;
+      return;
+    }
+    end_ = sizeof(file);
+    return;
+  }
+
+  std::uint64_t offset = sizeof(file);
+  ChunkHeader header{};
+  while (offset + sizeof(header) <= size &&
+         readAt(fd_, &header, sizeof(header), offset) &&
+         header.magic == kChunkMagic &&
+         offset + sizeof(header) + header.body_size <= size) {
+    const auto chunkSize =
+        static_cast<std::uint32_t>(sizeof(header) + header.body_size);
+    index_.push_back(
+        {header.min_ms, header.max_ms, header.count, offset, chunkSize});
+    offset += chunkSize;
+  }
+  // Drop a chunk torn by a crash so new chunks follow the last whole one.
+  if (offset < size && ftruncate(fd_, static_cast<off_t>(offset)) < 0) {
+    close(fd_);
+    fd_ = -1;
+    index_.clear();
+    return;
+  }
+  end_ = offset;
+}
+
+void TimeSeries::append(const HistoryRecord &rec) {
+  if (fd_ < 0)
+    return;
+  pending_.push_back(rec);
+  if (pending_.size() >= chunkRecords_)
+    flush();
+}
+
+bool TimeSeries::flush() {
+  if (fd_ < 0 || pending_.empty())
+    return fd_ >= 0;
+  ChunkEncoder encoder;
+  for (const auto &rec : pending_)
+    encoder.append(rec);
+  const auto range = std::minmax_element(
+      pending_.begin(), pending_.end(),
+      [](const HistoryRecord &a, const HistoryRecord &b) {
+        return a.time_ms < b.time_ms;
+      });
+  const ChunkInfo info{range.first->time_ms, range.second->time_ms,
+                       static_cast<std::uint32_t>(pending_.size()), end_, 0};
+  // The records are dropped on a write error so memory stays bounded; the
+  // memory-mapped History still holds the recent ones.
+  pending_.clear();
+  const std::string chunk = encoder.finish();
+  if (!writeAll(fd_, chunk.data(), chunk.size())) {
+    if (ftruncate(fd_, static_cast<off_t>(end_)) < 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+    return false;
+  }
+  index_.push_back(info);
+  index_.back().size = static_cast<std::uint32_t>(chunk.size());
+  end_ += chunk.size();
+  return true;
+}
+
+std::size_t TimeSeries::query(std::int64_t fromMs, std::int64_t toMs,
+                              std::vector<HistoryRecord> &out) const {
+  out.clear();
+  std::size_t decoded = 0;
+  std::string buf;
+  std::vector<HistoryRecord> records;
+  auto take = [&](const HistoryRecord &r) {
+    if (r.time_ms >= fromMs && r.time_ms <= toMs)
+      out.push_back(r);
+  };
+  for (const auto &chunk : index_) {
+    if (chunk.max_ms < fromMs || chunk.min_ms > toMs)
+      continue;
+    buf.resize(chunk.size);
+    records.clear();
+    if (!readAt(fd_, buf.data(), buf.size(), chunk.offset) ||
+        !decodeChunk(buf, records))
+      continue;
+    ++decoded;
+    for (const auto &r : records)
+      take(r);
+  }
+  for (const auto &r : pending_)
+    take(r);
+  return decoded;
+}
+
+std::string TimeSeries::defaultPath() {
+  return (std::filesystem::path(History::defaultPath()).parent_path() /
+          "archive.bin")
+      .string();
+}
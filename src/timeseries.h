@@ -0,0 +1,132 @@
+#pragma once
+#include "history.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Compresses HistoryRecords column by column into one chunk.
+ *
+ * Integer columns (time, KiB values, PSI totals) store the delta of deltas
+ * in variable-width bit codes, so a steady 1 Hz clock costs one bit per
+ * record. PSI averages and rates use Gorilla-style XOR encoding against the
+ * previous value; the state and presence bits are run-length encoded.
+ */
+class ChunkEncoder {
+public:
+  ChunkEncoder();
+  ~ChunkEncoder();
+
+  /** Add a record; records must come in time order. */
+  void append(const HistoryRecord &rec);
+
+  /** Number of records added since the last finish(). */
+  std::size_t count() const { return count_; }
+
+  /**
+   * @brief Serialize the chunk and start a new one.
+   * @return Chunk header followed by the encoded columns.
+   */
+  std::string finish();
+
+private:
+  struct Columns;
+  std::unique_ptr<Columns> columns_;
+  std::size_t count_ = 0;
+  std::int64_t minMs_ = 0;
+  std::int64_t maxMs_ = 0;
+};
+
+/**
+ * @brief Decode one chunk produced by ChunkEncoder::finish().
+ * @param chunk Header and body of the chunk.
+ * @param out Receives the records, appended in time order.
+ * @return False if the chunk is malformed or truncated.
+ */
+bool decodeChunk(std::string_view chunk, std::vector<HistoryRecord> &out);
+
+/**
+ * @brief Append-only file of compressed chunks for long-term history.
+ *
+ * Records are buffered and written out as one compressed chunk once
+ * @p chunkRecords have accumulated or on flush(). Every chunk header carries
+ * its first and last timestamp; opening the file reads only the headers to
+ * build a time index, so query() decompresses just the chunks overlapping
+ * the requested range. A chunk cut short by a crash is dropped on open.
+ */
+class TimeSeries {
+public:
+  /// One chunk per hour at 1 Hz.
+  static constexpr std::size_t kDefaultChunkRecords = 3600;
+
+  /** Location of a chunk in the file. */
+  struct ChunkInfo {
+    std::int64_t min_ms;   ///< Earliest record time.
+    std::int64_t max_ms;   ///< Latest record time.
+    std::uint32_t count;   ///< Records in the chunk.
+    std::uint64_t offset;  ///< Offset of the chunk header.
+    std::uint32_t size;    ///< Header and body size in bytes.
+  };
+
+  /**
+   * @brief Open or create a time-series file.
+   *
+   * A non-empty file without the archive header is left untouched and
+   * isOpen() returns false.
+   * @param path File to append to and query.
+   * @param chunkRecords Records per chunk.
+   */
+  explicit TimeSeries(std::string path,
+                      std::size_t chunkRecords = kDefaultChunkRecords);
+
+  /** Writes pending records as a final chunk. */
+  ~TimeSeries();
+
+  TimeSeries(const TimeSeries &) = delete;
+  TimeSeries &operator=(const TimeSeries &) = delete;
+
+  /** Whether the file could be opened. */
+  bool isOpen() const { return fd_ >= 0; }
+
+  /** Add a record, writing a chunk once enough have accumulated. */
+  void append(const HistoryRecord &rec);
+
+  /** Write pending records as a chunk. */
+  bool flush();
+
+  /**
+   * @brief Collect the records in [@p fromMs, @p toMs].
+   *
+   * Includes records still pending in the open chunk.
+   * @param out Receives the records in time order; cleared first.
+   * @return Number of chunks decompressed.
+   */
+  std::size_t query(std::int64_t fromMs, std::int64_t toMs,
+                    std::vector<HistoryRecord> &out) const;
+
+  /** Time index of the chunks written so far. */
+  const std::vector<ChunkInfo> &chunks() const { return index_; }
+
+  /** Bytes in the file. */
+  std::uint64_t fileSize() const { return end_; }
+
+  /**
+   * @brief Default file location.
+   * @return `archive.bin` next to History::defaultPath().
+   */
+  static std::string defaultPath();
+
+private:
+  void loadIndex();
+
+  std::string path_;
+  std::size_t chunkRecords_;
+  int fd_ = -1;
+  std::uint64_t end_ = 0;
+  std::vector<ChunkInfo> index_;
+  /// Records of the chunk not yet written.
+  std::vector<HistoryRecord> pending_;
+};
@@ -0,0 +1,217 @@
+#include "tooltip_template.h"
+#include "pressure_state.h"
+#include "system_probe.h"
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace {
+struct SizeField {
+  std::string_view name;
+  std::optional<long> ProbeSample::*value;
+};
+constexpr SizeField kSizes[] = {
+    {"mem_available", &ProbeSample::mem_available_kib},
+    {"mem_total", &ProbeSample::mem_total_kib},
+    {"mem_free", &ProbeSample::mem_free_kib},
+    {"swap_free", &ProbeSample::swap_free_kib},
+    {"cached", &ProbeSample::cached_kib},
+};
+
+struct PsiField {
+  std::string_view name;
+  PsiValues ProbeSample::*line;
+  double PsiValues::*avg;
+};
+constexpr PsiField kPsi[] = {
+    {"some.avg10", &ProbeSample::some, &PsiValues::avg10},
+    {"some.avg60", &ProbeSample::some, &PsiValues::avg60},
+    {"some.avg300", &ProbeSample::some, &PsiValues::avg300},
+    {"full.avg10", &ProbeSample::full, &PsiValues::avg10},
+    {"full.avg60", &ProbeSample::full, &PsiValues::avg60},
+    {"full.avg300", &ProbeSample::full, &PsiValues::avg300},
+};
+
+struct ResourceField {
+  std::string_view name;
+  PsiResourceValues ProbeSample::*values;
+};
+constexpr ResourceField kResources[] = {
+    {"cpu.avg10", &ProbeSample::cpu},
+    {"io.avg10", &ProbeSample::io},
+    {"irq.avg10", &ProbeSample::irq},
+};
+
+struct VmstatField {
+  std::string_view name;
+  double (*rate)(const VmstatRates &);
+};
+constexpr VmstatField kVmstat[] = {
+    {"refault", [](const VmstatRates &r) { return r.refault(); }},
+    {"pswpin", [](const VmstatRates &r) { return r.pswpin; }},
+    {"pswpout", [](const VmstatRates &r) { return r.pswpout; }},
+    {"pgmajfault", [](const VmstatRates &r) { return r.pgmajfault; }},
+    {"pgscan", [](const VmstatRates &r) { return r.pgscan; }},
+    {"pgsteal", [](const VmstatRates &r) { return r.pgsteal; }},
+    {"allocstall", [](const VmstatRates &r) { return r.allocstall; }},
+};
+
+template <typename Table>
+std::optional<std::uint16_t> find(const Table &table, std::string_view name) {
+  for (std::size_t i = 0; i < std::size(table); ++i)
+    if (table[i].name == name)
+      return static_cast<std::uint16_t>(i);
+  return std::nullopt;
+}
+
+void appendAscii(QString &out, const char *begin, const char *end) {
+  out.append(QLatin1String(begin, static_cast<int>(end - begin)));
+}
+
+void appendNa(QString &out) { out.append(QLatin1String("n/a")); }
+
+// std::to_chars ignores the C locale, which QCoreApplication sets from the
+// environment.
+void appendFixed(QString &out, double v, int precision) {
+  char buf[64];
+  const auto r = std::to_chars(buf, buf + sizeof(buf), v,
+                               std::chars_format::fixed, precision);
+  if (r.ec != std::errc())
+    return appendNa(out);
+  appendAscii(out, buf, r.ptr);
+}
+
+void appendInt(QString &out, long v) {
+  char buf[24];
+  const auto r = std::to_chars(buf, buf + sizeof(buf), v);
+  appendAscii(out, buf, r.ptr);
+}
+
+/// Same layout as the built-in tooltip: MiB, or GiB from 1 GiB on.
+void appendKib(QString &out, long kib) {
+  const double mib = kib / 1024.0;
+  if (mib >= 1024.0) {
+    appendFixed(out, mib / 1024.0, 1);
+    out.append(QLatin1String(" GiB"));
+  } else {
+    appendFixed(out, mib, 1);
+    out.append(QLatin1String(" MiB"));
+  }
+}
+} // namespace
+
+TooltipTemplate TooltipTemplate::compile(const QString &source) {
+  TooltipTemplate t;
+  t.source_ = source;
+  auto field = [](std::string_view name) -> std::optional<Op> {
+    if (name == "state")
+      return Op{Kind::State};
+    if (name == "seconds_to_critical")
+      return Op{Kind::Forecast};
+    if (auto i = find(kSizes, name))
+      return Op{Kind::Kib, *i};
+    if (auto i = find(kPsi, name))
+      return Op{Kind::Psi, *i};
+    if (auto i = find(kResources, name))
+      return Op{Kind::Resource, *i};
+    if (auto i = find(kVmstat, name))
+      return Op{Kind::Vmstat, *i};
+    if (auto f = findMeminfoField(name))
+      return Op{Kind::Meminfo, static_cast<std::uint16_t>(*f)};
+    return std::nullopt;
+  };
+
+  const std::string src = source.toStdString();
+  std::string literal;
+  auto flush = [&] {
+    if (literal.empty())
+      return;
+    t.ops_.push_back({Kind::Literal, 0, QString::fromStdString(literal)});
+    literal.clear();
+  };
+  for (std::size_t i = 0; i < src.size(); ++i) {
+    const char c = src[i];
+    const char next = i + 1 < src.size() ? src[i + 1] : '\0';
+    if (c == '\\' && next == 'n') {
+      literal += '\n';
+      ++i;
+      continue;
+    }
+    if ((c == '{' || c == '}') && next == c) {
+      literal += c;
+      ++i;
+      continue;
+    }
+    if (c == '{') {
+      const std::size_t close = src.find('}', i + 1);
+      if (close != std::string::npos) {
+        if (auto op = field(
+                std::string_view(src).substr(i + 1, close - i - 1))) {
+          flush();
+          t.ops_.push_back(std::move(*op));
+          i = close;
+          continue;
+        }
+      }
+    }
+    literal += c;
+  }
+  flush();
+  return t;
+}
+
+void TooltipTemplate::render(const ProbeSample &s, PressureState state,
+                             QString &out) const {
+  // truncate() keeps the capacity; clear() would release it.
+  out.truncate(0);
+  for (const Op &op : ops_) {
+    switch (op.kind) {
+    case Kind::Literal:
+      out.append(op.text);
+      break;
+    case Kind::State:
+      out.append(QLatin1String(pressureStateName(state)));
+      break;
+    case Kind::Kib:
+      if (const auto &v = s.*kSizes[op.arg].value)
+        appendKib(out, *v);
+      else
+        appendNa(out);
+      break;
+    case Kind::Meminfo: {
+      const auto f = static_cast<MeminfoField>(op.arg);
+      if (auto v = s.meminfoValue(f)) {
+        if (meminfoKey(f).kib)
+          appendKib(out, *v);
+        else
+          appendInt(out, *v);
+      } else {
+        appendNa(out);
+      }
+      break;
+    }
+    case Kind::Psi:
+      appendFixed(out, s.*kPsi[op.arg].line.*kPsi[op.arg].avg, 2);
+      break;
+    case Kind::Resource:
+      if (auto v = (s.*kResources[op.arg].values).avg10())
+        appendFixed(out, *v, 2);
+      else
+        appendNa(out);
+      break;
+    case Kind::Vmstat:
+      if (s.vmstat)
+        appendFixed(out, kVmstat[op.arg].rate(*s.vmstat), 0);
+      else
+        appendNa(out);
+      break;
+    case Kind::Forecast:
+      if (s.seconds_to_critical)
+        appendFixed(out, *s.seconds_to_critical, 0);
+      else
+        appendNa(out);
+      break;
+    }
+  }
+}
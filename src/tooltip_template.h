@@ -0,0 +1,66 @@
+#pragma once
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+struct ProbeSample;
+enum class PressureState;
+
+/**
+ * @brief User-defined tooltip layout, compiled once and rendered per sample.
+ *
+ * The source is literal text with fields in braces, e.g.
+ * "{mem_available}/{mem_total} PSI {some.avg10}". Known fields are:
+ *  - state: the pressure state name;
+ *  - mem_available, mem_total, mem_free, swap_free, cached, and any
+ *    /proc/meminfo key such as Shmem or HugePages_Total;
+ *  - some.avg10, some.avg60, some.avg300 and the same for full;
+ *  - cpu.avg10, io.avg10, irq.avg10;
+ *  - refault, pswpin, pswpout, pgmajfault, pgscan, pgsteal, allocstall
+ *    (per second);
+ *  - seconds_to_critical: whole seconds until the forecast critical state.
+ * Sizes are shown in MiB or GiB and missing readings as "n/a". "\n" starts a
+ * new line, "{{" and "}}" stand for literal braces, and an unknown field is
+ * kept verbatim so the typo shows up in the tooltip.
+ *
+ * compile() turns the source into a flat list of literal and field
+ * operations; render() then walks it and appends straight into the caller's
+ * buffer, formatting numbers on the stack, so once the buffer has grown to
+ * fit nothing is allocated.
+ */
+class TooltipTemplate {
+public:
+  TooltipTemplate() = default;
+
+  /// Parse @p source; an empty source gives an empty template.
+  static TooltipTemplate compile(const QString &source);
+
+  /// True when no template is configured.
+  bool empty() const { return ops_.empty(); }
+
+  /// The text compile() was given.
+  const QString &source() const { return source_; }
+
+  /// Replace the contents of @p out with the rendered text.
+  void render(const ProbeSample &s, PressureState state, QString &out) const;
+
+private:
+  enum class Kind : std::uint8_t {
+    Literal,
+    State,
+    Kib,      ///< One of the named ProbeSample sizes.
+    Meminfo,  ///< ProbeSample::meminfo entry.
+    Psi,      ///< Memory PSI some/full average.
+    Resource, ///< cpu, io or irq avg10.
+    Vmstat,   ///< VmstatRates member.
+    Forecast  ///< seconds_to_critical.
+  };
+  struct Op {
+    Kind kind;
+    std::uint16_t arg = 0; ///< Field index within its kind.
+    QString text{};        ///< Literal text.
+  };
+
+  QString source_;
+  std::vector<Op> ops_;
+};
@@ -2,13 +2,35 @@
 #include <QAction>
 #include <QCoreApplication>
 #include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
 #include <QIcon>
 #include <QMenu>
+#include <QMetaObject>
+#include <QScreen>
 #include <algorithm>
 #include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <tuple>
+#include <utility>
+#include <unistd.h>
 #include <vector>
 
 namespace {
+/// Quiet time after the last change to a watched file before reloading.
+constexpr int kReloadDebounceMs = 250;
+
+/// Self-pipe from the SIGUSR1 handler to the event loop.
+int usr1Pipe[2] = {-1, -1};
+
+void onUsr1(int) {
+  const char byte = 0;
+  [[maybe_unused]] ssize_t n = write(usr1Pipe[1], &byte, 1);
+}
+
 QIcon loadIcon(const QString &name) {
   if (QFile::exists(name))
     return QIcon(name);
@@ -17,50 +39,215 @@ QIcon loadIcon(const QString &name) {
     icon = QIcon(name);
   return icon;
 }
+
+/// Logical sizes tray hosts commonly ask for.
+constexpr int kTraySizes[] = {16, 22, 24, 32, 48, 64};
+
+/// Rasterizes an icon at every tray size and screen scale up front, so
+/// later draws neither stat the filesystem nor parse SVG.
+QIcon prerender(const QString &name, const std::vector<int> &sizes,
+                const std::vector<qreal> &ratios) {
+  const QIcon source = loadIcon(name);
+  if (source.isNull())
+    return source;
+  QIcon icon;
+  for (qreal ratio : ratios)
+    for (int size : sizes)
+      icon.addPixmap(source.pixmap(QSize(size, size), ratio));
+  return icon;
+}
+
+QString formatKib(long kib) {
+  double mib = kib / 1024.0;
+  if (mib >= 1024.0) {
+    double gib = mib / 1024.0;
+    return QString("%1 GiB").arg(gib, 0, 'f', 1);
+  }
+  return QString("%1 MiB").arg(mib, 0, 'f', 1);
+}
+
+/// "≈ 42 s to critical", in minutes from two minutes on.
+QString forecastLine(double seconds) {
+  const long s = std::lround(seconds);
+  const QString eta = s < 120 ? QString("%1 s").arg(s)
+                              : QString("%1 min").arg(std::lround(seconds / 60));
+  return QString("%1 %2 to critical").arg(QChar(0x2248)).arg(eta);
+}
+
+/// One line per cgroup: usage against its tightest limit and PSI.
+QString cgroupLine(const CgroupSample &cg) {
+  QString used = formatKib(cg.current_kib);
+  std::optional<long> limit = cg.high_kib;
+  if (cg.max_kib && (!limit || *cg.max_kib < *limit))
+    limit = cg.max_kib;
+  if (limit)
+    used += QString(" / %1").arg(formatKib(*limit));
+  return QString("%1: %2, PSI some %3")
+      .arg(QString::fromStdString(cg.path))
+      .arg(used)
+      .arg(cg.some.avg10, 0, 'f', 2);
+}
+
+/// One line per process: its largest memory measures.
+QString processLine(const ProcessSample &p) {
+  QString line = QString("%1 %2: RSS %3")
+                     .arg(p.pid)
+                     .arg(QString::fromStdString(p.name))
+                     .arg(formatKib(p.rss_kib));
+  if (p.pss_kib)
+    line += QString(", PSS %1").arg(formatKib(*p.pss_kib));
+  if (p.swap_kib > 0)
+    line += QString(", swap %1").arg(formatKib(p.swap_kib));
+  return line;
+}
+
+/// Replace the entries of a read-only submenu.
+template <typename T, typename Format>
+void fillMenu(QMenu *menu, const std::vector<T> &items, Format format) {
+  menu->clear();
+  for (const auto &item : items)
+    menu->addAction(format(item))->setEnabled(false);
+  menu->setEnabled(!items.empty());
+}
 } // namespace
 
 Tray::Tray(QObject *parent, std::unique_ptr<SystemProbe> probe,
            const QString &configPath)
-    : QObject(parent),
-      probe_(probe ? std::move(probe) : std::make_unique<SystemProbe>()) {
-  if (!configPath.isEmpty())
+    : QObject(parent) {
+  if (!configPath.isEmpty()) {
     cfg_.load(configPath);
+    configPath_ = configPath;
+    reloadTimer_.setSingleShot(true);
+    reloadTimer_.setInterval(kReloadDebounceMs);
+    connect(&reloadTimer_, &QTimer::timeout, this, &Tray::reloadConfig);
+    auto changed = [this] { reloadTimer_.start(); };
+    connect(&configWatcher_, &QFileSystemWatcher::fileChanged, this, changed);
+    connect(&configWatcher_, &QFileSystemWatcher::directoryChanged, this,
+            changed);
+    reloadPool_.setMaxThreadCount(1);
+    watchConfig();
+  }
+  tooltipBuffer_.reserve(512);
+  if (cfg_.ui.icon == "sparkline")
+    sparkline_ = std::make_unique<Sparkline>(cfg_.ui.sparkline_samples);
+  updates_.setTooltipInterval(
+      std::chrono::milliseconds(cfg_.ui.tooltip_min_interval_ms));
+  tooltipTimer_.setSingleShot(true);
+  // A coarse timer may fire before the interval is over.
+  tooltipTimer_.setTimerType(Qt::PreciseTimer);
+  connect(&tooltipTimer_, &QTimer::timeout, this, &Tray::flushToolTip);
   auto *menu = new QMenu();
+  if (cfg_.cgroup.enabled) {
+    cgroupMenu_ = menu->addMenu("Cgroups");
+    cgroupMenu_->setEnabled(false);
+  }
+  if (cfg_.process.enabled) {
+    processMenu_ = menu->addMenu("Top processes");
+    processMenu_->setEnabled(false);
+  }
+  latencyMenu_ = menu->addMenu("Latency");
+  // Percentiles are only formatted when someone looks at them.
+  connect(latencyMenu_, &QMenu::aboutToShow, this, [this] {
+    latencyMenu_->clear();
+    for (std::size_t i = 0; i < TickProfiler::kPhases; ++i)
+      latencyMenu_
+          ->addAction(QString::fromStdString(
+              profiler_.summary(static_cast<TickProfiler::Phase>(i))))
+          ->setEnabled(false);
+    latencyMenu_
+        ->addAction(QString("Skipped updates: icon %1, tooltip %2")
+                        .arg(updates_.skippedIcons())
+                        .arg(updates_.skippedTooltips()))
+        ->setEnabled(false);
+  });
   auto *quit = menu->addAction("Quit");
   connect(quit, &QAction::triggered, qApp, &QCoreApplication::quit);
   icon_.setContextMenu(menu);
-  timer_.setInterval(cfg_.sample_interval_ms);
-  connect(&timer_, &QTimer::timeout, this, &Tray::refresh);
+  sampler_ = std::make_unique<Sampler>(
+      probe ? std::move(probe) : std::make_unique<SystemProbe>(), cfg_);
+  sampler_->setProfiler(&profiler_);
+  sampler_->enableTriggers();
+}
 
-  std::vector<SystemProbe::Trigger> triggers;
-  if (cfg_.psi.trigger.some) {
-    const auto &t = *cfg_.psi.trigger.some;
-    triggers.push_back({SystemProbe::PsiType::Some, t.stall_us, t.window_us});
-  }
-  if (cfg_.psi.trigger.full) {
-    const auto &t = *cfg_.psi.trigger.full;
-    triggers.push_back({SystemProbe::PsiType::Full, t.stall_us, t.window_us});
+Tray::~Tray() {
+  // A reload in flight posts back to this object.
+  reloadPool_.waitForDone();
+  sampler_->stop();
+}
+
+void Tray::watchConfig() {
+  // Editors often replace the file instead of writing it, which drops it
+  // from the watch, and nohang.conf may only appear later; watching the
+  // directories catches both.
+  QStringList paths;
+  for (const QString &file : {configPath_, nohangConfigPath()}) {
+    const QFileInfo info(file);
+    for (const QString &path : {info.filePath(), info.path()})
+      if (QFileInfo::exists(path) &&
+          !configWatcher_.files().contains(path) &&
+          !configWatcher_.directories().contains(path) &&
+          !paths.contains(path))
+        paths << path;
   }
-  if (!triggers.empty())
-    probe_->enableTriggers(triggers);
+  if (!paths.isEmpty())
+    configWatcher_.addPaths(paths);
+}
+
+void Tray::reloadConfig() {
+  reloadPool_.start([this, path = configPath_,
+                     hadToml = cfg_.toml_loaded] {
+    AppConfig next;
+    next.load(path);
+    // A file briefly missing mid-save or turned unreadable would otherwise
+    // reset every TOML setting to its default.
+    if (hadToml && !next.toml_loaded) {
+      std::cerr << "Config reload skipped: cannot read " << path.toStdString()
+                << "; keeping the current settings\n";
+      return;
+    }
+    QMetaObject::invokeMethod(
+        this, [this, next] { applyConfig(next); }, Qt::QueuedConnection);
+  });
+}
+
+void Tray::applyConfig(const AppConfig &next) {
+  cfg_ = next;
+  updates_.setTooltipInterval(
+      std::chrono::milliseconds(cfg_.ui.tooltip_min_interval_ms));
+  if (cfg_.ui.icon != "sparkline")
+    sparkline_.reset();
+  else if (!sparkline_ || sparkline_->columns() != cfg_.ui.sparkline_samples)
+    sparkline_ = std::make_unique<Sparkline>(cfg_.ui.sparkline_samples);
+  // Thresholds and layout shown in the tooltip may have changed.
+  tooltipSample_.reset();
+  sampler_->reconfigure(cfg_);
+  watchConfig();
 }
 
 void Tray::show() {
-  icon_.setIcon(loadIcon(cfg_.palette.black)); // initial
+  setIcon(sparkline_ ? sparkline_->icon()
+                     : paletteIcon(std::nullopt)); // initial
   icon_.setVisible(true);
-  timer_.start();
+  if (usr1Pipe[0] < 0 && pipe2(usr1Pipe, O_CLOEXEC | O_NONBLOCK) == 0) {
+    struct sigaction sa {};
+    sa.sa_handler = onUsr1;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, nullptr);
+  }
+  if (usr1Pipe[0] >= 0 && !usr1Notifier_) {
+    usr1Notifier_ =
+        new QSocketNotifier(usr1Pipe[0], QSocketNotifier::Read, this);
+    connect(usr1Notifier_, &QSocketNotifier::activated, this,
+            &Tray::dumpLatency);
+  }
+  sampler_->start([this] {
+    QMetaObject::invokeMethod(this, &Tray::refresh, Qt::QueuedConnection);
+  });
 }
 
 QString Tray::buildTooltip(const ProbeSample &s, const AppConfig &cfg,
                            State state) {
-  auto formatKib = [](long kib) {
-    double mib = kib / 1024.0;
-    if (mib >= 1024.0) {
-      double gib = mib / 1024.0;
-      return QString("%1 GiB").arg(gib, 0, 'f', 1);
-    }
-    return QString("%1 MiB").arg(mib, 0, 'f', 1);
-  };
   auto makeBar = [&](double ratio) {
     ratio = std::clamp(ratio, 0.0, 1.0);
     int filled = static_cast<int>(ratio * 10);
@@ -99,6 +286,17 @@ QString Tray::buildTooltip(const ProbeSample &s, const AppConfig &cfg,
   else
     tip += QStringLiteral("Cached: n/a\n");
 
+  for (MeminfoField field : cfg.ui.meminfo_fields) {
+    const MeminfoKey &key = meminfoKey(field);
+    const QString name = QString::fromLatin1(key.name.data(),
+                                             static_cast<int>(key.name.size()));
+    if (auto v = s.meminfoValue(field))
+      tip += QString("%1: %2\n").arg(name).arg(key.kib ? formatKib(*v)
+                                                        : QString::number(*v));
+    else
+      tip += QString("%1: n/a\n").arg(name);
+  }
+
   std::vector<double> ratios;
   if (s.mem_available_kib)
     ratios.push_back(static_cast<double>(*s.mem_available_kib) /
@@ -121,6 +319,8 @@ QString Tray::buildTooltip(const ProbeSample &s, const AppConfig &cfg,
   } else {
     tip += QStringLiteral("Pressure: n/a\n");
   }
+  if (s.seconds_to_critical)
+    tip += QString("%1\n").arg(forecastLine(*s.seconds_to_critical));
 
   tip += QString("PSI some avg10: %1 (warn %2, crit %3)\n")
              .arg(s.some.avg10, 0, 'f', 2)
@@ -129,6 +329,43 @@ QString Tray::buildTooltip(const ProbeSample &s, const AppConfig &cfg,
 
   tip += QString("PSI full avg10: %1\n").arg(s.full.avg10, 0, 'f', 2);
 
+  const std::tuple<const char *, const PsiResourceValues &,
+                   const AppConfig::Psi::Resource &>
+      resources[] = {{"cpu", s.cpu, cfg.psi.cpu},
+                     {"io", s.io, cfg.psi.io},
+                     {"irq", s.irq, cfg.psi.irq}};
+  for (const auto &[name, values, thr] : resources) {
+    auto avg10 = values.avg10();
+    if (!avg10)
+      continue;
+    if (thr.avg10_warn > 0 || thr.avg10_crit > 0)
+      tip += QString("PSI %1 avg10: %2 (warn %3, crit %4)\n")
+                 .arg(name)
+                 .arg(*avg10, 0, 'f', 2)
+                 .arg(thr.avg10_warn, 0, 'f', 2)
+                 .arg(thr.avg10_crit, 0, 'f', 2);
+    else
+      tip += QString("PSI %1 avg10: %2\n").arg(name).arg(*avg10, 0, 'f', 2);
+  }
+
+  for (const auto &cg : s.cgroups)
+    tip += QString("cgroup %1\n").arg(cgroupLine(cg));
+  for (const auto &p : s.processes)
+    tip += QString("proc %1\n").arg(processLine(p));
+
+  if (s.vmstat) {
+    const VmstatRates &r = *s.vmstat;
+    tip += QString("Refault: %1/s, swap in %2/s, out %3/s, majflt %4/s\n")
+               .arg(r.refault(), 0, 'f', 0)
+               .arg(r.pswpin, 0, 'f', 0)
+               .arg(r.pswpout, 0, 'f', 0)
+               .arg(r.pgmajfault, 0, 'f', 0);
+    tip += QString("Reclaim: scan %1/s, steal %2/s, stalls %3/s\n")
+               .arg(r.pgscan, 0, 'f', 0)
+               .arg(r.pgsteal, 0, 'f', 0)
+               .arg(r.allocstall, 0, 'f', 0);
+  }
+
   if (cfg.psi.trigger.some) {
     const auto &t = *cfg.psi.trigger.some;
     tip +=
@@ -139,6 +376,18 @@ QString Tray::buildTooltip(const ProbeSample &s, const AppConfig &cfg,
     tip +=
         QString(" trigger full: %1us/%2us\n").arg(t.stall_us).arg(t.window_us);
   }
+  for (const auto &[name, values, thr] : resources) {
+    if (thr.trigger.some)
+      tip += QString(" trigger %1 some: %2us/%3us\n")
+                 .arg(name)
+                 .arg(thr.trigger.some->stall_us)
+                 .arg(thr.trigger.some->window_us);
+    if (thr.trigger.full)
+      tip += QString(" trigger %1 full: %2us/%3us\n")
+                 .arg(name)
+                 .arg(thr.trigger.full->stall_us)
+                 .arg(thr.trigger.full->window_us);
+  }
 
   tip += QString("interval: %1 ms\n").arg(cfg.sample_interval_ms);
   tip +=
@@ -147,64 +396,90 @@ QString Tray::buildTooltip(const ProbeSample &s, const AppConfig &cfg,
   return tip;
 }
 
-Tray::State Tray::decide(const ProbeSample &s, const AppConfig &cfg, State prev,
-                         std::optional<double> prevSomeAvg10) {
-  auto rank = [](State st) { return static_cast<int>(st); };
-  const int p = rank(prev);
-
-  const long memCritThr = (p >= rank(State::Red))
-                              ? cfg.mem.available_crit_exit_kib
-                              : cfg.mem.available_crit_kib;
-  const long swapCritThr = (p >= rank(State::Red)) ? cfg.swap.free_crit_exit_kib
-                                                   : cfg.swap.free_crit_kib;
-  const double psiCritThr =
-      (p >= rank(State::Red)) ? cfg.psi.avg10_crit_exit : cfg.psi.avg10_crit;
-  if ((s.mem_available_kib && *s.mem_available_kib <= memCritThr) ||
-      (s.swap_free_kib && *s.swap_free_kib <= swapCritThr) ||
-      s.some.avg10 >= psiCritThr)
-    return State::Red;
-
-  const long memWarnThr = (p >= rank(State::Orange))
-                              ? cfg.mem.available_warn_exit_kib
-                              : cfg.mem.available_warn_kib;
-  const long swapWarnThr = (p >= rank(State::Orange))
-                               ? cfg.swap.free_warn_exit_kib
-                               : cfg.swap.free_warn_kib;
-  if ((s.mem_available_kib && *s.mem_available_kib <= memWarnThr) ||
-      (s.swap_free_kib && *s.swap_free_kib <= swapWarnThr))
-    return State::Orange;
-
-  const long memWarnMarginThr = cfg.mem.available_warn_exit_kib;
-  const long swapWarnMarginThr = cfg.swap.free_warn_exit_kib;
-  if ((s.mem_available_kib && *s.mem_available_kib <= memWarnMarginThr) ||
-      (s.swap_free_kib && *s.swap_free_kib <= swapWarnMarginThr))
-    return State::Yellow;
-
-  if (prevSomeAvg10) {
-    double rate = (s.some.avg10 - *prevSomeAvg10) /
-                  (static_cast<double>(cfg.sample_interval_ms) / 1000.0);
-    if (rate >= cfg.psi.avg10_deriv_warn)
-      return State::Yellow;
+void Tray::refresh() {
+  if (!sampler_->running())
+    sampler_->tick();
+  Sampler::Snapshot snap;
+  if (sampler_->drain(snap))
+    render(snap);
+}
+
+void Tray::dumpLatency() {
+  char buf[64];
+  while (read(usr1Pipe[0], buf, sizeof(buf)) > 0) {
   }
+  std::fputs(profiler_.report().c_str(), stderr);
+  std::fprintf(stderr, "skipped updates: icon %llu, tooltip %llu\n",
+               static_cast<unsigned long long>(updates_.skippedIcons()),
+               static_cast<unsigned long long>(updates_.skippedTooltips()));
+}
 
-  const double psiWarnThr =
-      (p >= rank(State::Yellow)) ? cfg.psi.avg10_warn_exit : cfg.psi.avg10_warn;
-  if (s.some.avg10 >= psiWarnThr)
-    return State::Yellow;
+const QIcon &Tray::paletteIcon(std::optional<State> state) {
+  const QString *names[] = {&cfg_.palette.black, &cfg_.palette.green,
+                            &cfg_.palette.yellow, &cfg_.palette.orange,
+                            &cfg_.palette.red};
+  const QString theme = QIcon::themeName();
+  bool stale = theme != icons_.theme;
+  for (std::size_t i = 0; i < icons_.names.size() && !stale; ++i)
+    stale = *names[i] != icons_.names[i];
+  if (stale) {
+    std::vector<int> sizes(std::begin(kTraySizes), std::end(kTraySizes));
+    const int actual = icon_.geometry().height();
+    if (actual > 0)
+      sizes.push_back(actual);
+    std::vector<qreal> ratios{1.0};
+    for (const QScreen *screen : QGuiApplication::screens())
+      ratios.push_back(screen->devicePixelRatio());
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+    std::sort(ratios.begin(), ratios.end());
+    ratios.erase(std::unique(ratios.begin(), ratios.end()), ratios.end());
+    icons_.theme = theme;
+    for (std::size_t i = 0; i < icons_.names.size(); ++i) {
+      icons_.names[i] = *names[i];
+      icons_.icons[i] = prerender(*names[i], sizes, ratios);
+    }
+  }
+  return icons_.icons[state ? static_cast<std::size_t>(*state) + 1 : 0];
+}
 
-  return State::Green;
+void Tray::setIcon(const QIcon &icon) {
+  if (!updates_.offerIcon(icon.cacheKey()))
+    return;
+  const std::uint64_t start = TickProfiler::now();
+  icon_.setIcon(icon);
+  profiler_.finish(TickProfiler::Phase::SetIcon, start);
 }
 
-void Tray::refresh() {
-  auto sOpt = probe_->sample();
-  if (!sOpt) {
-    icon_.setIcon(loadIcon(cfg_.palette.black));
+void Tray::setToolTip(const QString &text) {
+  const std::uint64_t start = TickProfiler::now();
+  icon_.setToolTip(text);
+  profiler_.finish(TickProfiler::Phase::SetToolTip, start);
+}
+
+void Tray::flushToolTip() {
+  if (auto text = updates_.flushTooltip(UpdateCoalescer::Clock::now()))
+    setToolTip(*text);
+}
+
+void Tray::render(const Sampler::Snapshot &snap) {
+  if (!snap.sample) {
+    if (sparkline_) {
+      sparkline_->push(Sparkline::Column{});
+      setIcon(sparkline_->icon());
+    } else {
+      setIcon(paletteIcon(std::nullopt));
+    }
     return;
   }
-  const auto &s = *sOpt;
-  auto nextState = decide(s, cfg_, state_, prevSomeAvg10_);
-  bool updateTip = true;
-  if (tooltipSample_) {
+  const auto &s = *snap.sample;
+  const State nextState = snap.state;
+  // A template may show any field at any precision, so it is rendered every
+  // tick and the coalescer drops unchanged text. The built-in tooltip is
+  // rebuilt on a state change or when a value it shows moved noticeably.
+  bool updateTip = !tooltipSample_ || nextState != state_ ||
+                   !cfg_.ui.tooltip_template.empty();
+  if (!updateTip) {
     auto diffPct = [](double a, double b) {
       return (a == 0.0) ? std::abs(b) : std::abs(a - b) / std::abs(a);
     };
@@ -212,7 +487,6 @@ void Tray::refresh() {
       return (prev <= thr && cur > thr) || (prev > thr && cur <= thr);
     };
     const auto &prev = *tooltipSample_;
-    updateTip = false;
 
     if (prev.mem_available_kib != s.mem_available_kib) {
       if (!prev.mem_available_kib || !s.mem_available_kib)
@@ -245,29 +519,100 @@ void Tray::refresh() {
       if (diffPct(oldFull, curFull) > 0.05)
         updateTip = true;
     }
+
+    for (MeminfoField field : cfg_.ui.meminfo_fields) {
+      if (updateTip)
+        break;
+      const auto oldVal = prev.meminfoValue(field);
+      const auto curVal = s.meminfoValue(field);
+      if (oldVal.has_value() != curVal.has_value() ||
+          (oldVal && diffPct(static_cast<double>(*oldVal),
+                             static_cast<double>(*curVal)) > 0.05))
+        updateTip = true;
+    }
+
+    const std::pair<const PsiResourceValues &, const PsiResourceValues &>
+        resources[] = {{prev.cpu, s.cpu}, {prev.io, s.io}, {prev.irq, s.irq}};
+    for (const auto &[oldRes, curRes] : resources) {
+      if (updateTip)
+        break;
+      auto oldAvg = oldRes.avg10();
+      auto curAvg = curRes.avg10();
+      if (oldAvg.has_value() != curAvg.has_value() ||
+          (oldAvg && diffPct(*oldAvg, *curAvg) > 0.05))
+        updateTip = true;
+    }
+
+    if (!updateTip && prev.seconds_to_critical.has_value() !=
+                          s.seconds_to_critical.has_value())
+      updateTip = true;
+    if (!updateTip && s.seconds_to_critical &&
+        diffPct(*prev.seconds_to_critical, *s.seconds_to_critical) > 0.05)
+      updateTip = true;
+    if (!updateTip && prev.vmstat.has_value() != s.vmstat.has_value())
+      updateTip = true;
+    if (!updateTip && s.vmstat) {
+      const double oldRefault = prev.vmstat->refault();
+      const double curRefault = s.vmstat->refault();
+      if (crosses(oldRefault, curRefault, cfg_.thrash.refault_per_sec) ||
+          diffPct(oldRefault, curRefault) > 0.05)
+        updateTip = true;
+    }
+
+    auto sameCgroup = [&](const CgroupSample &a, const CgroupSample &b) {
+      return a.path == b.path && diffPct(a.some.avg10, b.some.avg10) <= 0.05;
+    };
+    if (!updateTip)
+      updateTip = prev.cgroups.size() != s.cgroups.size() ||
+                  !std::equal(prev.cgroups.begin(), prev.cgroups.end(),
+                              s.cgroups.begin(), sameCgroup);
+    auto sameProcess = [&](const ProcessSample &a, const ProcessSample &b) {
+      return a.pid == b.pid && diffPct(a.rss_kib, b.rss_kib) <= 0.05;
+    };
+    if (!updateTip)
+      updateTip = prev.processes.size() != s.processes.size() ||
+                  !std::equal(prev.processes.begin(), prev.processes.end(),
+                              s.processes.begin(), sameProcess);
   }
 
   if (updateTip) {
-    tooltipCache_ = buildTooltip(s, cfg_, nextState);
+    const std::uint64_t tooltipStart = TickProfiler::now();
+    if (cfg_.ui.tooltip_template.empty()) {
+      tooltipCache_ = buildTooltip(s, cfg_, nextState);
+    } else {
+      cfg_.ui.tooltip_template.render(s, nextState, tooltipBuffer_);
+      // A deep copy keeps the buffer unshared, so the next render reuses it.
+      if (tooltipBuffer_ != tooltipCache_)
+        tooltipCache_ =
+            QString(tooltipBuffer_.constData(), tooltipBuffer_.size());
+    }
+    profiler_.finish(TickProfiler::Phase::Tooltip, tooltipStart);
     tooltipSample_ = s;
+    if (cgroupMenu_)
+      fillMenu(cgroupMenu_, s.cgroups, cgroupLine);
+    if (processMenu_)
+      fillMenu(processMenu_, s.processes, processLine);
   }
-  icon_.setToolTip(tooltipCache_);
-  state_ = nextState;
-  prevSomeAvg10_ = s.some.avg10;
-  QString iconPath = cfg_.palette.black;
-  switch (state_) {
-  case State::Green:
-    iconPath = cfg_.palette.green;
+  const auto now = UpdateCoalescer::Clock::now();
+  switch (updates_.offerTooltip(tooltipCache_, now, nextState != state_)) {
+  case UpdateCoalescer::Tooltip::Push:
+    tooltipTimer_.stop();
+    setToolTip(tooltipCache_);
     break;
-  case State::Yellow:
-    iconPath = cfg_.palette.yellow;
+  case UpdateCoalescer::Tooltip::Defer:
+    if (!tooltipTimer_.isActive())
+      tooltipTimer_.start(std::chrono::ceil<std::chrono::milliseconds>(
+          updates_.tooltipWait(now)));
     break;
-  case State::Orange:
-    iconPath = cfg_.palette.orange;
-    break;
-  case State::Red:
-    iconPath = cfg_.palette.red;
+  case UpdateCoalescer::Tooltip::Skip:
     break;
   }
-  icon_.setIcon(loadIcon(iconPath));
+  state_ = nextState;
+  if (sparkline_) {
+    // An unchanged graph keeps its icon, which the coalescer then skips.
+    sparkline_->push(sparkline_->column(s, state_, cfg_));
+    setIcon(sparkline_->icon());
+  } else {
+    setIcon(paletteIcon(state_));
+  }
 }
@@ -1,16 +1,42 @@
 #pragma once
+#include <QFileSystemWatcher>
+#include <QIcon>
+#include <QMenu>
+#include <QSocketNotifier>
 #include <QSystemTrayIcon>
+#include <QThreadPool>
 #include <QTimer>
 #include "config.h"
+#include "latency_histogram.h"
+#include "pressure_state.h"
+#include "sampler.h"
+#include "sparkline.h"
 #include "system_probe.h"
+#include "update_coalescer.h"
+#include <array>
 #include <memory>
 #include <optional>
 
 /**
  * @brief Maintains a system tray icon reflecting memory pressure.
  *
- * Tray owns a SystemProbe, periodically samples system memory pressure and
- * updates the tray icon color and tooltip accordingly.
+ * Tray owns a Sampler that samples system memory pressure on its own thread
+ * and decides the state; the GUI thread only drains the published snapshots
+ * and updates the tray icon color and tooltip accordingly. The sampling
+ * interval adapts to how close readings are to their thresholds, and a PSI
+ * trigger firing wakes the sampler immediately. With cgroup monitoring
+ * enabled, the worst cgroups are listed in the tooltip and a submenu; the
+ * largest processes are listed the same way while the state is Orange or Red.
+ * Each phase of a tick is timed; the "Latency" submenu shows the
+ * percentiles and SIGUSR1 dumps them to stderr. Palette icons are resolved
+ * and rasterized once, and again only when the palette or the icon theme
+ * changes. The icon and tooltip are only handed to the shell when they
+ * change, and tooltip updates at most once per [ui] tooltip_min_interval_ms.
+ * A [ui] tooltip_template replaces the built-in tooltip layout, and
+ * [ui] icon = "sparkline" replaces the shield with a Sparkline of recent
+ * samples. The configuration file and nohang.conf are watched; edits are
+ * debounced, parsed on a worker thread and swapped into the running tray
+ * and sampler without a restart.
  */
 class Tray : public QObject {
   Q_OBJECT
@@ -25,18 +51,14 @@ public:
                 std::unique_ptr<SystemProbe> probe = nullptr,
                 const QString &configPath = QString());
 
-  /** Show the tray icon and start periodic updates. */
+  /** Stops the sampling thread before the tray goes away. */
+  ~Tray() override;
+
+  /** Show the tray icon, start the sampling thread and handle SIGUSR1. */
   void show();
 
-  /**
-   * @brief Color-coded memory pressure states.
-   */
-  enum class State {
-    Green,  ///< Normal memory pressure.
-    Yellow, ///< Mild pressure.
-    Orange, ///< High pressure.
-    Red     ///< Critical pressure.
-  };
+  /// Color-coded memory pressure states.
+  using State = PressureState;
 
   /**
    * @brief Build tooltip text from a probe sample and configuration.
@@ -47,18 +69,49 @@ public:
   /**
    * @brief Decide next state based on a sample and previous state.
    * @param prevSomeAvg10 Previous PSI some avg10 value to compute rate.
+   * @param elapsedSec Seconds since the previous sample; the configured
+   *        sample interval is assumed when not positive.
    */
   static State decide(const ProbeSample &s, const AppConfig &cfg, State prev,
-                      std::optional<double> prevSomeAvg10 = std::nullopt);
+                      std::optional<double> prevSomeAvg10 = std::nullopt,
+                      double elapsedSec = 0.0) {
+    return decidePressure(s, cfg, prev, prevSomeAvg10, elapsedSec);
+  }
 
 private:
   void refresh();
+  void render(const Sampler::Snapshot &snap);
+  const QIcon &paletteIcon(std::optional<State> state);
+  void setIcon(const QIcon &icon);
+  void setToolTip(const QString &text);
+  void flushToolTip();
+  void watchConfig();
+  void reloadConfig();
+  void applyConfig(const AppConfig &next);
+  void dumpLatency();
   QSystemTrayIcon icon_;
-  QTimer timer_;
+  QMenu *cgroupMenu_ = nullptr;  ///< Worst cgroups, owned by the context menu.
+  QMenu *processMenu_ = nullptr; ///< Largest processes, owned likewise.
+  QMenu *latencyMenu_ = nullptr; ///< Phase timings, owned likewise.
+  QSocketNotifier *usr1Notifier_ = nullptr;
   AppConfig cfg_;
-  std::unique_ptr<SystemProbe> probe_;
+  QString configPath_;
+  QFileSystemWatcher configWatcher_;
+  QTimer reloadTimer_; ///< Debounces bursts of file change events.
+  QThreadPool reloadPool_;
+  TickProfiler profiler_; ///< Outlives sampler_, which writes to it.
+  std::unique_ptr<Sampler> sampler_;
   State state_ = State::Green;
-  std::optional<double> prevSomeAvg10_;
   QString tooltipCache_;
+  QString tooltipBuffer_; ///< Rendered [ui] tooltip_template.
+  UpdateCoalescer updates_;
+  QTimer tooltipTimer_; ///< Pushes a deferred tooltip.
   std::optional<ProbeSample> tooltipSample_;
+  std::unique_ptr<Sparkline> sparkline_; ///< Set in sparkline icon mode.
+  /// Pre-rendered palette icons: black first, then one per State.
+  struct IconCache {
+    QString theme;
+    std::array<QString, 5> names;
+    std::array<QIcon, 5> icons;
+  } icons_;
 };
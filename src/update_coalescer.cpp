@@ -0,0 +1,58 @@
+#include "update_coalescer.h"
+
+UpdateCoalescer::UpdateCoalescer(std::chrono::milliseconds tooltipInterval)
+    : interval_(tooltipInterval) {}
+
+bool UpdateCoalescer::offerIcon(std::int64_t key) {
+  ++iconOffers_;
+  if (icon_ == key)
+    return false;
+  icon_ = key;
+  ++iconPushes_;
+  return true;
+}
+
+UpdateCoalescer::Tooltip
+UpdateCoalescer::offerTooltip(const QString &text, Clock::time_point now,
+                              bool urgent) {
+  ++tooltipOffers_;
+  if (tooltip_ == text) {
+    // A change that was still waiting has been reverted.
+    pending_.reset();
+    return Tooltip::Skip;
+  }
+  if (!urgent && tooltip_ && now - lastTooltip_ < interval_) {
+    pending_ = text;
+    return Tooltip::Defer;
+  }
+  pushed(text, now);
+  return Tooltip::Push;
+}
+
+UpdateCoalescer::Clock::duration
+UpdateCoalescer::tooltipWait(Clock::time_point now) const {
+  const Clock::duration left = lastTooltip_ + interval_ - now;
+  return left > Clock::duration::zero() ? left : Clock::duration::zero();
+}
+
+std::optional<QString> UpdateCoalescer::flushTooltip(Clock::time_point now) {
+  if (!pending_ || tooltipWait(now) > Clock::duration::zero())
+    return std::nullopt;
+  // The offer was counted when it was deferred.
+  QString text = std::move(*pending_);
+  pushed(text, now);
+  return text;
+}
+
+void UpdateCoalescer::reset() {
+  icon_.reset();
+  tooltip_.reset();
+  pending_.reset();
+}
+
+void UpdateCoalescer::pushed(const QString &text, Clock::time_point now) {
+  tooltip_ = text;
+  pending_.reset();
+  lastTooltip_ = now;
+  ++tooltipPushes_;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <QString>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+/**
+ * @brief Decides which tray updates are worth pushing to the shell.
+ *
+ * Every icon or tooltip change becomes a StatusNotifierItem signal on
+ * D-Bus and a repaint in each panel, so the icon is only pushed when its
+ * key changes and the tooltip only when its text changes. Tooltip pushes
+ * are further held to one per interval; a change arriving sooner is kept
+ * pending and pushed by flushTooltip() once the interval has passed.
+ * Urgent tooltips, such as those accompanying a state change, bypass the
+ * interval. Every offer that does not lead to a push counts as skipped.
+ */
+class UpdateCoalescer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// What the caller should do with an offered tooltip.
+  enum class Tooltip {
+    Push,  ///< Set it now.
+    Defer, ///< Call flushTooltip() after tooltipWait().
+    Skip   ///< Unchanged; nothing to do.
+  };
+
+  explicit UpdateCoalescer(std::chrono::milliseconds tooltipInterval = {});
+
+  /// Shortest time between two tooltip pushes.
+  void setTooltipInterval(std::chrono::milliseconds interval) {
+    interval_ = interval;
+  }
+
+  /// True when @p key differs from the icon pushed last.
+  bool offerIcon(std::int64_t key);
+
+  Tooltip offerTooltip(const QString &text, Clock::time_point now,
+                       bool urgent = false);
+
+  /// Time until a deferred tooltip may be pushed.
+  Clock::duration tooltipWait(Clock::time_point now) const;
+
+  /// The pending tooltip, if one is due, marked as pushed.
+  std::optional<QString> flushTooltip(Clock::time_point now);
+
+  /// Forget what was pushed, so the next offers push unconditionally.
+  void reset();
+
+  std::uint64_t skippedIcons() const { return iconOffers_ - iconPushes_; }
+  std::uint64_t skippedTooltips() const {
+    return tooltipOffers_ - tooltipPushes_;
+  }
+
+private:
+  void pushed(const QString &text, Clock::time_point now);
+
+  std::chrono::milliseconds interval_;
+  std::optional<std::int64_t> icon_;
+  std::optional<QString> tooltip_;
+  std::optional<QString> pending_;
+  Clock::time_point lastTooltip_{};
+  std::uint64_t iconOffers_ = 0;
+  std::uint64_t iconPushes_ = 0;
+  std::uint64_t tooltipOffers_ = 0;
+  std::uint64_t tooltipPushes_ = 0;
+};
@@ -0,0 +1,106 @@
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include "agent.h"
+
+namespace {
+struct StubProbe : SystemProbe {
+  ProbeSample s;
+  explicit StubProbe(const ProbeSample &sample) : s(sample) {}
+  std::optional<ProbeSample> sample() const override { return s; }
+};
+
+std::string readAll(std::FILE *f) {
+  std::rewind(f);
+  std::string out;
+  char buf[256];
+  std::size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+    out.append(buf, n);
+  return out;
+}
+} // namespace
+
+TEST_CASE("sample line holds the readings as JSON") {
+  Sampler::Snapshot snap;
+  snap.state = PressureState::Orange;
+  snap.interval_ms = 250;
+  snap.sample = ProbeSample{};
+  snap.sample->mem_available_kib = 1024;
+  snap.sample->some = PsiValues{1.5, 0.25, 0.0, 42};
+  snap.sample->cpu.some = PsiValues{3.0, 0.0, 0.0, 7};
+  CgroupSample cg;
+  cg.path = "user.slice/\"odd\"\n";
+  cg.current_kib = 10;
+  snap.sample->cgroups.push_back(cg);
+
+  const std::string line = AgentWriter::sampleLine(snap, 1000);
+  CHECK(line.rfind("{\"type\":\"sample\",\"time_ms\":1000,"
+                   "\"state\":\"orange\",\"interval_ms\":250,"
+                   "\"mem_available_kib\":1024,",
+                   0) == 0);
+  CHECK(line.find("\"some\":{\"avg10\":1.50,\"avg60\":0.25,\"avg300\":0.00,"
+                  "\"total\":42}") != std::string::npos);
+  CHECK(line.find("\"cpu\":{\"some\":{\"avg10\":3.00") != std::string::npos);
+  CHECK(line.find("\"io\"") == std::string::npos);
+  CHECK(line.find("\"mem_total_kib\"") == std::string::npos);
+  CHECK(line.find("\"cgroups\":[{\"path\":\"user.slice/\\\"odd\\\"\\n\","
+                  "\"current_kib\":10,") != std::string::npos);
+  CHECK(line.back() == '}');
+
+  snap.sample.reset();
+  CHECK(AgentWriter::sampleLine(snap, 5) ==
+        "{\"type\":\"sample\",\"time_ms\":5,\"state\":\"orange\","
+        "\"interval_ms\":250,\"error\":\"probe failed\"}");
+}
+
+TEST_CASE("writer announces transitions before the sample") {
+  std::FILE *f = std::tmpfile();
+  REQUIRE(f);
+  AgentWriter writer(f, false);
+  Sampler::Snapshot snap;
+  auto at = [&](long ms) {
+    snap.time = std::chrono::system_clock::time_point(
+        std::chrono::milliseconds(ms));
+    return snap;
+  };
+  writer.write(at(1));
+  snap.state = PressureState::Red;
+  writer.write(at(2));
+  writer.write(at(3));
+  CHECK(readAll(f) == AgentWriter::transitionLine(PressureState::Green,
+                                                  PressureState::Red, 2) +
+                          "\n");
+  std::fclose(f);
+
+  f = std::tmpfile();
+  REQUIRE(f);
+  AgentWriter all(f);
+  all.write(at(1));
+  CHECK(readAll(f) == AgentWriter::sampleLine(snap, 1) + "\n");
+  std::fclose(f);
+}
+
+TEST_CASE("drainEach hands over snapshots oldest first") {
+  AppConfig cfg;
+  ProbeSample low;
+  low.mem_available_kib = cfg.mem.available_crit_kib - 1;
+  Sampler sampler(std::make_unique<StubProbe>(low), cfg);
+  const auto before = std::chrono::system_clock::now();
+  sampler.tick();
+  sampler.tick();
+  std::vector<PressureState> states;
+  std::vector<std::chrono::system_clock::time_point> times;
+  CHECK(sampler.drainEach([&](const Sampler::Snapshot &s) {
+    states.push_back(s.state);
+    times.push_back(s.time);
+  }) == 2);
+  CHECK(states == std::vector<PressureState>{PressureState::Red,
+                                             PressureState::Red});
+  // Stamped when sampled, not when drained.
+  CHECK(times[0] >= before);
+  CHECK(times[1] >= times[0]);
+  CHECK(sampler.drainEach([](const Sampler::Snapshot &) {}) == 0);
+}
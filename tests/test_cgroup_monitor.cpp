@@ -0,0 +1,159 @@
+#include <catch2/catch_all.hpp>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "cgroup_monitor.h"
+
+namespace {
+namespace fs = std::filesystem;
+
+void writeFile(const fs::path& path, const std::string& content) {
+    std::ofstream out(path);
+    out << content;
+}
+
+/// Create a cgroup directory with the memory controller files.
+void makeCgroup(const fs::path& dir, long currentKib, const std::string& max,
+                double someAvg10) {
+    fs::create_directories(dir);
+    writeFile(dir / "memory.current", std::to_string(currentKib * 1024) + "\n");
+    writeFile(dir / "memory.max", max + "\n");
+    writeFile(dir / "memory.high", "max\n");
+    writeFile(dir / "memory.stat", "anon 2048\nfile 4096\nkernel 1024\n");
+    std::ostringstream psi;
+    psi << "some avg10=" << someAvg10 << " avg60=0.00 avg300=0.00 total=1\n"
+        << "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n";
+    writeFile(dir / "memory.pressure", psi.str());
+}
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+} // namespace
+
+TEST_CASE("rescan finds cgroups with the memory controller") {
+    fs::path root = fs::temp_directory_path() / "cgroup_rescan";
+    fs::remove_all(root);
+    makeCgroup(root / "user.slice", 100, "max", 0.0);
+    makeCgroup(root / "system.slice" / "foo.service", 100, "max", 0.0);
+    makeCgroup(root / "a" / "b" / "c" / "too_deep", 100, "max", 0.0);
+    fs::create_directories(root / "no_memory");
+    writeFile(root / "memory.pressure", "some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+
+    CgroupMonitor shallow(root.string(), 1);
+    CHECK(shallow.rescan() == 1); // user.slice; system.slice lacks memory.current
+
+    CgroupMonitor monitor(root.string(), 3);
+    CHECK(monitor.rescan() == 2);
+    fs::remove_all(root);
+}
+
+TEST_CASE("sample keeps the worst cgroups by pressure then usage") {
+    fs::path root = fs::temp_directory_path() / "cgroup_worst";
+    fs::remove_all(root);
+    makeCgroup(root / "calm", 100, "max", 0.0);
+    makeCgroup(root / "pressured", 100, "max", 5.5);
+    makeCgroup(root / "full", 900, std::to_string(1000 * 1024), 0.0);
+    makeCgroup(root / "roomy", 100, std::to_string(1000 * 1024), 0.0);
+
+    CgroupMonitor monitor(root.string());
+    REQUIRE(monitor.rescan() == 4);
+    std::vector<CgroupSample> worst;
+    monitor.sample(worst, 2);
+    REQUIRE(worst.size() == 2);
+    CHECK(worst[0].path == "pressured");
+    CHECK(worst[0].some.avg10 == Catch::Approx(5.5));
+    CHECK_FALSE(worst[0].max_kib);
+    CHECK_FALSE(worst[0].high_kib);
+    CHECK(worst[1].path == "full");
+    CHECK(worst[1].current_kib == 900);
+    REQUIRE(worst[1].max_kib);
+    CHECK(*worst[1].max_kib == 1000);
+    REQUIRE(worst[1].anon_kib);
+    REQUIRE(worst[1].file_kib);
+    CHECK(*worst[1].anon_kib == 2);
+    CHECK(*worst[1].file_kib == 4);
+
+    monitor.sample(worst, 0);
+    CHECK(worst.empty());
+    fs::remove_all(root);
+}
+
+TEST_CASE("rescan keeps existing cgroups and drops removed ones") {
+    fs::path root = fs::temp_directory_path() / "cgroup_churn";
+    fs::remove_all(root);
+    makeCgroup(root / "a", 100, "max", 1.0);
+    makeCgroup(root / "b", 200, "max", 2.0);
+
+    CgroupMonitor monitor(root.string());
+    REQUIRE(monitor.rescan() == 2);
+    // An unlinked file stays readable through the descriptor kept open.
+    fs::remove(root / "a" / "memory.current");
+    makeCgroup(root / "c", 300, "max", 3.0);
+    fs::remove_all(root / "b");
+    CHECK(monitor.rescan() == 2);
+
+    std::vector<CgroupSample> worst;
+    monitor.sample(worst, 5);
+    REQUIRE(worst.size() == 2);
+    CHECK(worst[0].path == "c");
+    CHECK(worst[1].path == "a");
+    CHECK(worst[1].current_kib == 100);
+    fs::remove_all(root);
+}
+
+TEST_CASE("cgroup triggers are written to every cgroup, including new ones") {
+    fs::path root = fs::temp_directory_path() / "cgroup_triggers";
+    fs::remove_all(root);
+    makeCgroup(root / "a", 100, "max", 0.0);
+
+    CgroupMonitor monitor(root.string());
+    monitor.rescan();
+    CHECK(monitor.eventFd() >= 0);
+    // Regular files cannot join an epoll set, so only the writes are checked.
+    monitor.enableTriggers({{SystemProbe::PsiType::Some, 150000, 1000000}});
+    CHECK(readFile(root / "a" / "memory.pressure").find("some 150000 1000000\n") !=
+          std::string::npos);
+
+    makeCgroup(root / "b", 100, "max", 0.0);
+    monitor.rescan();
+    CHECK(readFile(root / "b" / "memory.pressure").find("some 150000 1000000\n") !=
+          std::string::npos);
+    CHECK(monitor.drainEvents() == 0);
+    fs::remove_all(root);
+}
+
+TEST_CASE("triggers of a removed cgroup leave the epoll set") {
+    fs::path root = fs::temp_directory_path() / "cgroup_removed";
+    fs::remove_all(root);
+    makeCgroup(root / "gone", 100, "max", 0.0);
+    // A pseudo-terminal stands in for the kernfs file: once its master is
+    // closed it reports EPOLLERR | EPOLLHUP on every wait, as the trigger of
+    // a removed cgroup does.
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    REQUIRE(master >= 0);
+    REQUIRE(grantpt(master) == 0);
+    REQUIRE(unlockpt(master) == 0);
+    fs::remove(root / "gone" / "memory.pressure");
+    fs::create_symlink(ptsname(master), root / "gone" / "memory.pressure");
+
+    CgroupMonitor monitor(root.string());
+    REQUIRE(monitor.rescan() == 1);
+    REQUIRE(monitor.enableTriggers({{SystemProbe::PsiType::Some, 150000, 1000000}}));
+    pollfd pfd{monitor.eventFd(), POLLIN, 0};
+    CHECK(poll(&pfd, 1, 0) == 0);
+
+    ::close(master);
+    CHECK(poll(&pfd, 1, 0) == 1);
+    CHECK(monitor.drainEvents() == 0);
+    // Without a rescan, the set no longer wakes the sampler.
+    CHECK(poll(&pfd, 1, 0) == 0);
+    fs::remove_all(root);
+}
@@ -6,6 +6,7 @@
 #include <QTextStream>
 #include <cstdlib>
 #include "config.h"
+#include "pressure_state.h"
 
 namespace {
 QString resourcePath(const QString& relative) {
@@ -132,6 +133,7 @@ TEST_CASE("load thresholds from nohang config") {
     REQUIRE(appConf.open());
     AppConfig cfg;
     REQUIRE(cfg.load(appConf.fileName()));
+    CHECK(cfg.toml_loaded);
 
     CHECK(cfg.mem.available_warn_kib == 512 * 1024);
     CHECK(cfg.mem.available_warn_exit_kib == 512 * 1024 * 6 / 5);
@@ -272,4 +274,331 @@ TEST_CASE("load fails when config files missing") {
     EnvGuard home("HOME", QByteArray("/nowhere"));
     AppConfig cfg;
     CHECK_FALSE(cfg.load("/nonexistent.toml"));
+    CHECK_FALSE(cfg.toml_loaded);
+}
+
+TEST_CASE("load adaptive sampling bounds from config") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[sample]\n";
+    ts << "interval_ms = 1000\n";
+    ts << "min_interval_ms = 200\n";
+    ts << "max_interval_ms = 5000\n";
+    ts << "ramp = 2.0\n";
+    ts << "calm_ticks = 3\n";
+    ts.flush();
+
+    AppConfig cfg;
+    REQUIRE(cfg.load(tmp.fileName()));
+    CHECK(cfg.sample_interval_ms == 1000);
+    CHECK(cfg.sample.min_interval_ms == 200);
+    CHECK(cfg.sample.max_interval_ms == 5000);
+    CHECK(cfg.sample.ramp == Catch::Approx(2.0));
+    CHECK(cfg.sample.calm_ticks == 3);
+}
+
+TEST_CASE("load cpu, io and irq pressure thresholds and triggers") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[psi.cpu]\n";
+    ts << "avg10_warn = 30\n";
+    ts << "avg10_crit_exit = 55\n";
+    ts << "[psi.io]\n";
+    ts << "avg10_crit = 45\n";
+    ts << "[psi.io.trigger]\n";
+    ts << "full = \"50000 1000000\"\n";
+    ts << "[psi.irq]\n";
+    ts << "avg10_warn_exit = 2.5\n";
+    ts.flush();
+
+    AppConfig cfg;
+    REQUIRE(cfg.load(tmp.fileName()));
+    CHECK(cfg.psi.cpu.avg10_warn == Catch::Approx(30.0));
+    CHECK(cfg.psi.cpu.avg10_warn_exit == Catch::Approx(24.0));
+    CHECK(cfg.psi.cpu.avg10_crit == 0.0);
+    CHECK(cfg.psi.cpu.avg10_crit_exit == Catch::Approx(55.0));
+    CHECK(cfg.psi.io.avg10_crit == Catch::Approx(45.0));
+    CHECK(cfg.psi.io.avg10_crit_exit == Catch::Approx(36.0));
+    CHECK_FALSE(cfg.psi.io.trigger.some);
+    REQUIRE(cfg.psi.io.trigger.full);
+    CHECK(cfg.psi.io.trigger.full->stall_us == 50000);
+    CHECK(cfg.psi.io.trigger.full->window_us == 1000000);
+    CHECK(cfg.psi.irq.avg10_warn_exit == Catch::Approx(2.5));
+    CHECK_FALSE(cfg.psi.trigger.some);
+}
+
+TEST_CASE("load cgroup monitoring settings") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[cgroup]\n";
+    ts << "enabled = true\n";
+    ts << "root = \"/tmp/cg\"\n";
+    ts << "max_depth = 2\n";
+    ts << "top_n = 5\n";
+    ts << "rescan_ticks = 10\n";
+    ts << "[cgroup.trigger]\n";
+    ts << "some = \"100000 1000000\"\n";
+    ts.flush();
+
+    AppConfig cfg;
+    CHECK_FALSE(cfg.cgroup.enabled);
+    REQUIRE(cfg.load(tmp.fileName()));
+    CHECK(cfg.cgroup.enabled);
+    CHECK(cfg.cgroup.root == "/tmp/cg");
+    CHECK(cfg.cgroup.max_depth == 2);
+    CHECK(cfg.cgroup.top_n == 5);
+    CHECK(cfg.cgroup.rescan_ticks == 10);
+    REQUIRE(cfg.cgroup.trigger.some);
+    CHECK(cfg.cgroup.trigger.some->stall_us == 100000);
+    CHECK_FALSE(cfg.cgroup.trigger.full);
+}
+
+TEST_CASE("load process scanner settings") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[process]\n";
+    ts << "enabled = true\n";
+    ts << "top_n = 3\n";
+    ts << "workers = 4\n";
+    ts << "budget_ms = 5\n";
+    ts << "sort = \"swap\"\n";
+    ts.flush();
+
+    AppConfig cfg;
+    REQUIRE(cfg.load(tmp.fileName()));
+    CHECK(cfg.process.enabled);
+    CHECK(cfg.process.top_n == 3);
+    CHECK(cfg.process.workers == 4);
+    CHECK(cfg.process.budget_ms == 5);
+    CHECK(cfg.process.sort == "swap");
+}
+
+TEST_CASE("load extra meminfo fields for the tooltip") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[ui]\n";
+    ts << "meminfo_fields = [\"Shmem\", \"NoSuchKey\", \"HugePages_Total\"] # extras\n";
+    ts << "tooltip_min_interval_ms = 250\n";
+    ts << "tooltip_template = \"{state}: {mem_available}\"\n";
+    ts << "icon = \"sparkline\"\n";
+    ts << "sparkline_samples = 48\n";
+    ts.flush();
+
+    AppConfig cfg;
+    CHECK(cfg.ui.tooltip_min_interval_ms == 1000);
+    CHECK(cfg.ui.tooltip_template.empty());
+    REQUIRE(cfg.load(tmp.fileName()));
+    CHECK(cfg.ui.tooltip_min_interval_ms == 250);
+    CHECK(cfg.ui.tooltip_template.source() == "{state}: {mem_available}");
+    CHECK(cfg.ui.icon == "sparkline");
+    CHECK(cfg.ui.sparkline_samples == 48);
+    REQUIRE(cfg.ui.meminfo_fields.size() == 2);
+    CHECK(cfg.ui.meminfo_fields[0] == MeminfoField::Shmem);
+    CHECK(cfg.ui.meminfo_fields[1] == MeminfoField::HugePagesTotal);
+}
+
+TEST_CASE("load thrash thresholds") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[thrash]\n";
+    ts << "refault_per_sec = 2500\n";
+    ts << "swapin_exit_per_sec = 100\n";
+    ts << "allocstall_per_sec = 7\n";
+    ts.flush();
+
+    AppConfig cfg;
+    REQUIRE(cfg.load(tmp.fileName()));
+    CHECK(cfg.thrash.refault_per_sec == Catch::Approx(2500.0));
+    CHECK(cfg.thrash.refault_exit_per_sec == Catch::Approx(8000.0));
+    CHECK(cfg.thrash.swapin_exit_per_sec == Catch::Approx(100.0));
+    CHECK(cfg.thrash.allocstall_per_sec == Catch::Approx(7.0));
+}
+
+TEST_CASE("load history settings") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[history]\n";
+    ts << "enabled = true\n";
+    ts << "path = \"/tmp/h.bin\"\n";
+    ts << "capacity = 100\n";
+    ts << "archive = true\n";
+    ts << "archive_path = \"/tmp/a.bin\"\n";
+    ts.flush();
+
+    AppConfig cfg;
+    CHECK(cfg.history.path.isEmpty());
+    CHECK_FALSE(cfg.history.archive);
+    REQUIRE(cfg.load(tmp.fileName()));
+    CHECK(cfg.history.enabled);
+    CHECK(cfg.history.path == "/tmp/h.bin");
+    CHECK(cfg.history.capacity == 100);
+    CHECK(cfg.history.archive);
+    CHECK(cfg.history.archive_path == "/tmp/a.bin");
+}
+
+TEST_CASE("load metrics settings") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[metrics]\n";
+    ts << "listen = \"127.0.0.1:9101\"\n";
+    ts.flush();
+
+    AppConfig cfg;
+    CHECK(cfg.metrics.listen.isEmpty());
+    REQUIRE(cfg.load(tmp.fileName()));
+    CHECK(cfg.metrics.listen == "127.0.0.1:9101");
+}
+
+TEST_CASE("load inline tables, multi-line arrays and escaped strings") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[psi]\n";
+    ts << "trigger = { some = \"10 100\", full = [20, 200] }\n";
+    ts << "io = { avg10_warn = 25.0, trigger.some = \"1 2\" }\n";
+    ts << "[ui]\n";
+    ts << "meminfo_fields = [\n";
+    ts << "    \"Shmem\",   # shared memory\n";
+    ts << "    \"Dirty\",\n";
+    ts << "]\n";
+    ts << "tooltip_template = \"{state}\\n{mem_available} # free\"\n";
+    ts << "[ui.palette]\n";
+    ts << "red = 'shield-red#2'\n";
+    ts << "[history]\n";
+    ts << "capacity = 65_536\n";
+    ts.flush();
+
+    AppConfig cfg;
+    REQUIRE(cfg.load(tmp.fileName()));
+    REQUIRE(cfg.psi.trigger.some);
+    CHECK(cfg.psi.trigger.some->stall_us == 10);
+    CHECK(cfg.psi.trigger.some->window_us == 100);
+    REQUIRE(cfg.psi.trigger.full);
+    CHECK(cfg.psi.trigger.full->stall_us == 20);
+    CHECK(cfg.psi.trigger.full->window_us == 200);
+    CHECK(cfg.psi.io.avg10_warn == Catch::Approx(25.0));
+    REQUIRE(cfg.psi.io.trigger.some);
+    CHECK(cfg.psi.io.trigger.some->window_us == 2);
+    REQUIRE(cfg.ui.meminfo_fields.size() == 2);
+    CHECK(cfg.ui.meminfo_fields[0] == MeminfoField::Shmem);
+    CHECK(cfg.ui.meminfo_fields[1] == MeminfoField::Dirty);
+    CHECK(cfg.ui.tooltip_template.source() == "{state}\n{mem_available} # free");
+    CHECK(cfg.palette.red == "shield-red#2");
+    CHECK(cfg.history.capacity == 65536);
+}
+
+TEST_CASE("load forecast settings") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[forecast]\n";
+    ts << "horizon_sec = 90\n";
+    ts << "horizon_exit_sec = 120\n";
+    ts << "window_sec = 15.5\n";
+    ts.flush();
+
+    AppConfig cfg;
+    CHECK(cfg.forecast.horizon_sec == Catch::Approx(60.0));
+    REQUIRE(cfg.load(tmp.fileName()));
+    CHECK(cfg.forecast.horizon_sec == Catch::Approx(90.0));
+    CHECK(cfg.forecast.horizon_exit_sec == Catch::Approx(120.0));
+    CHECK(cfg.forecast.window_sec == Catch::Approx(15.5));
+}
+
+TEST_CASE("load policy rules") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QDir().mkpath(dir.filePath("nohang"));
+    QFile(dir.filePath("nohang/nohang.conf")).open(QIODevice::WriteOnly);
+    EnvGuard xdg("XDG_CONFIG_HOME", dir.path().toLocal8Bit());
+
+    QTemporaryFile tmp;
+    REQUIRE(tmp.open());
+    QTextStream ts(&tmp);
+    ts << "[policy]\n";
+    ts << "rules = [\n";
+    ts << "  \"red if psi.some.avg10 >= 1.0 exit 0.8\",\n";
+    ts << "  \"yellow if mem.available_kib <= mem.available_warn_kib\",\n";
+    ts << "  \"yellow if nonsense\",\n";
+    ts << "]\n";
+    ts.flush();
+
+    AppConfig cfg;
+    CHECK(cfg.policy.rules.empty());
+    REQUIRE(cfg.load(tmp.fileName()));
+    CHECK(cfg.policy.rules.size() == 2);
+
+    ProbeSample s;
+    s.mem_available_kib = cfg.mem.available_warn_kib * 4;
+    s.some.avg10 = 0.9;
+    CHECK(decidePressure(s, cfg, PressureState::Green) == PressureState::Green);
+    CHECK(decidePressure(s, cfg, PressureState::Red) == PressureState::Red);
 }
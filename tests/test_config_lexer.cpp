@@ -0,0 +1,165 @@
+#include <catch2/catch_all.hpp>
+#include "config_lexer.h"
+#include <string>
+#include <vector>
+
+namespace {
+struct Parsed {
+  std::string key;
+  ConfigEntry::Kind kind;
+  std::string text;
+  std::vector<std::string> items;
+  int line;
+};
+
+std::vector<Parsed> toml(std::string_view text, std::size_t *skipped = nullptr) {
+  std::vector<Parsed> out;
+  std::size_t n = parseToml(text, [&](const ConfigEntry &e) {
+    out.push_back({std::string(e.key), e.kind, std::string(e.text),
+                   {e.items.begin(), e.items.end()}, e.line});
+  });
+  if (skipped)
+    *skipped = n;
+  return out;
+}
+} // namespace
+
+TEST_CASE("keys are reported with their table path") {
+  auto entries = toml("top = 1\n"
+                      "[psi]\n"
+                      "avg10_warn = 0.5 # comment\n"
+                      "\n"
+                      "  [ psi.io . trigger ]\n"
+                      "some = \"10 100\"\n"
+                      "trigger.full = '20 200'\n"
+                      "\"quoted key\" = true\n");
+  REQUIRE(entries.size() == 5);
+  CHECK(entries[0].key == "top");
+  CHECK(entries[1].key == "psi.avg10_warn");
+  CHECK(entries[1].kind == ConfigEntry::Kind::Bare);
+  CHECK(entries[1].text == "0.5");
+  CHECK(entries[1].line == 3);
+  CHECK(entries[2].key == "psi.io.trigger.some");
+  CHECK(entries[2].kind == ConfigEntry::Kind::String);
+  CHECK(entries[2].text == "10 100");
+  CHECK(entries[3].key == "psi.io.trigger.trigger.full");
+  CHECK(entries[3].text == "20 200");
+  CHECK(entries[4].key == "psi.io.trigger.quoted key");
+}
+
+TEST_CASE("unquoted values run to the end of the line") {
+  auto entries = toml("[psi.trigger]\nsome = 10 100   # stall, window\n");
+  REQUIRE(entries.size() == 1);
+  CHECK(entries[0].kind == ConfigEntry::Kind::Bare);
+  CHECK(entries[0].text == "10 100");
+}
+
+TEST_CASE("basic strings resolve escapes and literal strings keep them") {
+  auto entries = toml(R"(a = "x\ty\n\"q\" \\ \u00e9 \q"
+b = 'C:\path # not a comment'
+c = "# not a comment either"
+)");
+  REQUIRE(entries.size() == 3);
+  CHECK(entries[0].text == "x\ty\n\"q\" \\ \xc3\xa9 \\q");
+  CHECK(entries[1].text == "C:\\path # not a comment");
+  CHECK(entries[2].text == "# not a comment either");
+}
+
+TEST_CASE("multi-line strings span lines") {
+  auto entries = toml("t = \"\"\"\n"
+                      "first\n"
+                      "second \\\n"
+                      "   third\"\"\"\n"
+                      "l = '''\n"
+                      "raw \\n'''\n"
+                      "after = 1\n");
+  REQUIRE(entries.size() == 3);
+  CHECK(entries[0].text == "first\nsecond third");
+  CHECK(entries[1].text == "raw \\n");
+  CHECK(entries[2].key == "after");
+  CHECK(entries[2].line == 7);
+}
+
+TEST_CASE("arrays collect their items over several lines") {
+  auto entries = toml("[ui]\n"
+                      "fields = [\n"
+                      "  \"Shmem\",   # shared\n"
+                      "  'Dirty',\n"
+                      "  42\n"
+                      "]\n"
+                      "empty = []\n"
+                      "next = 1\n");
+  REQUIRE(entries.size() == 3);
+  CHECK(entries[0].key == "ui.fields");
+  CHECK(entries[0].kind == ConfigEntry::Kind::Array);
+  CHECK(entries[0].items == std::vector<std::string>{"Shmem", "Dirty", "42"});
+  CHECK(entries[1].items.empty());
+  CHECK(entries[2].key == "ui.next");
+  CHECK(entries[2].line == 8);
+}
+
+TEST_CASE("inline tables are flattened into dotted keys") {
+  auto entries = toml("[psi]\n"
+                      "trigger = { some = \"10 100\", full = [20, 200] }\n"
+                      "io = { avg10_warn = 20, trigger = { some = '1 2' } }\n"
+                      "none = {}\n");
+  REQUIRE(entries.size() == 4);
+  CHECK(entries[0].key == "psi.trigger.some");
+  CHECK(entries[0].text == "10 100");
+  CHECK(entries[1].key == "psi.trigger.full");
+  CHECK(entries[1].items == std::vector<std::string>{"20", "200"});
+  CHECK(entries[2].key == "psi.io.avg10_warn");
+  CHECK(entries[2].text == "20");
+  CHECK(entries[3].key == "psi.io.trigger.some");
+}
+
+TEST_CASE("malformed lines are skipped and parsing goes on") {
+  std::size_t skipped = 0;
+  auto entries = toml("junk line without equals\n"
+                      "[unclosed\n"
+                      "a = \"unterminated\n"
+                      "b = [1, , 2]\n"
+                      "c = 3\n"
+                      "= 4\n"
+                      "d =\n",
+                      &skipped);
+  REQUIRE(entries.size() == 1);
+  CHECK(entries[0].key == "c");
+  CHECK(skipped == 6);
+}
+
+TEST_CASE("numbers accept TOML signs and separators") {
+  CHECK(ConfigEntry::parseLong("1_000_000") == 1000000);
+  CHECK(ConfigEntry::parseLong("+42") == 42);
+  CHECK(ConfigEntry::parseLong("-7") == -7);
+  CHECK_FALSE(ConfigEntry::parseLong("12 kB"));
+  CHECK_FALSE(ConfigEntry::parseLong("0.5"));
+  CHECK_FALSE(ConfigEntry::parseLong(""));
+  CHECK(ConfigEntry::parseDouble("0.5") == 0.5);
+  CHECK(ConfigEntry::parseDouble("1e3") == 1000.0);
+  CHECK(ConfigEntry::parseDouble("+1_0.5") == 10.5);
+  CHECK_FALSE(ConfigEntry::parseDouble("0.5x"));
+  ConfigEntry e;
+  e.text = "3000000000";
+  CHECK_FALSE(e.toInt());
+  e.text = "300";
+  CHECK(e.toInt() == 300);
+}
+
+TEST_CASE("nohang.conf lines are split at the first equals sign") {
+  std::vector<std::pair<std::string, std::string>> entries;
+  parseNohangConf("# comment\n"
+                  "@LOW_MEMORY_WARNINGS\n"
+                  "  warning_threshold_min_mem = 20 %   # trailing\n"
+                  "no equals here\n"
+                  "soft_threshold_max_psi=60\r\n"
+                  "last = x",
+                  [&](const ConfigEntry &e) {
+                    CHECK(e.kind == ConfigEntry::Kind::Bare);
+                    entries.emplace_back(e.key, e.text);
+                  });
+  REQUIRE(entries.size() == 3);
+  CHECK(entries[0] == std::pair<std::string, std::string>{"warning_threshold_min_mem", "20 %"});
+  CHECK(entries[1] == std::pair<std::string, std::string>{"soft_threshold_max_psi", "60"});
+  CHECK(entries[2] == std::pair<std::string, std::string>{"last", "x"});
+}
@@ -0,0 +1,124 @@
+#include <catch2/catch_all.hpp>
+#include "forecast.h"
+
+namespace {
+ProbeSample memSample(long availableKib, double someAvg10 = 0.0) {
+  ProbeSample s;
+  s.mem_available_kib = availableKib;
+  s.some.avg10 = someAvg10;
+  return s;
+}
+} // namespace
+
+TEST_CASE("regression recovers the slope of a straight line") {
+  TrendRegression r;
+  for (int i = 0; i < 10; ++i)
+    r.update(1000.0 - 25.0 * i, i ? 2.0 : 0.0, 30.0);
+  REQUIRE(r.slope());
+  CHECK(*r.slope() == Catch::Approx(-12.5));
+  CHECK(r.samples() == 10);
+  r.reset();
+  CHECK(r.samples() == 0);
+  CHECK_FALSE(r.slope());
+}
+
+TEST_CASE("regression needs samples spread over time") {
+  TrendRegression r;
+  r.update(100.0, 0.0, 30.0);
+  r.update(90.0, 2.0, 30.0);
+  CHECK_FALSE(r.slope()); // two samples
+  r.update(80.0, 2.0, 30.0);
+  CHECK(r.slope());
+
+  // Trigger wakeups microseconds apart say nothing about the trend.
+  TrendRegression burst;
+  for (int i = 0; i < 10; ++i)
+    burst.update(100.0 - i, 1e-5, 30.0);
+  CHECK_FALSE(burst.slope());
+}
+
+TEST_CASE("regression follows a new trend as old samples fade") {
+  TrendRegression r;
+  for (int i = 0; i < 30; ++i)
+    r.update(500.0, i ? 2.0 : 0.0, 10.0);
+  CHECK(*r.slope() == Catch::Approx(0.0).margin(1e-9));
+  double y = 500.0;
+  for (int i = 0; i < 30; ++i) {
+    y -= 20.0;
+    r.update(y, 2.0, 10.0);
+  }
+  // After six time constants the flat start barely counts.
+  CHECK(*r.slope() == Catch::Approx(-10.0).epsilon(0.03));
+}
+
+TEST_CASE("forecast extrapolates a falling MemAvailable to the crit threshold") {
+  AppConfig cfg;
+  ExhaustionForecast f;
+  const long crit = cfg.mem.available_crit_kib;
+  // 10 MiB/s down, sampled every 2 s.
+  long avail = crit + 2000 * 1024;
+  std::optional<double> eta;
+  for (int i = 0; i < 5; ++i) {
+    eta = f.update(memSample(avail), cfg, i ? 2.0 : 0.0);
+    avail -= 20 * 1024;
+  }
+  avail += 20 * 1024;
+  REQUIRE(eta);
+  CHECK(*eta == Catch::Approx(double(avail - crit) / (10 * 1024)));
+}
+
+TEST_CASE("forecast extrapolates rising PSI to avg10_crit") {
+  AppConfig cfg;
+  cfg.psi.avg10_crit = 10.0;
+  ExhaustionForecast f;
+  std::optional<double> eta;
+  for (int i = 0; i < 4; ++i)
+    eta = f.update(memSample(cfg.mem.available_warn_kib * 4, 1.0 + i),
+                   cfg, i ? 1.0 : 0.0);
+  REQUIRE(eta);
+  CHECK(*eta == Catch::Approx(6.0));
+}
+
+TEST_CASE("forecast ignores swap without swap space") {
+  AppConfig cfg;
+  ExhaustionForecast f;
+  std::optional<double> eta;
+  for (int i = 0; i < 5; ++i) {
+    ProbeSample s = memSample(cfg.mem.available_warn_kib * 4);
+    s.swap_free_kib = cfg.swap.free_crit_kib * 4 - i * 1024 * 100;
+    eta = f.update(s, cfg, 2.0);
+  }
+  CHECK_FALSE(eta);
+
+  ExhaustionForecast withSwap;
+  for (int i = 0; i < 5; ++i) {
+    ProbeSample s = memSample(cfg.mem.available_warn_kib * 4);
+    s.swap_free_kib = cfg.swap.free_crit_kib * 4 - i * 1024 * 100;
+    s.meminfo[static_cast<std::size_t>(MeminfoField::SwapTotal)] = 8 << 20;
+    s.meminfo_present |= std::uint64_t{1}
+                         << static_cast<std::size_t>(MeminfoField::SwapTotal);
+    eta = withSwap.update(s, cfg, 2.0);
+  }
+  CHECK(eta);
+}
+
+TEST_CASE("forecast stays quiet when steady, distant or already critical") {
+  AppConfig cfg;
+  ExhaustionForecast steady;
+  for (int i = 0; i < 10; ++i)
+    CHECK_FALSE(steady.update(memSample(cfg.mem.available_warn_kib * 2), cfg, 2.0));
+
+  // 1 KiB/s against gigabytes of headroom: far beyond kMaxSec.
+  ExhaustionForecast distant;
+  std::optional<double> eta;
+  for (int i = 0; i < 10; ++i)
+    eta = distant.update(memSample(cfg.mem.available_crit_kib + (8 << 20) - i * 2),
+                         cfg, 2.0);
+  CHECK_FALSE(eta);
+
+  ExhaustionForecast critical;
+  for (int i = 0; i < 5; ++i)
+    eta = critical.update(memSample(cfg.mem.available_crit_kib + 40 * 1024 - i * 20 * 1024),
+                          cfg, 2.0);
+  CHECK_FALSE(eta);
+}
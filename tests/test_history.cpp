@@ -0,0 +1,117 @@
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sys/stat.h>
+#include "history.h"
+
+namespace {
+namespace fs = std::filesystem;
+
+HistoryRecord record(long memAvailable, PressureState state) {
+  ProbeSample s;
+  s.mem_available_kib = memAvailable;
+  s.some.avg10 = 1.5;
+  return HistoryRecord::from(s, state, std::chrono::system_clock::now());
+}
+} // namespace
+
+TEST_CASE("HistoryRecord round-trips sample fields") {
+  ProbeSample s;
+  s.mem_available_kib = 123;
+  s.swap_free_kib = 45;
+  s.some.avg10 = 2.5;
+  s.full.total = 99;
+  s.io.full = PsiValues{7.5, 0, 0, 0};
+  s.vmstat = VmstatRates{};
+  s.vmstat->refault_anon = 300.0;
+  const auto now = std::chrono::system_clock::now();
+  auto rec = HistoryRecord::from(s, PressureState::Orange, now);
+  CHECK(rec.pressureState() == PressureState::Orange);
+  CHECK(std::chrono::abs(rec.time() - now) < std::chrono::milliseconds(1));
+
+  ProbeSample back = rec.sample();
+  REQUIRE(back.mem_available_kib);
+  CHECK(*back.mem_available_kib == 123);
+  CHECK(*back.swap_free_kib == 45);
+  CHECK_FALSE(back.mem_total_kib);
+  CHECK(back.some.avg10 == 2.5);
+  CHECK(back.full.total == 99);
+  CHECK_FALSE(back.cpu.avg10());
+  REQUIRE(back.io.avg10());
+  CHECK(*back.io.avg10() == 7.5);
+  REQUIRE(back.vmstat);
+  CHECK(back.vmstat->refault() == 300.0);
+}
+
+TEST_CASE("History wraps around and survives reopening") {
+  fs::path path = fs::temp_directory_path() / "nohang_history" / "h.bin";
+  fs::remove_all(path.parent_path());
+  {
+    History h(path.string(), 4);
+    REQUIRE(h.isOpen());
+    CHECK(h.size() == 0);
+    CHECK_FALSE(h.last());
+    for (long i = 1; i <= 6; ++i)
+      h.append(record(i, PressureState::Yellow));
+    CHECK(h.size() == 4);
+    CHECK(h.at(0)->mem_available_kib == 3);
+    CHECK_FALSE(h.at(4));
+    CHECK(h.last()->mem_available_kib == 6);
+  }
+  {
+    History h(path.string(), 4);
+    REQUIRE(h.size() == 4);
+    CHECK(h.at(0)->mem_available_kib == 3);
+    h.append(record(7, PressureState::Red));
+    CHECK(h.at(0)->mem_available_kib == 4);
+    CHECK(h.last()->pressureState() == PressureState::Red);
+  }
+  {
+    // A different capacity starts a fresh ring.
+    History h(path.string(), 8);
+    REQUIRE(h.isOpen());
+    CHECK(h.size() == 0);
+  }
+  fs::remove_all(path.parent_path());
+}
+
+TEST_CASE("History reserves the blocks of its file") {
+  fs::path path = fs::temp_directory_path() / "nohang_history_blocks.bin";
+  fs::remove(path);
+  {
+    History h(path.string(), 1024);
+    REQUIRE(h.isOpen());
+  }
+  struct stat st {};
+  REQUIRE(stat(path.c_str(), &st) == 0);
+  // No holes, so a full filesystem cannot fault a later store.
+  CHECK(static_cast<off_t>(st.st_blocks) * 512 >= st.st_size);
+  fs::remove(path);
+}
+
+TEST_CASE("History without a mapped file holds nothing") {
+  fs::path dir = fs::temp_directory_path() / "nohang_history_blocked";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  std::ofstream(dir / "file") << "not a directory";
+  History h((dir / "file" / "h.bin").string(), 4);
+  CHECK_FALSE(h.isOpen());
+  h.append(record(1, PressureState::Red));
+  CHECK(h.size() == 0);
+  CHECK_FALSE(h.at(0));
+  CHECK_FALSE(h.last());
+  fs::remove_all(dir);
+}
+
+TEST_CASE("History defaults to the XDG state directory") {
+  const char *old = std::getenv("XDG_STATE_HOME");
+  std::string saved = old ? old : "";
+  setenv("XDG_STATE_HOME", "/tmp/state", 1);
+  CHECK(History::defaultPath() == "/tmp/state/nohang-tr/history.bin");
+  if (old)
+    setenv("XDG_STATE_HOME", saved.c_str(), 1);
+  else
+    unsetenv("XDG_STATE_HOME");
+}
@@ -0,0 +1,48 @@
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+#include "latency_histogram.h"
+
+TEST_CASE("buckets bound every value within 1/16") {
+  CHECK(LatencyHistogram::bucket(0) == 0);
+  CHECK(LatencyHistogram::bucket(15) == 15);
+  std::size_t prev = 0;
+  for (std::uint64_t v : {16ull, 17ull, 31ull, 32ull, 1000ull, 123456789ull,
+                          ~0ull}) {
+    const std::size_t b = LatencyHistogram::bucket(v);
+    CHECK(b >= prev);
+    CHECK(b < LatencyHistogram::kBuckets);
+    const std::uint64_t upper = LatencyHistogram::bucketUpper(b);
+    CHECK(upper >= v);
+    CHECK(upper - v <= v / 16);
+    if (b + 1 < LatencyHistogram::kBuckets)
+      CHECK(LatencyHistogram::bucketUpper(b + 1) > upper);
+    prev = b;
+  }
+}
+
+TEST_CASE("percentiles follow the recorded distribution") {
+  LatencyHistogram h;
+  CHECK(h.percentile(50) == 0);
+  for (std::uint64_t v = 1; v <= 1000; ++v)
+    h.record(v * 1000);
+  CHECK(h.count() == 1000);
+  CHECK(h.max() == 1000000);
+  CHECK(h.percentile(50) == Catch::Approx(500000).epsilon(0.07));
+  CHECK(h.percentile(99) == Catch::Approx(990000).epsilon(0.07));
+  CHECK(h.percentile(100) == 1000000);
+  h.record(5000000000);
+  CHECK(h.max() == 5000000000);
+  CHECK(h.percentile(50) == Catch::Approx(500000).epsilon(0.07));
+}
+
+TEST_CASE("TickProfiler summarises each phase") {
+  TickProfiler p;
+  CHECK(p.summary(TickProfiler::Phase::Decide) == "decide: no samples");
+  const std::uint64_t start = TickProfiler::now();
+  p.finish(TickProfiler::Phase::Decide, start);
+  CHECK(p.histogram(TickProfiler::Phase::Decide).count() == 1);
+  CHECK(p.summary(TickProfiler::Phase::Decide).rfind("decide: p50 ", 0) == 0);
+  const std::string report = p.report();
+  CHECK(report.find("probe read: no samples\n") != std::string::npos);
+  CHECK(report.find("setToolTip: no samples\n") != std::string::npos);
+}
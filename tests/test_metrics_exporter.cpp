@@ -0,0 +1,175 @@
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "metrics_exporter.h"
+
+namespace {
+/// Minimal HTTP client standing in for the scraper.
+std::string fetch(const sockaddr *addr, socklen_t len,
+                  const std::string &request) {
+  int fd = socket(addr->sa_family, SOCK_STREAM, 0);
+  REQUIRE(fd >= 0);
+  REQUIRE(connect(fd, addr, len) == 0);
+  REQUIRE(write(fd, request.data(), request.size()) ==
+          static_cast<ssize_t>(request.size()));
+  std::string out;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0)
+    out.append(buf, static_cast<std::size_t>(n));
+  close(fd);
+  return out;
+}
+
+std::string fetchTcp(int port, const std::string &path) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<std::uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return fetch(reinterpret_cast<sockaddr *>(&addr), sizeof(addr),
+               "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+}
+
+bool contains(const std::string &text, const std::string &part) {
+  return text.find(part) != std::string::npos;
+}
+} // namespace
+
+TEST_CASE("endpoints parse") {
+  auto tcp = MetricsExporter::parseEndpoint("127.0.0.1:9101");
+  REQUIRE(tcp);
+  CHECK(tcp->host == "127.0.0.1");
+  CHECK(tcp->port == "9101");
+  auto v6 = MetricsExporter::parseEndpoint("[::1]:0");
+  REQUIRE(v6);
+  CHECK(v6->host == "::1");
+  auto unixEp = MetricsExporter::parseEndpoint("unix:/run/x.sock");
+  REQUIRE(unixEp);
+  CHECK(unixEp->unixPath == "/run/x.sock");
+  CHECK_FALSE(MetricsExporter::parseEndpoint("9101"));
+  CHECK_FALSE(MetricsExporter::parseEndpoint("localhost:"));
+  CHECK_FALSE(MetricsExporter::parseEndpoint(":9101"));
+  CHECK_FALSE(MetricsExporter::parseEndpoint("::1:9101"));
+  CHECK_FALSE(MetricsExporter::parseEndpoint("host:http"));
+  CHECK_FALSE(MetricsExporter::parseEndpoint("unix:"));
+}
+
+TEST_CASE("metrics text reflects samples and transitions") {
+  AppConfig cfg;
+  MetricsExporter exporter(cfg);
+  CHECK(contains(exporter.text(),
+                 "nohang_tr_memory_threshold_bytes{field=\"MemAvailable\","
+                 "level=\"warn\"} 536870912\n"));
+  CHECK_FALSE(contains(exporter.text(), "nohang_tr_state "));
+
+  ProbeSample s;
+  s.mem_available_kib = 1024;
+  s.some = PsiValues{1.5, 0.5, 0.25, 2000000};
+  s.io.full = PsiValues{3.0, 0, 0, 0};
+  exporter.update(s, PressureState::Green, std::chrono::milliseconds(2), 100,
+                  0);
+  exporter.update(s, PressureState::Red, std::chrono::milliseconds(4), 100, 3);
+  const std::string text = exporter.text();
+  CHECK(contains(text, "nohang_tr_state 3\n"));
+  CHECK(contains(text, "nohang_tr_probe_success 1\n"));
+  CHECK(contains(text, "nohang_tr_memory_bytes{field=\"MemAvailable\"} "
+                       "1048576\n"));
+  CHECK_FALSE(contains(text, "field=\"MemTotal\"} "));
+  CHECK(contains(text, "nohang_tr_pressure_percent{resource=\"memory\","
+                       "kind=\"some\",window=\"10s\"} 1.5\n"));
+  CHECK(contains(text, "nohang_tr_pressure_percent{resource=\"io\","
+                       "kind=\"full\",window=\"10s\"} 3\n"));
+  CHECK(contains(text, "nohang_tr_pressure_stall_seconds_total{resource="
+                       "\"memory\",kind=\"some\"} 2\n"));
+  CHECK(contains(text, "nohang_tr_state_transitions_total{from=\"green\","
+                       "to=\"red\"} 1\n"));
+  CHECK(contains(text, "nohang_tr_state_transitions_total{from=\"red\","
+                       "to=\"green\"} 0\n"));
+  CHECK(contains(text, "nohang_tr_sample_duration_seconds_count 2\n"));
+  CHECK(contains(text, "nohang_tr_sample_duration_seconds_sum 0.006"));
+  CHECK(contains(text, "nohang_tr_snapshots_dropped_total 3\n"));
+  CHECK(contains(text, "# TYPE nohang_tr_state gauge\n"));
+
+  exporter.update(std::nullopt, PressureState::Red, {}, 100, 3);
+  CHECK(contains(exporter.text(), "nohang_tr_probe_success 0\n"));
+  CHECK_FALSE(contains(exporter.text(), "nohang_tr_memory_bytes{"));
+}
+
+TEST_CASE("metrics text spells out non-finite values") {
+  AppConfig cfg;
+  MetricsExporter exporter(cfg);
+  ProbeSample s;
+  s.some = PsiValues{std::numeric_limits<double>::quiet_NaN(),
+                     std::numeric_limits<double>::infinity(),
+                     -std::numeric_limits<double>::infinity(), 0};
+  exporter.update(s, PressureState::Green, {}, 100, 0);
+  const std::string text = exporter.text();
+  CHECK(contains(text, "kind=\"some\",window=\"10s\"} NaN\n"));
+  CHECK(contains(text, "kind=\"some\",window=\"60s\"} +Inf\n"));
+  CHECK(contains(text, "kind=\"some\",window=\"300s\"} -Inf\n"));
+}
+
+TEST_CASE("exporter serves the cached text over TCP") {
+  AppConfig cfg;
+  MetricsExporter exporter(cfg);
+  REQUIRE(exporter.listen("127.0.0.1:0"));
+  REQUIRE(exporter.port() > 0);
+  ProbeSample s;
+  s.mem_available_kib = 1;
+  exporter.update(s, PressureState::Yellow, {}, 100, 0);
+
+  const std::string response = fetchTcp(exporter.port(), "/metrics");
+  CHECK(response.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+  CHECK(contains(response, "Content-Type: text/plain; version=0.0.4"));
+  const std::string text = exporter.text();
+  CHECK(contains(response,
+                 "Content-Length: " + std::to_string(text.size()) + "\r\n"));
+  CHECK(response.substr(response.size() - text.size()) == text);
+
+  CHECK(fetchTcp(exporter.port(), "/").rfind("HTTP/1.1 404", 0) == 0);
+
+  // A second exporter cannot take the same port.
+  MetricsExporter other(cfg);
+  CHECK_FALSE(other.listen("127.0.0.1:" + std::to_string(exporter.port())));
+}
+
+TEST_CASE("exporter serves over a Unix socket and removes it") {
+  namespace fs = std::filesystem;
+  const fs::path path = fs::temp_directory_path() / "nohang_metrics.sock";
+  AppConfig cfg;
+  {
+    MetricsExporter exporter(cfg);
+    REQUIRE(exporter.listen("unix:" + path.string()));
+    CHECK(exporter.port() == 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    path.string().copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+    const std::string response =
+        fetch(reinterpret_cast<sockaddr *>(&addr), sizeof(addr),
+              "HEAD /metrics HTTP/1.1\r\n\r\n");
+    CHECK(response.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+    CHECK(response.substr(response.size() - 4) == "\r\n\r\n");
+  }
+  CHECK_FALSE(fs::exists(path));
+}
+
+TEST_CASE("exporter leaves a file that is not a socket alone") {
+  namespace fs = std::filesystem;
+  const fs::path path = fs::temp_directory_path() / "nohang_metrics.txt";
+  std::ofstream(path) << "keep me";
+  {
+    MetricsExporter exporter(AppConfig{});
+    CHECK_FALSE(exporter.listen("unix:" + path.string()));
+  }
+  std::ifstream in(path);
+  std::string content;
+  std::getline(in, content);
+  CHECK(content == "keep me");
+  fs::remove(path);
+}
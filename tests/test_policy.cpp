@@ -0,0 +1,120 @@
+#include <catch2/catch_all.hpp>
+#include "policy.h"
+#include "pressure_state.h"
+#include <cmath>
+
+namespace {
+using State = PressureState;
+
+State eval(const Policy &p, const ProbeSample &s, const AppConfig &cfg,
+           State prev = State::Green) {
+  return p.evaluate({s, cfg, std::nullopt, 0.0}, prev);
+}
+} // namespace
+
+TEST_CASE("policy compiles the built-in rules") {
+  std::vector<std::string> errors;
+  Policy p = Policy::compile(Policy::defaultRules(), &errors);
+  CHECK(errors.empty());
+  CHECK(p.size() == Policy::defaultRules().size());
+  CHECK(Policy::defaults().size() == p.size());
+}
+
+TEST_CASE("policy reports and skips malformed rules") {
+  std::vector<std::string> errors;
+  Policy p = Policy::compile({"purple if psi.some.avg10 >= 1",
+                              "red if no.such.metric >= 1",
+                              "red if psi.some.avg10 == 1",
+                              "red if psi.some.avg10 >= no.such.key",
+                              "red when psi.some.avg10 >= 1",
+                              "red if psi.some.avg10 >= 1 exit",
+                              "RED  if psi.some.avg10 >= 1.0 exit 0.8"},
+                             &errors);
+  CHECK(p.size() == 1);
+  REQUIRE(errors.size() == 6);
+  CHECK(errors[0].rfind("purple if psi.some.avg10 >= 1: ", 0) == 0);
+  CHECK(Policy::compile({}).empty());
+}
+
+TEST_CASE("policy rules apply hysteresis per state") {
+  AppConfig cfg;
+  Policy p = Policy::compile({"yellow if psi.some.avg10 >= 0.5",
+                              "red if psi.some.avg10 >= 1.0 exit 0.8"});
+  ProbeSample s;
+  s.some.avg10 = 0.9;
+  CHECK(eval(p, s, cfg) == State::Yellow);
+  s.some.avg10 = 1.0;
+  CHECK(eval(p, s, cfg) == State::Red);
+  // Red rules are tried first although listed last; once Red, 0.8 holds it.
+  s.some.avg10 = 0.9;
+  CHECK(eval(p, s, cfg, State::Red) == State::Red);
+  s.some.avg10 = 0.79;
+  CHECK(eval(p, s, cfg, State::Red) == State::Yellow);
+  s.some.avg10 = 0.1;
+  CHECK(eval(p, s, cfg, State::Red) == State::Green);
+}
+
+TEST_CASE("policy distinguishes strict and inclusive comparisons") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = 1000;
+  CHECK(eval(Policy::compile({"red if mem.available_kib <= 1000"}), s, cfg) ==
+        State::Red);
+  CHECK(eval(Policy::compile({"red if mem.available_kib < 1000"}), s, cfg) ==
+        State::Green);
+  CHECK(eval(Policy::compile({"red if mem.available_kib >= 1000"}), s, cfg) ==
+        State::Red);
+  CHECK(eval(Policy::compile({"red if mem.available_kib > 1000"}), s, cfg) ==
+        State::Green);
+  CHECK(eval(Policy::compile({"red if mem.available_kib > 999.5"}), s, cfg) ==
+        State::Red);
+}
+
+TEST_CASE("policy never matches missing readings") {
+  AppConfig cfg;
+  ProbeSample s;
+  for (const char *rule :
+       {"red if mem.available_kib <= 1e18", "red if mem.available_kib >= -1e18",
+        "red if vmstat.refault >= 0", "red if psi.io.avg10 >= 0",
+        "red if psi.some.avg10_rate >= -1", "red if meminfo.Shmem >= 0",
+        "red if forecast.seconds_to_critical <= 1e9"})
+    CHECK(eval(Policy::compile({rule}), s, cfg) == State::Green);
+}
+
+TEST_CASE("policy reads meminfo keys and live config thresholds") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.meminfo[static_cast<std::size_t>(MeminfoField::Shmem)] = 4096;
+  s.meminfo_present |= std::uint64_t{1}
+                       << static_cast<std::size_t>(MeminfoField::Shmem);
+  CHECK(eval(Policy::compile({"orange if meminfo.Shmem >= 4096"}), s, cfg) ==
+        State::Orange);
+
+  Policy p = Policy::compile(
+      {"red if mem.available_kib <= mem.available_crit_kib"});
+  s.mem_available_kib = cfg.mem.available_crit_kib + 1;
+  CHECK(eval(p, s, cfg) == State::Green);
+  cfg.mem.available_crit_kib += 1;
+  CHECK(eval(p, s, cfg) == State::Red);
+}
+
+TEST_CASE("decide uses the configured policy") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.some.avg10 = 0.0;
+  s.mem_available_kib = cfg.mem.available_crit_kib - 1;
+  CHECK(decidePressure(s, cfg, State::Green) == State::Red);
+  cfg.policy.rules = Policy::compile({"yellow if psi.some.avg60 >= 0.5"});
+  CHECK(decidePressure(s, cfg, State::Green) == State::Green);
+  s.some.avg60 = 0.5;
+  CHECK(decidePressure(s, cfg, State::Green) == State::Yellow);
+}
+
+TEST_CASE("avg10 rate is measured over at least the PSI update period") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.some.avg10 = 4.0;
+  CHECK(std::isnan(someAvg10Rate({s, cfg, std::nullopt, 1.0})));
+  CHECK(someAvg10Rate({s, cfg, 0.0, 0.001}) == Catch::Approx(2.0));
+  CHECK(someAvg10Rate({s, cfg, 0.0, 4.0}) == Catch::Approx(1.0));
+}
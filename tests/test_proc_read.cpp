@@ -0,0 +1,115 @@
+#include <catch2/catch_all.hpp>
+#include <cerrno>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "proc_read.h"
+
+namespace {
+namespace fs = std::filesystem;
+
+int openFile(const fs::path& path, const std::string& content) {
+    std::ofstream(path) << content;
+    return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+} // namespace
+
+TEST_CASE("ProcReader reads every registered file in one batch") {
+    auto backend = GENERATE(ProcReader::Backend::Pread, ProcReader::Backend::IoUring);
+    fs::path dir = fs::temp_directory_path() / "proc_reader_batch";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    ProcReader reader(backend);
+    std::vector<int> fds;
+    std::vector<ProcReader::Handle> handles;
+    // More files than the io_uring submission queue holds.
+    for (int i = 0; i < 100; ++i) {
+        fds.push_back(openFile(dir / std::to_string(i), "value " + std::to_string(i) + "\n"));
+        handles.push_back(reader.add(fds.back(), 64));
+    }
+    CHECK(reader.readAll() == 100);
+    for (int i = 0; i < 100; ++i)
+        CHECK(reader.view(handles[i]) == "value " + std::to_string(i) + "\n");
+
+    // Files are re-read from the start on every batch.
+    std::ofstream(dir / "7") << "changed\n";
+    const auto before = reader.syscalls();
+    reader.readAll();
+    CHECK(reader.view(handles[7]) == "changed\n");
+    if (reader.backend() == ProcReader::Backend::IoUring)
+        CHECK(reader.syscalls() - before <= 2);
+    else
+        CHECK(reader.syscalls() - before == 100);
+
+    for (int fd : fds) ::close(fd);
+    fs::remove_all(dir);
+}
+
+TEST_CASE("ProcReader drops a partial line when the buffer fills") {
+    fs::path path = fs::temp_directory_path() / "proc_reader_partial";
+    int fd = openFile(path, "first line\nsecond line\n");
+    ProcReader reader;
+    auto h = reader.add(fd, 16);
+    reader.readAll();
+    CHECK(reader.result(h) == 11);
+    CHECK(reader.view(h) == "first line\n");
+    ::close(fd);
+    fs::remove(path);
+}
+
+TEST_CASE("ProcReader reports unusable descriptors and reuses slots") {
+    fs::path path = fs::temp_directory_path() / "proc_reader_slots";
+    int fd = openFile(path, "ok\n");
+    int pipeFds[2];
+    REQUIRE(::pipe(pipeFds) == 0);
+
+    ProcReader reader;
+    auto none = reader.add(-1, 16);
+    auto pipe = reader.add(pipeFds[0], 16);
+    reader.readAll();
+    CHECK(reader.result(none) == -EBADF);
+    CHECK(reader.result(pipe) == -ESPIPE);
+    CHECK(reader.view(pipe).empty());
+
+    reader.reset(none, fd);
+    reader.readAll();
+    CHECK(reader.view(none) == "ok\n");
+
+    reader.remove(pipe);
+    CHECK(reader.add(fd, 16) == pipe);
+
+    ::close(pipeFds[0]);
+    ::close(pipeFds[1]);
+    ::close(fd);
+    fs::remove(path);
+}
+
+TEST_CASE("ProcReader retries a failed read alone and keeps its backend") {
+    auto backend = GENERATE(ProcReader::Backend::Pread, ProcReader::Backend::IoUring);
+    fs::path dir = fs::temp_directory_path() / "proc_reader_failed";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    int fd = openFile(dir / "file", "ok\n");
+    // Directories seek but fail every read with EISDIR.
+    int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    REQUIRE(dirFd >= 0);
+
+    ProcReader reader(backend);
+    const auto used = reader.backend();
+    auto file = reader.add(fd, 16);
+    auto bad = reader.add(dirFd, 16);
+    for (int i = 0; i < 2; ++i) {
+        CHECK(reader.readAll() == 2);
+        CHECK(reader.view(file) == "ok\n");
+        CHECK(reader.result(bad) == -EISDIR);
+        CHECK(reader.backend() == used);
+    }
+
+    ::close(dirFd);
+    ::close(fd);
+    fs::remove_all(dir);
+}
@@ -0,0 +1,192 @@
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "process_scanner.h"
+
+namespace {
+namespace fs = std::filesystem;
+
+void writeFile(const fs::path& path, const std::string& content) {
+    std::ofstream out(path);
+    out << content;
+}
+
+/// Write /proc/<pid>/stat with the given start time and resident pages.
+void writeStat(const fs::path& root, int pid, const std::string& name,
+               unsigned long long start, long rssPages) {
+    fs::create_directories(root / std::to_string(pid));
+    std::string fields = "S 1 1 1 0 -1 0 0 0 0 0 0 0 0 0 20 0 1 0 " +
+                         std::to_string(start) + " 1000 " + std::to_string(rssPages) + " 0\n";
+    writeFile(root / std::to_string(pid) / "stat",
+              std::to_string(pid) + " (" + name + ") " + fields);
+}
+} // namespace
+
+TEST_CASE("parseStat handles command names with spaces and parentheses") {
+    std::string name;
+    unsigned long long start = 0;
+    long rss = 0;
+    REQUIRE(ProcessScanner::parseStat(
+        "42 (Web (Content) x) S 1 1 1 0 -1 0 0 0 0 0 0 0 0 0 20 0 1 0 777 1000 55 0\n",
+        name, start, rss));
+    CHECK(name == "Web (Content) x");
+    CHECK(start == 777);
+    CHECK(rss == 55);
+    CHECK_FALSE(ProcessScanner::parseStat("42 (truncated) S 1 1", name, start, rss));
+    CHECK_FALSE(ProcessScanner::parseStat("garbage", name, start, rss));
+}
+
+TEST_CASE("parseMemoryLines reads smaps_rollup and status keys") {
+    ProcessSample s;
+    ProcessScanner::parseMemoryLines("Rss:     300 kB\nPss:     200 kB\nSwap:     10 kB\n", s);
+    CHECK(s.rss_kib == 300);
+    REQUIRE(s.pss_kib);
+    CHECK(*s.pss_kib == 200);
+    CHECK(s.swap_kib == 10);
+
+    ProcessSample st;
+    ProcessScanner::parseMemoryLines("Name:\tbash\nVmRSS:\t   64 kB\nVmSwap:\t    8 kB\n", st);
+    CHECK(st.rss_kib == 64);
+    CHECK_FALSE(st.pss_kib);
+    CHECK(st.swap_kib == 8);
+}
+
+TEST_CASE("scan ranks processes and falls back to status and statm") {
+    fs::path root = fs::temp_directory_path() / "proc_scan";
+    fs::remove_all(root);
+    writeStat(root, 10, "rollup", 1, 1);
+    writeFile(root / "10" / "smaps_rollup", "Rss: 5000 kB\nPss: 4000 kB\nSwap: 0 kB\n");
+    writeStat(root, 20, "status", 1, 1);
+    writeFile(root / "20" / "status", "VmRSS: 3000 kB\nVmSwap: 900 kB\n");
+    writeStat(root, 30, "statm", 1, 1);
+    writeFile(root / "30" / "statm", "100 2 1 0 0 0 0\n");
+    fs::create_directories(root / "self");
+
+    ProcessScanner scanner(root.string(), 2, std::chrono::seconds(5));
+    std::vector<ProcessSample> top;
+    CHECK(scanner.scan(top, 2) == 3);
+    CHECK(scanner.size() == 3);
+    REQUIRE(top.size() == 2);
+    CHECK(top[0].pid == 10);
+    CHECK(top[0].name == "rollup");
+    CHECK(*top[0].pss_kib == 4000);
+    CHECK(top[1].pid == 20);
+    CHECK_FALSE(top[1].pss_kib);
+
+    scanner.scan(top, 1, ProcessScanner::SortKey::Swap);
+    REQUIRE(top.size() == 1);
+    CHECK(top[0].pid == 20);
+
+    scanner.scan(top, 5, ProcessScanner::SortKey::Rss);
+    REQUIRE(top.size() == 3);
+    CHECK(top[2].pid == 30);
+    CHECK(top[2].rss_kib > 0);
+    fs::remove_all(root);
+}
+
+TEST_CASE("scan re-reads a process only when its stat changes") {
+    fs::path root = fs::temp_directory_path() / "proc_cache";
+    fs::remove_all(root);
+    writeStat(root, 10, "app", 1, 1);
+    writeFile(root / "10" / "smaps_rollup", "Rss: 100 kB\nPss: 100 kB\n");
+
+    ProcessScanner scanner(root.string(), 1, std::chrono::seconds(5));
+    std::vector<ProcessSample> top;
+    scanner.scan(top, 1);
+    writeFile(root / "10" / "smaps_rollup", "Rss: 900 kB\nPss: 900 kB\n");
+    scanner.scan(top, 1);
+    REQUIRE(top.size() == 1);
+    CHECK(top[0].rss_kib == 100);
+
+    writeStat(root, 10, "app", 1, 2);
+    scanner.scan(top, 1);
+    CHECK(top[0].rss_kib == 900);
+
+    // A reused pid has a new start time.
+    writeStat(root, 10, "other", 2, 2);
+    scanner.scan(top, 1);
+    CHECK(top[0].name == "other");
+
+    fs::remove_all(root / "10");
+    scanner.scan(top, 1);
+    CHECK(top.empty());
+    fs::remove_all(root);
+}
+
+TEST_CASE("scan spreads work over calls when the budget runs out") {
+    fs::path root = fs::temp_directory_path() / "proc_budget";
+    fs::remove_all(root);
+    for (int pid = 1; pid <= 3; ++pid) {
+        writeStat(root, pid, "p", 1, 1);
+        writeFile(root / std::to_string(pid) / "status", "VmRSS: " + std::to_string(pid) + " kB\n");
+    }
+    ProcessScanner scanner(root.string(), 1, std::chrono::microseconds(0));
+    std::vector<ProcessSample> top;
+    CHECK(scanner.scan(top, 3) == 1);
+    CHECK(top.size() == 1);
+    CHECK(scanner.scan(top, 3) == 1);
+    CHECK(scanner.scan(top, 3) == 1);
+    REQUIRE(top.size() == 3);
+    CHECK(top[0].pid == 3);
+    fs::remove_all(root);
+}
+
+TEST_CASE("scan never reports a process that exited since it was read") {
+    fs::path root = fs::temp_directory_path() / "proc_exited";
+    fs::remove_all(root);
+    for (int pid = 1; pid <= 4; ++pid) {
+        writeStat(root, pid, "p", 1, 1);
+        writeFile(root / std::to_string(pid) / "status",
+                  "VmRSS: " + std::to_string(pid == 1 ? 1000 : pid) + " kB\n");
+    }
+    ProcessScanner scanner(root.string(), 1, std::chrono::microseconds(0));
+    std::vector<ProcessSample> top;
+    // One process per call: the fifth call starts over with pid 1.
+    for (int i = 0; i < 5; ++i) scanner.scan(top, 2);
+    REQUIRE(top.size() == 2);
+    CHECK(top[0].pid == 1);
+
+    // Killed before the cursor comes back to it.
+    fs::remove_all(root / "1");
+    scanner.scan(top, 2);
+    REQUIRE(top.size() == 2);
+    CHECK(top[0].pid == 4);
+    CHECK(top[1].pid == 3);
+
+    // A new process under the same pid is not the one cached.
+    writeStat(root, 4, "p", 2, 1);
+    scanner.scan(top, 2);
+    REQUIRE_FALSE(top.empty());
+    CHECK(top[0].pid == 3);
+    fs::remove_all(root);
+}
+
+TEST_CASE("scan reuses its worker threads") {
+    fs::path root = fs::temp_directory_path() / "proc_workers";
+    fs::remove_all(root);
+    for (int pid = 1; pid <= 20; ++pid) {
+        writeStat(root, pid, "p", 1, pid);
+        writeFile(root / std::to_string(pid) / "status", "VmRSS: " + std::to_string(pid) + " kB\n");
+    }
+    auto threads = [] {
+        auto n = std::distance(fs::directory_iterator("/proc/self/task"), fs::directory_iterator());
+        return static_cast<int>(n);
+    };
+    const int before = threads();
+    {
+        ProcessScanner scanner(root.string(), 4, std::chrono::seconds(1));
+        CHECK(threads() == before + 3);
+        std::vector<ProcessSample> top;
+        for (int i = 0; i < 5; ++i) {
+            CHECK(scanner.scan(top, 2) == 20);
+            CHECK(threads() == before + 3);
+        }
+        REQUIRE(top.size() == 2);
+        CHECK(top[0].pid == 20);
+    }
+    CHECK(threads() == before);
+    fs::remove_all(root);
+}
@@ -0,0 +1,142 @@
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include "replay.h"
+
+namespace {
+namespace fs = std::filesystem;
+
+std::string meminfo(long availableKib) {
+  return "MemTotal: 8388608 kB\nMemAvailable: " +
+         std::to_string(availableKib) + " kB\nSwapFree: 4194304 kB\n";
+}
+
+std::string psi(double avg10) {
+  return "some avg10=" + std::to_string(avg10) +
+         " avg60=0.00 avg300=0.00 total=0\n"
+         "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n";
+}
+
+TraceFrame frame(std::int64_t ms, long availableKib, double avg10 = 0.0) {
+  TraceFrame f;
+  f.time_ms = ms;
+  f.meminfo = meminfo(availableKib);
+  f.memory = psi(avg10);
+  return f;
+}
+
+struct WorkDir {
+  fs::path path = fs::temp_directory_path() / "nohang_replay";
+  WorkDir() { fs::remove_all(path); fs::create_directories(path); }
+  ~WorkDir() { fs::remove_all(path); }
+};
+} // namespace
+
+TEST_CASE("traces round-trip through the text format") {
+  TraceFrame f = frame(1000, 123);
+  f.vmstat = "pswpin 5";
+  std::stringstream ss;
+  ss << "# comment\n";
+  Trace::writeFrame(ss, f);
+  ss << "! 1500 oom kill\n";
+  Trace::writeFrame(ss, frame(2000, 456));
+
+  std::string error;
+  auto trace = Trace::parse(ss, &error);
+  REQUIRE(trace);
+  REQUIRE(trace->frames.size() == 2);
+  CHECK(trace->frames[0].time_ms == 1000);
+  CHECK(trace->frames[0].meminfo == meminfo(123));
+  CHECK(trace->frames[0].vmstat == "pswpin 5\n");
+  CHECK(trace->frames[1].cpu.empty());
+  REQUIRE(trace->events.size() == 1);
+  CHECK(trace->events[0].time_ms == 1500);
+  CHECK(trace->events[0].label == "oom kill");
+
+  std::istringstream bad("@ 10\n== swaps\n");
+  CHECK_FALSE(Trace::parse(bad, &error));
+  CHECK(error == "line 2: unknown section");
+  std::istringstream order("@ 10\n@ 5\n");
+  CHECK_FALSE(Trace::parse(order, &error));
+  std::istringstream orphan("stray\n");
+  CHECK_FALSE(Trace::parse(orphan, &error));
+}
+
+TEST_CASE("replay reports transitions, time in state, flaps and detection") {
+  AppConfig cfg;
+  const long ok = cfg.mem.available_warn_exit_kib * 2;
+  const long low = cfg.mem.available_crit_kib - 1;
+  Trace trace;
+  trace.frames = {frame(0, ok),       frame(10000, ok),  frame(20000, low),
+                  frame(25000, ok),   frame(30000, low), frame(40000, ok),
+                  frame(100000, ok)};
+  trace.events = {{18000, "freeze"}, {32000, "during"}, {90000, "calm"}};
+
+  WorkDir dir;
+  Replayer replayer(cfg, dir.path.string(), {});
+  const ReplayReport report = replayer.run(trace);
+  CHECK(report.frames == 7);
+  CHECK(report.failed_frames == 0);
+  REQUIRE(report.transitions.size() == 4);
+  CHECK(report.transitions[0].time_ms == 20000);
+  CHECK(report.transitions[0].from == PressureState::Green);
+  CHECK(report.transitions[0].to == PressureState::Red);
+  CHECK(report.transitions[1].to == PressureState::Green);
+  // Every change after the first returns to a state left 5 or 10 s earlier.
+  CHECK(report.flaps == 3);
+  CHECK(report.seconds_in_state[0] == Catch::Approx(85.0));
+  CHECK(report.seconds_in_state[3] == Catch::Approx(15.0));
+  REQUIRE(report.detections.size() == 3);
+  CHECK(*report.detections[0].latency_sec == Catch::Approx(2.0));
+  CHECK(*report.detections[1].latency_sec == Catch::Approx(-2.0));
+  CHECK_FALSE(report.detections[2].latency_sec);
+
+  const std::string text = report.format(0);
+  CHECK(text.find("+20.0s green -> red") != std::string::npos);
+  CHECK(text.find("freeze: detected +2.0s") != std::string::npos);
+  CHECK(text.find("calm: missed") != std::string::npos);
+
+  Replayer strict(cfg, dir.path.string(), {1.0, PressureState::Orange});
+  CHECK(strict.run(trace).flaps == 0);
+}
+
+TEST_CASE("replay computes vmstat rates on the trace clock") {
+  AppConfig cfg;
+  const long ok = cfg.mem.available_warn_exit_kib * 2;
+  Trace trace;
+  trace.frames = {frame(0, ok), frame(1000, ok), frame(2000, ok)};
+  trace.frames[0].vmstat = "pswpin 0\n";
+  trace.frames[1].vmstat = "pswpin 100\n";
+  trace.frames[2].vmstat =
+      "pswpin " +
+      std::to_string(100 + static_cast<long>(cfg.thrash.swapin_per_sec)) +
+      "\n";
+  WorkDir dir;
+  const ReplayReport report = Replayer(cfg, dir.path.string(), {}).run(trace);
+  REQUIRE(report.transitions.size() == 1);
+  CHECK(report.transitions[0].time_ms == 2000);
+  CHECK(report.transitions[0].to == PressureState::Orange);
+}
+
+TEST_CASE("replay warns at the start of a linear memory ramp") {
+  AppConfig cfg;
+  // 40 MiB/s down from 4 GiB, sampled every 2 s: critical after 96 s, the
+  // warn margin only after about 87 s.
+  Trace trace;
+  for (int i = 0; i <= 50; ++i)
+    trace.frames.push_back(frame(i * 2000, (4096 - 80 * i) * 1024L));
+  WorkDir dir;
+
+  const ReplayReport report = Replayer(cfg, dir.path.string(), {}).run(trace);
+  REQUIRE_FALSE(report.transitions.empty());
+  CHECK(report.transitions[0].to == PressureState::Yellow);
+  // About 60 s ahead of critical, as configured by horizon_sec.
+  CHECK(report.transitions[0].time_ms >= 34000);
+  CHECK(report.transitions[0].time_ms <= 38000);
+
+  cfg.forecast.horizon_sec = 0;
+  const ReplayReport plain = Replayer(cfg, dir.path.string(), {}).run(trace);
+  REQUIRE_FALSE(plain.transitions.empty());
+  CHECK(plain.transitions[0].time_ms > 80000);
+}
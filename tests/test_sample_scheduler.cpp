@@ -0,0 +1,79 @@
+#include <catch2/catch_all.hpp>
+#include "sample_scheduler.h"
+
+namespace {
+ProbeSample calmSample(const AppConfig &cfg) {
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_exit_kib * 4;
+  s.swap_free_kib = cfg.swap.free_warn_exit_kib * 4;
+  s.some.avg10 = 0.0;
+  return s;
+}
+} // namespace
+
+TEST_CASE("scheduler starts at base interval") {
+  AppConfig cfg;
+  SampleScheduler sched(cfg);
+  CHECK(sched.interval() == cfg.sample_interval_ms);
+}
+
+TEST_CASE("scheduler stretches interval while calm") {
+  AppConfig cfg;
+  cfg.sample.calm_ticks = 3;
+  SampleScheduler sched(cfg);
+  auto s = calmSample(cfg);
+  CHECK(sched.next(s, false, 0.0) == cfg.sample_interval_ms);
+  CHECK(sched.next(s, false, 0.0) == cfg.sample_interval_ms);
+  int stretched = sched.next(s, false, 0.0);
+  CHECK(stretched > cfg.sample_interval_ms);
+  for (int i = 0; i < 50; ++i)
+    sched.next(s, false, 0.0);
+  CHECK(sched.interval() == cfg.sample.max_interval_ms);
+}
+
+TEST_CASE("scheduler drops to minimum when pressure appears") {
+  AppConfig cfg;
+  cfg.sample.calm_ticks = 1;
+  SampleScheduler sched(cfg);
+  auto s = calmSample(cfg);
+  for (int i = 0; i < 10; ++i)
+    sched.next(s, false, 0.0);
+  REQUIRE(sched.interval() > cfg.sample_interval_ms);
+  CHECK(sched.next(s, true, 0.0) == cfg.sample.min_interval_ms);
+}
+
+TEST_CASE("scheduler shrinks interval on rising PSI") {
+  AppConfig cfg;
+  SampleScheduler sched(cfg);
+  auto s = calmSample(cfg);
+  int first = sched.next(s, false, 0.05);
+  CHECK(first < cfg.sample_interval_ms);
+  CHECK(sched.next(s, false, 0.05) < first);
+}
+
+TEST_CASE("scheduler returns to base near thresholds") {
+  AppConfig cfg;
+  cfg.sample.calm_ticks = 1;
+  SampleScheduler sched(cfg);
+  auto s = calmSample(cfg);
+  for (int i = 0; i < 10; ++i)
+    sched.next(s, false, 0.0);
+  s.mem_available_kib = cfg.mem.available_warn_exit_kib + 1;
+  CHECK(sched.next(s, false, 0.0) == cfg.sample_interval_ms);
+
+  sched.next(s, true, 0.0);
+  int recovering = sched.next(s, false, 0.0);
+  CHECK(recovering > cfg.sample.min_interval_ms);
+  CHECK(recovering <= cfg.sample_interval_ms);
+}
+
+TEST_CASE("farFromThresholds checks every reading") {
+  AppConfig cfg;
+  auto s = calmSample(cfg);
+  CHECK(SampleScheduler::farFromThresholds(s, cfg));
+  s.some.avg10 = cfg.psi.avg10_warn_exit;
+  CHECK_FALSE(SampleScheduler::farFromThresholds(s, cfg));
+  s = calmSample(cfg);
+  s.swap_free_kib = cfg.swap.free_warn_exit_kib;
+  CHECK_FALSE(SampleScheduler::farFromThresholds(s, cfg));
+}
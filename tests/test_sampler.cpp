@@ -0,0 +1,425 @@
+#include <catch2/catch_all.hpp>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "sampler.h"
+
+namespace {
+struct StubProbe : SystemProbe {
+  ProbeSample s;
+  bool fail = false;
+  explicit StubProbe(const ProbeSample &sample) : s(sample) {}
+  std::optional<ProbeSample> sample() const override {
+    if (fail)
+      return std::nullopt;
+    return s;
+  }
+};
+} // namespace
+
+TEST_CASE("tick publishes sample with decided state") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_crit_kib - 1;
+  Sampler sampler(std::make_unique<StubProbe>(s), cfg);
+  sampler.tick();
+  Sampler::Snapshot snap;
+  REQUIRE(sampler.drain(snap) == 1);
+  REQUIRE(snap.sample);
+  CHECK(*snap.sample->mem_available_kib == cfg.mem.available_crit_kib - 1);
+  CHECK(snap.state == PressureState::Red);
+  CHECK(snap.interval_ms == cfg.sample.min_interval_ms);
+}
+
+TEST_CASE("probe failure publishes empty sample and keeps state") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_kib - 1;
+  auto *probe = new StubProbe(s);
+  Sampler sampler(std::unique_ptr<SystemProbe>(probe), cfg);
+  sampler.tick();
+  probe->fail = true;
+  sampler.tick();
+  Sampler::Snapshot snap;
+  REQUIRE(sampler.drain(snap) == 2);
+  CHECK_FALSE(snap.sample);
+  CHECK(snap.state == PressureState::Orange);
+}
+
+TEST_CASE("drain keeps the newest snapshot") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_kib * 4;
+  auto *probe = new StubProbe(s);
+  Sampler sampler(std::unique_ptr<SystemProbe>(probe), cfg);
+  sampler.tick();
+  probe->s.mem_available_kib = 42;
+  sampler.tick();
+  Sampler::Snapshot snap;
+  REQUIRE(sampler.drain(snap) == 2);
+  CHECK(*snap.sample->mem_available_kib == 42);
+  CHECK(sampler.drain(snap) == 0);
+}
+
+TEST_CASE("full ring counts dropped snapshots and keeps the newest") {
+  AppConfig cfg;
+  auto *probe = new StubProbe(ProbeSample{});
+  Sampler sampler(std::unique_ptr<SystemProbe>(probe), cfg);
+  for (long i = 0; i < 70; ++i) {
+    probe->s.mem_available_kib = cfg.mem.available_warn_kib * 4 + i;
+    sampler.tick();
+  }
+  // 64 in the ring, the newest beside it, the five in between lost.
+  CHECK(sampler.dropped() == 5);
+  Sampler::Snapshot snap;
+  CHECK(sampler.drain(snap) == 65);
+  CHECK(*snap.sample->mem_available_kib == cfg.mem.available_warn_kib * 4 + 69);
+
+  // Once drained, the ring fills in order again.
+  for (long i = 70; i < 72; ++i) {
+    probe->s.mem_available_kib = cfg.mem.available_warn_kib * 4 + i;
+    sampler.tick();
+  }
+  std::vector<long> seen;
+  CHECK(sampler.drainEach([&](const Sampler::Snapshot &s) {
+    seen.push_back(*s.sample->mem_available_kib);
+  }) == 2);
+  CHECK(seen == std::vector<long>{cfg.mem.available_warn_kib * 4 + 70,
+                                  cfg.mem.available_warn_kib * 4 + 71});
+}
+
+TEST_CASE("sampling thread publishes and notifies until stopped") {
+  AppConfig cfg;
+  cfg.sample_interval_ms = 10;
+  cfg.sample.min_interval_ms = 10;
+  cfg.sample.max_interval_ms = 10;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_kib * 4;
+  Sampler sampler(std::make_unique<StubProbe>(s), cfg);
+  std::atomic<int> notified{0};
+  sampler.start([&] { notified.fetch_add(1); });
+  REQUIRE(sampler.running());
+
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  std::size_t consumed = 0;
+  while (consumed < 3 && std::chrono::steady_clock::now() < deadline) {
+    Sampler::Snapshot snap;
+    consumed += sampler.drain(snap);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  sampler.stop();
+  CHECK_FALSE(sampler.running());
+  CHECK(consumed >= 3);
+  CHECK(notified.load() >= 1);
+}
+
+TEST_CASE("stop wakes a sleeping sampler promptly") {
+  AppConfig cfg;
+  cfg.sample_interval_ms = 60000;
+  cfg.sample.max_interval_ms = 60000;
+  Sampler sampler(std::make_unique<StubProbe>(ProbeSample{}), cfg);
+  sampler.start();
+  const auto begin = std::chrono::steady_clock::now();
+  sampler.stop();
+  CHECK(std::chrono::steady_clock::now() - begin < std::chrono::seconds(5));
+}
+
+TEST_CASE("tick attaches the worst cgroups when monitoring is enabled") {
+  namespace fs = std::filesystem;
+  fs::path root = fs::temp_directory_path() / "sampler_cgroups";
+  fs::remove_all(root);
+  for (const char *name : {"a.slice", "b.slice"}) {
+    fs::create_directories(root / name);
+    std::ofstream(root / name / "memory.current") << "1048576\n";
+    std::ofstream(root / name / "memory.pressure")
+        << "some avg10=" << (name[0] == 'b' ? "2.00" : "1.00")
+        << " avg60=0.00 avg300=0.00 total=0\n";
+  }
+  AppConfig cfg;
+  cfg.cgroup.enabled = true;
+  cfg.cgroup.root = QString::fromStdString(root.string());
+  cfg.cgroup.top_n = 1;
+  Sampler sampler(std::make_unique<StubProbe>(ProbeSample{}), cfg);
+  sampler.tick();
+  Sampler::Snapshot snap;
+  REQUIRE(sampler.drain(snap) == 1);
+  REQUIRE(snap.sample);
+  REQUIRE(snap.sample->cgroups.size() == 1);
+  CHECK(snap.sample->cgroups[0].path == "b.slice");
+  CHECK(snap.sample->cgroups[0].current_kib == 1024);
+  fs::remove_all(root);
+}
+
+TEST_CASE("tick lists the largest processes only under high pressure") {
+  AppConfig cfg;
+  cfg.process.enabled = true;
+  cfg.process.top_n = 2;
+  cfg.process.budget_ms = 1000;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_kib * 4;
+  auto *probe = new StubProbe(s);
+  Sampler sampler(std::unique_ptr<SystemProbe>(probe), cfg);
+  Sampler::Snapshot snap;
+  sampler.tick();
+  REQUIRE(sampler.drain(snap) == 1);
+  CHECK(snap.sample->processes.empty());
+
+  probe->s.mem_available_kib = cfg.mem.available_crit_kib - 1;
+  sampler.tick();
+  REQUIRE(sampler.drain(snap) == 1);
+  CHECK(snap.state == PressureState::Red);
+  CHECK_FALSE(snap.sample->processes.empty());
+  CHECK(snap.sample->processes.size() <= 2);
+}
+
+TEST_CASE("history restores hysteresis state across restarts") {
+  namespace fs = std::filesystem;
+  fs::path path = fs::temp_directory_path() / "sampler_history.bin";
+  fs::remove(path);
+  AppConfig cfg;
+  cfg.history.enabled = true;
+  cfg.history.path = QString::fromStdString(path.string());
+  cfg.history.capacity = 16;
+
+  ProbeSample red;
+  red.mem_available_kib = cfg.mem.available_crit_kib - 1;
+  {
+    Sampler sampler(std::make_unique<StubProbe>(red), cfg);
+    REQUIRE(sampler.history());
+    sampler.tick();
+    CHECK(sampler.history()->size() == 1);
+  }
+
+  // Between crit and its exit threshold: Red only while latched.
+  ProbeSample band;
+  band.mem_available_kib = cfg.mem.available_crit_kib + 1;
+  Sampler restarted(std::make_unique<StubProbe>(band), cfg);
+  restarted.tick();
+  Sampler::Snapshot snap;
+  REQUIRE(restarted.drain(snap) == 1);
+  CHECK(snap.state == PressureState::Red);
+  CHECK(restarted.history()->size() == 2);
+
+  cfg.history.enabled = false;
+  Sampler fresh(std::make_unique<StubProbe>(band), cfg);
+  fresh.tick();
+  REQUIRE(fresh.drain(snap) == 1);
+  CHECK(snap.state == PressureState::Orange);
+  fs::remove(path);
+}
+
+TEST_CASE("archive keeps every sample after the sampler stops") {
+  namespace fs = std::filesystem;
+  fs::path path = fs::temp_directory_path() / "sampler_archive.bin";
+  fs::path ring = fs::temp_directory_path() / "sampler_archive_ring.bin";
+  fs::remove(path);
+  fs::remove(ring);
+  AppConfig cfg;
+  cfg.history.archive = true;
+  cfg.history.archive_path = QString::fromStdString(path.string());
+  ProbeSample s;
+  s.mem_available_kib = 4242;
+  {
+    // Without the History ring the unflushed tail could be lost.
+    Sampler sampler(std::make_unique<StubProbe>(s), cfg);
+    CHECK_FALSE(sampler.archive());
+  }
+  cfg.history.enabled = true;
+  cfg.history.path = QString::fromStdString(ring.string());
+  {
+    Sampler sampler(std::make_unique<StubProbe>(s), cfg);
+    REQUIRE(sampler.archive());
+    sampler.tick();
+    sampler.tick();
+  }
+  TimeSeries ts(path.string());
+  std::vector<HistoryRecord> out;
+  CHECK(ts.query(0, std::numeric_limits<std::int64_t>::max(), out) == 1);
+  REQUIRE(out.size() == 2);
+  CHECK(out[1].mem_available_kib == 4242);
+  fs::remove(path);
+  fs::remove(ring);
+}
+
+TEST_CASE("archive recovers the samples of a killed sampler from history") {
+  namespace fs = std::filesystem;
+  fs::path path = fs::temp_directory_path() / "sampler_killed_archive.bin";
+  fs::path ring = fs::temp_directory_path() / "sampler_killed_ring.bin";
+  fs::remove(path);
+  fs::remove(ring);
+  AppConfig cfg;
+  cfg.history.enabled = true;
+  cfg.history.path = QString::fromStdString(ring.string());
+  cfg.history.archive = true;
+  cfg.history.archive_path = QString::fromStdString(path.string());
+  ProbeSample s;
+  s.mem_available_kib = 1;
+  {
+    Sampler sampler(std::make_unique<StubProbe>(s), cfg);
+    sampler.tick();
+  }
+  // Records sharing the archived chunk's last millisecond count as archived.
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+  // The child dies without destructors, like a process killed by the OOM
+  // killer, so its samples only reach the History ring.
+  const pid_t child = fork();
+  REQUIRE(child >= 0);
+  if (child == 0) {
+    auto *probe = new StubProbe(s);
+    auto *sampler = new Sampler(std::unique_ptr<SystemProbe>(probe), cfg);
+    for (long kib : {2, 3}) {
+      probe->s.mem_available_kib = kib;
+      sampler->tick();
+    }
+    _exit(0);
+  }
+  int status = 0;
+  REQUIRE(waitpid(child, &status, 0) == child);
+  REQUIRE(WIFEXITED(status));
+
+  {
+    Sampler sampler(std::make_unique<StubProbe>(s), cfg);
+    REQUIRE(sampler.archive());
+  }
+  TimeSeries ts(path.string());
+  std::vector<HistoryRecord> out;
+  ts.query(0, std::numeric_limits<std::int64_t>::max(), out);
+  REQUIRE(out.size() == 3);
+  CHECK(out[0].mem_available_kib == 1);
+  CHECK(out[1].mem_available_kib == 2);
+  CHECK(out[2].mem_available_kib == 3);
+  fs::remove(path);
+  fs::remove(ring);
+}
+
+TEST_CASE("metrics exporter is fed every decided sample") {
+  AppConfig cfg;
+  cfg.metrics.listen = "127.0.0.1:0";
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_crit_kib - 1;
+  Sampler sampler(std::make_unique<StubProbe>(s), cfg);
+  REQUIRE(sampler.metrics());
+  CHECK(sampler.metrics()->port() > 0);
+  sampler.tick();
+  const std::string text = sampler.metrics()->text();
+  CHECK(text.find("nohang_tr_state 3\n") != std::string::npos);
+  CHECK(text.find("nohang_tr_sample_duration_seconds_count 1\n") !=
+        std::string::npos);
+
+  // Reloaded thresholds are exported from the next tick on.
+  AppConfig reloaded = cfg;
+  reloaded.thrash.refault_per_sec = 1234.5;
+  sampler.reconfigure(reloaded);
+  sampler.tick();
+  CHECK(sampler.metrics()->text().find(
+            "nohang_tr_vmstat_threshold_per_second{counter=\"refault\"} "
+            "1234.5\n") != std::string::npos);
+
+  cfg.metrics.listen = "not an endpoint";
+  Sampler broken(std::make_unique<StubProbe>(s), cfg);
+  CHECK_FALSE(broken.metrics());
+}
+
+TEST_CASE("profiler times the probe and the decision of every tick") {
+  namespace fs = std::filesystem;
+  fs::path dir = fs::temp_directory_path() / "sampler_profiler";
+  fs::create_directories(dir);
+  fs::path mem = dir / "meminfo";
+  fs::path psi = dir / "pressure";
+  {
+    std::ofstream out(mem);
+    out << "MemTotal: 456 kB\nMemAvailable: 123 kB\n";
+  }
+  {
+    std::ofstream out(psi);
+    out << "some avg10=1 avg60=2 avg300=3 total=4\n";
+    out << "full avg10=5 avg60=6 avg300=7 total=8\n";
+  }
+  AppConfig cfg;
+  TickProfiler profiler;
+  Sampler sampler(std::make_unique<SystemProbe>(mem.string(), psi.string()),
+                  cfg);
+  sampler.setProfiler(&profiler);
+  sampler.tick();
+  sampler.tick();
+  using Phase = TickProfiler::Phase;
+  CHECK(profiler.histogram(Phase::ProbeRead).count() == 2);
+  CHECK(profiler.histogram(Phase::Parse).count() == 2);
+  CHECK(profiler.histogram(Phase::Decide).count() == 2);
+  CHECK(profiler.histogram(Phase::Tooltip).count() == 0);
+  fs::remove_all(dir);
+}
+
+TEST_CASE("reconfigure takes effect on the next tick") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_exit_kib * 2;
+  Sampler sampler(std::make_unique<StubProbe>(s), cfg);
+  sampler.tick();
+  Sampler::Snapshot snap;
+  REQUIRE(sampler.drain(snap) == 1);
+  CHECK(snap.state == PressureState::Green);
+
+  AppConfig tighter = cfg;
+  tighter.mem.available_warn_kib = *s.mem_available_kib * 2;
+  tighter.mem.available_warn_exit_kib = *s.mem_available_kib * 3;
+  tighter.process.sort = "rss";
+  sampler.reconfigure(tighter);
+  // Nothing changes until the sampling thread picks it up.
+  CHECK(sampler.config().mem.available_warn_kib == cfg.mem.available_warn_kib);
+  sampler.tick();
+  REQUIRE(sampler.drain(snap) == 1);
+  CHECK(snap.state == PressureState::Orange);
+  CHECK(sampler.config().mem.available_warn_kib == *s.mem_available_kib * 2);
+  CHECK(sampler.config().process.sort == "rss");
+}
+
+TEST_CASE("reconfigure re-registers PSI triggers only when they change") {
+  namespace fs = std::filesystem;
+  fs::path dir = fs::temp_directory_path() / "sampler_retrigger";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  fs::path mem = dir / "meminfo";
+  fs::path psi = dir / "pressure";
+  {
+    std::ofstream out(mem);
+    out << "MemAvailable: 123 kB\n";
+  }
+  std::ofstream(psi.string()).flush();
+  AppConfig cfg;
+  cfg.psi.trigger.some = AppConfig::Psi::Trigger{10, 100};
+  Sampler sampler(std::make_unique<SystemProbe>(mem.string(), psi.string()),
+                  cfg);
+  sampler.enableTriggers();
+  REQUIRE(sampler.probe().triggerFds().size() == 1);
+  const int fd = sampler.probe().triggerFds()[0];
+
+  AppConfig same = cfg;
+  same.mem.available_warn_kib *= 2;
+  sampler.reconfigure(same);
+  sampler.tick();
+  REQUIRE(sampler.probe().triggerFds().size() == 1);
+  CHECK(sampler.probe().triggerFds()[0] == fd);
+
+  AppConfig more = same;
+  more.psi.trigger.full = AppConfig::Psi::Trigger{20, 200};
+  sampler.reconfigure(more);
+  sampler.tick();
+  CHECK(sampler.probe().triggerFds().size() == 2);
+  std::ifstream in(psi);
+  std::string line;
+  std::vector<std::string> lines;
+  while (std::getline(in, line))
+    lines.push_back(line);
+  CHECK(lines == std::vector<std::string>{"some 10 100", "some 10 100",
+                                          "full 20 200"});
+  fs::remove_all(dir);
+}
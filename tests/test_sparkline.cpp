@@ -0,0 +1,75 @@
+#include <QGuiApplication>
+#include <QImage>
+#include <catch2/catch_all.hpp>
+#include <memory>
+#include "sparkline.h"
+
+namespace {
+// QPixmap needs a GUI application; test_tray.cpp usually made one already.
+void ensureApp() {
+  static std::unique_ptr<QGuiApplication> app;
+  if (QCoreApplication::instance())
+    return;
+  qputenv("QT_QPA_PLATFORM", "offscreen");
+  static int argc = 1;
+  static char arg0[] = "test";
+  static char *argv[] = {arg0, nullptr};
+  app = std::make_unique<QGuiApplication>(argc, argv);
+}
+
+QImage image(const Sparkline &graph) {
+  return graph.icon().pixmap(graph.columns(), 32).toImage();
+}
+} // namespace
+
+TEST_CASE("sparkline columns scale memory and PSI") {
+  ensureApp();
+  Sparkline graph(8);
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_total_kib = 1000;
+  s.mem_available_kib = 250;
+  s.some.avg10 = cfg.psi.avg10_crit;
+  auto c = graph.column(s, PressureState::Orange, cfg);
+  CHECK(c.mem == 24);
+  CHECK(c.psi == 16);
+  CHECK(c.state == PressureState::Orange);
+
+  s.mem_total_kib.reset();
+  s.some.avg10 = cfg.psi.avg10_crit * 10;
+  c = graph.column(s, PressureState::Red, cfg);
+  CHECK(c.mem == 0);
+  CHECK(c.psi == 31);
+}
+
+TEST_CASE("sparkline scrolls one column per push") {
+  ensureApp();
+  Sparkline graph(4);
+  const QImage empty = image(graph);
+  const Sparkline::Column high{32, 0, PressureState::Red};
+  REQUIRE(graph.push(high));
+  QImage img = image(graph);
+  CHECK(img.pixelColor(3, 0) == QColor(0xe7, 0x4c, 0x3c));
+  CHECK(img.pixelColor(3, 31) == Qt::white);
+  CHECK(img.pixelColor(2, 0) == empty.pixelColor(2, 0));
+
+  REQUIRE(graph.push(Sparkline::Column{}));
+  img = image(graph);
+  CHECK(img.pixelColor(2, 0) == QColor(0xe7, 0x4c, 0x3c));
+  CHECK(img.pixelColor(3, 0) == empty.pixelColor(3, 0));
+}
+
+TEST_CASE("sparkline skips pushes that leave the image unchanged") {
+  ensureApp();
+  Sparkline graph(3);
+  // Empty columns onto an empty graph change nothing.
+  CHECK_FALSE(graph.push(Sparkline::Column{}));
+  const Sparkline::Column c{10, 5, PressureState::Green};
+  CHECK(graph.push(c));
+  CHECK(graph.push(c));
+  CHECK(graph.push(c));
+  const qint64 key = graph.icon().cacheKey();
+  CHECK_FALSE(graph.push(c));
+  CHECK(graph.icon().cacheKey() == key);
+  CHECK(graph.push(Sparkline::Column{11, 5, PressureState::Green}));
+}
@@ -0,0 +1,54 @@
+#include <catch2/catch_all.hpp>
+#include <thread>
+#include "spsc_ring.h"
+
+TEST_CASE("ring pops values in push order") {
+  SpscRing<int, 4> ring;
+  int v = 0;
+  CHECK(ring.empty());
+  CHECK_FALSE(ring.pop(v));
+  REQUIRE(ring.push(1));
+  REQUIRE(ring.push(2));
+  REQUIRE(ring.pop(v));
+  CHECK(v == 1);
+  REQUIRE(ring.pop(v));
+  CHECK(v == 2);
+  CHECK(ring.empty());
+}
+
+TEST_CASE("full ring rejects pushes until drained") {
+  SpscRing<int, 2> ring;
+  REQUIRE(ring.push(1));
+  REQUIRE(ring.push(2));
+  CHECK_FALSE(ring.push(3));
+  int v = 0;
+  REQUIRE(ring.pop(v));
+  CHECK(ring.push(3));
+  REQUIRE(ring.pop(v));
+  CHECK(v == 2);
+  REQUIRE(ring.pop(v));
+  CHECK(v == 3);
+}
+
+TEST_CASE("ring hands values across threads in order") {
+  SpscRing<int, 8> ring;
+  constexpr int kCount = 10000;
+  std::thread producer([&] {
+    for (int i = 0; i < kCount;) {
+      if (ring.push(i))
+        ++i;
+    }
+  });
+  int expected = 0;
+  bool ordered = true;
+  while (expected < kCount) {
+    int v = -1;
+    if (ring.pop(v)) {
+      ordered = ordered && v == expected;
+      ++expected;
+    }
+  }
+  producer.join();
+  CHECK(ordered);
+  CHECK(ring.empty());
+}
@@ -4,6 +4,9 @@
 #include <fstream>
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
 #include <unistd.h>
 #include "system_probe.h"
 
@@ -72,6 +75,81 @@ TEST_CASE("parse Cached missing returns nullopt") {
     REQUIRE_FALSE(v);
 }
 
+TEST_CASE("parseMeminfo fills all fields in one pass") {
+    ProbeSample s;
+    parseMeminfo("MemTotal:       456 kB\n"
+                 "MemFree:         77 kB\n"
+                 "MemAvailable:   123 kB\n"
+                 "Cached:          55 kB\n"
+                 "HugePages_Total:  0\n"
+                 "SwapFree:        10 kB\n",
+                 s);
+    REQUIRE(s.mem_total_kib);
+    REQUIRE(s.mem_free_kib);
+    REQUIRE(s.mem_available_kib);
+    REQUIRE(s.cached_kib);
+    REQUIRE(s.swap_free_kib);
+    CHECK(*s.mem_total_kib == 456);
+    CHECK(*s.mem_free_kib == 77);
+    CHECK(*s.mem_available_kib == 123);
+    CHECK(*s.cached_kib == 55);
+    CHECK(*s.swap_free_kib == 10);
+}
+
+TEST_CASE("parseMeminfo ignores malformed and similar keys") {
+    ProbeSample s;
+    parseMeminfo("SwapCached: 5 kB\nMemAvailable: abc kB\nno colon here\nCached: 9", s);
+    CHECK_FALSE(s.mem_available_kib);
+    CHECK_FALSE(s.swap_free_kib);
+    REQUIRE(s.cached_kib);
+    CHECK(*s.cached_kib == 9);
+}
+
+TEST_CASE("parseMeminfo fills the dense field array") {
+    ProbeSample s;
+    parseMeminfo("AnonPages:      300 kB\n"
+                 "Active(anon):   200 kB\n"
+                 "HugePages_Surp:   2\n"
+                 "SomeFutureKey:    9 kB\n",
+                 s);
+    REQUIRE(s.meminfoValue(MeminfoField::AnonPages));
+    CHECK(*s.meminfoValue(MeminfoField::AnonPages) == 300);
+    CHECK(*s.meminfoValue(MeminfoField::ActiveAnon) == 200);
+    CHECK(*s.meminfoValue(MeminfoField::HugePagesSurp) == 2);
+    CHECK_FALSE(s.meminfoValue(MeminfoField::Shmem));
+    CHECK_FALSE(s.mem_available_kib);
+    CHECK(findMeminfoField("Committed_AS") == MeminfoField::CommittedAs);
+    CHECK_FALSE(meminfoKey(MeminfoField::HugePagesTotal).kib);
+}
+
+TEST_CASE("parseVmstat sums reclaim counters without double counting") {
+    VmstatCounters c;
+    parseVmstat("workingset_refault_anon 10\n"
+                "workingset_refault_file 20\n"
+                "pswpin 3\npswpout 4\npgmajfault 5\n"
+                "pgscan_kswapd 100\npgscan_direct 50\npgscan_anon 120\npgscan_file 30\n"
+                "pgsteal_kswapd 80\npgsteal_direct 40\npgsteal_anon 100\n"
+                "allocstall_normal 2\nallocstall_movable 1\n",
+                c);
+    CHECK(c.refault_anon == 10);
+    CHECK(c.refault_file == 20);
+    CHECK(c.pswpin == 3);
+    CHECK(c.pswpout == 4);
+    CHECK(c.pgmajfault == 5);
+    CHECK(c.pgscan == 150);
+    CHECK(c.pgsteal == 120);
+    CHECK(c.allocstall == 3);
+
+    VmstatCounters later = c;
+    later.refault_file += 400;
+    later.pswpin += 20;
+    later.pgmajfault = 0; // went backwards
+    auto r = vmstatRates(c, later, 2.0);
+    CHECK(r.refault() == Catch::Approx(200.0));
+    CHECK(r.pswpin == Catch::Approx(10.0));
+    CHECK(r.pgmajfault == 0.0);
+}
+
 TEST_CASE("parse PSI memory some line") {
     std::string line = "some avg10=1.23 avg60=4.56 avg300=7.89 total=789";
     auto parsed = SystemProbe::parsePsiMemoryLine(line);
@@ -99,6 +177,27 @@ TEST_CASE("parse PSI memory invalid line returns nullopt") {
     REQUIRE_FALSE(parsed);
 }
 
+TEST_CASE("parsePsi reads some and full lines") {
+    std::optional<PsiValues> some, full;
+    SystemProbe::parsePsi("some avg10=1.50 avg60=0.00 avg300=0.00 total=12\n"
+                          "full avg10=0.25 avg60=0.00 avg300=0.00 total=3\n",
+                          some, full);
+    REQUIRE(some);
+    REQUIRE(full);
+    CHECK(some->avg10 == Catch::Approx(1.5));
+    CHECK(some->total == 12);
+    CHECK(full->avg10 == Catch::Approx(0.25));
+    CHECK(full->total == 3);
+}
+
+TEST_CASE("parsePsi leaves missing lines empty") {
+    std::optional<PsiValues> some, full;
+    SystemProbe::parsePsi("some avg10=0.10 avg60=0.20 avg300=0.30 total=4", some, full);
+    REQUIRE(some);
+    CHECK(some->avg300 == Catch::Approx(0.3));
+    CHECK_FALSE(full);
+}
+
 TEST_CASE("sample provides non-negative values") {
     SystemProbe probe;
     auto sOpt = probe.sample();
@@ -222,7 +321,9 @@ TEST_CASE("enableTriggers writes thresholds") {
     }
     SystemProbe probe(mem.string(), psi.string());
     SystemProbe::Trigger t{SystemProbe::PsiType::Some, 10, 100};
+    CHECK(probe.triggerFds().empty());
     REQUIRE(probe.enableTriggers(trig.string(), {t}));
+    CHECK(probe.triggerFds().size() == 1);
     std::ifstream in(trig);
     std::string line;
     std::getline(in, line);
@@ -338,3 +439,105 @@ TEST_CASE("sample processes triggers when enabled") {
     auto s = probe.sample();
     REQUIRE(s);
 }
+
+TEST_CASE("sample reads cpu, io and irq pressure next to memory PSI") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "psi_resources";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    fs::path mem = dir / "meminfo";
+    fs::path psi = dir / "memory";
+    {
+        std::ofstream out(mem);
+        out << "MemAvailable: 1 kB\n";
+    }
+    {
+        std::ofstream out(psi);
+        out << "some avg10=0 avg60=0 avg300=0 total=0\n";
+        out << "full avg10=0 avg60=0 avg300=0 total=0\n";
+    }
+    {
+        std::ofstream out(dir / "cpu");
+        out << "some avg10=12.50 avg60=0 avg300=0 total=100\n";
+    }
+    {
+        std::ofstream out(dir / "irq");
+        out << "full avg10=3.00 avg60=0 avg300=0 total=7\n";
+    }
+    SystemProbe probe(mem.string(), psi.string());
+    auto s = probe.sample();
+    REQUIRE(s);
+    REQUIRE(s->cpu.some);
+    CHECK(s->cpu.some->avg10 == Catch::Approx(12.5));
+    CHECK_FALSE(s->cpu.full);
+    CHECK_FALSE(s->io.avg10());
+    REQUIRE(s->irq.avg10());
+    CHECK(*s->irq.avg10() == Catch::Approx(3.0));
+    CHECK(s->irq.full->total == 7);
+}
+
+TEST_CASE("enableTriggers registers one descriptor per trigger and resource") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "psi_resource_triggers";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    fs::path mem = dir / "meminfo";
+    fs::path psi = dir / "memory";
+    for (const char* name : {"meminfo", "memory", "io"}) {
+        std::ofstream out(dir / name);
+    }
+    SystemProbe probe(mem.string(), psi.string());
+    SystemProbe::Trigger some{SystemProbe::PsiType::Some, 150000, 1000000};
+    SystemProbe::Trigger full{SystemProbe::PsiType::Full, 50000, 1000000};
+    REQUIRE(probe.enableTriggers(SystemProbe::PsiResource::Io, {some, full}));
+    CHECK(probe.triggerFds().size() == 2);
+    CHECK_FALSE(probe.enableTriggers(SystemProbe::PsiResource::Cpu, {some}));
+    CHECK(probe.triggerFds().size() == 2);
+
+    std::ifstream in(dir / "io");
+    std::string line1, line2;
+    std::getline(in, line1);
+    std::getline(in, line2);
+    CHECK(line1 == "some 150000 1000000");
+    CHECK(line2 == "full 50000 1000000");
+
+    const int fd = probe.triggerFds()[0];
+    probe.disableTriggers();
+    CHECK(probe.triggerFds().empty());
+    CHECK(fcntl(fd, F_GETFD) == -1);
+}
+
+TEST_CASE("sample reports vmstat rates once a window has passed") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "psi_vmstat";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    fs::path mem = dir / "meminfo";
+    fs::path psi = dir / "pressure";
+    fs::path vmstat = dir / "vmstat";
+    std::ofstream(mem) << "MemAvailable: 1 kB\n";
+    std::ofstream(psi) << "some avg10=0 avg60=0 avg300=0 total=0\n"
+                          "full avg10=0 avg60=0 avg300=0 total=0\n";
+    std::ofstream(vmstat) << "workingset_refault_file 1000\npswpin 0\n";
+
+    SystemProbe probe(mem.string(), psi.string());
+    auto first = probe.sample();
+    REQUIRE(first);
+    CHECK_FALSE(first->vmstat);
+
+    std::ofstream(vmstat) << "workingset_refault_file 2000\npswpin 0\n";
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    auto second = probe.sample();
+    REQUIRE(second);
+    REQUIRE(second->vmstat);
+    CHECK(second->vmstat->refault() > 0.0);
+    CHECK(second->vmstat->refault() <= 1000.0 / 0.6);
+    CHECK(second->vmstat->pswpin == 0.0);
+
+    // Too soon for a new window: the previous rates are repeated.
+    auto third = probe.sample();
+    REQUIRE(third);
+    REQUIRE(third->vmstat);
+    CHECK(third->vmstat->refault() == second->vmstat->refault());
+    fs::remove_all(dir);
+}
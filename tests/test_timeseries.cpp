@@ -0,0 +1,186 @@
+#include <catch2/catch_all.hpp>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include "timeseries.h"
+
+namespace {
+namespace fs = std::filesystem;
+
+constexpr std::int64_t kStart = 1700000000000;
+
+/// A day-like series at 1 Hz: memory drifts, pressure comes in bursts.
+std::vector<HistoryRecord> series(std::size_t n) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> drift(-64, 64);
+  std::vector<HistoryRecord> out;
+  HistoryRecord r;
+  r.present = HistoryRecord::MemAvailable | HistoryRecord::MemTotal |
+              HistoryRecord::MemFree | HistoryRecord::SwapFree |
+              HistoryRecord::Cached;
+  r.mem_total_kib = 16 * 1024 * 1024;
+  r.mem_available_kib = 8 * 1024 * 1024;
+  r.mem_free_kib = 2 * 1024 * 1024;
+  r.swap_free_kib = 4 * 1024 * 1024;
+  r.cached_kib = 3 * 1024 * 1024;
+  r.cpu_avg10 = 0.0;
+  r.io_avg10 = 0.0;
+  r.irq_avg10 = std::numeric_limits<double>::quiet_NaN();
+  for (std::size_t i = 0; i < n; ++i) {
+    r.time_ms = kStart + static_cast<std::int64_t>(i) * 1000;
+    r.mem_available_kib += drift(rng);
+    r.mem_free_kib += drift(rng);
+    r.cached_kib += drift(rng);
+    const bool burst = i % 3600 < 60;
+    r.some.avg10 = burst ? std::round((i % 60) * 0.37 * 100) / 100 : 0.0;
+    r.some.total += burst ? 12345 : 0;
+    r.state = static_cast<std::uint8_t>(burst && i % 60 > 30);
+    out.push_back(r);
+  }
+  return out;
+}
+
+bool sameBits(double a, double b) { return std::memcmp(&a, &b, sizeof(a)) == 0; }
+
+void checkEqual(const HistoryRecord &a, const HistoryRecord &b) {
+  CHECK(a.time_ms == b.time_ms);
+  CHECK(a.state == b.state);
+  CHECK(a.present == b.present);
+  CHECK(a.mem_available_kib == b.mem_available_kib);
+  CHECK(a.mem_total_kib == b.mem_total_kib);
+  CHECK(a.mem_free_kib == b.mem_free_kib);
+  CHECK(a.swap_free_kib == b.swap_free_kib);
+  CHECK(a.cached_kib == b.cached_kib);
+  CHECK(a.some.total == b.some.total);
+  CHECK(a.full.total == b.full.total);
+  CHECK(sameBits(a.some.avg10, b.some.avg10));
+  CHECK(sameBits(a.full.avg300, b.full.avg300));
+  CHECK(sameBits(a.irq_avg10, b.irq_avg10));
+  CHECK(sameBits(a.refault_per_sec, b.refault_per_sec));
+}
+} // namespace
+
+TEST_CASE("chunks round-trip extreme values") {
+  std::vector<HistoryRecord> in(5);
+  in[0].time_ms = kStart;
+  in[1].time_ms = kStart - 5000; // clock stepped back
+  in[1].mem_available_kib = std::numeric_limits<std::int64_t>::max();
+  in[2].time_ms = kStart + 1;
+  in[2].mem_available_kib = std::numeric_limits<std::int64_t>::min();
+  in[3].time_ms = kStart + 2;
+  in[3].some.avg10 = -0.0;
+  in[3].swapin_per_sec = std::numeric_limits<double>::infinity();
+  in[4].time_ms = kStart + 3;
+  in[4].some.avg10 = 1e-300;
+  in[4].state = 2;
+  in[4].present = HistoryRecord::Vmstat;
+
+  ChunkEncoder enc;
+  for (const auto &r : in)
+    enc.append(r);
+  CHECK(enc.count() == 5);
+  const std::string chunk = enc.finish();
+  CHECK(enc.count() == 0);
+
+  std::vector<HistoryRecord> out;
+  REQUIRE(decodeChunk(chunk, out));
+  REQUIRE(out.size() == in.size());
+  for (std::size_t i = 0; i < in.size(); ++i)
+    checkEqual(in[i], out[i]);
+
+  std::string corrupt = chunk;
+  corrupt.back() = static_cast<char>(corrupt.back() ^ 1);
+  CHECK_FALSE(decodeChunk(corrupt, out));
+  CHECK_FALSE(decodeChunk(chunk.substr(0, chunk.size() - 1), out));
+  CHECK(out.size() == in.size());
+}
+
+TEST_CASE("a day at 1 Hz compresses well and round-trips") {
+  const auto in = series(86400);
+  ChunkEncoder enc;
+  for (const auto &r : in)
+    enc.append(r);
+  const std::string chunk = enc.finish();
+  // The raw records take well over 100 bytes each.
+  CHECK(chunk.size() < in.size() * 12);
+
+  std::vector<HistoryRecord> out;
+  REQUIRE(decodeChunk(chunk, out));
+  REQUIRE(out.size() == in.size());
+  for (std::size_t i = 0; i < in.size(); i += 997)
+    checkEqual(in[i], out[i]);
+  checkEqual(in.back(), out.back());
+}
+
+TEST_CASE("TimeSeries queries only the chunks in range") {
+  fs::path path = fs::temp_directory_path() / "nohang_timeseries" / "a.bin";
+  fs::remove_all(path.parent_path());
+  const auto in = series(1050);
+  {
+    TimeSeries ts(path.string(), 100);
+    REQUIRE(ts.isOpen());
+    for (const auto &r : in)
+      ts.append(r);
+    CHECK(ts.chunks().size() == 10);
+
+    std::vector<HistoryRecord> out;
+    // Seconds 250..349 span chunks 2 and 3.
+    CHECK(ts.query(kStart + 250000, kStart + 349000, out) == 2);
+    REQUIRE(out.size() == 100);
+    checkEqual(out.front(), in[250]);
+    checkEqual(out.back(), in[349]);
+
+    // Pending records are included without touching a chunk.
+    CHECK(ts.query(kStart + 1020000, kStart + 2000000, out) == 0);
+    REQUIRE(out.size() == 30);
+    checkEqual(out.back(), in.back());
+  }
+  {
+    // Reopening reads only the headers; the pending tail was flushed.
+    TimeSeries ts(path.string(), 100);
+    REQUIRE(ts.chunks().size() == 11);
+    CHECK(ts.chunks().front().min_ms == kStart);
+    CHECK(ts.chunks().back().max_ms == in.back().time_ms);
+    std::vector<HistoryRecord> out;
+    CHECK(ts.query(std::numeric_limits<std::int64_t>::min(),
+                   std::numeric_limits<std::int64_t>::max(), out) == 11);
+    REQUIRE(out.size() == in.size());
+    checkEqual(out[777], in[777]);
+  }
+  {
+    // A chunk torn by a crash is dropped and appending carries on.
+    const auto size = fs::file_size(path);
+    fs::resize_file(path, size - 3);
+    TimeSeries ts(path.string(), 100);
+    CHECK(ts.chunks().size() == 10);
+    CHECK(ts.fileSize() < size);
+    ts.append(in.back());
+    REQUIRE(ts.flush());
+    std::vector<HistoryRecord> out;
+    CHECK(ts.query(in.back().time_ms, in.back().time_ms, out) == 1);
+    CHECK(out.size() == 1);
+  }
+  {
+    // A foreign file is refused and left as it was.
+    std::ofstream(path, std::ios::trunc) << "not a time series";
+    {
+      TimeSeries ts(path.string(), 100);
+      CHECK_FALSE(ts.isOpen());
+    }
+    std::ifstream in(path);
+    std::string content((std::istreambuf_iterator<char>(in)), {});
+    CHECK(content == "not a time series");
+  }
+  {
+    // An empty file is started afresh.
+    std::ofstream(path, std::ios::trunc);
+    TimeSeries ts(path.string(), 100);
+    REQUIRE(ts.isOpen());
+    CHECK(ts.chunks().empty());
+  }
+  fs::remove_all(path.parent_path());
+}
@@ -0,0 +1,72 @@
+#include <catch2/catch_all.hpp>
+#include "pressure_state.h"
+#include "system_probe.h"
+#include "tooltip_template.h"
+
+namespace {
+std::string render(const char *source, const ProbeSample &s,
+                   PressureState state = PressureState::Green) {
+  QString out;
+  TooltipTemplate::compile(source).render(s, state, out);
+  return out.toStdString();
+}
+} // namespace
+
+TEST_CASE("an empty source gives an empty template") {
+  CHECK(TooltipTemplate().empty());
+  CHECK(TooltipTemplate::compile("").empty());
+  CHECK_FALSE(TooltipTemplate::compile("x").empty());
+  CHECK(TooltipTemplate::compile("{state}").source() == "{state}");
+}
+
+TEST_CASE("fields are replaced by formatted readings") {
+  ProbeSample s;
+  s.mem_available_kib = 512 * 1024;
+  s.mem_total_kib = 16 * 1024 * 1024;
+  s.some.avg10 = 1.234;
+  s.full.avg300 = 0.5;
+  s.io.some = PsiValues{7.5, 0, 0, 0};
+  CHECK(render("{mem_available}/{mem_total} PSI {some.avg10}", s) ==
+        "512.0 MiB/16.0 GiB PSI 1.23");
+  CHECK(render("{state}: full {full.avg300}", s, PressureState::Orange) ==
+        "orange: full 0.50");
+  CHECK(render("io {io.avg10}, cpu {cpu.avg10}", s) == "io 7.50, cpu n/a");
+  CHECK(render("{swap_free} {refault}", s) == "n/a n/a");
+  s.vmstat = VmstatRates{};
+  s.vmstat->refault_anon = 10.4;
+  s.vmstat->refault_file = 20.2;
+  s.vmstat->allocstall = 3;
+  CHECK(render("{refault}/s, {allocstall}/s", s) == "31/s, 3/s");
+  CHECK(render("{seconds_to_critical} s", s) == "n/a s");
+  s.seconds_to_critical = 41.6;
+  CHECK(render("{seconds_to_critical} s", s) == "42 s");
+}
+
+TEST_CASE("any meminfo key is a field") {
+  ProbeSample s;
+  parseMeminfo("Shmem: 2048 kB\nHugePages_Total: 4\n", s);
+  CHECK(render("{Shmem} {HugePages_Total} {Dirty}", s) == "2.0 MiB 4 n/a");
+}
+
+TEST_CASE("escapes and unknown fields stay literal") {
+  ProbeSample s;
+  CHECK(render("a\\nb", s) == "a\nb");
+  CHECK(render("{{state}} {state}", s) == "{state} green");
+  CHECK(render("{nope} {state", s) == "{nope} {state");
+  CHECK(render("}", s) == "}");
+}
+
+TEST_CASE("rendering reuses the buffer") {
+  ProbeSample s;
+  s.mem_available_kib = 1024;
+  const auto t = TooltipTemplate::compile("{state} {mem_available} left");
+  QString out("stale text");
+  out.reserve(256);
+  const auto capacity = out.capacity();
+  t.render(s, PressureState::Red, out);
+  CHECK(out.toStdString() == "red 1.0 MiB left");
+  s.mem_available_kib = 2048;
+  t.render(s, PressureState::Red, out);
+  CHECK(out.toStdString() == "red 2.0 MiB left");
+  CHECK(out.capacity() == capacity);
+}
@@ -1,5 +1,6 @@
 #include <QApplication>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QIcon>
 #include <catch2/catch_all.hpp>
 #include <filesystem>
@@ -31,6 +32,8 @@ void applyPalette(Tray &tray) {
   tray.cfg_.palette.orange = resourcePath("res/icons/shield-orange.svg");
   tray.cfg_.palette.red = resourcePath("res/icons/shield-red.svg");
   tray.cfg_.palette.black = resourcePath("res/icons/shield-black.svg");
+  // Tests refresh back to back and expect every tooltip change at once.
+  tray.updates_.setTooltipInterval({});
 }
 
 struct StubProbe : SystemProbe {
@@ -279,13 +282,55 @@ TEST_CASE("Tray skips enabling PSI triggers when none configured") {
   REQUIRE_FALSE(std::getline(in, line));
 }
 
-TEST_CASE("Tray show makes icon visible and starts timer") {
+TEST_CASE("Tray reloads the configuration when the file changes") {
+  namespace fs = std::filesystem;
+  fs::path dir = fs::temp_directory_path() / "tray_reload";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  fs::path cfg = dir / "config.toml";
+  {
+    std::ofstream out(cfg);
+    out << "[mem]\navailable_warn_kib = 1000\n";
+  }
+  ProbeSample s;
+  Tray tray(nullptr, std::make_unique<StubProbe>(s),
+            QString::fromStdString(cfg.string()));
+  CHECK(tray.configWatcher_.files().contains(
+      QString::fromStdString(cfg.string())));
+  REQUIRE(tray.cfg_.mem.available_warn_kib == 1000);
+
+  {
+    std::ofstream out(cfg);
+    out << "[mem]\navailable_warn_kib = 2000\n";
+    out << "[ui]\nicon = \"sparkline\"\n";
+  }
+  QElapsedTimer elapsed;
+  elapsed.start();
+  while (tray.cfg_.mem.available_warn_kib != 2000 && elapsed.elapsed() < 5000)
+    QCoreApplication::processEvents(QEventLoop::AllEvents, 20);
+  CHECK(tray.cfg_.mem.available_warn_kib == 2000);
+  CHECK(tray.sparkline_);
+  // The sampler adopts it with its next tick.
+  tray.refresh();
+  CHECK(tray.sampler_->config().mem.available_warn_kib == 2000);
+
+  // Losing the file keeps the settings rather than reverting to defaults.
+  fs::remove(cfg);
+  tray.reloadConfig();
+  tray.reloadPool_.waitForDone();
+  QCoreApplication::processEvents();
+  CHECK(tray.cfg_.mem.available_warn_kib == 2000);
+  CHECK(tray.sparkline_);
+  fs::remove_all(dir);
+}
+
+TEST_CASE("Tray show makes icon visible and starts sampler") {
   ProbeSample s; // defaults ok
   Tray tray(nullptr, std::make_unique<StubProbe>(s));
   applyPalette(tray);
   tray.show();
   CHECK(tray.icon_.isVisible());
-  CHECK(tray.timer_.isActive());
+  CHECK(tray.sampler_->running());
   auto actual = tray.icon_.icon().pixmap(16, 16).toImage();
   auto expected = QIcon(tray.cfg_.palette.black).pixmap(16, 16).toImage();
   bool same = (actual == expected);
@@ -386,6 +431,128 @@ TEST_CASE("refresh caches tooltip until significant change") {
   CHECK(tray.icon_.toolTip() != initial);
 }
 
+TEST_CASE("palette icons are rendered once and reused") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_crit_kib - 1;
+  Tray tray(nullptr, std::make_unique<StubProbe>(s));
+  applyPalette(tray);
+  tray.refresh();
+  const auto red = tray.icons_.icons[1 + static_cast<int>(Tray::State::Red)];
+  REQUIRE_FALSE(red.isNull());
+  CHECK(tray.icon_.icon().cacheKey() == red.cacheKey());
+  auto actual = tray.icon_.icon().pixmap(16, 16).toImage();
+  auto expected = QIcon(tray.cfg_.palette.red).pixmap(16, 16).toImage();
+  bool same = (actual == expected);
+  CHECK(same);
+
+  tray.refresh();
+  CHECK(tray.icon_.icon().cacheKey() == red.cacheKey());
+
+  // A palette change rebuilds the cache.
+  tray.cfg_.palette.red = tray.cfg_.palette.orange;
+  tray.refresh();
+  CHECK(tray.icon_.icon().cacheKey() != red.cacheKey());
+  actual = tray.icon_.icon().pixmap(16, 16).toImage();
+  expected = QIcon(tray.cfg_.palette.orange).pixmap(16, 16).toImage();
+  same = (actual == expected);
+  CHECK(same);
+}
+
+TEST_CASE("refresh times each phase") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_kib * 2;
+  Tray tray(nullptr, std::make_unique<StubProbe>(s));
+  applyPalette(tray);
+  using Phase = TickProfiler::Phase;
+  tray.refresh();
+  tray.refresh();
+  CHECK(tray.profiler_.histogram(Phase::Decide).count() == 2);
+  // The cached tooltip is not rebuilt for an unchanged sample.
+  CHECK(tray.profiler_.histogram(Phase::Tooltip).count() == 1);
+  // Neither changed, so neither is pushed again.
+  CHECK(tray.profiler_.histogram(Phase::SetToolTip).count() == 1);
+  CHECK(tray.profiler_.histogram(Phase::SetIcon).count() == 1);
+  // The stub does not read /proc.
+  CHECK(tray.profiler_.histogram(Phase::ProbeRead).count() == 0);
+
+  emit tray.latencyMenu_->aboutToShow();
+  const auto actions = tray.latencyMenu_->actions();
+  REQUIRE(actions.size() == static_cast<int>(TickProfiler::kPhases) + 1);
+  CHECK(actions[0]->text() == "probe read: no samples");
+  CHECK(actions[2]->text().startsWith("decide: p50 "));
+  CHECK(actions.back()->text() == "Skipped updates: icon 1, tooltip 1");
+}
+
+TEST_CASE("tooltip changes are held to the minimum interval") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_kib * 4;
+  auto *probe = new StubProbe(s);
+  Tray tray(nullptr, std::unique_ptr<SystemProbe>(probe));
+  applyPalette(tray);
+  tray.updates_.setTooltipInterval(std::chrono::hours(1));
+  tray.refresh();
+  const auto first = tray.icon_.toolTip();
+  CHECK(first == tray.tooltipCache_);
+
+  // Same state, different text: deferred until the timer fires.
+  probe->s.mem_available_kib = cfg.mem.available_warn_kib * 3;
+  tray.refresh();
+  CHECK(tray.tooltipCache_ != first);
+  CHECK(tray.icon_.toolTip() == first);
+  CHECK(tray.tooltipTimer_.isActive());
+
+  // A state change is shown at once.
+  probe->s.mem_available_kib = cfg.mem.available_crit_kib - 1;
+  tray.refresh();
+  CHECK(tray.state_ == Tray::State::Red);
+  CHECK(tray.icon_.toolTip() == tray.tooltipCache_);
+  CHECK_FALSE(tray.tooltipTimer_.isActive());
+  CHECK(tray.updates_.skippedTooltips() == 1);
+}
+
+TEST_CASE("refresh renders the configured tooltip template") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_crit_kib - 1;
+  s.some.avg10 = 0.25;
+  auto *probe = new StubProbe(s);
+  Tray tray(nullptr, std::unique_ptr<SystemProbe>(probe));
+  applyPalette(tray);
+  tray.cfg_.ui.tooltip_template =
+      TooltipTemplate::compile("{state}: {mem_available}\\nsome {some.avg10}");
+  tray.refresh();
+  CHECK(tray.icon_.toolTip() == "red: 256.0 MiB\nsome 0.25");
+
+  probe->s.some.avg10 = 0.5;
+  tray.refresh();
+  CHECK(tray.icon_.toolTip() == "red: 256.0 MiB\nsome 0.50");
+
+  // Smaller moves than the built-in tooltip waits for still show.
+  probe->s.some.avg10 = 0.51;
+  tray.refresh();
+  CHECK(tray.icon_.toolTip() == "red: 256.0 MiB\nsome 0.51");
+}
+
+TEST_CASE("sparkline mode scrolls the graph into the icon") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_total_kib = cfg.mem.available_warn_kib * 4;
+  s.mem_available_kib = cfg.mem.available_warn_kib * 2;
+  Tray tray(nullptr, std::make_unique<StubProbe>(s));
+  applyPalette(tray);
+  tray.sparkline_ = std::make_unique<Sparkline>(2);
+  tray.refresh();
+  CHECK(tray.icon_.icon().cacheKey() == tray.sparkline_->icon().cacheKey());
+  tray.refresh();
+  tray.refresh();
+  // The third identical sample leaves the two-column graph unchanged.
+  CHECK(tray.profiler_.histogram(TickProfiler::Phase::SetIcon).count() == 2);
+  CHECK(tray.icon_.icon().cacheKey() == tray.sparkline_->icon().cacheKey());
+}
+
 TEST_CASE("refresh updates tooltip on threshold crossing") {
   AppConfig cfg;
   ProbeSample s;
@@ -459,3 +626,196 @@ TEST_CASE("refresh updates tooltip on PSI full change") {
   CHECK(tray.icon_.toolTip() != tip);
 }
 
+
+TEST_CASE("decide scales PSI rate by elapsed time") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_exit_kib + 1;
+  s.some.avg10 = 0.4;
+  // rise of 0.3 over 2s is 0.15/s, over 10s only 0.03/s
+  CHECK(Tray::decide(s, cfg, Tray::State::Green, 0.1, 2.0) ==
+        Tray::State::Yellow);
+  CHECK(Tray::decide(s, cfg, Tray::State::Green, 0.1, 10.0) ==
+        Tray::State::Green);
+  // sub-second gaps are measured against the kernel's 2s update period
+  s.some.avg10 = 0.2;
+  CHECK(Tray::decide(s, cfg, Tray::State::Green, 0.1, 0.01) ==
+        Tray::State::Green);
+}
+
+TEST_CASE("decide warns when critical is forecast within the horizon") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_exit_kib * 4;
+  s.seconds_to_critical = cfg.forecast.horizon_sec + 1;
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Green);
+  s.seconds_to_critical = cfg.forecast.horizon_sec - 1;
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Yellow);
+  // Once warned, the forecast must recede past the exit horizon.
+  s.seconds_to_critical = cfg.forecast.horizon_exit_sec - 1;
+  CHECK(Tray::decide(s, cfg, Tray::State::Yellow) == Tray::State::Yellow);
+  s.seconds_to_critical = cfg.forecast.horizon_exit_sec + 1;
+  CHECK(Tray::decide(s, cfg, Tray::State::Yellow) == Tray::State::Green);
+  cfg.forecast.horizon_sec = 0;
+  s.seconds_to_critical = 1;
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Green);
+}
+
+TEST_CASE("buildTooltip shows the time to critical") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_kib;
+  auto tooltip = Tray::buildTooltip(s, cfg, Tray::State::Green).toStdString();
+  CHECK(tooltip.find("to critical") == std::string::npos);
+  s.seconds_to_critical = 41.7;
+  tooltip = Tray::buildTooltip(s, cfg, Tray::State::Yellow).toStdString();
+  CHECK(tooltip.find("\u2248 42 s to critical\n") != std::string::npos);
+  s.seconds_to_critical = 600;
+  tooltip = Tray::buildTooltip(s, cfg, Tray::State::Yellow).toStdString();
+  CHECK(tooltip.find("\u2248 10 min to critical\n") != std::string::npos);
+}
+
+TEST_CASE("refresh adapts sampling interval to pressure") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_crit_kib - 1;
+  auto *probe = new StubProbe(s);
+  Tray tray(nullptr, std::unique_ptr<SystemProbe>(probe));
+  applyPalette(tray);
+  CHECK(tray.sampler_->interval() == cfg.sample_interval_ms);
+  tray.refresh();
+  CHECK(tray.sampler_->interval() == cfg.sample.min_interval_ms);
+  CHECK(tray.state_ == Tray::State::Red);
+}
+
+TEST_CASE("decide accounts for cpu, io and irq pressure") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_kib * 2;
+
+  // Off by default: a CPU-bound build with free memory stays Green.
+  s.cpu.some = PsiValues{100.0, 0, 0, 0};
+  s.io.some = PsiValues{100.0, 0, 0, 0};
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Green);
+  s.io.some.reset();
+
+  cfg.psi.cpu = {40.0, 32.0, 80.0, 64.0, {}};
+  cfg.psi.io = {20.0, 16.0, 50.0, 40.0, {}};
+  cfg.psi.irq = {10.0, 8.0, 30.0, 24.0, {}};
+  s.cpu.some = PsiValues{cfg.psi.cpu.avg10_crit + 1.0, 0, 0, 0};
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Orange);
+  s.cpu.some->avg10 = cfg.psi.cpu.avg10_warn + 1.0;
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Yellow);
+  // between crit exit and crit keeps Orange once entered
+  s.cpu.some->avg10 = cfg.psi.cpu.avg10_crit_exit + 1.0;
+  CHECK(Tray::decide(s, cfg, Tray::State::Orange) == Tray::State::Orange);
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Yellow);
+  s.cpu.some.reset();
+
+  s.io.some = PsiValues{cfg.psi.io.avg10_warn_exit + 0.5, 0, 0, 0};
+  CHECK(Tray::decide(s, cfg, Tray::State::Yellow) == Tray::State::Yellow);
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Green);
+  s.io.some.reset();
+
+  // irq only reports a "full" line
+  s.irq.full = PsiValues{cfg.psi.irq.avg10_crit, 0, 0, 0};
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Orange);
+}
+
+TEST_CASE("buildTooltip lists cpu, io and irq pressure when available") {
+  AppConfig cfg;
+  cfg.psi.io.trigger.some = AppConfig::Psi::Trigger{150000, 1000000};
+  ProbeSample s;
+  s.cpu.some = PsiValues{12.5, 0, 0, 0};
+  auto tip = Tray::buildTooltip(s, cfg, Tray::State::Green).toStdString();
+  CHECK(tip.find("PSI cpu avg10: 12.50\n") != std::string::npos);
+  cfg.psi.cpu = {40.0, 32.0, 80.0, 64.0, {}};
+  tip = Tray::buildTooltip(s, cfg, Tray::State::Green).toStdString();
+  CHECK(tip.find("PSI cpu avg10: 12.50 (warn 40.00, crit 80.00)") !=
+        std::string::npos);
+  CHECK(tip.find("PSI io avg10") == std::string::npos);
+  CHECK(tip.find("trigger io some: 150000us/1000000us") != std::string::npos);
+}
+
+TEST_CASE("buildTooltip lists the worst cgroups") {
+  AppConfig cfg;
+  ProbeSample s;
+  CgroupSample cg;
+  cg.path = "user.slice";
+  cg.current_kib = 2 * 1024 * 1024;
+  cg.max_kib = 8L * 1024 * 1024;
+  cg.high_kib = 4L * 1024 * 1024;
+  cg.some.avg10 = 3.25;
+  s.cgroups.push_back(cg);
+  auto tip = Tray::buildTooltip(s, cfg, Tray::State::Green).toStdString();
+  CHECK(tip.find("cgroup user.slice: 2.0 GiB / 4.0 GiB, PSI some 3.25") !=
+        std::string::npos);
+}
+
+TEST_CASE("buildTooltip lists the largest processes") {
+  AppConfig cfg;
+  ProbeSample s;
+  ProcessSample p;
+  p.pid = 4242;
+  p.name = "firefox";
+  p.rss_kib = 2 * 1024 * 1024;
+  p.pss_kib = 1024 * 1024;
+  s.processes.push_back(p);
+  auto tip = Tray::buildTooltip(s, cfg, Tray::State::Orange).toStdString();
+  CHECK(tip.find("proc 4242 firefox: RSS 2.0 GiB, PSS 1.0 GiB") !=
+        std::string::npos);
+  CHECK(tip.find("swap") == std::string::npos);
+}
+
+TEST_CASE("buildTooltip lists configured meminfo fields") {
+  AppConfig cfg;
+  cfg.ui.meminfo_fields = {MeminfoField::Shmem, MeminfoField::HugePagesFree,
+                           MeminfoField::Dirty};
+  ProbeSample s;
+  parseMeminfo("Shmem: 2048 kB\nHugePages_Free: 3\n", s);
+  auto tip = Tray::buildTooltip(s, cfg, Tray::State::Green).toStdString();
+  CHECK(tip.find("Shmem: 2.0 MiB\n") != std::string::npos);
+  CHECK(tip.find("HugePages_Free: 3\n") != std::string::npos);
+  CHECK(tip.find("Dirty: n/a\n") != std::string::npos);
+  CHECK(tip.find("AnonPages") == std::string::npos);
+}
+
+TEST_CASE("refresh rebuilds the tooltip when a listed meminfo field moves") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_kib * 4;
+  parseMeminfo("Dirty: 2048 kB\n", s);
+  auto *probe = new StubProbe(s);
+  Tray tray(nullptr, std::unique_ptr<SystemProbe>(probe));
+  applyPalette(tray);
+  tray.cfg_.ui.meminfo_fields = {MeminfoField::Dirty};
+  tray.refresh();
+  CHECK(tray.tooltipCache_.contains("Dirty: 2.0 MiB\n"));
+
+  // Nothing else the tooltip shows has changed.
+  parseMeminfo("Dirty: 4096 kB\n", probe->s);
+  tray.refresh();
+  CHECK(tray.tooltipCache_.contains("Dirty: 4.0 MiB\n"));
+}
+
+TEST_CASE("decide raises Orange on thrashing with hysteresis") {
+  AppConfig cfg;
+  ProbeSample s;
+  s.mem_available_kib = cfg.mem.available_warn_kib * 2;
+  s.vmstat = VmstatRates{};
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Green);
+
+  s.vmstat->refault_file = cfg.thrash.refault_per_sec;
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Orange);
+  s.vmstat->refault_file = cfg.thrash.refault_exit_per_sec + 1.0;
+  CHECK(Tray::decide(s, cfg, Tray::State::Orange) == Tray::State::Orange);
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Green);
+  s.vmstat->refault_file = 0.0;
+
+  s.vmstat->pswpin = cfg.thrash.swapin_per_sec;
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Orange);
+  s.vmstat->pswpin = 0.0;
+
+  s.vmstat->allocstall = cfg.thrash.allocstall_per_sec;
+  CHECK(Tray::decide(s, cfg, Tray::State::Green) == Tray::State::Orange);
+}
@@ -0,0 +1,63 @@
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include "update_coalescer.h"
+
+using namespace std::chrono_literals;
+using Tooltip = UpdateCoalescer::Tooltip;
+
+TEST_CASE("icon is pushed only when its key changes") {
+  UpdateCoalescer c;
+  CHECK(c.offerIcon(1));
+  CHECK_FALSE(c.offerIcon(1));
+  CHECK_FALSE(c.offerIcon(1));
+  CHECK(c.offerIcon(2));
+  CHECK(c.offerIcon(1));
+  CHECK(c.skippedIcons() == 2);
+  c.reset();
+  CHECK(c.offerIcon(1));
+}
+
+TEST_CASE("unchanged tooltip text is skipped") {
+  UpdateCoalescer c(1000ms);
+  const auto t0 = UpdateCoalescer::Clock::time_point{} + 1h;
+  CHECK(c.offerTooltip("a", t0) == Tooltip::Push);
+  CHECK(c.offerTooltip("a", t0 + 5s) == Tooltip::Skip);
+  CHECK(c.offerTooltip("b", t0 + 6s) == Tooltip::Push);
+  CHECK(c.skippedTooltips() == 1);
+}
+
+TEST_CASE("tooltip changes within the interval are deferred") {
+  UpdateCoalescer c(1000ms);
+  const auto t0 = UpdateCoalescer::Clock::time_point{} + 1h;
+  CHECK(c.offerTooltip("a", t0) == Tooltip::Push);
+  CHECK(c.offerTooltip("b", t0 + 100ms) == Tooltip::Defer);
+  CHECK(c.offerTooltip("c", t0 + 200ms) == Tooltip::Defer);
+  CHECK(c.tooltipWait(t0 + 200ms) == 800ms);
+  CHECK_FALSE(c.flushTooltip(t0 + 500ms));
+  auto text = c.flushTooltip(t0 + 1000ms);
+  REQUIRE(text);
+  CHECK(*text == "c");
+  CHECK_FALSE(c.flushTooltip(t0 + 2000ms));
+  // "b" was never shown.
+  CHECK(c.skippedTooltips() == 1);
+}
+
+TEST_CASE("urgent tooltips bypass the interval") {
+  UpdateCoalescer c(1000ms);
+  const auto t0 = UpdateCoalescer::Clock::time_point{} + 1h;
+  CHECK(c.offerTooltip("a", t0) == Tooltip::Push);
+  CHECK(c.offerTooltip("b", t0 + 100ms) == Tooltip::Defer);
+  CHECK(c.offerTooltip("c", t0 + 200ms, true) == Tooltip::Push);
+  // The deferred text was superseded.
+  CHECK_FALSE(c.flushTooltip(t0 + 2000ms));
+}
+
+TEST_CASE("a reverted change cancels the pending tooltip") {
+  UpdateCoalescer c(1000ms);
+  const auto t0 = UpdateCoalescer::Clock::time_point{} + 1h;
+  CHECK(c.offerTooltip("a", t0) == Tooltip::Push);
+  CHECK(c.offerTooltip("b", t0 + 100ms) == Tooltip::Defer);
+  CHECK(c.offerTooltip("a", t0 + 200ms) == Tooltip::Skip);
+  CHECK_FALSE(c.flushTooltip(t0 + 2000ms));
+  CHECK(c.skippedTooltips() == 2);
+}
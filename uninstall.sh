@@ -8,6 +8,8 @@ prefix=${1:-/usr/local}
 
 echo "[uninstall] removing binary"
 sudo rm -f "$prefix/bin/nohang-tr"
+sudo rm -f "$prefix/bin/nohang-tr-agent"
+sudo rm -f "$prefix/bin/nohang-tr-replay"
 
 echo "[uninstall] removing desktop entry"
 sudo rm -f "$prefix/share/applications/nohang-tr.desktop"